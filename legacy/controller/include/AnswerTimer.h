@@ -0,0 +1,86 @@
+/**
+ * @file AnswerTimer.h
+ * @brief 最初の押下からの解答時間を計るクラス（ANSWER）
+ *
+ * ラウンドで最初に受け付けた押下の時刻から制限時間を計り、切れた時点で answerTimeout を送る
+ * サーバーのタイマーはシリアルの転送（9600bps で数十ミリ秒）の後に始まり、負荷で揺らぐため、
+ * 計時はコントローラー側で押下と同じ時刻（SerialCommunicator::getTimestamp()）を起点にして行う
+ * - 解答中のボタンの LED は点灯したまま、残りが ANSWER_WARNING_MS を切ったら ANSWER_BLINK_MS の周期で点滅し、
+ *   時間切れで消灯する
+ * - 計時は1ラウンドに1回だけで、RESET（ラウンドの切り替え）と ANSWER STOP で止まる
+ * - 同着の規則で先頭が入れ替わった場合は、起点はそのままで解答中のボタンを移す
+ * - ウォッチドッグ復帰で復元したラウンドでは計時しない
+ * 判定はメインループで行うため、時間切れの検出の遅れはループ1周分（通常 1 ミリ秒未満）
+ */
+
+#ifndef ANSWER_TIMER_H
+#define ANSWER_TIMER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ButtonManager.h"
+#include "SerialCommunicator.h"
+#include "config.h"
+
+class AnswerTimer
+{
+public:
+    /**
+     * @brief 設定できる制限時間の上限（ミリ秒）
+     */
+    static const unsigned long MAX_LIMIT_MS = 3600000UL;
+
+    /**
+     * @brief コンストラクタ
+     */
+    AnswerTimer();
+
+    /**
+     * @brief 現在のラウンドを計時済みとする（setup() の最後に呼ぶ）
+     *
+     * 復元したラウンドの押下は時刻が古いため、そこから計時し直さない
+     * @param buttonManager ボタン入力管理
+     */
+    void begin(const ButtonManager &buttonManager);
+
+    /**
+     * @brief メインループで呼び出し、最初の押下で計時を始め、LED の点滅と時間切れを処理する
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     */
+    void update(ButtonManager &buttonManager, SerialCommunicator &serialComm);
+
+    /**
+     * @brief 制限時間を設定する（計時中の分には影響しない）
+     * @param limitMs 制限時間（ミリ秒、0 で計時しない）
+     * @return 範囲外（MAX_LIMIT_MS を超える）の場合 false
+     */
+    bool setLimit(unsigned long limitMs);
+
+    /**
+     * @brief 計時を止める（サーバーが正誤を判定した場合、ANSWER STOP）
+     *
+     * 解答中のボタンの LED は点灯に戻す
+     * @param buttonManager ボタン入力管理
+     */
+    void stop(ButtonManager &buttonManager);
+
+    /**
+     * @brief 計時の状態を送信する（ANSWER コマンドの応答）
+     * @param serialComm シリアル通信管理
+     */
+    void send(const SerialCommunicator &serialComm) const;
+
+private:
+    unsigned long limit;     // 次の計時に使う制限時間（ミリ秒）
+    uint16_t seenRound;      // 最後に見たラウンド番号
+    bool started;            // このラウンドで計時を始めたか（押下がなければ false）
+    bool running;            // 計時中か
+    bool expired;            // このラウンドで時間切れになったか
+    uint8_t buttonId;        // 解答中のボタンID
+    unsigned long startedAt; // 計時の起点（最初の押下の時刻、ミリ秒）
+    unsigned long duration;  // 計時中の制限時間（ミリ秒）
+    bool ledOn;              // 解答中のボタンの LED の状態
+};
+
+#endif // ANSWER_TIMER_H
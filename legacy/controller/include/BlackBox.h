@@ -0,0 +1,154 @@
+/**
+ * @file BlackBox.h
+ * @brief 直近の動作（起動・リセット・押下・エラー）を EEPROM に残すクラス（DUMP）
+ *
+ * 結果に異議が出たときにコントローラー側で何が起きたかを確かめるための記録
+ * SerialCommunicator が送るイベントをそのまま1件ずつ記録する（形式は lib/QuizBlackBox）
+ * - EEPROM の BLACK_BOX_EEPROM_ADDRESS から BLACK_BOX_EEPROM_SIZE バイトをリングバッファとして使い、
+ *   最古の件から順に上書きする（全てのセルを均等に書き換えるため、特定の番地だけが寿命に達することはない）
+ *   先頭の位置は保存せず、起動時に全件を読んで通し番号が最新の件の次とする
+ * - record() は RAM のキューに積むだけで、EEPROM への書き込みはメインループの update() で行う
+ *   記録が BLACK_BOX_FLUSH_MS 途切れてから（キューが半分埋まった場合はすぐに）、
+ *   書き込みが終わっているときだけ1バイトずつ書くので、押下の判定もメインループも待たせない
+ * - 書き込みの前に電源が落ちた件は失われ、書き込み途中の件は CRC が合わないため読み飛ばす
+ *
+ * DUMP では JSON の blackBox フレームに続けて、古い順の全件をバイナリのまま送る
+ * 送信バッファの空きに合わせて書き出し、その間はイベントの書き出しを保留する
+ */
+
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <QuizBlackBox.h>
+#include "SerialCommunicator.h"
+#include "config.h"
+
+class BlackBox
+{
+public:
+    /**
+     * @brief EEPROM に保存できる件数
+     */
+    static const uint8_t SLOT_COUNT = BLACK_BOX_EEPROM_SIZE / BLACK_BOX_ENTRY_SIZE;
+
+    /**
+     * @brief コンストラクタ
+     */
+    BlackBox();
+
+    /**
+     * @brief EEPROM から最新の件を探し、起動を記録する（setup() でイベントを送る前に呼ぶ）
+     * @param resetFlags リセット要因（RecoveryStore::getResetFlags()）
+     */
+    void begin(uint8_t resetFlags);
+
+    /**
+     * @brief 1件を記録する（SerialCommunicator がイベントごとに呼ぶ）
+     *
+     * キューに積むだけで EEPROM には書かない。キューが満杯なら捨てて通し番号だけ進める
+     * @param type 種類（BlackBoxType）
+     * @param buttonId ボタンID
+     * @param round ラウンド番号
+     * @param seq イベントのシーケンス番号
+     * @param timestamp 時刻（ミリ秒）
+     * @param detail 種類ごとの付加情報
+     */
+    void record(uint8_t type, uint8_t buttonId, uint16_t round, uint16_t seq, unsigned long timestamp,
+                uint16_t detail);
+
+    /**
+     * @brief メインループで呼び出し、キューの記録を EEPROM に書く（DUMP 中はバイナリを書き出す）
+     * @param serialComm シリアル通信管理
+     */
+    void update(SerialCommunicator &serialComm);
+
+    /**
+     * @brief blackBox フレームを送り、全件のバイナリの書き出しを始める（DUMP コマンド）
+     *
+     * キューにあってまだ EEPROM に書いていない件も含める。書き出しの間は EEPROM に書かない
+     * @param serialComm シリアル通信管理
+     */
+    void startDump(SerialCommunicator &serialComm);
+
+    /**
+     * @brief バイナリを書き出している途中かを取得
+     *
+     * 途中の間は他のフレームを書き出さないこと（コマンドの応答も含む）
+     * @return 書き出し中なら true
+     */
+    bool isSending() const;
+
+private:
+    uint8_t nextSlot;         // 次に書く EEPROM の位置（最古の件）
+    uint16_t nextIndex;       // 次に記録する件の通し番号
+    unsigned long overflows;  // キューが満杯で捨てた件数（起動からの累計）
+    unsigned long recordedAt; // 最後に記録した時刻（millis()）
+
+    BlackBoxEntry queue[BLACK_BOX_QUEUE_SIZE]; // EEPROM に書く前の件（リングバッファ）
+    uint8_t queueHead;                         // 最古の件の位置
+    uint8_t queueCount;                        // 件数
+
+    uint8_t writeBuffer[BLACK_BOX_ENTRY_SIZE]; // 書き込み中の件（符号化済み）
+    uint8_t writeOffset;                       // 書き込んだバイト数
+    bool writing;                              // キューの先頭を書き込み中か
+
+    bool dumping;                             // バイナリを書き出し中か
+    uint8_t dumpSlot;                         // 次に読む EEPROM の位置（nextSlot からの件数）
+    uint8_t dumpQueued;                       // 書き出したキューの件数
+    uint8_t dumpQueueCount;                   // 書き出すキューの件数（DUMP の時点）
+    uint8_t dumpBuffer[BLACK_BOX_ENTRY_SIZE]; // 書き出し中の件
+    uint8_t dumpOffset;                       // dumpBuffer のうち書き出したバイト数
+
+    /**
+     * @brief EEPROM の位置から1件を読み出す
+     * @param slot 位置
+     * @param bytes 読み出し先
+     * @return CRC が一致した場合 true
+     */
+    static bool readSlot(uint8_t slot, uint8_t *bytes);
+
+    /**
+     * @brief 書き出しの位置を先頭（最古の件）に戻す
+     */
+    void rewindDump();
+
+    /**
+     * @brief 書き出す次の件を dumpBuffer に読み込む（EEPROM の古い順、続けてキュー）
+     * @return 件がある場合 true
+     */
+    bool loadDumpEntry();
+
+    /**
+     * @brief キューの先頭の件を1バイト書き込む
+     */
+    void writeQueued();
+
+    /**
+     * @brief バイナリを送信バッファの空きの分だけ書き出す
+     * @param serialComm シリアル通信管理
+     */
+    void writeDump(SerialCommunicator &serialComm);
+
+    /**
+     * @brief DUMP の先頭に送る blackBox フレームの内容（2回書く場合も同じ値にする）
+     */
+    struct Header
+    {
+        uint16_t entries;        // 送る件数
+        uint16_t next;           // 次に記録する件の通し番号
+        unsigned long overflows; // キューが満杯で捨てた件数
+        uint16_t crc;            // 送る件の CRC-16
+        unsigned long timestamp;
+    };
+
+    /**
+     * @brief blackBox フレームの本文を書く（SerialCommunicator::FrameBody）
+     * @param writer 書き出し先
+     * @param context Header
+     */
+    static void writeHeader(JsonFrameWriter &writer, const void *context);
+};
+
+#endif // BLACK_BOX_H
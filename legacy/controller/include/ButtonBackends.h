@@ -0,0 +1,319 @@
+/**
+ * @file ButtonBackends.h
+ * @brief ButtonManager のボタン入力・LED出力・デバウンス方式の実装
+ *
+ * ButtonManagerT のテンプレート引数として使う
+ * - PinMapInput / PinMapLeds: ピン配置をコンパイル時に決める（ポート操作が展開され、設定ミスは static_assert になる）
+ * - ConfigInput / ConfigLeds: ButtonConfig のピン配置を実行時に使う（EEPROM などから設定する場合）
+ *
+ * ピン番号からポートへの変換は ATmega328P（Uno / Nano）のピン配置を前提とする
+ */
+
+#ifndef BUTTON_BACKENDS_H
+#define BUTTON_BACKENDS_H
+
+#include <Arduino.h>
+#include "ButtonConfig.h"
+#include "config.h"
+
+// ===== ピン番号とポートの対応（ATmega328P） =====
+
+/**
+ * @brief ピン番号が有効か（D0-D13, A0-A5）
+ */
+constexpr bool isValidPin(uint8_t pin)
+{
+    return pin < 20;
+}
+
+/**
+ * @brief ピンのポート内ビットマスク
+ */
+constexpr uint8_t pinBitMask(uint8_t pin)
+{
+    return (uint8_t)(1 << (pin < 8 ? pin : (pin < 14 ? pin - 8 : pin - 14)));
+}
+
+/**
+ * @brief ピンの入力レジスタ（PINx）
+ */
+inline volatile uint8_t &pinInputRegister(uint8_t pin)
+{
+    return pin < 8 ? PIND : (pin < 14 ? PINB : PINC);
+}
+
+/**
+ * @brief ピンの出力レジスタ（PORTx）
+ */
+inline volatile uint8_t &pinOutputRegister(uint8_t pin)
+{
+    return pin < 8 ? PORTD : (pin < 14 ? PORTB : PORTC);
+}
+
+// ===== ピン配置 =====
+
+/**
+ * @brief config.h で定義したピン配置
+ */
+struct ConfigPinMap
+{
+    static constexpr uint8_t button(uint8_t index)
+    {
+        return index == 0 ? BUTTON_1_PIN
+             : index == 1 ? BUTTON_2_PIN
+             : index == 2 ? BUTTON_3_PIN
+             : index == 3 ? BUTTON_4_PIN
+             : index == 4 ? BUTTON_5_PIN
+                          : BUTTON_6_PIN;
+    }
+
+    static constexpr uint8_t led(uint8_t index)
+    {
+        return index == 0 ? LED_1_PIN
+             : index == 1 ? LED_2_PIN
+             : index == 2 ? LED_3_PIN
+             : index == 3 ? LED_4_PIN
+             : index == 4 ? LED_5_PIN
+                          : LED_6_PIN;
+    }
+};
+
+/**
+ * @brief ピン配置のコンパイル時検証
+ * @tparam Map button(i) / led(i) を持つピン配置
+ * @tparam N ボタン数
+ */
+template <class Map, uint8_t N>
+struct PinMapCheck
+{
+    static constexpr bool buttonsValid(uint8_t i = 0)
+    {
+        return i >= N || (isValidPin(Map::button(i)) && buttonsValid(i + 1));
+    }
+
+    static constexpr bool ledsValid(uint8_t i = 0)
+    {
+        return i >= N || (isValidPin(Map::led(i)) && ledsValid(i + 1));
+    }
+
+    static constexpr bool buttonsUnique(uint8_t i = 0, uint8_t j = 1)
+    {
+        return i >= N ? true
+             : j >= N ? buttonsUnique(i + 1, i + 2)
+                      : Map::button(i) != Map::button(j) && buttonsUnique(i, j + 1);
+    }
+
+    static constexpr bool ledsUnique(uint8_t i = 0, uint8_t j = 1)
+    {
+        return i >= N ? true
+             : j >= N ? ledsUnique(i + 1, i + 2)
+                      : Map::led(i) != Map::led(j) && ledsUnique(i, j + 1);
+    }
+
+    static constexpr bool ledsDisjointFromButtons(uint8_t i = 0, uint8_t j = 0)
+    {
+        return i >= N ? true
+             : j >= N ? ledsDisjointFromButtons(i + 1, 0)
+                      : Map::led(i) != Map::button(j) && ledsDisjointFromButtons(i, j + 1);
+    }
+};
+
+// ===== ボタン入力 =====
+
+/**
+ * @brief ピン配置を展開して読み取るボタン入力
+ */
+template <class Map, uint8_t N>
+class PinMapInput
+{
+    static_assert(PinMapCheck<Map, N>::buttonsValid(), "Button pin out of range (D0-D13, A0-A5)");
+    static_assert(PinMapCheck<Map, N>::buttonsUnique(), "Two buttons share the same pin");
+
+    template <uint8_t I, bool Dummy = true>
+    struct Reader
+    {
+        static inline uint8_t read()
+        {
+            // LOW = 押下
+            return Reader<I - 1>::read() |
+                   ((pinInputRegister(Map::button(I - 1)) & pinBitMask(Map::button(I - 1))) ? 0 : (uint8_t)(1 << (I - 1)));
+        }
+    };
+
+    template <bool Dummy>
+    struct Reader<0, Dummy>
+    {
+        static inline uint8_t read() { return 0; }
+    };
+
+public:
+    /**
+     * @brief ボタンピンを初期化
+     * @return 常に true
+     */
+    static bool begin(const ButtonConfig &)
+    {
+        for (uint8_t i = 0; i < N; i++)
+        {
+            pinMode(Map::button(i), INPUT_PULLUP);
+        }
+        return true;
+    }
+
+    /**
+     * @brief 全ボタンの状態を読み取る（割り込みに展開される）
+     * @return 押下中のボタン（bit i = ボタン i）
+     */
+    static inline uint8_t read() { return Reader<N>::read(); }
+};
+
+/**
+ * @brief ButtonConfig のピン配置を実行時に読み取るボタン入力
+ */
+class ConfigInput
+{
+public:
+    /**
+     * @brief ButtonConfig のピン配置を取り込み、ボタンピンを初期化
+     * @param config ボタン設定
+     * @return ピン配置が有効な場合 true
+     */
+    static bool begin(const ButtonConfig &config);
+
+    /**
+     * @brief 全ボタンの状態を読み取る（割り込みに展開される）
+     * @return 押下中のボタン（bit i = ボタン i）
+     */
+    static inline uint8_t read()
+    {
+        uint8_t mask = 0;
+        for (uint8_t i = 0; i < buttonCount; i++)
+        {
+            // LOW = 押下
+            if (!(*inputRegs[i] & inputBits[i]))
+            {
+                mask |= (uint8_t)(1 << i);
+            }
+        }
+        return mask;
+    }
+
+private:
+    static volatile uint8_t *inputRegs[MAX_BUTTONS];
+    static uint8_t inputBits[MAX_BUTTONS];
+    static uint8_t buttonCount;
+};
+
+// ===== LED出力 =====
+
+/**
+ * @brief ピン配置を展開して操作する LED 出力
+ */
+template <class Map, uint8_t N>
+class PinMapLeds
+{
+    static_assert(PinMapCheck<Map, N>::ledsValid(), "LED pin out of range (D0-D13, A0-A5)");
+    static_assert(PinMapCheck<Map, N>::ledsUnique(), "Two LEDs share the same pin");
+    static_assert(PinMapCheck<Map, N>::ledsDisjointFromButtons(), "An LED pin is also used as a button pin");
+
+    template <uint8_t I, bool Dummy = true>
+    struct Writer
+    {
+        static inline void set(uint8_t index, bool on)
+        {
+            if (index == I - 1)
+            {
+                if (on)
+                {
+                    pinOutputRegister(Map::led(I - 1)) |= pinBitMask(Map::led(I - 1));
+                }
+                else
+                {
+                    pinOutputRegister(Map::led(I - 1)) &= (uint8_t)~pinBitMask(Map::led(I - 1));
+                }
+                return;
+            }
+            Writer<I - 1>::set(index, on);
+        }
+    };
+
+    template <bool Dummy>
+    struct Writer<0, Dummy>
+    {
+        static inline void set(uint8_t, bool) {}
+    };
+
+public:
+    /**
+     * @brief LEDピンを出力に設定して消灯
+     */
+    static void begin(const ButtonConfig &)
+    {
+        for (uint8_t i = 0; i < N; i++)
+        {
+            pinMode(Map::led(i), OUTPUT);
+            digitalWrite(Map::led(i), LOW);
+        }
+    }
+
+    /**
+     * @brief LEDを点灯・消灯
+     * @param index ボタンのインデックス
+     * @param on true: 点灯
+     */
+    static void set(uint8_t index, bool on) { Writer<N>::set(index, on); }
+};
+
+/**
+ * @brief LEDなし（ENABLE_LED_FEEDBACK が無効な場合）
+ */
+class NoLeds
+{
+public:
+    static void begin(const ButtonConfig &) {}
+    static void set(uint8_t, bool) {}
+};
+
+/**
+ * @brief ButtonConfig のピン配置と LED 有効設定を実行時に使う LED 出力
+ */
+class ConfigLeds
+{
+public:
+    /**
+     * @brief ButtonConfig の LED 設定を取り込み、LEDピンを初期化
+     * @param config ボタン設定
+     */
+    static void begin(const ButtonConfig &config);
+
+    /**
+     * @brief LEDを点灯・消灯
+     * @param index ボタンのインデックス
+     * @param on true: 点灯
+     */
+    static void set(uint8_t index, bool on);
+
+private:
+    static int8_t ledPins[MAX_BUTTONS]; // -1: LEDなし
+    static bool enabled;                // begin() 済みで LED が有効か
+};
+
+// ===== デバウンス方式 =====
+
+/**
+ * @brief 生の状態が一定時間変化しなかったら確定する
+ */
+struct StableTimeDebounce
+{
+    static bool settled(uint32_t elapsedTicks, uint32_t debounceTicks) { return elapsedTicks >= debounceTicks; }
+};
+
+/**
+ * @brief デバウンスしない（ハードウェアでデバウンス済みの入力用）
+ */
+struct NoDebounce
+{
+    static bool settled(uint32_t, uint32_t) { return true; }
+};
+
+#endif // BUTTON_BACKENDS_H
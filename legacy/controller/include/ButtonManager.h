@@ -3,51 +3,175 @@
  * @brief ボタン入力管理クラス
  *
  * ボタンの状態監視、デバウンス処理、イベント検出を行う
+ * 入力は ButtonSampler が一定間隔でサンプリングした状態変化を使い、
+ * デバウンスと押下順の判定はサンプル番号（tick）の上で行う
+ * 押下を順位に入れるかどうかと並べ方は QuizArbiter（サーバーと共有）が決める
+ * デバウンス時間はボタンごとに持ち、確定した変化ごとのバウンス（BounceProfile）を DebounceLearner に渡す
+ * ENABLE_TRIGGER_INPUT が有効な場合、RESET の後は TriggerInput の立ち下がりでラウンドを開始し、
+ * それより前に入力が変化した押下はフライングとしてそのラウンドの間は受け付けない
+ * ラウンドの押下は2面の RoundSlot に交互に記録する。reset() は面を切り替えるだけで、
+ * 直前のラウンドの結果は次のリセットまで getPrevious*() で読める（押下イベントにはラウンド番号が付く）
+ * ENABLE_SCOPE が有効な場合、取り出したサンプルを setScope() で設定した ScopeStreamer にもそのまま渡す
+ * ENABLE_GESTURES が有効な場合、入力が変化した押下・解放を GestureTracker に渡し、確定したジェスチャーを送信する
+ * （リセットで確定し直した押されたままのボタンのように、生の変化がない押下・解放は渡さない）
+ *
+ * ボタン数・入力・LED・デバウンス方式はテンプレート引数で指定する（ButtonBackends.h）
+ * - FixedButtonManager: config.h のピン配置をコンパイル時に展開（ピン設定の誤りは static_assert）
+ * - RuntimeButtonManager: ButtonConfig のピン配置を実行時に使う（EEPROM などから設定する場合）
+ * ButtonManager は ENABLE_RUNTIME_PIN_CONFIG に応じてどちらかを指す
  */
 
 #ifndef BUTTON_MANAGER_H
 #define BUTTON_MANAGER_H
 
 #include <Arduino.h>
+#include <QuizArbiter.h>
+#include "ButtonBackends.h"
 #include "ButtonConfig.h"
+#include "ButtonSampler.h"
+#include "GestureTracker.h"
+#include "ScopeStreamer.h"
 #include "SerialCommunicator.h"
+#include "TriggerInput.h"
+
+/**
+ * @brief 1回の状態変化（押下または解放）で観測したバウンス
+ */
+struct BounceProfile
+{
+    uint8_t edges;        // 確定までに生の状態が変化した回数（1: バウンスなし）
+    uint16_t spanTicks;   // 最初の変化から最後の変化までのサンプル数
+    uint16_t maxGapTicks; // 変化の間隔の最大（デバウンス時間がこれ以下だと1回の操作が分かれる）
+    bool chatter;         // 直前の確定から DEBOUNCE_DELAY 未満で確定した（デバウンス時間が短すぎる疑い）
+};
+
+/**
+ * @brief 1ラウンド分の押下（arbiter が受け付けた押下のみ、押下順）
+ * @tparam N ボタン数
+ */
+template <uint8_t N>
+struct RoundSlot
+{
+    uint16_t id;                // ラウンド番号
+    uint8_t pressCount;         // 押されたボタン数
+    uint8_t order[N];           // ボタンID（1-N）
+    unsigned long times[N];     // 押下時刻（ミリ秒）
+    uint16_t seqs[N];           // 押下イベントのシーケンス番号
+    uint16_t reactions[N];      // ラウンド開始からの反応時間（ミリ秒、65534 で頭打ち、REACTION_UNKNOWN: 不明）
+};
 
-class ButtonManager
+/**
+ * @tparam N ボタン数
+ * @tparam InputBackend ボタン入力（begin(config) / read()）
+ * @tparam LedBackend LED出力（begin(config) / set(index, on)）
+ * @tparam DebouncePolicy デバウンス方式（settled(elapsedTicks, debounceTicks)）
+ */
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+class ButtonManagerT
 {
+    static_assert(N >= 1 && N <= 8, "Button states are sampled into an 8-bit mask");
+    static_assert(N <= MAX_BUTTONS, "N must not exceed MAX_BUTTONS");
+
+public:
+    typedef InputBackend Input; // サンプリング割り込みで展開して読むボタン入力
+
 private:
     ButtonConfig *config;
     SerialCommunicator *communicator;
+    ButtonSampler sampler;
 
-    bool buttonStates[MAX_BUTTONS];              // 現在のボタン状態
-    bool lastButtonStates[MAX_BUTTONS];          // 前回のボタン状態
-    unsigned long lastDebounceTime[MAX_BUTTONS]; // 最後のデバウンス時刻
-    unsigned long debounceDelay;                 // デバウンス遅延時間
+    bool buttonStates[N];     // デバウンス後のボタン状態
+    uint8_t rawStates;        // サンプリングした生の状態（bit i = ボタン i）
+    uint32_t rawChangedAt[N]; // 生の状態が最後に変化したサンプル番号
+    uint16_t debounceTicks[N];   // ボタンごとのデバウンス時間（サンプル数）
+    uint16_t offsetTicks[N];     // 検出遅延の補正量（サンプル数、LatencyCalibrator が設定）
+    bool calibrating;            // 校正中は状態変化を確定しない
+
+    BounceProfile bouncing[N];   // 確定待ちの変化のバウンス（edges == 0: 確定待ちの変化なし）
+    uint32_t bounceStartedAt[N]; // 確定待ちの最初の変化のサンプル番号
+    uint32_t committedAt[N];     // 最後に確定した変化の最初のサンプル番号
+    BounceProfile lastBounce[N]; // 最後に確定した変化のバウンス
+    uint8_t bounceCount[N];      // lastBounce を更新した回数（一周する）
 
     bool systemActive;      // システムアクティブ状態
     bool buttonPressed;     // いずれかのボタンが押されたか
     int firstPressedButton; // 最初に押されたボタンID
+    uint32_t armedTick;     // ラウンドを開始したサンプル番号（反応時間の起点）
+    bool reactionArmed;     // armedTick が有効か（起動直後・復元したラウンドでは無効）
+#if ENABLE_TRIGGER_INPUT
+    TriggerInput trigger;
+    bool waitingForTrigger; // RESET の後、トリガーの立ち下がりを待っているか
+    uint8_t falseStartMask; // 現在のラウンドでフライングしたボタン（bit i = ボタン i）
+#endif
+
+#if ENABLE_SCOPE
+    ScopeStreamer *scope; // 生のサンプルの送り先（nullptr: なし）
+#endif
+#if ENABLE_GESTURES
+    GestureTracker gestures;
+#endif
+
+    QuizArbiter arbiter;  // 時刻は補正後のサンプル番号
+    RoundSlot<N> rounds[2]; // 現在と直前のラウンド（リセットのたびに入れ替える）
+    uint8_t current;        // 現在のラウンドの面（0 / 1）
 
     /**
-     * @brief デバウンス処理を行いながらボタン状態を読み取る
+     * @brief 指定したサンプル番号までに安定したボタン状態を確定する
+     *
+     * 複数のボタンが確定する場合は、生の状態が変化した順に処理する
+     * @param untilTick 判定に使うサンプル番号
+     */
+    void commitStableStates(uint32_t untilTick);
+
+    /**
+     * @brief 検出遅延を補正した、生の状態が変化したサンプル番号
+     *
+     * 補正量はデバウンス時間未満に制限する（まだ届いていない変化より前に並ばないようにするため）
+     * @param buttonIndex ボタンのインデックス
+     * @return 補正後のサンプル番号
+     */
+    uint32_t compensatedChangeTick(uint8_t buttonIndex) const;
+
+    /**
+     * @brief 生の状態の変化をバウンスとして記録する（rawChangedAt を更新する前に呼ぶ）
      * @param buttonIndex ボタンのインデックス
-     * @return デバウンス後のボタン状態
+     * @param tick 変化したサンプル番号
      */
-    bool readButtonWithDebounce(int buttonIndex);
+    void trackBounce(uint8_t buttonIndex, uint32_t tick);
 
     /**
-     * @brief LEDを制御
-     * @param ledIndex LEDのインデックス
-     * @param state LEDの状態（HIGH/LOW）
+     * @brief 確定した変化のバウンスを lastBounce に移す
+     * @param buttonIndex ボタンのインデックス
      */
-    void controlLed(int ledIndex, bool state);
+    void finishBounce(uint8_t buttonIndex);
+
+    /**
+     * @brief デバウンス後のボタン状態を更新し、押下ならイベントを送信
+     * @param buttonIndex ボタンのインデックス
+     * @param pressed 押下されているか
+     */
+    void applyButtonState(uint8_t buttonIndex, bool pressed);
+
+#if ENABLE_GESTURES
+    /**
+     * @brief 確定したジェスチャーを送信する（サンプル番号をタイムスタンプの時間軸に直す）
+     * @param gesture 確定したジェスチャー
+     */
+    void sendGesture(const Gesture &gesture);
+#endif
 
 public:
+    /**
+     * @brief 反応時間が分からない押下を表す値
+     */
+    static const uint16_t REACTION_UNKNOWN = 0xFFFF;
+
     /**
      * @brief コンストラクタ
      * @param buttonConfig ボタン設定
      * @param serialComm シリアル通信管理
      */
-    ButtonManager(ButtonConfig *buttonConfig, SerialCommunicator *serialComm);
+    ButtonManagerT(ButtonConfig *buttonConfig, SerialCommunicator *serialComm);
 
     /**
      * @brief 初期化処理
@@ -76,6 +200,12 @@ public:
      */
     bool isButtonPressed() const;
 
+    /**
+     * @brief トリガーの立ち下がりを待っているかを取得
+     * @return RESET の後、ラウンドがまだ開始されていなければ true（ENABLE_TRIGGER_INPUT が無効なら常に false）
+     */
+    bool isWaitingForTrigger() const;
+
     /**
      * @brief 最初に押されたボタンIDを取得
      * @return ボタンID（1-6）、押されていない場合は0
@@ -83,10 +213,178 @@ public:
     int getFirstPressedButton() const;
 
     /**
-     * @brief デバウンス時間を設定
+     * @brief 全ボタンのデバウンス時間を設定
      * @param delay デバウンス時間（ミリ秒）
      */
     void setDebounceDelay(unsigned long delay);
+
+    /**
+     * @brief ボタンごとのデバウンス時間を設定する（init() の後に呼ぶ、DebounceLearner が設定）
+     * @param windowMicros デバウンス時間（マイクロ秒、N 個）
+     */
+    void setDebounceWindows(const uint16_t *windowMicros);
+
+    /**
+     * @brief 確定した変化のバウンスを記録した回数を取得
+     *
+     * 値が変わっていれば getBounce() が新しい変化を指す
+     * @param buttonIndex ボタンのインデックス
+     * @return 起動後の回数（一周する）
+     */
+    uint8_t getBounceCount(uint8_t buttonIndex) const;
+
+    /**
+     * @brief 最後に確定した変化のバウンスを取得
+     * @param buttonIndex ボタンのインデックス
+     * @return バウンス
+     */
+    const BounceProfile &getBounce(uint8_t buttonIndex) const;
+
+    /**
+     * @brief 現在のラウンドで押されたボタン数を取得
+     * @return 0-N
+     */
+    uint8_t getPressCount() const;
+
+    /**
+     * @brief ラウンド内で order 番目に押されたボタンを取得
+     * @param order 押下順（0が最初）
+     * @return ボタンID（1-N）
+     */
+    uint8_t getPressedButton(uint8_t order) const;
+
+    /**
+     * @brief ラウンド内で order 番目の押下時刻を取得
+     * @param order 押下順（0が最初）
+     * @return タイムスタンプ（ミリ秒）
+     */
+    unsigned long getPressTime(uint8_t order) const;
+
+    /**
+     * @brief ラウンド内で order 番目の押下イベントのシーケンス番号を取得
+     * @param order 押下順（0が最初）
+     * @return シーケンス番号
+     */
+    uint16_t getPressSeq(uint8_t order) const;
+
+    /**
+     * @brief ラウンド内で order 番目の押下の反応時間を取得
+     *
+     * RESET（ENABLE_TRIGGER_INPUT ではトリガーの立ち下がり）でラウンドを開始してから入力が変化するまでの時間（検出遅延の補正後）
+     * @param order 押下順（0が最初）
+     * @return ミリ秒（65534 で頭打ち。起動後最初のラウンド・ウォッチドッグ復帰で復元した押下は REACTION_UNKNOWN）
+     */
+    uint16_t getPressReaction(uint8_t order) const;
+
+    /**
+     * @brief ラウンド番号を取得
+     * @return 起動後（ウォームブートではリセット前から）のリセット回数
+     */
+    uint16_t getRound() const;
+
+    /**
+     * @brief 直前のラウンドの押下を取得
+     *
+     * reset() の後も次の reset() までは書き換わらないため、新しいラウンドの受け付けと並行して結果を報告できる
+     * @return 直前のラウンド（起動直後・復元直後は押下なし）
+     */
+    const RoundSlot<N> &getPreviousRound() const;
+
+    /**
+     * @brief リセット前のラウンドの状態を復元する（ウォッチドッグ復帰用、init() の後に呼ぶ）
+     *
+     * 押されていたボタンは押下済みとして LED を点け直し、イベントは再送しない
+     * @param active システムアクティブ状態
+     * @param roundNumber ラウンド番号
+     * @param count 押されたボタン数
+     * @param order ボタンID（押下順）
+     * @param times 押下時刻
+     * @param seqs 押下イベントのシーケンス番号
+     * @return 内容が不正で復元しなかった場合 false
+     */
+    bool restoreRound(bool active, uint16_t roundNumber, uint8_t count, const uint8_t *order,
+                      const unsigned long *times, const uint16_t *seqs);
+
+    /**
+     * @brief 不正解になったボタンを順位から外し、LED を消す（サーバーの判定に合わせる）
+     *
+     * 外したボタンは離して押し直せば、もう一度押下として受け付ける
+     * @param buttonId ボタンID（1-6）
+     * @return 順位に入っていなかった場合 false
+     */
+    bool judgeIncorrect(uint8_t buttonId);
+
+    /**
+     * @brief ボタンごとの検出遅延の補正量を設定する（init() の後に呼ぶ）
+     *
+     * 押下順は「生の状態が変化した時刻 - 補正量」の早い順に確定する
+     * @param offsetMicros 補正量（マイクロ秒、N 個）
+     */
+    void setLatencyOffsets(const uint16_t *offsetMicros);
+
+    /**
+     * @brief 校正モードを切り替える
+     *
+     * 校正中はサンプルの取り込みだけを行い、押下・解放を確定しない（イベントもLEDもなし）
+     * 終了時点の生の状態をそのまま確定した状態とする
+     * @param enabled true: 校正を開始, false: 終了
+     */
+    void setCalibrating(bool enabled);
+
+    /**
+     * @brief サンプリングした生の状態を取得（校正用）
+     * @return 押下中のボタン（bit i = ボタンインデックス i）
+     */
+    uint8_t getRawStates() const;
+
+    /**
+     * @brief 生の状態が最後に変化したサンプル番号を取得（校正用）
+     * @param buttonIndex ボタンのインデックス
+     * @return サンプル番号
+     */
+    uint32_t getRawChangedAt(uint8_t buttonIndex) const;
+
+    /**
+     * @brief サンプラーから取り出した状態変化を渡す先を設定する（ENABLE_SCOPE 用）
+     * @param scopeStreamer 送り先（nullptr で解除）
+     */
+    void setScope(ScopeStreamer *scopeStreamer);
+
+    /**
+     * @brief ボタンの LED を切り替える（AnswerTimer の点滅用）
+     *
+     * 押下・リセットでも LED は切り替わるため、呼び出し側が押下済みのボタンに対してだけ使う
+     * @param buttonIndex ボタンのインデックス
+     * @param on 点灯するか
+     */
+    void setLed(uint8_t buttonIndex, bool on);
+
+    /**
+     * @brief ボタン入力のサンプラーを取得（統計情報用）
+     * @return サンプラー
+     */
+    const ButtonSampler &getSampler() const;
 };
 
+#if ENABLE_LED_FEEDBACK
+typedef PinMapLeds<ConfigPinMap, MAX_BUTTONS> FixedLedBackend;
+#else
+typedef NoLeds FixedLedBackend;
+#endif
+
+typedef ButtonManagerT<MAX_BUTTONS, PinMapInput<ConfigPinMap, MAX_BUTTONS>, FixedLedBackend, StableTimeDebounce>
+    FixedButtonManager;
+typedef ButtonManagerT<MAX_BUTTONS, ConfigInput, ConfigLeds, StableTimeDebounce> RuntimeButtonManager;
+
+// 実装は ButtonManager.cpp で明示的にインスタンス化する
+extern template class ButtonManagerT<MAX_BUTTONS, PinMapInput<ConfigPinMap, MAX_BUTTONS>, FixedLedBackend,
+                                     StableTimeDebounce>;
+extern template class ButtonManagerT<MAX_BUTTONS, ConfigInput, ConfigLeds, StableTimeDebounce>;
+
+#if ENABLE_RUNTIME_PIN_CONFIG
+typedef RuntimeButtonManager ButtonManager;
+#else
+typedef FixedButtonManager ButtonManager;
+#endif
+
 #endif // BUTTON_MANAGER_H
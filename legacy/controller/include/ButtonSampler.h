@@ -0,0 +1,175 @@
+/**
+ * @file ButtonSampler.h
+ * @brief タイマー割り込みによるボタン入力サンプリングクラス
+ *
+ * Timer2 のコンペアマッチ割り込みで SCAN_SAMPLE_RATE_HZ ごとにボタン入力を読み取り、
+ * 状態が変化したサンプルだけを（tick, 押下ビット）として FIFO に積む
+ * メインループの処理時間に関係なく、一定間隔でサンプリングされた入力を扱える
+ *
+ * 入力の読み取りは sample<Input>() に展開する。割り込みハンドラ（ButtonManager.cpp）が
+ * 選択した ButtonManager の InputBackend を渡すため、関数ポインタ経由の呼び出しにならない
+ */
+
+#ifndef BUTTON_SAMPLER_H
+#define BUTTON_SAMPLER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+class ButtonSampler
+{
+public:
+    /**
+     * @brief 状態が変化したサンプル
+     */
+    struct Sample
+    {
+        uint32_t tick; // サンプル番号（起動後の割り込み回数）
+        uint8_t mask;  // 押下中のボタン（bit i = ボタンインデックス i）
+    };
+
+    /**
+     * @brief コンストラクタ
+     */
+    ButtonSampler();
+
+    /**
+     * @brief サンプリングを開始
+     *
+     * ボタンピンは事前に INPUT_PULLUP に設定しておくこと
+     */
+    void begin();
+
+    /**
+     * @brief 状態が変化したサンプルを古い順に取り出す
+     * @param sample 取り出したサンプル
+     * @return サンプルがある場合 true
+     */
+    bool pop(Sample &sample);
+
+    /**
+     * @brief 現在のサンプル番号を取得
+     * @return 起動後の割り込み回数
+     */
+    uint32_t getTick() const;
+
+    /**
+     * @brief 実際のサンプリング周波数を取得（タイマー分周の都合で設定値と異なる場合がある）
+     * @return 周波数（Hz）
+     */
+    uint32_t getSampleRate() const;
+
+    /**
+     * @brief ミリ秒をサンプル数に変換
+     * @param ms ミリ秒
+     * @return サンプル数
+     */
+    uint32_t msToTicks(unsigned long ms) const;
+
+    /**
+     * @brief サンプル数をマイクロ秒に変換
+     * @param ticks サンプル数
+     * @return マイクロ秒
+     */
+    unsigned long ticksToMicros(uint32_t ticks) const;
+
+    /**
+     * @brief サンプル数をミリ秒に変換（長い時間用、切り捨て）
+     * @param ticks サンプル数
+     * @return ミリ秒
+     */
+    unsigned long ticksToMillis(uint32_t ticks) const;
+
+    /**
+     * @brief 割り込みが1周期以上遅れた回数を取得
+     * @return 起動後の回数
+     */
+    unsigned long getMissedDeadlineCount() const;
+
+    /**
+     * @brief FIFO が一杯でサンプルの登録が遅れた回数を取得
+     * @return 起動後の回数
+     */
+    unsigned long getOverflowCount() const;
+
+    /**
+     * @brief 割り込み要求から sample() の終わりまでにかかった最大の CPU サイクル数を取得
+     *
+     * Timer2 のカウンタで測るため、分解能は分周比（20kHz なら 8 サイクル）
+     * @return サイクル数（割り込みの入口・出口の退避と復帰を除く）
+     */
+    uint16_t getMaxIsrCycles() const;
+
+    /**
+     * @brief 割り込みハンドラから呼ばれるサンプリング処理
+     * @tparam Input ボタン入力（static uint8_t read()、bit i = ボタンインデックス i）
+     */
+    template <class Input>
+    inline void sample()
+    {
+        // 一致から読み取りまでの揺らぎを小さくするため、最初に読む
+        uint8_t mask = Input::read();
+
+        // 割り込みに入った時点で次の一致フラグが立っていれば、1周期以上遅れている
+        if (TIFR2 & _BV(OCF2A))
+        {
+            missedDeadlineCount++;
+        }
+        tick++;
+
+        if (mask != lastMask)
+        {
+            uint8_t next = (fifoHead + 1) & (SAMPLE_FIFO_SIZE - 1);
+            if (next == fifoTail)
+            {
+                // 積めなかった変化は次のサンプルで再度検出される（時刻が遅れる）
+                overflowCount++;
+            }
+            else
+            {
+                fifo[fifoHead].tick = static_cast<uint16_t>(tick);
+                fifo[fifoHead].mask = mask;
+                fifoHead = next;
+                lastMask = mask;
+            }
+        }
+
+        // CTC モードのカウンタは一致で 0 に戻るため、今の値が一致からの経過時間
+        uint8_t elapsed = TCNT2;
+        if (elapsed > maxIsrCounts)
+        {
+            maxIsrCounts = elapsed;
+        }
+    }
+
+    /**
+     * @brief 割り込みハンドラが使うインスタンス
+     */
+    static ButtonSampler *instance;
+
+private:
+    uint32_t sampleRate;
+    uint16_t timerDivider; // Timer2 の分周比
+
+    /**
+     * @brief FIFO に積むサンプル（RAM を減らすため tick の下位16ビットだけを持ち、pop() で復元する）
+     *
+     * 取り出しまでに 65536 サンプル（20kHz で約3.3秒）以上かかると時刻を誤る
+     */
+    struct Entry
+    {
+        uint16_t tick;
+        uint8_t mask;
+    };
+
+    Entry fifo[SAMPLE_FIFO_SIZE];
+    volatile uint8_t fifoHead; // 割り込み側が書き込む位置
+    volatile uint8_t fifoTail; // メインループ側が読み出す位置
+    volatile uint32_t tick;
+    volatile uint8_t lastMask; // 最後に FIFO に積んだ状態
+    volatile unsigned long missedDeadlineCount;
+    volatile unsigned long overflowCount;
+    volatile uint8_t maxIsrCounts; // sample() の終わりの Timer2 のカウンタの最大値
+};
+
+#endif // BUTTON_SAMPLER_H
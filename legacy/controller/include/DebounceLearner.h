@@ -0,0 +1,130 @@
+/**
+ * @file DebounceLearner.h
+ * @brief ボタンごとのバウンスを観測し、デバウンス時間を学習するクラス
+ *
+ * DEBOUNCE_DELAY は最もバウンスの長いスイッチに合わせた値で、多くのスイッチには長すぎる（その分だけ押下の通知が遅れる）
+ * 通常の押下・解放のたびに ButtonManager が記録したバウンス（変化の回数・全体の長さ・変化の間隔の最大）を集計し、
+ * 「変化の間隔の最大」の推定値 × DEBOUNCE_MARGIN をボタンごとのデバウンス時間にする
+ * - 間隔の推定値は観測した値が上回ればすぐに上げ、下回れば差の 1/64 ずつ下げる（まれな長いバウンスを覚えておく）
+ * - 確定した状態が DEBOUNCE_DELAY 未満で変わった場合（チャタリングの疑い）は、デバウンス時間を倍にする
+ * - デバウンス時間は DEBOUNCE_MIN_MS 以上 DEBOUNCE_DELAY 以下、ミリ秒単位に切り上げる
+ * - DEBOUNCE_LEARN_COUNT 回観測するまでは DEBOUNCE_DELAY のまま
+ *
+ * 学習したデバウンス時間が変わったら、DEBOUNCE_SAVE_INTERVAL_MS 以上の間隔をあけて EEPROM に保存する
+ * （書き込みはメインループを止めるが、入力のサンプリングは割り込みで続く）
+ */
+
+#ifndef DEBOUNCE_LEARNER_H
+#define DEBOUNCE_LEARNER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ButtonManager.h"
+#include "SerialCommunicator.h"
+#include "config.h"
+
+class DebounceLearner
+{
+public:
+    /**
+     * @brief コンストラクタ
+     */
+    DebounceLearner();
+
+    /**
+     * @brief EEPROM から学習結果を読み込み、デバウンス時間を ButtonManager に設定する
+     *
+     * buttonManager.init() の後に呼ぶ。保存内容が壊れている場合は未学習として扱う
+     * @param buttonManager ボタン入力管理
+     */
+    void begin(ButtonManager &buttonManager);
+
+    /**
+     * @brief メインループで呼び出し、新しく確定した変化のバウンスを学習する
+     * @param buttonManager ボタン入力管理
+     */
+    void update(ButtonManager &buttonManager);
+
+    /**
+     * @brief 学習結果を消去し、全ボタンを DEBOUNCE_DELAY に戻す（EEPROM も消去する）
+     * @param buttonManager ボタン入力管理
+     */
+    void clear(ButtonManager &buttonManager);
+
+    /**
+     * @brief デバウンス時間とバウンスの統計を送信する（DEBOUNCE コマンドの応答）
+     * @param serialComm シリアル通信管理
+     */
+    void send(const SerialCommunicator &serialComm) const;
+
+    /**
+     * @brief 学習したデバウンス時間を取得
+     * @param index ボタンのインデックス
+     * @return マイクロ秒
+     */
+    uint16_t getWindow(uint8_t index) const;
+
+private:
+    /**
+     * @brief 1ボタン分の学習状態
+     */
+    struct SwitchProfile
+    {
+        uint16_t observed;  // 観測した変化の回数（65535 で止まる）
+        uint16_t gapUs;     // 変化の間隔の最大の推定値（マイクロ秒）
+        uint16_t edges16;   // 変化の回数の移動平均（×16）
+        uint16_t spanUs;    // バウンス全体の長さの移動平均（マイクロ秒）
+        uint16_t maxSpanUs; // バウンス全体の長さの最大（マイクロ秒）
+        uint8_t chatters;   // チャタリングの疑いでデバウンス時間を延ばした回数（255 で止まる）
+    };
+
+    SwitchProfile profiles[MAX_BUTTONS];
+    uint16_t windows[MAX_BUTTONS];     // ButtonManager に設定したデバウンス時間（マイクロ秒）
+    uint8_t seenBounces[MAX_BUTTONS];  // 学習済みの ButtonManager::getBounceCount()
+    bool dirty;                        // 保存していない変更があるか
+    unsigned long savedAt;             // 最後に保存した時刻（ミリ秒）
+
+    /**
+     * @brief 1回の変化のバウンスを学習する
+     * @param index ボタンのインデックス
+     * @param bounce バウンス
+     * @param sampler サンプル数の変換に使うサンプラー
+     */
+    void learn(uint8_t index, const BounceProfile &bounce, const ButtonSampler &sampler);
+
+    /**
+     * @brief 学習状態からデバウンス時間を求める
+     * @param index ボタンのインデックス
+     * @return マイクロ秒
+     */
+    uint16_t computeWindow(uint8_t index) const;
+
+    /**
+     * @brief デバウンス時間を求め直し、変わっていれば ButtonManager に設定する
+     * @param buttonManager ボタン入力管理
+     */
+    void apply(ButtonManager &buttonManager);
+
+    /**
+     * @brief 学習結果を EEPROM に保存する
+     */
+    void save();
+
+    /**
+     * @brief DEBOUNCE の応答の内容（2回書く場合も同じ時刻にする）
+     */
+    struct Reply
+    {
+        const DebounceLearner *learner;
+        unsigned long timestamp;
+    };
+
+    /**
+     * @brief DEBOUNCE の応答の本文を書く（SerialCommunicator::FrameBody）
+     * @param writer 書き出し先
+     * @param context Reply
+     */
+    static void writeReply(JsonFrameWriter &writer, const void *context);
+};
+
+#endif // DEBOUNCE_LEARNER_H
@@ -0,0 +1,97 @@
+/**
+ * @file FixedString.h
+ * @brief ヒープを使わない文字列ビューと固定長文字列
+ *
+ * ArduinoSTL の std::string の代わりに使う
+ * - StringView: 既存の文字列を指すだけのビュー（コピー・確保なし、NUL 終端とは限らない）
+ * - FixedString<N>: 最大 N 文字を内部の配列に持つ文字列（超えた分は切り詰める）
+ * どちらも静的コンストラクタやヒープ確保を伴わない
+ */
+
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <stddef.h>
+#include <string.h>
+
+class StringView
+{
+public:
+    StringView() : ptr(""), len(0) {}
+    StringView(const char *str) : ptr(str != nullptr ? str : ""), len(str != nullptr ? strlen(str) : 0) {}
+    StringView(const char *str, size_t length) : ptr(str), len(length) {}
+
+    const char *data() const { return ptr; }
+    size_t size() const { return len; }
+    size_t length() const { return len; }
+    bool empty() const { return len == 0; }
+    char operator[](size_t index) const { return ptr[index]; }
+
+    bool operator==(const StringView &other) const
+    {
+        return len == other.len && memcmp(ptr, other.ptr, len) == 0;
+    }
+    bool operator!=(const StringView &other) const { return !(*this == other); }
+
+private:
+    const char *ptr;
+    size_t len;
+};
+
+template <size_t Capacity>
+class FixedString
+{
+public:
+    FixedString() : len(0) { buffer[0] = '\0'; }
+    FixedString(const char *str) : len(0) { assign(StringView(str)); }
+    FixedString(StringView str) : len(0) { assign(str); }
+
+    /**
+     * @brief 内容を置き換える（Capacity を超えた分は切り詰める）
+     * @param str 新しい内容
+     * @return *this
+     */
+    FixedString &assign(StringView str)
+    {
+        len = 0;
+        return append(str);
+    }
+
+    /**
+     * @brief 末尾に追加する（Capacity を超えた分は切り詰める）
+     * @param str 追加する文字列
+     * @return *this
+     */
+    FixedString &append(StringView str)
+    {
+        size_t count = str.size() < Capacity - len ? str.size() : Capacity - len;
+        memcpy(buffer + len, str.data(), count);
+        len += count;
+        buffer[len] = '\0';
+        return *this;
+    }
+
+    FixedString &operator=(StringView str) { return assign(str); }
+    FixedString &operator+=(StringView str) { return append(str); }
+
+    void clear()
+    {
+        len = 0;
+        buffer[0] = '\0';
+    }
+
+    const char *c_str() const { return buffer; }
+    const char *data() const { return buffer; }
+    size_t size() const { return len; }
+    size_t length() const { return len; }
+    bool empty() const { return len == 0; }
+    static size_t capacity() { return Capacity; }
+
+    operator StringView() const { return StringView(buffer, len); }
+
+private:
+    char buffer[Capacity + 1];
+    size_t len;
+};
+
+#endif // FIXED_STRING_H
@@ -0,0 +1,122 @@
+/**
+ * @file GestureTracker.h
+ * @brief ボタンごとの押下・解放からジェスチャー（連打・長押し）を判定するクラス
+ *
+ * ButtonManager がデバウンス後の押下・解放をサンプル番号付きで渡し、1回の操作をまとめて1件のジェスチャーにする
+ * - 長押し: 押してから離すまでが GESTURE_LONG_PRESS_MS 以上。離した時点で確定する
+ * - 連打: 離してから GESTURE_TAP_GAP_MS 以内に次の押下がなければ、それまでの押下回数（1: 単押し、2: ダブル…）で確定する
+ *   途中の押下が長押しなら、そこまでの押下回数で長押しとして確定する
+ * 時刻は全て入力が変化したサンプル番号で比べるため、メインループの遅れは判定に影響しない
+ * ラウンドの押下順や受け付け（QuizArbiter）とは独立しており、フライングしたボタンや2回目以降の押下も数える
+ */
+
+#ifndef GESTURE_TRACKER_H
+#define GESTURE_TRACKER_H
+
+#include <Arduino.h>
+#include "ButtonSampler.h"
+#include "config.h"
+
+/**
+ * @brief 確定したジェスチャー
+ */
+struct Gesture
+{
+    uint8_t buttonIndex;     // ボタンのインデックス
+    uint8_t taps;            // 押下回数
+    bool longPress;          // 最後の押下が長押しか
+    uint32_t firstPressTick; // 最初の押下のサンプル番号
+    uint32_t lastPressTick;  // 最後の押下のサンプル番号
+    uint32_t releaseTick;    // 最後の解放のサンプル番号
+};
+
+class GestureTracker
+{
+public:
+    /**
+     * @brief コンストラクタ
+     */
+    GestureTracker();
+
+    /**
+     * @brief しきい値をサンプル数に換算する
+     * @param buttonSampler 時刻に使うサンプラー（begin() 済みであること）
+     */
+    void begin(const ButtonSampler &buttonSampler);
+
+    /**
+     * @brief 押下を記録する
+     *
+     * 前の連打の待ちが切れていた場合は、その連打を先に確定して返す
+     * @param buttonIndex ボタンのインデックス
+     * @param tick 入力が変化したサンプル番号
+     * @param gesture 確定したジェスチャー
+     * @return 確定した場合 true
+     */
+    bool press(uint8_t buttonIndex, uint32_t tick, Gesture &gesture);
+
+    /**
+     * @brief 解放を記録する（長押しならその場で確定する）
+     * @param buttonIndex ボタンのインデックス
+     * @param tick 入力が変化したサンプル番号
+     * @param gesture 確定したジェスチャー
+     * @return 確定した場合 true
+     */
+    bool release(uint8_t buttonIndex, uint32_t tick, Gesture &gesture);
+
+    /**
+     * @brief 次の押下を待つ時間が切れた連打を1件取り出す
+     * @param untilTick 判定に使うサンプル番号
+     * @param gesture 確定したジェスチャー
+     * @return 確定した場合 true
+     */
+    bool poll(uint32_t untilTick, Gesture &gesture);
+
+    /**
+     * @brief 次の押下を待っている連打を1件確定して取り出す（ラウンドの切り替え用）
+     *
+     * 押されている途中の操作は取り消す（押されたままのボタンは次の押下から数え直す）
+     * @param gesture 確定したジェスチャー
+     * @return 確定した場合 true（なくなるまで繰り返し呼ぶ）
+     */
+    bool flush(Gesture &gesture);
+
+    /**
+     * @brief 全ボタンの途中の操作を取り消す（校正の開始時）
+     */
+    void clear();
+
+private:
+    /**
+     * @brief ボタンごとの状態
+     */
+    enum Phase : uint8_t
+    {
+        PHASE_IDLE,    // 操作なし
+        PHASE_HELD,    // 押されている
+        PHASE_WAITING  // 離されて次の押下を待っている
+    };
+
+    struct Track
+    {
+        Phase phase;
+        uint8_t taps;
+        uint32_t firstPressTick;
+        uint32_t lastPressTick;
+        uint32_t releaseTick;
+    };
+
+    Track tracks[MAX_BUTTONS];
+    uint32_t longPressTicks; // 長押しとするサンプル数
+    uint32_t tapGapTicks;    // 連打として続けるサンプル数
+
+    /**
+     * @brief ボタンの操作を確定して gesture に書き出し、状態を戻す
+     * @param buttonIndex ボタンのインデックス
+     * @param longPress 長押しか
+     * @param gesture 書き出し先
+     */
+    void finish(uint8_t buttonIndex, bool longPress, Gesture &gesture);
+};
+
+#endif // GESTURE_TRACKER_H
@@ -0,0 +1,114 @@
+/**
+ * @file JsonFrameWriter.h
+ * @brief JsonDocument を使わずに JSON オブジェクトを出力先へ直接書き出すクラス
+ *
+ * 要素の多い応答（DEBOUNCE・STATUS・state など）を JsonDocument で組み立てると、
+ * 値のスロットと F() のキーのコピーで 0.3〜0.5KB のヒープを使い、これが RAM の最大の使用量になる
+ * このクラスは書いた順にそのまま出力するため、ヒープを使わない
+ * SerialCommunicator::writeFrame(FrameBody, context) から使う（COBS では同じ内容を2回書く）
+ *
+ *   writer.begin(F("status"));          // {"type":"status"
+ *   writer.add(F("round"), 3);          // ,"round":3
+ *   writer.beginArray(F("pressed"));    // ,"pressed":[
+ *   writer.item(2);                     // 2
+ *   writer.endArray();                  // ]
+ *   writer.end();                       // }
+ */
+
+#ifndef JSON_FRAME_WRITER_H
+#define JSON_FRAME_WRITER_H
+
+#include <Arduino.h>
+
+class JsonFrameWriter
+{
+public:
+    /**
+     * @brief コンストラクタ
+     * @param output 出力先
+     */
+    explicit JsonFrameWriter(Print &output);
+
+    /**
+     * @brief オブジェクトを開始し、type を書く
+     * @param type type の値（F() の文字列）
+     */
+    void begin(const __FlashStringHelper *type);
+
+    /**
+     * @brief 数値のメンバーを書く
+     * @param key キー（F() の文字列）
+     * @param value 値
+     */
+    void add(const __FlashStringHelper *key, unsigned long value);
+
+    /**
+     * @brief 符号付きの数値のメンバーを書く（-1 などの「なし」を含む値）
+     * @param key キー（F() の文字列）
+     * @param value 値
+     */
+    void addSigned(const __FlashStringHelper *key, long value);
+
+    /**
+     * @brief 真偽値のメンバーを書く
+     * @param key キー（F() の文字列）
+     * @param value 値
+     */
+    void addBool(const __FlashStringHelper *key, bool value);
+
+    /**
+     * @brief 配列のメンバーを開始する（endArray() で閉じる）
+     * @param key キー（F() の文字列）
+     */
+    void beginArray(const __FlashStringHelper *key);
+
+    /**
+     * @brief 配列の要素として配列を開始する（endArray() で閉じる）
+     */
+    void beginNestedArray();
+
+    /**
+     * @brief 配列に数値を書く
+     * @param value 値
+     */
+    void item(unsigned long value);
+
+    /**
+     * @brief 配列に小数を書く
+     * @param value 値
+     * @param digits 小数点以下の桁数
+     */
+    void itemFloat(float value, uint8_t digits);
+
+    /**
+     * @brief 配列に null を書く
+     */
+    void itemNull();
+
+    /**
+     * @brief 配列を閉じる
+     */
+    void endArray();
+
+    /**
+     * @brief オブジェクトを閉じる
+     */
+    void end();
+
+private:
+    Print &output;
+    bool first; // 次に書く要素がオブジェクト・配列の先頭か
+
+    /**
+     * @brief 2つ目以降の要素の前に区切りを書く
+     */
+    void separate();
+
+    /**
+     * @brief 区切りとキーを書く
+     * @param key キー（F() の文字列）
+     */
+    void key(const __FlashStringHelper *key);
+};
+
+#endif // JSON_FRAME_WRITER_H
@@ -0,0 +1,140 @@
+/**
+ * @file LatencyCalibrator.h
+ * @brief ボタンごとの検出遅延を計測し、押下順の判定を補正するクラス
+ *
+ * 配線の長さ・スイッチの種類・入力回路の違いで、ボタンごとに押下の検出遅延が一定量ずれる
+ * CALIBRATION_PIN を校正するボタンの入力線につなぎ、CALIBRATE <id> で基準エッジを出して
+ * 「エッジを出してからサンプラーが変化を捉えるまで」の時間を CALIBRATION_SAMPLES 回平均する
+ * 校正済みボタンのうち最も速いものとの差を補正量として ButtonManager に渡し、結果は EEPROM に保存する
+ *
+ * 計測はメインループを止めずに進める（校正中は ButtonManager が押下を確定しない）
+ * 計測値にはサンプリング周期の半分ほどの待ちが含まれるが、全ボタンで同じなので補正量には影響しない
+ */
+
+#ifndef LATENCY_CALIBRATOR_H
+#define LATENCY_CALIBRATOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ButtonManager.h"
+#include "SerialCommunicator.h"
+#include "config.h"
+
+class LatencyCalibrator
+{
+public:
+    /**
+     * @brief 未校正を表す検出遅延の値
+     */
+    static const uint16_t UNCALIBRATED = 0xFFFF;
+
+    /**
+     * @brief コンストラクタ
+     */
+    LatencyCalibrator();
+
+    /**
+     * @brief EEPROM から校正結果を読み込み、補正量を ButtonManager に設定する
+     *
+     * buttonManager.init() の後に呼ぶ。保存内容が壊れている場合は未校正として扱う
+     * @param buttonManager ボタン入力管理
+     */
+    void begin(ButtonManager &buttonManager);
+
+    /**
+     * @brief ボタンの校正を開始する
+     *
+     * 完了すると校正結果（calibration）を送信する。失敗した場合はエラーを送信し、以前の値を残す
+     * @param buttonId 校正するボタンID（1-MAX_BUTTONS）
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     */
+    void start(uint8_t buttonId, ButtonManager &buttonManager, SerialCommunicator &serialComm);
+
+    /**
+     * @brief 全ボタンの校正結果を消去し、補正をやめる
+     * @param buttonManager ボタン入力管理
+     */
+    void clear(ButtonManager &buttonManager);
+
+    /**
+     * @brief メインループで呼び出し、計測を進める（buttonManager.update() の後に呼ぶ）
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     */
+    void update(ButtonManager &buttonManager, SerialCommunicator &serialComm);
+
+    /**
+     * @brief 校正結果を送信する（CALIBRATION コマンドの応答）
+     * @param serialComm シリアル通信管理
+     * @param buttonId 校正を終えたボタンID（問い合わせへの応答は0）
+     */
+    void sendResult(const SerialCommunicator &serialComm, uint8_t buttonId = 0) const;
+
+    /**
+     * @brief 校正中かどうかを取得
+     * @return 校正中なら true
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief ボタンの検出遅延を取得
+     * @param index ボタンのインデックス
+     * @return マイクロ秒（未校正なら UNCALIBRATED）
+     */
+    uint16_t getLatency(uint8_t index) const;
+
+    /**
+     * @brief ボタンの補正量を取得（校正済みボタンのうち最も速いものとの差）
+     * @param index ボタンのインデックス
+     * @return マイクロ秒（未校正なら0）
+     */
+    uint16_t getOffset(uint8_t index) const;
+
+private:
+    enum Phase
+    {
+        PHASE_IDLE,    // 校正していない
+        PHASE_SETTLE,  // 入力線が戻るのを待っている
+        PHASE_WAITING  // 基準エッジを出し、検出を待っている
+    };
+
+    Phase phase;
+    uint8_t buttonIndex;        // 校正中のボタンのインデックス
+    uint8_t sampleCount;        // 終えた計測回数
+    uint32_t latencySum;        // 計測値の合計（マイクロ秒）
+    uint32_t edgeTick;          // 基準エッジの直前のサンプル番号
+    uint16_t edgeDelay;         // そのサンプルから基準エッジまでの待ち（マイクロ秒）
+    unsigned long phaseStartedAt; // 現在の段階に入った時刻（ミリ秒）
+    uint16_t latencies[MAX_BUTTONS]; // ボタンごとの検出遅延（マイクロ秒）
+
+    /**
+     * @brief 基準エッジを出す（入力線を LOW に引く）
+     * @param buttonManager ボタン入力管理
+     */
+    void fireEdge(const ButtonManager &buttonManager);
+
+    /**
+     * @brief 基準エッジを戻す（ハイインピーダンスにする）
+     */
+    void releaseEdge();
+
+    /**
+     * @brief 校正を終了する
+     * @param buttonManager ボタン入力管理
+     */
+    void finish(ButtonManager &buttonManager);
+
+    /**
+     * @brief 補正量を ButtonManager に設定する
+     * @param buttonManager ボタン入力管理
+     */
+    void applyOffsets(ButtonManager &buttonManager) const;
+
+    /**
+     * @brief 校正結果を EEPROM に保存する
+     */
+    void save() const;
+};
+
+#endif // LATENCY_CALIBRATOR_H
@@ -10,35 +10,47 @@
  * このファイルは、Arduino環境でのログ出力を管理するLoggerクラスのヘッダーファイルです。
  * ログレベルに応じて、情報、デバッグ、警告、エラー、致命的なエラーメッセージを出力します。
  * 使用するには、Loggerクラスのインスタンスを作成し、必要なログメソッドを呼び出します。
+ * モジュール名は固定長の文字列に保持し、ヒープは使用しません（NAME_CAPACITY 文字を超える名前は切り詰め）。
+ * 固定のメッセージは F() で渡すと RAM にコピーされません。
  */
 
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
-#include <ArduinoSTL.h>
+#include <stdio.h>
+#include "FixedString.h"
+
+class __FlashStringHelper;
 
 // #define DEBUG // / 定義するとデバックメッセージが出力されます。
 
 class Logger
 {
 public:
-    Logger(const std::string &name = std::string("unknown"))
+    static const size_t NAME_CAPACITY = 15; // モジュール名の最大文字数
+
+    Logger(StringView name)
         : name(name) {};
     Logger(const char *name = "unknown")
-        : name(std::string(name)) {};
+        : name(name) {};
 
     void setup();
 
-    void info(const std::string &message);
+    void info(StringView message);
     void info(const char *message);
-    void debug(const std::string &message);
+    void info(const __FlashStringHelper *message);
+    void debug(StringView message);
     void debug(const char *message);
-    void warn(const std::string &message);
+    void debug(const __FlashStringHelper *message);
+    void warn(StringView message);
     void warn(const char *message);
-    void error(const std::string &message);
+    void warn(const __FlashStringHelper *message);
+    void error(StringView message);
     void error(const char *message);
-    void fatal(const std::string &message);
+    void error(const __FlashStringHelper *message);
+    void fatal(StringView message);
     void fatal(const char *message);
+    void fatal(const __FlashStringHelper *message);
 
     // 書式付きのログ出力
     template <typename... Args>
@@ -57,10 +69,10 @@ public:
     void fatalf(const char *format, Args... args);
 
 private:
-    std::string name = "unknown";
+    FixedString<NAME_CAPACITY> name;
 
-    void log(const char *message, const char *level);
-    char *createPrefix(const char *level, const char *message);
+    void log(StringView message, const char *level);
+    void log(const __FlashStringHelper *message, const char *level);
 };
 
 /**
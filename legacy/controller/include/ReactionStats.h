@@ -0,0 +1,132 @@
+/**
+ * @file ReactionStats.h
+ * @brief ボタン（プレイヤー）ごとの反応時間の統計クラス
+ *
+ * ラウンド開始（RESET）から押下までの反応時間を、イベントを保存せずに逐次集計する
+ * - 回数・平均・分散: Welford 法（1件ごとに更新、桁落ちしにくい）
+ * - 分位点（p50 / p90 / p99）: 64ms から 1/3 オクターブ（約 26%）刻みの対数ヒストグラムで近似する
+ *   ビンは 8bit で、溢れそうになったら全ビンを半分にする（分布の形を保ったまま古い押下の重みを下げる）
+ * 1人あたり約 40 バイトの固定サイズで、ANALYTICS で全員分を1フレームで返す
+ */
+
+#ifndef REACTION_STATS_H
+#define REACTION_STATS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ButtonManager.h"
+#include "SerialCommunicator.h"
+#include "config.h"
+
+class ReactionStats
+{
+public:
+    /**
+     * @brief ヒストグラムのビン数（ReactionStats.cpp の境界値の表と合わせる）
+     */
+    static const uint8_t BIN_COUNT = 24;
+
+    /**
+     * @brief コンストラクタ
+     */
+    ReactionStats();
+
+    /**
+     * @brief メインループで呼び出し、新しく記録された押下の反応時間を集計する
+     * @param buttonManager ボタン入力管理
+     */
+    void update(const ButtonManager &buttonManager);
+
+    /**
+     * @brief 反応時間を1件追加する
+     * @param buttonId ボタンID（1-MAX_BUTTONS）
+     * @param reactionMs 反応時間（ミリ秒）
+     */
+    void add(uint8_t buttonId, unsigned long reactionMs);
+
+    /**
+     * @brief 全員の統計を消去する
+     */
+    void clear();
+
+    /**
+     * @brief 統計を送信する（ANALYTICS コマンドの応答）
+     * @param serialComm シリアル通信管理
+     */
+    void send(const SerialCommunicator &serialComm) const;
+
+    /**
+     * @brief 集計した押下の数を取得
+     * @param index ボタンのインデックス
+     * @return 件数
+     */
+    uint16_t getCount(uint8_t index) const;
+
+    /**
+     * @brief 反応時間の平均を取得
+     * @param index ボタンのインデックス
+     * @return ミリ秒
+     */
+    float getMean(uint8_t index) const;
+
+    /**
+     * @brief 反応時間の標準偏差（標本）を取得
+     * @param index ボタンのインデックス
+     * @return ミリ秒（2件未満なら0）
+     */
+    float getStdDev(uint8_t index) const;
+
+    /**
+     * @brief 反応時間の分位点の近似値を取得
+     *
+     * 該当するビンの中を線形に補間し、観測した最小値・最大値の範囲に収めて返す
+     * 誤差はビンの幅（値の約 26%）以内
+     * @param index ボタンのインデックス
+     * @param percent 分位（1-100）
+     * @return ミリ秒（0件なら0）
+     */
+    uint16_t getQuantile(uint8_t index, uint8_t percent) const;
+
+private:
+    /**
+     * @brief 1人分の統計
+     */
+    struct PlayerStats
+    {
+        uint16_t count;            // 件数（65535 で止まる）
+        float mean;                // 平均（ミリ秒）
+        float m2;                  // 平均からの偏差の二乗和
+        uint16_t minMs;            // 最小値
+        uint16_t maxMs;            // 最大値
+        uint8_t bins[BIN_COUNT];   // 対数ヒストグラム
+    };
+
+    PlayerStats players[MAX_BUTTONS];
+    uint16_t seenRound;     // 集計済みの押下が属するラウンド
+    uint8_t seenPressCount; // そのラウンドで集計済みの押下数
+
+    /**
+     * @brief 反応時間が入るビンを求める
+     * @param reactionMs 反応時間（ミリ秒）
+     * @return ビンのインデックス
+     */
+    static uint8_t binIndex(uint16_t reactionMs);
+
+    /**
+     * @brief ANALYTICS の応答の内容（2回書く場合も同じ時刻にする）
+     */
+    struct Reply
+    {
+        const ReactionStats *stats;
+        unsigned long timestamp;
+    };
+
+    /**
+     * @brief ANALYTICS の応答の本文を書く（SerialCommunicator::FrameBody）
+     * @param writer 書き出し先
+     * @param context Reply
+     */
+    static void writeReply(JsonFrameWriter &writer, const void *context);
+};
+
+#endif // REACTION_STATS_H
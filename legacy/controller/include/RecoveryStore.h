@@ -0,0 +1,66 @@
+/**
+ * @file RecoveryStore.h
+ * @brief ウォッチドッグ等によるリセットをまたいでラウンドの状態を保持するクラス
+ *
+ * ラウンドの状態（アクティブ状態・ラウンド番号・押下順・押下時刻・シーケンス番号）を
+ * 起動時に初期化されない .noinit セクションに CRC 付きで保存しておき、
+ * ウォッチドッグまたはブラウンアウトによるリセット後はそこから復元する（ウォームブート）
+ * 電源投入・リセットボタン・ホストの DTR による書き込み前リセットでは復元しない
+ */
+
+#ifndef RECOVERY_STORE_H
+#define RECOVERY_STORE_H
+
+#include <Arduino.h>
+#include "ButtonManager.h"
+#include "SerialCommunicator.h"
+#include "config.h"
+
+class RecoveryStore
+{
+public:
+    /**
+     * @brief コンストラクタ
+     */
+    RecoveryStore();
+
+    /**
+     * @brief リセット要因と保存された状態を検査する（setup() の最初に呼ぶ）
+     * @return 復元できる状態がある場合 true（ウォームブート）
+     */
+    bool begin();
+
+    /**
+     * @brief 起動時に退避したリセット要因を取得
+     * @return MCUSR の値（WDRF / BORF / EXTRF / PORF）
+     */
+    static uint8_t getResetFlags();
+
+    /**
+     * @brief 保存された状態を復元し、復帰イベントを送信する
+     *
+     * buttonManager.init() の後に呼ぶ。未ACKだった押下は元の番号のまま再送される
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     */
+    void restore(ButtonManager &buttonManager, SerialCommunicator &serialComm);
+
+    /**
+     * @brief メインループで呼び出し、状態が変化した場合または一定間隔で保存する
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     */
+    void update(const ButtonManager &buttonManager, const SerialCommunicator &serialComm);
+
+private:
+    bool warmBoot; // begin() で復元できる状態が見つかったか
+
+    /**
+     * @brief 現在の状態を保存する
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     */
+    void save(const ButtonManager &buttonManager, const SerialCommunicator &serialComm);
+};
+
+#endif // RECOVERY_STORE_H
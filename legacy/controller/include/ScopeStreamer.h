@@ -0,0 +1,138 @@
+/**
+ * @file ScopeStreamer.h
+ * @brief サンプリングした生の入力をデバウンス前のまま送信するクラス（SCOPE）
+ *
+ * ButtonSampler は状態が変化したサンプルだけを記録するため、変化（サンプル番号と押下ビット）の列が
+ * そのままランレングス符号になる。ButtonManager が取り出したサンプルを record() で受け取り、
+ * 選択したボタンのビットが変わったものだけを {"type":"scope"} のフレームにまとめて送る
+ * - 時刻はサンプル番号（SCAN_SAMPLE_RATE_HZ ごと）で、フレーム内は直前の変化からの差で表す
+ * - 9600bps では 1 フレームの書き出しに 100 ミリ秒程度かかるため、送信バッファの空きに合わせて少しずつ書き出す
+ *   その間は SerialCommunicator::holdOutput() でイベントを保留し、フレームの切れ目で先に送る
+ * - 送信が追いつかずに溢れた変化と、ButtonSampler の FIFO 溢れは lost として数える
+ */
+
+#ifndef SCOPE_STREAMER_H
+#define SCOPE_STREAMER_H
+
+#include <Arduino.h>
+#include "ButtonSampler.h"
+#include "SerialCommunicator.h"
+#include "config.h"
+
+class ScopeStreamer
+{
+public:
+    /**
+     * @brief コンストラクタ
+     */
+    ScopeStreamer();
+
+    /**
+     * @brief ストリーミングを開始する（開始中なら対象のボタンを切り替える）
+     *
+     * 開始フレーム（サンプリング周波数・対象のボタン・現在の状態）を送る
+     * @param mask 対象のボタン（bit i = ボタンインデックス i）
+     * @param rawStates 現在の生の状態（ButtonManager::getRawStates()）
+     * @param sampler サンプラー
+     * @param serialComm シリアル通信管理
+     */
+    void start(uint8_t mask, uint8_t rawStates, const ButtonSampler &sampler, SerialCommunicator &serialComm);
+
+    /**
+     * @brief ストリーミングを停止する（溜まっている変化と終了フレームを送ってから止まる）
+     */
+    void stop();
+
+    /**
+     * @brief ストリーミング中（終了フレームの送信待ちを含む）かを取得
+     * @return ストリーミング中なら true
+     */
+    bool isActive() const;
+
+    /**
+     * @brief フレームを書き出している途中かを取得
+     *
+     * 途中の間は他のフレームを書き出さないこと（コマンドの応答も含む）
+     * @return 書き出し中なら true
+     */
+    bool isSending() const;
+
+    /**
+     * @brief サンプラーから取り出した状態変化を記録する（ButtonManager::update() から呼ばれる）
+     * @param tick サンプル番号
+     * @param mask 押下中のボタン（bit i = ボタンインデックス i）
+     */
+    void record(uint32_t tick, uint8_t mask);
+
+    /**
+     * @brief メインループで呼び出し、フレームを作って送信バッファの空きの分だけ書き出す
+     * @param sampler サンプラー
+     * @param serialComm シリアル通信管理
+     */
+    void update(const ButtonSampler &sampler, SerialCommunicator &serialComm);
+
+private:
+    /**
+     * @brief 送信待ちの変化
+     */
+    struct Edge
+    {
+        uint32_t tick; // サンプル番号
+        uint8_t mask;  // 対象のボタンの押下ビット
+    };
+
+    bool active;                 // ストリーミング中か
+    bool stopping;               // 停止を要求されたか（送信待ちの変化と終了フレームを送る）
+    uint8_t buttonMask;          // 対象のボタン
+    uint8_t lastMask;            // 最後に記録した状態
+    uint32_t lastTick;           // 最後に送った変化のサンプル番号（次のフレームの差の起点）
+    unsigned long lost;          // 溢れた変化の数（開始からの累計）
+    unsigned long seenOverflows; // 集計済みの ButtonSampler::getOverflowCount()
+    unsigned long sentAt;        // 最後にフレームを作った時刻（ミリ秒）
+
+    Edge edges[SCOPE_BUFFER_EDGES]; // 送信待ちの変化（リングバッファ）
+    uint8_t edgeHead;               // 最古の変化の位置
+    uint8_t edgeCount;              // 送信待ちの変化の数
+
+    uint8_t frame[SCOPE_FRAME_BYTES]; // 書き出し中のフレーム
+    uint8_t frameLength;              // フレームのバイト数
+    uint8_t frameSent;                // 書き出したバイト数
+
+    /**
+     * @brief 送信待ちの変化を最大 SCOPE_FRAME_EDGES 個フレームに符号化し、イベントの書き出しを保留する
+     *
+     * 送信待ちの変化がなければ、tick の時点の現在の状態を変化として入れる（開始・終了・無変化の通知）
+     * @param tick 現在のサンプル番号
+     * @param start 開始フレームにするか
+     * @param end 終了フレームにするか
+     * @param sampler サンプラー
+     * @param serialComm シリアル通信管理
+     */
+    void buildFrame(uint32_t tick, bool start, bool end, const ButtonSampler &sampler, SerialCommunicator &serialComm);
+
+    // writeContent() に渡すフレームの内容
+    struct FrameContent
+    {
+        const ScopeStreamer *streamer;
+        uint32_t tick;  // 現在のサンプル番号
+        uint32_t rate;  // サンプリング周波数（開始フレーム用）
+        bool start;     // 開始フレームか
+        bool end;       // 終了フレームか
+        uint8_t count;  // 入れる変化の数
+    };
+
+    /**
+     * @brief フレームの本文を書く（SerialCommunicator::FrameBody）
+     * @param writer 書き出し先
+     * @param context フレームの内容（FrameContent）
+     */
+    static void writeContent(JsonFrameWriter &writer, const void *context);
+
+    /**
+     * @brief 書き出し中のフレームを送信バッファの空きの分だけ書き出す
+     * @param serialComm シリアル通信管理
+     */
+    void writeFrame(SerialCommunicator &serialComm);
+};
+
+#endif // SCOPE_STREAMER_H
@@ -3,6 +3,12 @@
  * @brief シリアル通信管理クラス
  *
  * JSON形式でのデータ送受信を管理
+ * イベントにはシーケンス番号を付与し、ホストからACKされるまで再送ウィンドウに保持する
+ * 短時間に続いたボタン押下は1フレームにまとめて送信する
+ * ENABLE_LATENCY_TRACE が有効な場合は、各フレームに区間ごとの時刻（micros()）を trace として付ける
+ * ENABLE_COBS_FRAMING が有効な場合は、JSON を改行区切りの行ではなく COBS + CRC-16 のフレームで送る（QuizFraming.h）
+ * ENABLE_BLACK_BOX が有効な場合は、イベントとウィンドウ溢れで破棄したイベントを setBlackBox() で設定した BlackBox に記録する
+ * ジェスチャーイベント（ENABLE_GESTURES）は確定までに時間がかかるため、timestamp は送信時刻ではなく最後に離した時刻になる
  */
 
 #ifndef SERIAL_COMMUNICATOR_H
@@ -10,17 +16,181 @@
 
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include "JsonFrameWriter.h"
+#include "config.h"
+
+class BlackBox;
 
 class SerialCommunicator
 {
+public:
+    /**
+     * @brief フレームの本文を書く関数（writeFrame(FrameBody, context) 用）
+     *
+     * ENABLE_COBS_FRAMING では長さと CRC を先に求めるため2回呼ばれる。毎回同じ内容を書くこと
+     * @param writer 書き出し先
+     * @param context writeFrame() に渡した値
+     */
+    typedef void (*FrameBody)(JsonFrameWriter &writer, const void *context);
+
 private:
+    /**
+     * @brief 送信イベントの種類
+     */
+    enum EventType : uint8_t
+    {
+        EVENT_BUTTON_PRESS,
+        EVENT_SYSTEM_RESET,
+        EVENT_ERROR,
+        EVENT_SYSTEM_READY,
+        EVENT_RECOVERED,
+        EVENT_ARMED,
+        EVENT_FALSE_START,
+        EVENT_ANSWER_TIMEOUT,
+        EVENT_GESTURE
+    };
+
+    /**
+     * @brief ACK待ちイベント
+     *
+     * 再送時に同じ内容を再構築できるだけの情報を保持する
+     * message は F() の文字列を指すこと（コピーしない）
+     */
+    struct PendingEvent
+    {
+        uint16_t seq;             // シーケンス番号
+        EventType type;           // イベント種類
+        uint8_t buttonId;         // ボタンID（押下・フライング・解答時間切れ・ジェスチャーイベントのみ）
+        uint16_t round;           // 発生時のラウンド番号（押下・リセット・アーム・フライング・解答時間切れ・ジェスチャーで送る）
+        unsigned long timestamp;  // 発生時刻（ミリ秒）
+        const __FlashStringHelper *message; // エラーメッセージ・復帰理由・ジェスチャーの種類（フラッシュ）
+        unsigned long lastSentAt; // 最終送信時刻（ミリ秒）
+#if ENABLE_GESTURES
+        uint8_t taps;             // 押下回数（ジェスチャーイベントのみ）
+        uint16_t hold;            // 最後の押下の長さ（ミリ秒、ジェスチャーイベントのみ）
+        uint16_t total;           // 最初の押下から最後の解放まで（ミリ秒、ジェスチャーイベントのみ）
+#endif
+#if ENABLE_LATENCY_TRACE
+        unsigned long capturedAt;  // 入力が変化した時刻（マイクロ秒、押下イベントのみ）
+        unsigned long committedAt; // デバウンス後に確定した時刻（マイクロ秒）
+#endif
+    };
+
     int baudRate;
 
+    PendingEvent pending[RETRANSMIT_WINDOW]; // 再送ウィンドウ（リングバッファ）
+    uint8_t pendingHead;                     // 最古の未ACKイベントの位置
+    uint8_t pendingCount;                    // 未ACKイベント数
+    uint8_t unsentCount;                     // ウィンドウ末尾の未送信イベント数
+    unsigned long batchStartedAt;            // 未送信の押下が溜まり始めた時刻
+    uint16_t nextSeq;                        // 次に割り当てるシーケンス番号
+    uint16_t currentRound;                   // 以降のイベントに付けるラウンド番号
+    bool peerAcks;                           // ホストがACKに対応しているか
+    bool held;                               // 書き出しを保留しているか（holdOutput）
+    uint8_t retransmitAttempts;              // 最後の ACK・RESYNC 以降のタイムアウト再送の回数
+    unsigned long retransmitCount;           // 再送回数
+    unsigned long droppedCount;              // ウィンドウ溢れで破棄したイベント数
+#if ENABLE_BLACK_BOX
+    BlackBox *blackBox;                      // イベントの記録先（nullptr: なし）
+#endif
+    unsigned long timeBase;                  // タイムスタンプと millis() の差（ウォッチドッグ復帰時に引き継ぐ）
+    unsigned long recoveryDowntime;          // 復帰イベントで報告する停止時間（ミリ秒）
+
     /**
-     * @brief 現在のタイムスタンプを取得
-     * @return タイムスタンプ（ミリ秒）
+     * @brief イベントにシーケンス番号を割り当てて送信する
+     * @param type イベント種類
+     * @param buttonId ボタンID
+     * @param message エラーメッセージ・復帰理由
+     * @param capturedAt 入力が変化した時刻（マイクロ秒、ENABLE_LATENCY_TRACE 用）
+     * @return 割り当てたシーケンス番号
      */
-    unsigned long getTimestamp() const;
+    uint16_t emit(EventType type, uint8_t buttonId, const __FlashStringHelper *message, unsigned long capturedAt = 0);
+
+    /**
+     * @brief 内容を埋めたイベントにシーケンス番号を割り当てて送信する（seq・lastSentAt はここで設定する）
+     * @param event 送信するイベント
+     * @return 割り当てたシーケンス番号
+     */
+    uint16_t post(PendingEvent &event);
+
+    /**
+     * @brief 再送ウィンドウの末尾にイベントを追加する（満杯なら最古を破棄）
+     * @param event 追加するイベント
+     */
+    void enqueue(const PendingEvent &event);
+
+#if ENABLE_BLACK_BOX
+    /**
+     * @brief イベントを BlackBox に記録する
+     * @param event イベント
+     * @param dropped ウィンドウ溢れで破棄したイベントとして記録するか
+     */
+    void recordEvent(const PendingEvent &event, bool dropped);
+#endif
+
+    /**
+     * @brief イベントをJSONとしてシリアルに書き出す
+     * @param index ウィンドウ内の位置（古い順）
+     */
+    void writeEvent(uint8_t index);
+
+#if ENABLE_LATENCY_TRACE
+    /**
+     * @brief フレームの trace（[エンコード開始, 送信開始, 入力変化, 確定, ...]）を追加する
+     *
+     * 送信開始は送信バッファに残っているバイト数から見積もる
+     * @param doc 書き出すJSONドキュメント
+     * @param first ウィンドウ内の先頭位置（古い順）
+     * @param count フレームに含まれるイベント数
+     */
+    void addTrace(JsonDocument &doc, uint8_t first, uint8_t count);
+#endif
+
+    /**
+     * @brief 連続したボタン押下をまとめて1フレームで書き出す（同じラウンドの押下に限る）
+     * @param first ウィンドウ内の先頭位置（古い順）
+     * @param count まとめる押下イベント数（2以上）
+     */
+    void writePressBatch(uint8_t first, uint8_t count);
+
+    /**
+     * @brief ウィンドウ内の範囲を送信する（連続した押下は1フレームにまとめる）
+     * @param first ウィンドウ内の先頭位置（古い順）
+     * @param count 送信するイベント数
+     */
+    void writeRange(uint8_t first, uint8_t count);
+
+    /**
+     * @brief 未送信のイベントを全て送信する
+     */
+    void flush();
+
+    /**
+     * @brief 送信済みイベントを解放する（ACK非対応時）
+     */
+    void releaseSent();
+
+    /**
+     * @brief 再送ウィンドウ内のi番目（古い順）のイベントを取得
+     * @param index 0が最古
+     * @return イベントへの参照
+     */
+    PendingEvent &pendingAt(uint8_t index);
+
+    /**
+     * @brief JSONドキュメントを1フレームとして出力先に書き出す
+     * @param doc 書き出すJSONドキュメント
+     * @param output 出力先
+     */
+    static void printFrame(const JsonDocument &doc, Print &output);
+
+    /**
+     * @brief 本文を書く関数の出力を1フレームとして出力先に書き出す
+     * @param body 本文を書く関数
+     * @param context body に渡す値
+     * @param output 出力先
+     */
+    static void printFrame(FrameBody body, const void *context, Print &output);
 
 public:
     /**
@@ -31,14 +201,51 @@ public:
     /**
      * @brief シリアル通信を初期化
      * @param baud ボーレート
+     * @param waitForPort シリアルポートの接続と安定化を待つか（ウォッチドッグ復帰時は待たない）
+     */
+    void init(int baud, bool waitForPort = true);
+
+    /**
+     * @brief 現在のタイムスタンプを取得
+     * @return タイムスタンプ（ミリ秒）
+     */
+    unsigned long getTimestamp() const;
+
+    /**
+     * @brief メインループで呼び出す更新処理
+     *
+     * まとめ待ちの押下の送信と、タイムアウトしたイベントの再送を行う
+     */
+    void update();
+
+    /**
+     * @brief ホストからの累積ACKを処理
+     * @param seq 受信済みの最後のシーケンス番号（これ以前は全て受信済み）
      */
-    void init(int baud);
+    void acknowledge(uint16_t seq);
+
+    /**
+     * @brief 未ACKイベントを古い順に全て再送する（再接続後のRESYNCコマンド用）
+     */
+    void resync();
+
+    /**
+     * @brief 以降のイベントに付けるラウンド番号を設定する（ButtonManager がリセット・復元時に設定）
+     *
+     * 送信済み・まとめ待ちのイベントは元のラウンド番号のまま再送される
+     * @param round ラウンド番号
+     */
+    void setRound(uint16_t round);
 
     /**
      * @brief ボタン押下イベントを送信
+     *
+     * PRESS_BATCH_WINDOW の間に続いた押下とまとめて update() で送信される
      * @param buttonId ボタンID（1-6）
+     * @param capturedAt 入力が変化した時刻（マイクロ秒、ENABLE_LATENCY_TRACE 用）
+     * @return 割り当てたシーケンス番号
      */
-    void sendButtonPress(int buttonId);
+    uint16_t sendButtonPress(int buttonId, unsigned long capturedAt = 0);
 
     /**
      * @brief システムリセットイベントを送信
@@ -47,20 +254,154 @@ public:
 
     /**
      * @brief エラーメッセージを送信
-     * @param errorMessage エラーメッセージ
+     * @param errorMessage エラーメッセージ（F() の文字列）
      */
-    void sendError(const char *errorMessage);
+    void sendError(const __FlashStringHelper *errorMessage);
 
     /**
      * @brief システム準備完了メッセージを送信
      */
     void sendSystemReady();
 
+    /**
+     * @brief ウォッチドッグ等によるリセットからの復帰を送信（systemReady の代わり）
+     * @param reason 復帰理由（F() の文字列）
+     * @param downtime 推定停止時間（ミリ秒）
+     */
+    void sendRecovered(const __FlashStringHelper *reason, unsigned long downtime);
+
+    /**
+     * @brief トリガーの立ち下がりでラウンドを開始したことを送信（ENABLE_TRIGGER_INPUT 用）
+     */
+    void sendArmed();
+
+    /**
+     * @brief ラウンドの開始前に押されたボタンを送信（ENABLE_TRIGGER_INPUT 用）
+     * @param buttonId ボタンID（1-6）
+     */
+    void sendFalseStart(uint8_t buttonId);
+
+    /**
+     * @brief 解答時間が切れたことを送信（ENABLE_ANSWER_TIMER 用）
+     * @param buttonId 解答中だったボタンID（1-6）
+     */
+    void sendAnswerTimeout(uint8_t buttonId);
+
+    /**
+     * @brief 確定したジェスチャーを送信（ENABLE_GESTURES 用）
+     *
+     * 最初の押下は releasedAt - total、最後の押下は releasedAt - hold の時刻になる
+     * @param buttonId ボタンID（1-6）
+     * @param longPress 最後の押下が長押しか
+     * @param taps 押下回数
+     * @param hold 最後の押下の長さ（ミリ秒）
+     * @param total 最初の押下から最後の解放まで（ミリ秒）
+     * @param releasedAt 最後に離した時刻（ミリ秒、getTimestamp() の時間軸）
+     */
+    void sendGesture(uint8_t buttonId, bool longPress, uint8_t taps, uint16_t hold, uint16_t total,
+                     unsigned long releasedAt);
+
+    /**
+     * @brief リセット前のシーケンス番号とタイムスタンプを引き継ぐ
+     * @param seq 次に割り当てるシーケンス番号
+     * @param timestamp 現在のタイムスタンプ（ミリ秒）
+     */
+    void resume(uint16_t seq, unsigned long timestamp);
+
+    /**
+     * @brief リセット前に送信した押下を元の番号と時刻のまま再送ウィンドウに戻す
+     *
+     * resume() の後、新しいイベントより前に番号順に呼ぶこと
+     * @param seq シーケンス番号
+     * @param buttonId ボタンID（1-6）
+     * @param round 押下のラウンド番号
+     * @param timestamp 押下時刻（ミリ秒）
+     */
+    void requeuePress(uint16_t seq, uint8_t buttonId, uint16_t round, unsigned long timestamp);
+
+    /**
+     * @brief JSONドキュメントを1フレームとして書き出す（コマンドの応答・状態通知用、ACK・再送の対象外）
+     *
+     * ENABLE_COBS_FRAMING なら COBS フレーム、そうでなければ改行で終わる1行になる
+     * @param doc 書き出すJSONドキュメント
+     */
+    void writeFrame(const JsonDocument &doc) const;
+
+    /**
+     * @brief 本文を JsonFrameWriter で直接書き、1フレームとして書き出す（要素の多い応答用）
+     *
+     * JsonDocument のヒープを使わないため、DEBOUNCE・STATUS・state などの大きな応答に使う
+     * @param body 本文を書く関数
+     * @param context body に渡す値
+     */
+    void writeFrame(FrameBody body, const void *context) const;
+
+    /**
+     * @brief 本文を writeFrame() と同じ形式でバッファに符号化する（少しずつ書き出す場合用）
+     * @param body 本文を書く関数
+     * @param context body に渡す値
+     * @param buffer 書き込み先
+     * @param capacity buffer のバイト数
+     * @return 符号化したバイト数（収まらない場合は 0）
+     */
+    size_t encodeFrame(FrameBody body, const void *context, uint8_t *buffer, size_t capacity) const;
+
+    /**
+     * @brief イベントの書き出しを保留する（他のフレームを少しずつ書き出している間に使う）
+     *
+     * 保留中のイベントは再送ウィンドウに溜め、保留を解いた時点でまとめ待ちの時間に関係なく送る
+     * ウィンドウが未送信のイベントで埋まった場合は最古のイベントを破棄する
+     * @param hold true: 保留する, false: 保留を解いて溜まったイベントを送る
+     */
+    void holdOutput(bool hold);
+
+    /**
+     * @brief イベントの記録先を設定する（ENABLE_BLACK_BOX 用）
+     * @param box 記録先（nullptr で解除）
+     */
+    void setBlackBox(BlackBox *box);
+
     /**
      * @brief デバッグメッセージを送信
-     * @param message デバッグメッセージ
+     * @param message デバッグメッセージ（F() の文字列）
+     */
+    void sendDebug(const __FlashStringHelper *message);
+
+    /**
+     * @brief 未ACKイベント数を取得
+     * @return 再送ウィンドウ内のイベント数
+     */
+    uint8_t getPendingCount() const;
+
+    /**
+     * @brief まとめ送信待ちのイベント数を取得
+     * @return まだ一度も送信していないイベント数
+     */
+    uint8_t getUnsentCount() const;
+
+    /**
+     * @brief 次に割り当てるシーケンス番号を取得
+     * @return シーケンス番号
+     */
+    uint16_t getNextSeq() const;
+
+    /**
+     * @brief 最古の未ACKイベントのシーケンス番号を取得
+     * @return シーケンス番号（未ACKイベントがない場合は次に割り当てる番号）
+     */
+    uint16_t getFirstUnackedSeq() const;
+
+    /**
+     * @brief 再送回数を取得
+     * @return 起動後の再送回数
+     */
+    unsigned long getRetransmitCount() const;
+
+    /**
+     * @brief ウィンドウ溢れで破棄したイベント数を取得
+     * @return 起動後の破棄数
      */
-    void sendDebug(const char *message);
+    unsigned long getDroppedCount() const;
 };
 
 #endif // SERIAL_COMMUNICATOR_H
@@ -0,0 +1,115 @@
+/**
+ * @file StatePublisher.h
+ * @brief 状態の購読（SUBSCRIBE）に対して差分とハートビートを送信するクラス
+ *
+ * SUBSCRIBE を受けると全体のスナップショット（state）を1回送り、以降は
+ * アクティブ状態・ラウンド番号・押下順が変わったときだけ差分（stateDelta）を送る
+ * ラウンド番号が変わった差分には直前のラウンドの押下順（previousRound / previousPressed）も載せる
+ * 一定間隔で健全性カウンタを載せたハートビート（heartbeat）も送る
+ * 各メッセージの version で差分の取りこぼしを検出できる（不一致なら SUBSCRIBE し直す）
+ */
+
+#ifndef STATE_PUBLISHER_H
+#define STATE_PUBLISHER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ButtonManager.h"
+#include "SerialCommunicator.h"
+#include "config.h"
+
+class StatePublisher
+{
+public:
+    /**
+     * @brief コンストラクタ
+     */
+    StatePublisher();
+
+    /**
+     * @brief 購読を開始し、スナップショットを送信する
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     */
+    void subscribe(const ButtonManager &buttonManager, const SerialCommunicator &serialComm);
+
+    /**
+     * @brief 購読を終了する
+     */
+    void unsubscribe();
+
+    /**
+     * @brief メインループで呼び出し、状態が変化していれば差分を、間隔が来ればハートビートを送る
+     *
+     * 差分は STATE_DELTA_MIN_INTERVAL ごとにまとめ、送信待ちの押下がある間は送らない
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     */
+    void update(const ButtonManager &buttonManager, const SerialCommunicator &serialComm);
+
+    /**
+     * @brief 購読中かどうかを取得
+     * @return 購読中なら true
+     */
+    bool isSubscribed() const;
+
+private:
+    bool subscribed;
+    uint16_t version;            // 送信した状態の版（差分ごとに1増える）
+    bool sentActive;             // 最後に送信したアクティブ状態
+    uint16_t sentRound;          // 最後に送信したラウンド番号
+    uint8_t sentPressCount;      // 最後に送信した押下数（ラウンド内では増えるだけ）
+    unsigned long lastDeltaAt;   // 最後に差分を送信した時刻
+    unsigned long lastHeartbeatAt; // 最後にハートビート・スナップショットを送信した時刻
+
+    // 送信するメッセージに含めるメンバー
+    enum
+    {
+        FIELD_ACTIVE = 0x01,
+        FIELD_ROUND = 0x02,
+        FIELD_PRESSED = 0x04,
+        FIELD_PREVIOUS = 0x08,
+        FIELD_HEALTH = 0x10
+    };
+
+    // writeMessage() に渡す送信内容（COBS では2回書くため、割り込みで変わるカウンタは先に読んでおく）
+    struct Message
+    {
+        const __FlashStringHelper *type;
+        uint8_t fields;
+        uint16_t version;
+        const ButtonManager *buttonManager;
+        unsigned long missedDeadlines;
+        unsigned long sampleOverflows;
+        uint8_t pending;
+        unsigned long retransmits;
+        unsigned long dropped;
+        unsigned long timestamp;
+    };
+
+    /**
+     * @brief メッセージを組み立てて送信する
+     * @param type type の値
+     * @param fields 含めるメンバー（FIELD_* の組み合わせ）
+     * @param buttonManager ボタン入力管理
+     * @param serialComm シリアル通信管理
+     * @param timestamp 送信時刻
+     */
+    void send(const __FlashStringHelper *type, uint8_t fields, const ButtonManager &buttonManager,
+              const SerialCommunicator &serialComm, unsigned long timestamp);
+
+    /**
+     * @brief メッセージの本文を書く（SerialCommunicator::FrameBody）
+     * @param writer 書き出し先
+     * @param context 送信内容（Message）
+     */
+    static void writeMessage(JsonFrameWriter &writer, const void *context);
+
+    /**
+     * @brief 送信した状態を記録する
+     * @param buttonManager ボタン入力管理
+     */
+    void remember(const ButtonManager &buttonManager);
+};
+
+#endif // STATE_PUBLISHER_H
@@ -0,0 +1,67 @@
+/**
+ * @file TriggerInput.h
+ * @brief ラウンド開始（アーム）のトリガー入力クラス
+ *
+ * TRIGGER_PIN の立ち下がりをピン変化割り込みで捉え、ButtonSampler と同じサンプル番号で記録する
+ * シリアルの RESET（数十ミリ秒の揺らぎがある）ではなく、司会のボタンや音声の合図からの
+ * 配線でラウンドを開始できる（分解能はボタンと同じ1サンプル）
+ *
+ * enable() の後の最初の立ち下がりだけを記録し、次の enable() まで以降のエッジは無視する
+ */
+
+#ifndef TRIGGER_INPUT_H
+#define TRIGGER_INPUT_H
+
+#include <Arduino.h>
+#include "ButtonSampler.h"
+#include "config.h"
+
+class TriggerInput
+{
+public:
+    /**
+     * @brief コンストラクタ
+     */
+    TriggerInput();
+
+    /**
+     * @brief トリガーピンと割り込みを設定する（待ち受けはしない）
+     * @param buttonSampler 時刻に使うサンプラー（begin() 済みであること）
+     */
+    void begin(const ButtonSampler &buttonSampler);
+
+    /**
+     * @brief 次の立ち下がりを待ち受ける（記録済みのエッジは消去する）
+     */
+    void enable();
+
+    /**
+     * @brief 待ち受けをやめる
+     */
+    void disable();
+
+    /**
+     * @brief 立ち下がりが記録されていれば取り出す
+     * @param tick エッジのサンプル番号（エッジの後の最初のサンプル）
+     * @return 記録されていた場合 true
+     */
+    bool poll(uint32_t &tick);
+
+    /**
+     * @brief 割り込みハンドラから呼ばれるエッジの処理
+     */
+    void handleEdge();
+
+    /**
+     * @brief 割り込みハンドラが使うインスタンス
+     */
+    static TriggerInput *instance;
+
+private:
+    const ButtonSampler *sampler;
+    volatile bool waiting;   // 立ち下がりを待ち受けているか
+    volatile bool triggered; // 立ち下がりが記録されているか
+    volatile uint32_t edgeTick;
+};
+
+#endif // TRIGGER_INPUT_H
@@ -18,18 +18,104 @@
 
 // ===== システム設定 =====
 #define MAX_BUTTONS 6     // 最大ボタン数
-#define DEBOUNCE_DELAY 50 // デバウンス時間（ミリ秒）
+#define DEBOUNCE_DELAY 50 // デバウンス時間（ミリ秒、ENABLE_ADAPTIVE_DEBOUNCE では学習前の値と上限）
+
+// ===== サンプリング設定 =====
+#define SCAN_SAMPLE_RATE_HZ 20000 // ボタン入力のサンプリング周波数（Timer2 割り込み、1000-50000）
+#define SAMPLE_FIFO_SIZE 32       // 状態変化サンプルの FIFO サイズ（2のべき乗）
+
+// ===== 押下順の判定（lib/QuizArbiter、サーバーと同じ規則） =====
+#define PRESS_TIE_WINDOW_US 0         // この時間差以内の押下を同着とする（マイクロ秒、0: 同じサンプルのみ）
+#define PRESS_TIE_RULE TIE_BY_ARRIVAL // 同着の並べ方（TIE_BY_ARRIVAL: 確定した順、TIE_BY_PLAYER: ボタンIDの小さい順）
 
 // ===== LED設定（オプション） =====
 #define LED_1_PIN 2
 #define LED_2_PIN 3
 #define LED_3_PIN 4
 #define LED_4_PIN 5
-#define LED_5_PIN 2
-#define LED_6_PIN 3
+#define LED_5_PIN 6
+#define LED_6_PIN 7
+
+// ===== 通信信頼性設定 =====
+#define RETRANSMIT_WINDOW 8     // ACK待ちイベントの保持数
+#define RETRANSMIT_TIMEOUT 500  // 再送までの待ち時間（ミリ秒、ACK が来ないまま再送するたびに2倍にする）
+#define RETRANSMIT_MAX_ATTEMPTS 5 // ACK が来ないまま再送する回数の上限（以降は次の ACK か RESYNC まで再送しない）
+#define PRESS_BATCH_WINDOW 2    // 同時押しを1フレームにまとめる時間（ミリ秒、0で無効）
+
+// ===== 状態通知設定（SUBSCRIBE） =====
+#define STATE_DELTA_MIN_INTERVAL 100   // 差分通知の最短間隔（ミリ秒、この間の変化はまとめる）
+#define STATE_HEARTBEAT_INTERVAL 5000  // ハートビートの間隔（ミリ秒）
+
+// ===== 検出遅延の校正設定（CALIBRATE） =====
+#define CALIBRATION_PIN 12            // 基準エッジを出すピン（校正するボタンの入力線につなぐ、通常はハイインピーダンス）
+#define CALIBRATION_SAMPLES 16        // 1ボタンあたりの計測回数（平均する）
+#define CALIBRATION_SETTLE_MS 20      // 計測の間に入力線が戻るのを待つ時間（ミリ秒）
+#define CALIBRATION_TIMEOUT_MS 20     // 基準エッジが検出されない場合に失敗とする時間（ミリ秒）
+#define CALIBRATION_EEPROM_ADDRESS 0  // 校正結果を保存する EEPROM の先頭アドレス
+
+// ===== ラウンド開始のトリガー入力（ENABLE_TRIGGER_INPUT） =====
+#define TRIGGER_PIN 8 // LOW への立ち下がりでラウンドを開始するピン（D8-D13、INPUT_PULLUP）
+
+// ===== デバウンス時間の学習（ENABLE_ADAPTIVE_DEBOUNCE、DEBOUNCE） =====
+#define DEBOUNCE_MIN_MS 5                // 学習で縮めるデバウンス時間の下限（ミリ秒）
+#define DEBOUNCE_MARGIN 2                // 観測したバウンスの間隔の最大に対するデバウンス時間の倍率
+#define DEBOUNCE_LEARN_COUNT 16          // この回数（押下・解放）観測するまでは DEBOUNCE_DELAY のまま
+#define DEBOUNCE_SAVE_INTERVAL_MS 60000  // 学習結果を EEPROM に保存する最短間隔（ミリ秒）
+#define DEBOUNCE_EEPROM_ADDRESS 16       // 学習結果を保存する EEPROM の先頭アドレス（校正結果の後ろ）
+
+// ===== 生の入力のストリーミング（ENABLE_SCOPE、SCOPE） =====
+#define SCOPE_BUFFER_EDGES 16  // 送信待ちの変化を保持する数（溢れた分は lost として数える）
+#define SCOPE_FRAME_EDGES 6    // 1フレームに入れる変化の最大数
+#define SCOPE_FRAME_BYTES 112  // 1フレームの最大バイト数（符号化後、改行・COBS の区切りを含む）
+#define SCOPE_FLUSH_MS 20      // 変化がこの時間溜まったら SCOPE_FRAME_EDGES に満たなくても送る（ミリ秒）
+#define SCOPE_IDLE_MS 1000     // 変化がない間も現在の状態を送る間隔（ミリ秒）
+
+// ===== 解答時間（ENABLE_ANSWER_TIMER、ANSWER） =====
+#define ANSWER_TIME_MS 20000   // 最初の押下からの制限時間の初期値（ミリ秒、ANSWER <ms> で変更、0: 計時しない）
+#define ANSWER_WARNING_MS 5000 // 残りがこの時間を切ったら解答中のボタンの LED を点滅させる（ミリ秒）
+#define ANSWER_BLINK_MS 250    // 点滅の周期（ミリ秒）
+
+// ===== ジェスチャー（ENABLE_GESTURES） =====
+#define GESTURE_LONG_PRESS_MS 800 // 押してから離すまでがこの時間以上なら長押しとする（ミリ秒）
+#define GESTURE_TAP_GAP_MS 300    // 離してからこの時間以内に押せば連打として続ける（ミリ秒、確定はこの時間だけ遅れる）
+
+// ===== 動作記録（ENABLE_BLACK_BOX、DUMP） =====
+#define BLACK_BOX_EEPROM_ADDRESS 64 // 記録を保存する EEPROM の先頭アドレス（デバウンスの学習結果の後ろ）
+#define BLACK_BOX_EEPROM_SIZE 960   // 記録に使う EEPROM のバイト数（1件 16 バイト、60 件で6人が押すラウンドの約7回分）
+#define BLACK_BOX_QUEUE_SIZE 8      // EEPROM に書くまで RAM に溜めておく件数（溢れた分は捨てる）
+#define BLACK_BOX_FLUSH_MS 500      // 記録がこの時間途切れたら EEPROM に書き始める（ミリ秒）
+
+// ===== ウォッチドッグ設定 =====
+#define WATCHDOG_TIMEOUT WDTO_250MS // ウォッチドッグのタイムアウト（avr/wdt.h の WDTO_*）
+#define WATCHDOG_TIMEOUT_MS 250     // 上記のミリ秒換算（復帰時の停止時間の推定に使う）
+// 最大のフレームは DEBOUNCE の応答（通常 約340 バイト、最大 約420 バイト）で、9600bps（1 バイト 約1.04ms）では
+// 送信バッファ（64 バイト）が空くのを待ちながら書き出すため最大 約440ms かかる。ANALYTICS（約200 バイト）も
+// タイムアウトに近いため、1フレームの書き出し中も一定バイト数ごとにリセットする
+#define WATCHDOG_RESET_BYTES 32 // フレームの書き出し中にウォッチドッグをリセットする間隔（バイト、9600bps で約33ms）
+#define RECOVERY_SAVE_INTERVAL 10   // 状態に変化がなくても生存時刻を保存する間隔（ミリ秒）
 
 // ===== 機能フラグ =====
+// RAM（Uno は 2KB）の見積もりは既定の設定で静的に 約1.45KB（BLACK_BOX の 約166 バイトを含む）、スタックと送信中の
+// JsonDocument のヒープが最大 約0.43KB（gesture イベントの送信時。DEBOUNCE・STATUS・state・scope・analytics・blackBox は
+// JsonFrameWriter で直接書き、ヒープを使わない）で、合計 約1.88KB（残り 約165 バイト）
+// 診断用の SCOPE・REACTION_STATS は既定で無効とし、使うときは BLACK_BOX を無効にして1つだけ有効にする
+// （2つ以上を同時に有効にすると 2KB を超える見積もり。pio run -e uno の RAM と STATUS の ramFree で空きを確かめる）
+//   SCOPE: 約216 バイト（合計 約1.93KB、残り 約115 バイト）
+//   REACTION_STATS: 約231 バイト（合計 約1.95KB、残り 約100 バイト）
+// 内訳は README の「RAM の使用量」
 #define ENABLE_LED_FEEDBACK true  // LED表示を有効化
 #define ENABLE_DEBUG_OUTPUT false // デバッグ出力を有効化
+#define ENABLE_RELIABLE_DELIVERY true // シーケンス番号・ACK・再送を有効化
+#define ENABLE_RUNTIME_PIN_CONFIG false // ピン配置を実行時に ButtonConfig から読む（false: config.h の値をコンパイル時に展開）
+#define ENABLE_WATCHDOG_RECOVERY true // ウォッチドッグを有効化し、リセット後にラウンドの状態を復元する
+#define ENABLE_LATENCY_TRACE false // 各イベントに遅延計測用のタイムスタンプ（trace）を付ける
+#define ENABLE_COBS_FRAMING false // JSON を改行区切りの行ではなく COBS + CRC-16 のフレームで送る（ホストは自動判別）
+#define ENABLE_REACTION_STATS false // ボタンごとの反応時間の統計を取り、ANALYTICS で返す（診断用）
+#define ENABLE_ADAPTIVE_DEBOUNCE true // ボタンごとのバウンスを観測してデバウンス時間を学習し、DEBOUNCE で返す
+#define ENABLE_TRIGGER_INPUT false // RESET の後、TRIGGER_PIN の立ち下がりでラウンドを開始する（それより前の押下はフライング）
+#define ENABLE_SCOPE false // SCOPE コマンドでサンプリングした生の入力の変化をそのまま送る（バウンスの観測用）
+#define ENABLE_BLACK_BOX true // 起動・リセット・押下・エラーを EEPROM に記録し、DUMP で返す
+#define ENABLE_ANSWER_TIMER true // 最初の押下から解答時間を計り、LED の点滅と answerTimeout で知らせる
+#define ENABLE_GESTURES true // ボタンごとの連打・長押しを判定し、1回の操作ごとに gesture イベントで送る
 
 #endif // CONFIG_H
@@ -0,0 +1,182 @@
+/**
+ * @file QuizArbiter.cpp
+ * @brief 早押しの判定の実装
+ */
+
+#include "QuizArbiter.h"
+
+QuizArbiter::QuizArbiter(uint8_t players)
+    : playerCount(players > ARBITER_MAX_PLAYERS ? ARBITER_MAX_PLAYERS : players),
+      accepting(true),
+      count(0),
+      lockedMask(0),
+      penaltyMask(0)
+{
+    rules.tieWindow = 0;
+    rules.tieRule = TIE_BY_ARRIVAL;
+    rules.penalty = 0;
+    for (uint8_t i = 0; i < ARBITER_MAX_PLAYERS; i++)
+    {
+        order[i] = 0;
+        times[i] = 0;
+        penaltyUntil[i] = 0;
+    }
+}
+
+void QuizArbiter::setRules(const ArbiterRules &newRules)
+{
+    rules = newRules;
+}
+
+void QuizArbiter::open()
+{
+    accepting = true;
+    count = 0;
+    lockedMask = 0;
+    penaltyMask = 0;
+}
+
+void QuizArbiter::close()
+{
+    accepting = false;
+}
+
+ArbiterDecision QuizArbiter::press(uint8_t player, uint32_t time)
+{
+    if (player < 1 || player > playerCount)
+    {
+        return ARBITER_INVALID;
+    }
+    if (!accepting)
+    {
+        return ARBITER_CLOSED;
+    }
+    if (getPosition(player) != 0)
+    {
+        return ARBITER_DUPLICATE;
+    }
+    if (isLockedOut(player, time))
+    {
+        return ARBITER_LOCKED_OUT;
+    }
+    penaltyMask &= (uint8_t)~(1 << (player - 1));
+
+    // 後ろから比べて挿入位置を決める（同着の到着順を保つため、前に並ぶ場合だけ進める）
+    uint8_t position = count;
+    while (position > 0 && ranksBefore(player, time, position - 1))
+    {
+        order[position] = order[position - 1];
+        times[position] = times[position - 1];
+        position--;
+    }
+    order[position] = player;
+    times[position] = time;
+    count++;
+    return ARBITER_ACCEPTED;
+}
+
+uint8_t QuizArbiter::judgeIncorrect(uint32_t now)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint8_t player = order[0];
+    withdraw(player);
+
+    uint8_t bit = (uint8_t)(1 << (player - 1));
+    if (rules.penalty == ARBITER_LOCKOUT_QUESTION)
+    {
+        lockedMask |= bit;
+    }
+    else if (rules.penalty > 0)
+    {
+        penaltyMask |= bit;
+        penaltyUntil[player - 1] = now + rules.penalty;
+    }
+    return player;
+}
+
+bool QuizArbiter::withdraw(uint8_t player)
+{
+    uint8_t position = getPosition(player);
+    if (position == 0)
+    {
+        return false;
+    }
+    for (uint8_t i = position; i < count; i++)
+    {
+        order[i - 1] = order[i];
+        times[i - 1] = times[i];
+    }
+    count--;
+    return true;
+}
+
+bool QuizArbiter::restore(uint8_t restoredCount, const uint8_t *restoredOrder, uint32_t time)
+{
+    if (restoredCount > playerCount)
+    {
+        return false;
+    }
+    uint8_t seen = 0;
+    for (uint8_t i = 0; i < restoredCount; i++)
+    {
+        if (restoredOrder[i] < 1 || restoredOrder[i] > playerCount || (seen >> (restoredOrder[i] - 1)) & 1)
+        {
+            return false;
+        }
+        seen |= (uint8_t)(1 << (restoredOrder[i] - 1));
+    }
+
+    open();
+    for (uint8_t i = 0; i < restoredCount; i++)
+    {
+        order[i] = restoredOrder[i];
+        times[i] = time;
+    }
+    count = restoredCount;
+    return true;
+}
+
+uint8_t QuizArbiter::getPosition(uint8_t player) const
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (order[i] == player)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool QuizArbiter::isLockedOut(uint8_t player, uint32_t now) const
+{
+    if (player < 1 || player > playerCount)
+    {
+        return false;
+    }
+    uint8_t bit = (uint8_t)(1 << (player - 1));
+    if (lockedMask & bit)
+    {
+        return true;
+    }
+    return (penaltyMask & bit) && (int32_t)(now - penaltyUntil[player - 1]) < 0;
+}
+
+bool QuizArbiter::ranksBefore(uint8_t player, uint32_t time, uint8_t position) const
+{
+    int32_t diff = (int32_t)(time - times[position]);
+    int32_t window = rules.tieWindow < 0x7FFFFFFFUL ? (int32_t)rules.tieWindow : 0x7FFFFFFF;
+    if (diff < -window)
+    {
+        return true;
+    }
+    if (diff > window)
+    {
+        return false;
+    }
+    // 同着
+    return rules.tieRule == TIE_BY_PLAYER && player < order[position];
+}
@@ -0,0 +1,192 @@
+/**
+ * @file QuizArbiter.h
+ * @brief 早押しの判定（押下順・同着・ロックアウト・ペナルティ）（コントローラーとサーバーで共有）
+ *
+ * ボタン（コントローラー）とタブレット（サーバー）の押下を同じ規則で判定するため、判定はこのクラスに集める
+ * - 押下順: 押下の時刻の早い順（後から届いた押下でも時刻が早ければ前に入る）
+ * - 同着: 時刻の差が tieWindow 以内の押下は、tieRule（到着順 / プレーヤー番号順）で並べる
+ * - 重複: 問題ごとに1人1回（順位に残っている間は押し直せない）
+ * - ペナルティ: 不正解で順位から外れた人は penalty の間押せない（ARBITER_LOCKOUT_QUESTION: 次の問題まで）
+ *
+ * 時刻の単位は呼び出し側が決める（コントローラーはサンプル番号、サーバーはマイクロ秒）
+ * 32bit の時刻は一周するため、差が 2^31 未満の範囲で比較する
+ *
+ * コントローラー（C++11、Arduino）とサーバーのネイティブアドオン（C++17）の両方でビルドするため、
+ * 標準 C のヘッダーだけを使い、動的なメモリ確保はしない
+ */
+
+#ifndef QUIZ_ARBITER_H
+#define QUIZ_ARBITER_H
+
+#include <stdint.h>
+
+/**
+ * @brief 判定できるプレーヤー数の上限
+ */
+const uint8_t ARBITER_MAX_PLAYERS = 8;
+
+/**
+ * @brief 不正解の後、次の問題まで押せなくする場合の penalty
+ */
+const uint32_t ARBITER_LOCKOUT_QUESTION = 0xFFFFFFFFUL;
+
+/**
+ * @brief 同着の並べ方
+ */
+enum ArbiterTieRule
+{
+    TIE_BY_ARRIVAL, // 先に届いた方を前にする
+    TIE_BY_PLAYER   // プレーヤー番号の小さい方を前にする
+};
+
+/**
+ * @brief press() の結果
+ */
+enum ArbiterDecision
+{
+    ARBITER_ACCEPTED,   // 受け付けた（getPosition() で順位が分かる）
+    ARBITER_DUPLICATE,  // 既に順位に入っている
+    ARBITER_LOCKED_OUT, // ペナルティ中
+    ARBITER_CLOSED,     // 受付中でない
+    ARBITER_INVALID     // プレーヤー番号が範囲外
+};
+
+/**
+ * @brief 判定の規則
+ */
+struct ArbiterRules
+{
+    uint32_t tieWindow;      // この時間差以内の押下は同着（0: 同じ時刻のみ）
+    ArbiterTieRule tieRule;  // 同着の並べ方
+    uint32_t penalty;        // 不正解の後に押せない時間（0: すぐ押せる）
+};
+
+class QuizArbiter
+{
+public:
+    /**
+     * @brief コンストラクタ（受付中、同着は同じ時刻のみ・到着順、ペナルティなし）
+     * @param players プレーヤー数（1-ARBITER_MAX_PLAYERS）
+     */
+    explicit QuizArbiter(uint8_t players = ARBITER_MAX_PLAYERS);
+
+    /**
+     * @brief 判定の規則を設定する（受け付け済みの順位は並べ直さない）
+     * @param newRules 規則
+     */
+    void setRules(const ArbiterRules &newRules);
+
+    /**
+     * @brief 判定の規則を取得
+     * @return 規則
+     */
+    const ArbiterRules &getRules() const { return rules; }
+
+    /**
+     * @brief 新しい問題の受付を始める（順位とペナルティを消去する）
+     */
+    void open();
+
+    /**
+     * @brief 受付を終える（順位は次の open() まで残る）
+     */
+    void close();
+
+    /**
+     * @brief 押下を判定し、受け付けた場合は順位に入れる
+     * @param player プレーヤー番号（1-playerCount）
+     * @param time 押下の時刻
+     * @return 判定結果
+     */
+    ArbiterDecision press(uint8_t player, uint32_t time);
+
+    /**
+     * @brief 先頭のプレーヤーを不正解として順位から外し、ペナルティを科す
+     * @param now 現在の時刻（ペナルティの起点）
+     * @return 外したプレーヤー番号（順位が空なら0）
+     */
+    uint8_t judgeIncorrect(uint32_t now);
+
+    /**
+     * @brief プレーヤーを順位から外す（ペナルティは科さない、後ろの順位は繰り上がる）
+     * @param player プレーヤー番号
+     * @return 順位に入っていなかった場合 false
+     */
+    bool withdraw(uint8_t player);
+
+    /**
+     * @brief 順位をそのまま復元する（コントローラーのウォッチドッグ復帰用）
+     *
+     * 復元した押下の時刻は全て time とし、以降の押下はその後ろに並ぶ
+     * @param restoredCount プレーヤー数
+     * @param restoredOrder プレーヤー番号（押下順）
+     * @param time 復元した押下の時刻
+     * @return 内容が不正で復元しなかった場合 false
+     */
+    bool restore(uint8_t restoredCount, const uint8_t *restoredOrder, uint32_t time);
+
+    /**
+     * @brief 受付中かどうかを取得
+     * @return 受付中なら true
+     */
+    bool isOpen() const { return accepting; }
+
+    /**
+     * @brief 順位に入っているプレーヤー数を取得
+     * @return 0-playerCount
+     */
+    uint8_t getCount() const { return count; }
+
+    /**
+     * @brief position 番目のプレーヤーを取得
+     * @param position 順位（0が最初）
+     * @return プレーヤー番号
+     */
+    uint8_t getPlayer(uint8_t position) const { return order[position]; }
+
+    /**
+     * @brief position 番目の押下の時刻を取得
+     * @param position 順位（0が最初）
+     * @return 時刻
+     */
+    uint32_t getTime(uint8_t position) const { return times[position]; }
+
+    /**
+     * @brief プレーヤーの順位を取得
+     * @param player プレーヤー番号
+     * @return 順位（1が最初、順位に入っていなければ0）
+     */
+    uint8_t getPosition(uint8_t player) const;
+
+    /**
+     * @brief プレーヤーがペナルティ中かどうかを取得
+     * @param player プレーヤー番号
+     * @param now 現在の時刻
+     * @return ペナルティ中なら true
+     */
+    bool isLockedOut(uint8_t player, uint32_t now) const;
+
+private:
+    ArbiterRules rules;
+    uint8_t playerCount;
+    bool accepting;
+
+    uint8_t count;
+    uint8_t order[ARBITER_MAX_PLAYERS];  // プレーヤー番号（順位順）
+    uint32_t times[ARBITER_MAX_PLAYERS]; // 押下の時刻（順位順）
+
+    uint8_t lockedMask;  // 次の問題まで押せないプレーヤー（bit i = プレーヤー i+1）
+    uint8_t penaltyMask; // 時間つきのペナルティ中のプレーヤー
+    uint32_t penaltyUntil[ARBITER_MAX_PLAYERS]; // ペナルティが明ける時刻
+
+    /**
+     * @brief 新しい押下が position 番目の押下より前に並ぶか
+     * @param player 新しい押下のプレーヤー番号
+     * @param time 新しい押下の時刻
+     * @param position 比べる順位
+     * @return 前に並ぶ場合 true
+     */
+    bool ranksBefore(uint8_t player, uint32_t time, uint8_t position) const;
+};
+
+#endif // QUIZ_ARBITER_H
@@ -0,0 +1,72 @@
+/**
+ * @file QuizBlackBox.cpp
+ * @brief 動作記録の形式の実装
+ */
+
+#include "QuizBlackBox.h"
+#include <QuizFraming.h>
+
+namespace
+{
+const size_t CRC_OFFSET = BLACK_BOX_ENTRY_SIZE - 2;
+
+void putU16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+}
+
+void putU32(uint8_t *bytes, uint32_t value)
+{
+    putU16(bytes, (uint16_t)value);
+    putU16(bytes + 2, (uint16_t)(value >> 16));
+}
+
+uint16_t getU16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | ((uint16_t)bytes[1] << 8));
+}
+
+uint32_t getU32(const uint8_t *bytes)
+{
+    return getU16(bytes) | ((uint32_t)getU16(bytes + 2) << 16);
+}
+
+uint16_t entryCrc(const uint8_t *bytes)
+{
+    uint16_t crc = BLACK_BOX_CRC_SEED;
+    for (size_t i = 0; i < CRC_OFFSET; i++)
+    {
+        crc = frameCrc16Update(crc, bytes[i]);
+    }
+    return crc;
+}
+} // namespace
+
+void blackBoxEncode(const BlackBoxEntry &entry, uint8_t *bytes)
+{
+    putU16(bytes, entry.index);
+    bytes[2] = entry.type;
+    bytes[3] = entry.buttonId;
+    putU16(bytes + 4, entry.round);
+    putU16(bytes + 6, entry.seq);
+    putU32(bytes + 8, entry.timestamp);
+    putU16(bytes + 12, entry.detail);
+    putU16(bytes + CRC_OFFSET, entryCrc(bytes));
+}
+
+bool blackBoxDecode(const uint8_t *bytes, BlackBoxEntry &entry)
+{
+    if (getU16(bytes + CRC_OFFSET) != entryCrc(bytes))
+    {
+        return false;
+    }
+    entry.index = getU16(bytes);
+    entry.type = bytes[2];
+    entry.buttonId = bytes[3];
+    entry.round = getU16(bytes + 4);
+    entry.seq = getU16(bytes + 6);
+    entry.timestamp = getU32(bytes + 8);
+    entry.detail = getU16(bytes + 12);
+    return true;
+}
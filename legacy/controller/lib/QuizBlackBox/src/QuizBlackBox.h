@@ -0,0 +1,80 @@
+/**
+ * @file QuizBlackBox.h
+ * @brief EEPROM に残す動作記録（ブラックボックス）の形式（コントローラーとホストで共有）
+ *
+ * 1件は BLACK_BOX_ENTRY_SIZE バイトの固定長で、リトルエンディアンで次の順に並ぶ
+ *
+ *   index(2) | type(1) | buttonId(1) | round(2) | seq(2) | timestamp(4) | detail(2) | crc(2)
+ *
+ * - index は記録した順の通し番号（一周する）。記録が溢れて捨てた分も番号を進めるため、欠番は取りこぼしを表す
+ * - crc は crc より前の 14 バイトの CRC-16/CCITT（初期値 BLACK_BOX_CRC_SEED）
+ *   書き込み途中で電源が落ちた件・消去したままの領域（0xFF）は CRC が合わないため読み飛ばす
+ *
+ * コントローラー（C++11、Arduino）とホスト（C++17）の両方でビルドするため、標準 C のヘッダーだけを使う
+ */
+
+#ifndef QUIZ_BLACK_BOX_H
+#define QUIZ_BLACK_BOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 1件のバイト数
+ */
+const size_t BLACK_BOX_ENTRY_SIZE = 16;
+
+/**
+ * @brief CRC の初期値（"QB"、他の用途で書かれた EEPROM の内容を記録と取り違えないようにする）
+ */
+const uint16_t BLACK_BOX_CRC_SEED = 0x5142;
+
+/**
+ * @brief 記録の種類
+ */
+enum BlackBoxType
+{
+    BLACK_BOX_BOOT = 1,            // 起動（detail: リセット要因の MCUSR、timestamp: 起動時の millis()）
+    BLACK_BOX_PRESS = 2,           // 押下（確定した順）
+    BLACK_BOX_RESET = 3,           // ラウンドのリセット（RESET）
+    BLACK_BOX_ARMED = 4,           // トリガー入力でラウンドを開始した
+    BLACK_BOX_FALSE_START = 5,     // フライング
+    BLACK_BOX_ERROR = 6,           // エラー（detail: メッセージの CRC-16/CCITT-FALSE）
+    BLACK_BOX_READY = 7,           // 起動完了（systemReady）
+    BLACK_BOX_RECOVERED = 8,       // ウォッチドッグ等のリセットから復帰した（detail: 停止時間のミリ秒、65535 で止まる）
+    BLACK_BOX_DROPPED = 9,         // 再送ウィンドウが溢れてイベントを破棄した（seq・buttonId は破棄したイベントのもの）
+    BLACK_BOX_ANSWER_TIMEOUT = 10, // 解答時間切れ（answerTimeout）
+    BLACK_BOX_GESTURE = 11         // ジェスチャー（detail: 上位4ビットが押下回数で 15 で止まる、
+                                   // 下位12ビットが最後の押下の長さの 10 ミリ秒単位で 4095 で止まる、timestamp: 最後に離した時刻）
+};
+
+/**
+ * @brief 1件の記録
+ */
+struct BlackBoxEntry
+{
+    uint16_t index;     // 通し番号
+    uint8_t type;       // BlackBoxType
+    uint8_t buttonId;   // ボタンID（押下・フライング・解答時間切れ・ジェスチャー、それ以外は 0）
+    uint16_t round;     // ラウンド番号
+    uint16_t seq;       // イベントのシーケンス番号
+    uint32_t timestamp; // コントローラーの時刻（ミリ秒、イベントの timestamp と同じ時間軸）
+    uint16_t detail;    // 種類ごとの付加情報
+};
+
+/**
+ * @brief 1件を CRC 付きのバイト列にする
+ * @param entry 記録
+ * @param bytes 書き込み先（BLACK_BOX_ENTRY_SIZE バイト）
+ */
+void blackBoxEncode(const BlackBoxEntry &entry, uint8_t *bytes);
+
+/**
+ * @brief バイト列から1件を取り出し、CRC を検査する
+ * @param bytes BLACK_BOX_ENTRY_SIZE バイト
+ * @param entry 取り出した記録
+ * @return CRC が一致した場合 true
+ */
+bool blackBoxDecode(const uint8_t *bytes, BlackBoxEntry &entry);
+
+#endif // QUIZ_BLACK_BOX_H
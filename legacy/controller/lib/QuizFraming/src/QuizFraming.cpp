@@ -0,0 +1,68 @@
+/**
+ * @file QuizFraming.cpp
+ * @brief COBS と CRC-16 によるフレーム化の実装
+ */
+
+#include "QuizFraming.h"
+
+uint16_t frameCrc16Update(uint16_t crc, uint8_t byte)
+{
+    crc ^= (uint16_t)byte << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+        crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+uint16_t frameCrc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = frameCrc16Update(crc, data[i]);
+    }
+    return crc;
+}
+
+FrameStatus frameDecode(uint8_t *data, size_t length, size_t &bodyLength)
+{
+    if (length == 0)
+    {
+        return FRAME_EMPTY;
+    }
+
+    // 書き込み位置は常に読み出し位置より前にあるので、同じバッファに上書きしてよい
+    size_t in = 0;
+    size_t out = 0;
+    while (in < length)
+    {
+        uint8_t code = data[in++];
+        if (code == FRAME_DELIMITER || in + code - 1 > length)
+        {
+            return FRAME_MALFORMED;
+        }
+        for (uint8_t i = 1; i < code; i++)
+        {
+            // 区切りで分けていない入力（ブロックの途中の 0x00）は COBS として不正
+            if (data[in] == FRAME_DELIMITER)
+            {
+                return FRAME_MALFORMED;
+            }
+            data[out++] = data[in++];
+        }
+        // 長さが上限（0xFF）のブロックとフレームの最後のブロックの後ろには 0x00 がない
+        if (code != 0xFF && in < length)
+        {
+            data[out++] = 0x00;
+        }
+    }
+
+    if (out < FRAME_CRC_SIZE)
+    {
+        return FRAME_MALFORMED;
+    }
+    bodyLength = out - FRAME_CRC_SIZE;
+    uint16_t expected = (uint16_t)((data[bodyLength] << 8) | data[bodyLength + 1]);
+    return frameCrc16(data, bodyLength) == expected ? FRAME_OK : FRAME_BAD_CRC;
+}
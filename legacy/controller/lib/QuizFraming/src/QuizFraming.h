@@ -0,0 +1,213 @@
+/**
+ * @file QuizFraming.h
+ * @brief COBS と CRC-16 によるフレーム化（コントローラーとホストで共有）
+ *
+ * 改行区切りの JSON 行の代わりに使うフレーム形式
+ *
+ *   0x00 | COBS(本文 + CRC-16 上位バイト + CRC-16 下位バイト) | 0x00
+ *
+ * - COBS で符号化した部分には 0x00 が現れないため、0x00 は必ずフレームの区切りになる
+ *   途中から受信を始めても、ノイズで壊れても、次の 0x00 から読み直せば同期が戻る
+ * - 先頭の 0x00 は、直前に届いた不完全なデータ（デバッグ出力など）を別のフレームとして切り離す
+ * - CRC-16 は CCITT-FALSE（多項式 0x1021、初期値 0xFFFF）で本文だけにかかる
+ *
+ * コントローラー（C++11、Arduino）とホスト（C++17）の両方でビルドするため、標準 C のヘッダーだけを使う
+ */
+
+#ifndef QUIZ_FRAMING_H
+#define QUIZ_FRAMING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief フレームの区切り
+ */
+const uint8_t FRAME_DELIMITER = 0x00;
+
+/**
+ * @brief フレーム末尾の CRC のバイト数
+ */
+const size_t FRAME_CRC_SIZE = 2;
+
+/**
+ * @brief frameDecode() の結果
+ */
+enum FrameStatus
+{
+    FRAME_OK,        // 正常（本文を取り出した）
+    FRAME_EMPTY,     // 区切りが続いただけ（フレームではない）
+    FRAME_MALFORMED, // COBS として不正（途中で切れた、CRC より短い）
+    FRAME_BAD_CRC    // CRC 不一致
+};
+
+/**
+ * @brief CRC-16/CCITT-FALSE を1バイト分更新する
+ * @param crc 現在の値（最初は 0xFFFF）
+ * @param byte 追加するバイト
+ * @return 更新後の値
+ */
+uint16_t frameCrc16Update(uint16_t crc, uint8_t byte);
+
+/**
+ * @brief バイト列の CRC-16/CCITT-FALSE を計算する
+ * @param data データ
+ * @param length バイト数
+ * @return CRC
+ */
+uint16_t frameCrc16(const uint8_t *data, size_t length);
+
+/**
+ * @brief 区切りを除いた1フレームを復号し、CRC を検査する
+ *
+ * 復号結果は元の位置に上書きする（出力は常に入力より短いため、その場で復号できる）
+ * @param data 区切りの間のバイト列（復号した本文で上書きされる）
+ * @param length バイト数
+ * @param bodyLength 本文のバイト数（FRAME_OK の場合）
+ * @return 結果
+ */
+FrameStatus frameDecode(uint8_t *data, size_t length, size_t &bodyLength);
+
+/**
+ * @brief 本文の長さと CRC を求める（FrameEncoder の前に本文を1回流す）
+ */
+class FrameChecksum
+{
+public:
+    FrameChecksum() : crc(0xFFFF), count(0) {}
+
+    void update(uint8_t byte)
+    {
+        crc = frameCrc16Update(crc, byte);
+        count++;
+    }
+
+    uint16_t getCrc() const { return crc; }
+    size_t getLength() const { return count; }
+
+private:
+    uint16_t crc;
+    size_t count;
+};
+
+/**
+ * @brief 本文を1バイトずつ受け取り、バッファなしでフレームを書き出す
+ *
+ * COBS は各ブロックの先頭に「次の 0x00 までの距離」を書くため、本来は先読みが必要になる
+ * 本文に 0x00 を含まない（JSON テキスト）ことと、本文の長さと CRC が先に分かっていることを前提に、
+ * 0x00 が現れうる位置を CRC の2バイトに限って先読みを不要にしている
+ *
+ * @tparam Output write(uint8_t) を持つ出力先（Arduino の Print、ホストの文字列など）
+ */
+template <class Output>
+class FrameEncoder
+{
+public:
+    /**
+     * @brief コンストラクタ（先頭の区切りを書き出す）
+     * @param output 出力先
+     * @param length 本文のバイト数
+     * @param crc 本文の CRC（FrameChecksum で求める）
+     */
+    FrameEncoder(Output &output, size_t length, uint16_t crc)
+        : out(output),
+          bodyLength(length),
+          position(0),
+          blockEnd(0),
+          blockOpen(false),
+          zeroAtEnd(false),
+          lastWasZero(false)
+    {
+        trailer[0] = (uint8_t)(crc >> 8);
+        trailer[1] = (uint8_t)crc;
+        out.write(FRAME_DELIMITER);
+    }
+
+    /**
+     * @brief 本文の次の1バイトを書き出す（0x00 は不可）
+     * @param byte 本文のバイト
+     */
+    void put(uint8_t byte)
+    {
+        if (!blockOpen)
+        {
+            startBlock();
+        }
+        if (zeroAtEnd && position == blockEnd)
+        {
+            // ブロックの終わりの 0x00 はブロック先頭の長さで表すので書き出さない
+            position++;
+            blockOpen = false;
+            lastWasZero = true;
+            return;
+        }
+        out.write(byte);
+        position++;
+        lastWasZero = false;
+        if (!zeroAtEnd && position == blockEnd)
+        {
+            blockOpen = false;
+        }
+    }
+
+    /**
+     * @brief CRC と末尾の区切りを書き出してフレームを閉じる（本文を全て put() した後に呼ぶ）
+     */
+    void finish()
+    {
+        put(trailer[0]);
+        put(trailer[1]);
+        if (!blockOpen && lastWasZero)
+        {
+            // 最後のバイトが 0x00 の場合、その後ろの空のブロックを書く
+            out.write((uint8_t)0x01);
+        }
+        out.write(FRAME_DELIMITER);
+    }
+
+private:
+    Output &out;
+    size_t bodyLength;
+    size_t position;   // 次に受け取るバイトの位置（本文の先頭から、CRC を含む）
+    size_t blockEnd;   // 現在のブロックの終わりの位置
+    bool blockOpen;    // ブロックの途中か
+    bool zeroAtEnd;    // 現在のブロックが 0x00 で終わるか（254 バイトの上限・フレームの終わりで切れる場合は false）
+    bool lastWasZero;  // 最後に受け取ったバイトが 0x00 だったか
+    uint8_t trailer[FRAME_CRC_SIZE];
+
+    /**
+     * @brief position 以降で最初に 0x00 が現れる位置（なければフレームの終わり）
+     */
+    size_t nextZero() const
+    {
+        for (size_t i = 0; i < FRAME_CRC_SIZE; i++)
+        {
+            if (bodyLength + i >= position && trailer[i] == 0)
+            {
+                return bodyLength + i;
+            }
+        }
+        return bodyLength + FRAME_CRC_SIZE;
+    }
+
+    void startBlock()
+    {
+        size_t zero = nextZero();
+        size_t run = zero - position;
+        if (run >= 0xFE)
+        {
+            out.write((uint8_t)0xFF);
+            blockEnd = position + 0xFE;
+            zeroAtEnd = false;
+        }
+        else
+        {
+            out.write((uint8_t)(run + 1));
+            blockEnd = zero;
+            zeroAtEnd = zero < bodyLength + FRAME_CRC_SIZE;
+        }
+        blockOpen = true;
+    }
+};
+
+#endif // QUIZ_FRAMING_H
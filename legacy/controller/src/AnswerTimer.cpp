@@ -0,0 +1,124 @@
+/**
+ * @file AnswerTimer.cpp
+ * @brief 解答時間の計時クラスの実装
+ */
+
+#include "AnswerTimer.h"
+
+static_assert(ANSWER_BLINK_MS >= 2, "ANSWER_BLINK_MS must be at least 2");
+
+AnswerTimer::AnswerTimer()
+    : limit(ANSWER_TIME_MS),
+      seenRound(0),
+      started(false),
+      running(false),
+      expired(false),
+      buttonId(0),
+      startedAt(0),
+      duration(0),
+      ledOn(true)
+{
+}
+
+void AnswerTimer::begin(const ButtonManager &buttonManager)
+{
+    seenRound = buttonManager.getRound();
+    started = buttonManager.getPressCount() > 0;
+}
+
+void AnswerTimer::update(ButtonManager &buttonManager, SerialCommunicator &serialComm)
+{
+    if (buttonManager.getRound() != seenRound)
+    {
+        // リセットで LED は全て消灯済み
+        seenRound = buttonManager.getRound();
+        started = false;
+        running = false;
+        expired = false;
+    }
+
+    if (!started)
+    {
+        if (buttonManager.getPressCount() == 0)
+        {
+            return;
+        }
+        // 起点は押下を受け付けた時刻（メインループがここに来るまでの遅れを含めない）
+        started = true;
+        running = limit > 0;
+        buttonId = buttonManager.getPressedButton(0);
+        startedAt = buttonManager.getPressTime(0);
+        duration = limit;
+        ledOn = true;
+    }
+    if (!running)
+    {
+        return;
+    }
+
+    uint8_t first = buttonManager.getPressedButton(0);
+    if (first != buttonId)
+    {
+        buttonManager.setLed(buttonId - 1, true);
+        buttonId = first;
+        ledOn = true;
+    }
+
+    unsigned long elapsed = serialComm.getTimestamp() - startedAt;
+    if (elapsed >= duration)
+    {
+        running = false;
+        expired = true;
+        buttonManager.setLed(buttonId - 1, false);
+        serialComm.sendAnswerTimeout(buttonId);
+        return;
+    }
+
+    // 残り時間に合わせた位相で点滅し、最後の半周期は点灯したまま時間切れを迎える
+    unsigned long remaining = duration - elapsed;
+    bool on = remaining > ANSWER_WARNING_MS || ((remaining / (ANSWER_BLINK_MS / 2)) & 1) == 0;
+    if (on != ledOn)
+    {
+        buttonManager.setLed(buttonId - 1, on);
+        ledOn = on;
+    }
+}
+
+bool AnswerTimer::setLimit(unsigned long limitMs)
+{
+    if (limitMs > MAX_LIMIT_MS)
+    {
+        return false;
+    }
+    limit = limitMs;
+    return true;
+}
+
+void AnswerTimer::stop(ButtonManager &buttonManager)
+{
+    if (running && !ledOn)
+    {
+        buttonManager.setLed(buttonId - 1, true);
+    }
+    running = false;
+    ledOn = true;
+}
+
+void AnswerTimer::send(const SerialCommunicator &serialComm) const
+{
+    JsonDocument doc;
+    doc[F("type")] = F("answerTimer");
+    doc[F("limit")] = limit;
+    doc[F("running")] = running;
+    doc[F("expired")] = expired;
+    if (running || expired)
+    {
+        unsigned long elapsed = serialComm.getTimestamp() - startedAt;
+        doc[F("buttonId")] = buttonId;
+        doc[F("startedAt")] = startedAt;
+        doc[F("remaining")] = running && elapsed < duration ? duration - elapsed : 0;
+    }
+    doc[F("timestamp")] = serialComm.getTimestamp();
+
+    serialComm.writeFrame(doc);
+}
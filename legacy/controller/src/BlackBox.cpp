@@ -0,0 +1,248 @@
+/**
+ * @file BlackBox.cpp
+ * @brief 動作記録クラスの実装
+ */
+
+#include "BlackBox.h"
+#include <EEPROM.h>
+#include <QuizFraming.h>
+#include <avr/eeprom.h>
+
+#if BLACK_BOX_EEPROM_ADDRESS + BLACK_BOX_EEPROM_SIZE > E2END + 1
+#error "BLACK_BOX_EEPROM_ADDRESS + BLACK_BOX_EEPROM_SIZE exceeds the EEPROM size"
+#endif
+
+#if BLACK_BOX_QUEUE_SIZE < 2 || BLACK_BOX_QUEUE_SIZE > 255
+#error "BLACK_BOX_QUEUE_SIZE must be between 2 and 255"
+#endif
+
+static_assert(BLACK_BOX_EEPROM_SIZE / BLACK_BOX_ENTRY_SIZE >= 2 && BLACK_BOX_EEPROM_SIZE / BLACK_BOX_ENTRY_SIZE <= 255,
+              "BLACK_BOX_EEPROM_SIZE must hold between 2 and 255 entries");
+
+BlackBox::BlackBox()
+    : nextSlot(0),
+      nextIndex(0),
+      overflows(0),
+      recordedAt(0),
+      queueHead(0),
+      queueCount(0),
+      writeOffset(0),
+      writing(false),
+      dumping(false),
+      dumpSlot(0),
+      dumpQueued(0),
+      dumpQueueCount(0),
+      dumpOffset(BLACK_BOX_ENTRY_SIZE)
+{
+}
+
+void BlackBox::begin(uint8_t resetFlags)
+{
+    // 通し番号が最新の件の次から書く（件は番号順に並ぶので、比較は一周を考慮した差で足りる）
+    bool found = false;
+    uint16_t newestIndex = 0;
+    uint8_t newestSlot = 0;
+    uint8_t bytes[BLACK_BOX_ENTRY_SIZE];
+    BlackBoxEntry entry;
+    for (uint8_t slot = 0; slot < SLOT_COUNT; slot++)
+    {
+        if (readSlot(slot, bytes) && blackBoxDecode(bytes, entry) && (!found || (int16_t)(entry.index - newestIndex) > 0))
+        {
+            found = true;
+            newestIndex = entry.index;
+            newestSlot = slot;
+        }
+    }
+    if (found)
+    {
+        nextSlot = (newestSlot + 1) % SLOT_COUNT;
+        nextIndex = newestIndex + 1;
+    }
+
+    record(BLACK_BOX_BOOT, 0, 0, 0, millis(), resetFlags);
+}
+
+void BlackBox::record(uint8_t type, uint8_t buttonId, uint16_t round, uint16_t seq, unsigned long timestamp,
+                      uint16_t detail)
+{
+    uint16_t index = nextIndex++;
+    recordedAt = millis();
+    if (queueCount == BLACK_BOX_QUEUE_SIZE)
+    {
+        // 捨てた件は通し番号の欠番として残る
+        overflows++;
+        return;
+    }
+
+    BlackBoxEntry &entry = queue[(queueHead + queueCount) % BLACK_BOX_QUEUE_SIZE];
+    entry.index = index;
+    entry.type = type;
+    entry.buttonId = buttonId;
+    entry.round = round;
+    entry.seq = seq;
+    entry.timestamp = timestamp;
+    entry.detail = detail;
+    queueCount++;
+}
+
+void BlackBox::update(SerialCommunicator &serialComm)
+{
+    if (dumping)
+    {
+        writeDump(serialComm);
+        return;
+    }
+
+    if (!writing)
+    {
+        // 押下が続いている間は書かず、記録が途切れてからまとめて書く
+        if (queueCount == 0 ||
+            (queueCount < BLACK_BOX_QUEUE_SIZE / 2 && millis() - recordedAt < BLACK_BOX_FLUSH_MS))
+        {
+            return;
+        }
+        blackBoxEncode(queue[queueHead], writeBuffer);
+        writeOffset = 0;
+        writing = true;
+    }
+    writeQueued();
+}
+
+void BlackBox::writeQueued()
+{
+    // 前のバイトの書き込み（約 3.4 ミリ秒）が終わっていなければ待たずに戻る
+    if (!eeprom_is_ready())
+    {
+        return;
+    }
+
+    // 内容が同じバイトは書き込まない
+    EEPROM.update(BLACK_BOX_EEPROM_ADDRESS + nextSlot * BLACK_BOX_ENTRY_SIZE + writeOffset, writeBuffer[writeOffset]);
+    writeOffset++;
+    if (writeOffset < BLACK_BOX_ENTRY_SIZE)
+    {
+        return;
+    }
+
+    writing = false;
+    queueHead = (queueHead + 1) % BLACK_BOX_QUEUE_SIZE;
+    queueCount--;
+    nextSlot = (nextSlot + 1) % SLOT_COUNT;
+}
+
+bool BlackBox::readSlot(uint8_t slot, uint8_t *bytes)
+{
+    int address = BLACK_BOX_EEPROM_ADDRESS + slot * BLACK_BOX_ENTRY_SIZE;
+    for (uint8_t i = 0; i < BLACK_BOX_ENTRY_SIZE; i++)
+    {
+        bytes[i] = EEPROM.read(address + i);
+    }
+    BlackBoxEntry entry;
+    return blackBoxDecode(bytes, entry);
+}
+
+void BlackBox::startDump(SerialCommunicator &serialComm)
+{
+    // 書き出す件数と CRC を先に求める（書き出しの間は EEPROM もキューの先頭も変わらない）
+    dumpQueueCount = queueCount;
+    rewindDump();
+    uint16_t count = 0;
+    uint16_t crc = 0xFFFF;
+    while (loadDumpEntry())
+    {
+        count++;
+        for (uint8_t i = 0; i < BLACK_BOX_ENTRY_SIZE; i++)
+        {
+            crc = frameCrc16Update(crc, dumpBuffer[i]);
+        }
+    }
+    rewindDump();
+
+    Header header = {count, nextIndex, overflows, crc, serialComm.getTimestamp()};
+    serialComm.writeFrame(writeHeader, &header);
+
+    if (count == 0)
+    {
+        return;
+    }
+    dumping = true;
+    serialComm.holdOutput(true);
+    writeDump(serialComm);
+}
+
+void BlackBox::writeHeader(JsonFrameWriter &writer, const void *context)
+{
+    // JsonDocument では 約0.3KB のヒープを使い、記録を有効にしたときの最大の送信になるため直接書き出す
+    const Header &header = *static_cast<const Header *>(context);
+    writer.begin(F("blackBox"));
+    writer.add(F("entries"), header.entries);
+    writer.add(F("entrySize"), BLACK_BOX_ENTRY_SIZE);
+    writer.add(F("capacity"), SLOT_COUNT);
+    writer.add(F("next"), header.next);
+    writer.add(F("overflows"), header.overflows);
+    writer.add(F("bytes"), (unsigned long)header.entries * BLACK_BOX_ENTRY_SIZE);
+    writer.add(F("crc"), header.crc);
+    writer.add(F("timestamp"), header.timestamp);
+    writer.end();
+}
+
+bool BlackBox::isSending() const
+{
+    return dumping;
+}
+
+void BlackBox::rewindDump()
+{
+    dumpSlot = 0;
+    dumpQueued = 0;
+    dumpOffset = BLACK_BOX_ENTRY_SIZE;
+}
+
+bool BlackBox::loadDumpEntry()
+{
+    while (dumpSlot < SLOT_COUNT)
+    {
+        uint8_t slot = (nextSlot + dumpSlot) % SLOT_COUNT;
+        dumpSlot++;
+        if (readSlot(slot, dumpBuffer))
+        {
+            return true;
+        }
+    }
+    if (dumpQueued < dumpQueueCount)
+    {
+        blackBoxEncode(queue[(queueHead + dumpQueued) % BLACK_BOX_QUEUE_SIZE], dumpBuffer);
+        dumpQueued++;
+        return true;
+    }
+    return false;
+}
+
+void BlackBox::writeDump(SerialCommunicator &serialComm)
+{
+    // 送信バッファに入る分だけ書き出す（Serial.write() がブロックしないように）
+    int room = Serial.availableForWrite();
+    while (room > 0)
+    {
+        if (dumpOffset == BLACK_BOX_ENTRY_SIZE)
+        {
+            if (!loadDumpEntry())
+            {
+                break;
+            }
+            dumpOffset = 0;
+        }
+        uint8_t remaining = BLACK_BOX_ENTRY_SIZE - dumpOffset;
+        uint8_t chunk = room < remaining ? (uint8_t)room : remaining;
+        Serial.write(dumpBuffer + dumpOffset, chunk);
+        dumpOffset += chunk;
+        room -= chunk;
+    }
+
+    // 最後の件を書き終えたら保留を解く
+    if (dumpOffset == BLACK_BOX_ENTRY_SIZE && dumpSlot == SLOT_COUNT && dumpQueued == dumpQueueCount)
+    {
+        dumping = false;
+        serialComm.holdOutput(false);
+    }
+}
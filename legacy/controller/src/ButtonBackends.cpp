@@ -0,0 +1,66 @@
+/**
+ * @file ButtonBackends.cpp
+ * @brief 実行時設定のボタン入力・LED出力の実装
+ */
+
+#include "ButtonBackends.h"
+
+volatile uint8_t *ConfigInput::inputRegs[MAX_BUTTONS];
+uint8_t ConfigInput::inputBits[MAX_BUTTONS];
+uint8_t ConfigInput::buttonCount = 0;
+
+int8_t ConfigLeds::ledPins[MAX_BUTTONS];
+bool ConfigLeds::enabled = false;
+
+bool ConfigInput::begin(const ButtonConfig &config)
+{
+    if (!config.validate())
+    {
+        return false;
+    }
+
+    buttonCount = config.getButtonCount();
+    for (uint8_t i = 0; i < buttonCount; i++)
+    {
+        int pin = config.getButtonPin(i);
+
+        // ボタンピンを入力モードで初期化（プルアップ抵抗有効）
+        pinMode(pin, INPUT_PULLUP);
+        inputRegs[i] = portInputRegister(digitalPinToPort(pin));
+        inputBits[i] = digitalPinToBitMask(pin);
+    }
+    return true;
+}
+
+void ConfigLeds::begin(const ButtonConfig &config)
+{
+    for (int i = 0; i < MAX_BUTTONS; i++)
+    {
+        ledPins[i] = -1;
+    }
+    enabled = config.isLedEnabled();
+    if (!enabled)
+    {
+        return;
+    }
+
+    // LEDピンを出力モードで初期化
+    for (int i = 0; i < config.getButtonCount(); i++)
+    {
+        int ledPin = config.getLedPin(i);
+        if (ledPin >= 0)
+        {
+            pinMode(ledPin, OUTPUT);
+            digitalWrite(ledPin, LOW); // 初期状態はOFF
+            ledPins[i] = (int8_t)ledPin;
+        }
+    }
+}
+
+void ConfigLeds::set(uint8_t index, bool on)
+{
+    if (enabled && index < MAX_BUTTONS && ledPins[index] >= 0)
+    {
+        digitalWrite(ledPins[index], on ? HIGH : LOW);
+    }
+}
@@ -105,10 +105,18 @@ bool ButtonConfig::validate() const
 
         if (ledEnabled)
         {
-            // ボタンピンとLEDピンの重複チェック
-            if (buttonPins[i] == ledPins[i])
+            for (int j = 0; j < buttonCount; j++)
             {
-                return false;
+                // ボタンピンとLEDピンの重複チェック
+                if (buttonPins[i] == ledPins[j])
+                {
+                    return false;
+                }
+                // LEDピンの重複チェック
+                if (j > i && ledPins[i] == ledPins[j])
+                {
+                    return false;
+                }
             }
         }
     }
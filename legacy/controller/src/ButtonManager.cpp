@@ -1,177 +1,660 @@
 /**
  * @file ButtonManager.cpp
  * @brief ボタン入力管理クラスの実装
+ *
+ * テンプレートの実装はここに置き、使用する組み合わせを末尾で明示的にインスタンス化する
  */
 
 #include "ButtonManager.h"
 #include "config.h"
 
-ButtonManager::ButtonManager(ButtonConfig *buttonConfig, SerialCommunicator *serialComm)
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::ButtonManagerT(ButtonConfig *buttonConfig,
+                                                                            SerialCommunicator *serialComm)
     : config(buttonConfig),
       communicator(serialComm),
-      debounceDelay(DEBOUNCE_DELAY),
+      rawStates(0),
+      calibrating(false),
       systemActive(true),
       buttonPressed(false),
-      firstPressedButton(0)
+      firstPressedButton(0),
+      armedTick(0),
+      reactionArmed(false),
+#if ENABLE_TRIGGER_INPUT
+      waitingForTrigger(false),
+      falseStartMask(0),
+#endif
+#if ENABLE_SCOPE
+      scope(nullptr),
+#endif
+      arbiter(N),
+      current(0)
 {
+    for (uint8_t r = 0; r < 2; r++)
+    {
+        rounds[r].id = 0;
+        rounds[r].pressCount = 0;
+    }
 
     // 配列の初期化
-    for (int i = 0; i < MAX_BUTTONS; i++)
+    for (uint8_t i = 0; i < N; i++)
     {
         buttonStates[i] = false;
-        lastButtonStates[i] = false;
-        lastDebounceTime[i] = 0;
+        rawChangedAt[i] = 0;
+        offsetTicks[i] = 0;
+        debounceTicks[i] = 0;
+        bouncing[i].edges = 0;
+        bounceStartedAt[i] = 0;
+        committedAt[i] = 0;
+        lastBounce[i].edges = 0;
+        bounceCount[i] = 0;
     }
 }
 
-void ButtonManager::init()
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::init()
 {
-    // 設定の検証
-    if (!config->validate())
+    // ボタンピンを入力モードで初期化（実行時設定の場合は設定を検証）
+    if (!InputBackend::begin(*config))
     {
-        communicator->sendError("Invalid button configuration");
+        communicator->sendError(F("Invalid button configuration"));
         return;
     }
 
-    // ボタンピンを入力モードで初期化（プルアップ抵抗有効）
-    for (int i = 0; i < config->getButtonCount(); i++)
+    // LEDピンを出力モードで初期化
+    LedBackend::begin(*config);
+
+    // 一定周期のサンプリングを開始
+    sampler.begin();
+    setDebounceDelay(DEBOUNCE_DELAY);
+#if ENABLE_TRIGGER_INPUT
+    trigger.begin(sampler);
+#endif
+#if ENABLE_GESTURES
+    gestures.begin(sampler);
+#endif
+
+    ArbiterRules rules;
+    rules.tieWindow = ((uint32_t)PRESS_TIE_WINDOW_US * sampler.getSampleRate() + 500000UL) / 1000000UL;
+    rules.tieRule = PRESS_TIE_RULE;
+    rules.penalty = 0; // 正誤の判定はサーバーが行う
+    arbiter.setRules(rules);
+
+#if ENABLE_DEBUG_OUTPUT
+    config->printConfig();
+    communicator->sendDebug(F("ButtonManager initialized"));
+#endif
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::commitStableStates(uint32_t untilTick)
+{
+    if (calibrating)
     {
-        int pin = config->getButtonPin(i);
-        if (pin >= 0)
-        {
-            pinMode(pin, INPUT_PULLUP);
-        }
+        return;
     }
 
-    // LEDピンを出力モードで初期化
-    if (config->isLedEnabled())
+    for (;;)
     {
-        for (int i = 0; i < config->getButtonCount(); i++)
+        // 確定待ちのボタンのうち、補正後に最も早く変化したものから確定する
+        // それがまだ安定していなければ、後から変化したボタンも確定しない（押下順を補正後の時刻で保つ）
+        int8_t next = -1;
+        for (uint8_t i = 0; i < N; i++)
         {
-            int ledPin = config->getLedPin(i);
-            if (ledPin >= 0)
+            bool raw = (rawStates >> i) & 1;
+            if (raw == buttonStates[i])
+            {
+                // 確定した状態に戻って安定したパルス（ノイズ）はバウンスとして数えない
+                if (bouncing[i].edges > 0 && DebouncePolicy::settled(untilTick - rawChangedAt[i], debounceTicks[i]))
+                {
+                    bouncing[i].edges = 0;
+                }
+                continue;
+            }
+            if (next < 0 || (int32_t)(compensatedChangeTick(i) - compensatedChangeTick(next)) < 0)
             {
-                pinMode(ledPin, OUTPUT);
-                digitalWrite(ledPin, LOW); // 初期状態はOFF
+                next = i;
             }
         }
+        if (next < 0 || !DebouncePolicy::settled(untilTick - rawChangedAt[next], debounceTicks[next]))
+        {
+            return;
+        }
+        applyButtonState(next, (rawStates >> next) & 1);
     }
-
-#if ENABLE_DEBUG_OUTPUT
-    config->printConfig();
-    communicator->sendDebug("ButtonManager initialized");
-#endif
 }
 
-bool ButtonManager::readButtonWithDebounce(int buttonIndex)
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint32_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::compensatedChangeTick(uint8_t buttonIndex) const
 {
-    int pin = config->getButtonPin(buttonIndex);
-    if (pin < 0)
+    uint32_t offset = offsetTicks[buttonIndex];
+    uint32_t window = debounceTicks[buttonIndex];
+    if (offset >= window)
     {
-        return false;
+        offset = window > 0 ? window - 1 : 0;
     }
+    return rawChangedAt[buttonIndex] - offset;
+}
 
-    // ボタンの現在の物理状態を読み取る（LOW = 押下）
-    bool reading = (digitalRead(pin) == LOW);
-
-    // 状態が変化した場合
-    if (reading != lastButtonStates[buttonIndex])
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::trackBounce(uint8_t buttonIndex, uint32_t tick)
+{
+    BounceProfile &bounce = bouncing[buttonIndex];
+    if (bounce.edges == 0)
     {
-        lastDebounceTime[buttonIndex] = millis();
-        lastButtonStates[buttonIndex] = reading;
+        bounce.edges = 1;
+        bounce.maxGapTicks = 0;
+        bounceStartedAt[buttonIndex] = tick;
+        return;
     }
 
-    // デバウンス期間が経過したか確認
-    if ((millis() - lastDebounceTime[buttonIndex]) > debounceDelay)
+    uint32_t gap = tick - rawChangedAt[buttonIndex];
+    if (gap > bounce.maxGapTicks)
     {
-        // デバウンス後の安定した状態を返す
-        return reading;
+        bounce.maxGapTicks = gap > 0xFFFF ? 0xFFFF : (uint16_t)gap;
+    }
+    if (bounce.edges < 0xFF)
+    {
+        bounce.edges++;
     }
-
-    // デバウンス中は前回の状態を維持
-    return buttonStates[buttonIndex];
 }
 
-void ButtonManager::controlLed(int ledIndex, bool state)
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::finishBounce(uint8_t buttonIndex)
 {
-    if (!config->isLedEnabled())
+    // リセットで確定し直す押されたままのボタンなど、生の変化がない確定は記録しない
+    BounceProfile &bounce = bouncing[buttonIndex];
+    if (bounce.edges == 0)
     {
         return;
     }
 
-    int ledPin = config->getLedPin(ledIndex);
-    if (ledPin >= 0)
-    {
-        digitalWrite(ledPin, state ? HIGH : LOW);
-    }
+    uint32_t span = rawChangedAt[buttonIndex] - bounceStartedAt[buttonIndex];
+    bounce.spanTicks = span > 0xFFFF ? 0xFFFF : (uint16_t)span;
+    bounce.chatter = bounceStartedAt[buttonIndex] - committedAt[buttonIndex] < sampler.msToTicks(DEBOUNCE_DELAY);
+    committedAt[buttonIndex] = bounceStartedAt[buttonIndex];
+
+    lastBounce[buttonIndex] = bounce;
+    bounceCount[buttonIndex]++;
+    bounce.edges = 0;
 }
 
-void ButtonManager::update()
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::applyButtonState(uint8_t buttonIndex, bool pressed)
 {
-    // 各ボタンの状態をチェック
-    for (int i = 0; i < config->getButtonCount(); i++)
+#if ENABLE_GESTURES
+    // ジェスチャーは押下の受け付け（フライング・順位）に関係なく、入力が変化した時刻で数える
+    if (bouncing[buttonIndex].edges > 0)
+    {
+        Gesture gesture;
+        if (pressed ? gestures.press(buttonIndex, rawChangedAt[buttonIndex], gesture)
+                    : gestures.release(buttonIndex, rawChangedAt[buttonIndex], gesture))
+        {
+            sendGesture(gesture);
+        }
+    }
+#endif
+
+    finishBounce(buttonIndex);
+
+    // 状態が変化し、かつ押下された場合
+    if (pressed && !buttonStates[buttonIndex])
     {
-        bool currentState = readButtonWithDebounce(i);
+        uint8_t buttonId = buttonIndex + 1; // 1-6のボタンID
+        uint32_t changeTick = compensatedChangeTick(buttonIndex);
 
-        // 状態が変化し、かつ押下された場合
-        if (currentState && !buttonStates[i])
+#if ENABLE_TRIGGER_INPUT
+        // トリガーより前に入力が変化した押下はフライング（そのラウンドの間は押下として扱わない）
+        if (!((falseStartMask >> buttonIndex) & 1) &&
+            (waitingForTrigger || (reactionArmed && (int32_t)(changeTick - armedTick) < 0)))
         {
-            firstPressedButton = i + 1; // 1-6のボタンID
+            falseStartMask |= (uint8_t)(1 << buttonIndex);
+            communicator->sendFalseStart(buttonId);
+        }
+        if ((falseStartMask >> buttonIndex) & 1)
+        {
+            buttonStates[buttonIndex] = pressed;
+            return;
+        }
+#endif
+
+        // 先に arbiter で判定し、受け付けた押下だけを送信・点灯する
+        // （押下済み・ペナルティ中の押し直しに seq と再送の枠を使わない）
+        if (arbiter.press(buttonId, changeTick) != ARBITER_ACCEPTED)
+        {
+            buttonStates[buttonIndex] = pressed;
+            return;
+        }
+
+        // イベントを送信
+#if ENABLE_LATENCY_TRACE
+        // 生の状態が変化したサンプルの時刻（micros() の時間軸）
+        unsigned long capturedAt = micros() - sampler.ticksToMicros(sampler.getTick() - rawChangedAt[buttonIndex]);
+        uint16_t seq = communicator->sendButtonPress(buttonId, capturedAt);
+#else
+        uint16_t seq = communicator->sendButtonPress(buttonId);
+#endif
 
-            // イベントを送信
-            communicator->sendButtonPress(firstPressedButton);
+        // arbiter が決めた順位に記録する（同着の規則によっては途中に入る）
+        RoundSlot<N> &slot = rounds[current];
+        uint8_t position = arbiter.getPosition(buttonId) - 1;
+        for (uint8_t i = slot.pressCount; i > position; i--)
+        {
+            slot.order[i] = slot.order[i - 1];
+            slot.times[i] = slot.times[i - 1];
+            slot.seqs[i] = slot.seqs[i - 1];
+            slot.reactions[i] = slot.reactions[i - 1];
+        }
+        slot.order[position] = buttonId;
+        slot.times[position] = communicator->getTimestamp();
+        slot.seqs[position] = seq;
+        slot.reactions[position] = REACTION_UNKNOWN;
+        if (reactionArmed)
+        {
+            // リセット前から押されていたボタンは 0 とする
+            // 統計は 16 ビットで集計するため、REACTION_UNKNOWN の手前で頭打ちにする
+            int32_t reactionTicks = (int32_t)(changeTick - armedTick);
+            unsigned long reactionMs = sampler.ticksToMillis(reactionTicks > 0 ? (uint32_t)reactionTicks : 0);
+            slot.reactions[position] = reactionMs < REACTION_UNKNOWN ? (uint16_t)reactionMs : REACTION_UNKNOWN - 1;
+        }
+        slot.pressCount++;
+        buttonPressed = true;
+        firstPressedButton = slot.order[0];
 
-            // LEDを点灯
-            controlLed(i, true);
+        // LEDを点灯
+        LedBackend::set(buttonIndex, true);
 
 #if ENABLE_DEBUG_OUTPUT
-            communicator->sendDebug("First button pressed");
+        communicator->sendDebug(F("First button pressed"));
+#endif
+    }
+
+    buttonStates[buttonIndex] = pressed;
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::update()
+{
+#if ENABLE_TRIGGER_INPUT
+    // 先にトリガーを取り込み、確定待ちの押下をトリガーの時刻と比べられるようにする
+    uint32_t triggerTick;
+    if (trigger.poll(triggerTick))
+    {
+        waitingForTrigger = false;
+        armedTick = triggerTick;
+        reactionArmed = true;
+        communicator->sendArmed();
+    }
 #endif
+
+    // サンプラーが記録した状態変化を古い順に処理
+    ButtonSampler::Sample sample;
+    while (sampler.pop(sample))
+    {
+#if ENABLE_SCOPE
+        // デバウンス前の変化をそのまま渡す
+        if (scope != nullptr)
+        {
+            scope->record(sample.tick, sample.mask);
+        }
+#endif
+
+        // この変化より前に安定していた状態を先に確定する
+        commitStableStates(sample.tick);
+
+        uint8_t changed = sample.mask ^ rawStates;
+        for (uint8_t i = 0; i < N; i++)
+        {
+            if ((changed >> i) & 1)
+            {
+                trackBounce(i, sample.tick);
+                rawChangedAt[i] = sample.tick;
+            }
         }
+        rawStates = sample.mask;
+    }
+
+    commitStableStates(sampler.getTick());
 
-        buttonStates[i] = currentState;
+#if ENABLE_GESTURES
+    // 次の押下を待つ時間が切れた連打を確定する
+    Gesture gesture;
+    while (gestures.poll(sampler.getTick(), gesture))
+    {
+        sendGesture(gesture);
     }
+#endif
 }
 
-void ButtonManager::reset()
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::reset()
 {
+#if ENABLE_GESTURES
+    // 次の押下を待っている連打は直前のラウンドのジェスチャーとして確定する（押している途中の操作は取り消す）
+    Gesture gesture;
+    while (gestures.flush(gesture))
+    {
+        sendGesture(gesture);
+    }
+#endif
+
     // 全てのボタン状態をリセット
-    for (int i = 0; i < MAX_BUTTONS; i++)
+    // 押されたままのボタンはデバウンス時間の経過後に再度押下として扱う
+    uint32_t now = sampler.getTick();
+    for (uint8_t i = 0; i < N; i++)
     {
         buttonStates[i] = false;
-        lastButtonStates[i] = false;
+        rawChangedAt[i] = now;
+        bouncing[i].edges = 0;
 
         // LEDを消灯
-        controlLed(i, false);
+        LedBackend::set(i, false);
     }
 
     buttonPressed = false;
     firstPressedButton = 0;
+    arbiter.open();
+
+    // 直前のラウンドの押下はそのまま残し、もう一方の面で新しいラウンドを始める
+    uint16_t nextRound = rounds[current].id + 1;
+    current ^= 1;
+    rounds[current].id = nextRound;
+    rounds[current].pressCount = 0;
+    communicator->setRound(nextRound);
     systemActive = true;
+#if ENABLE_TRIGGER_INPUT
+    // ラウンドはトリガーの立ち下がりで開始する
+    reactionArmed = false;
+    waitingForTrigger = true;
+    falseStartMask = 0;
+    trigger.enable();
+#else
+    armedTick = now;
+    reactionArmed = true;
+#endif
 
     communicator->sendSystemReset();
 
 #if ENABLE_DEBUG_OUTPUT
-    communicator->sendDebug("System reset complete");
+    communicator->sendDebug(F("System reset complete"));
 #endif
 }
 
-bool ButtonManager::isSystemActive() const
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+bool ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::isSystemActive() const
 {
     return systemActive;
 }
 
-bool ButtonManager::isButtonPressed() const
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+bool ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::isButtonPressed() const
 {
     return buttonPressed;
 }
 
-int ButtonManager::getFirstPressedButton() const
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+bool ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::isWaitingForTrigger() const
+{
+#if ENABLE_TRIGGER_INPUT
+    return waitingForTrigger;
+#else
+    return false;
+#endif
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+int ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getFirstPressedButton() const
 {
     return firstPressedButton;
 }
 
-void ButtonManager::setDebounceDelay(unsigned long delay)
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::setDebounceDelay(unsigned long delay)
+{
+    uint32_t ticks = sampler.msToTicks(delay);
+    for (uint8_t i = 0; i < N; i++)
+    {
+        debounceTicks[i] = ticks > 0xFFFF ? 0xFFFF : (uint16_t)ticks;
+    }
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::setDebounceWindows(const uint16_t *windowMicros)
+{
+    for (uint8_t i = 0; i < N; i++)
+    {
+        uint32_t ticks = ((uint32_t)windowMicros[i] * sampler.getSampleRate() + 999999UL) / 1000000UL;
+        debounceTicks[i] = ticks > 0xFFFF ? 0xFFFF : (uint16_t)ticks;
+    }
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint8_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getBounceCount(uint8_t buttonIndex) const
+{
+    return bounceCount[buttonIndex];
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+const BounceProfile &ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getBounce(uint8_t buttonIndex) const
+{
+    return lastBounce[buttonIndex];
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint8_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getPressCount() const
+{
+    return rounds[current].pressCount;
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint8_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getPressedButton(uint8_t order) const
+{
+    return rounds[current].order[order];
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+unsigned long ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getPressTime(uint8_t order) const
+{
+    return rounds[current].times[order];
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint16_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getPressSeq(uint8_t order) const
+{
+    return rounds[current].seqs[order];
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint16_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getPressReaction(uint8_t order) const
+{
+    return rounds[current].reactions[order];
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint16_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getRound() const
+{
+    return rounds[current].id;
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+const RoundSlot<N> &ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getPreviousRound() const
+{
+    return rounds[current ^ 1];
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+bool ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::restoreRound(bool active, uint16_t roundNumber,
+                                                                               uint8_t count, const uint8_t *order,
+                                                                               const unsigned long *times,
+                                                                               const uint16_t *seqs)
+{
+    // 復元した押下は、以降の押下（補正で最大 debounceTicks 早まる）と同着にならない時刻に置く
+    uint32_t longestWindow = 0;
+    for (uint8_t i = 0; i < N; i++)
+    {
+        if (debounceTicks[i] > longestWindow)
+        {
+            longestWindow = debounceTicks[i];
+        }
+    }
+    uint32_t restoredTick = sampler.getTick() - longestWindow - arbiter.getRules().tieWindow - 1;
+    if (!arbiter.restore(count, order, restoredTick))
+    {
+        return false;
+    }
+
+    // 直前のラウンドは保存していないため空とする
+    RoundSlot<N> &slot = rounds[current];
+    rounds[current ^ 1].id = roundNumber - 1;
+    rounds[current ^ 1].pressCount = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        slot.order[i] = order[i];
+        slot.times[i] = times[i];
+        slot.seqs[i] = seqs[i];
+        slot.reactions[i] = REACTION_UNKNOWN;
+
+        // 押下済みとして扱う（離されていればデバウンス後に解放として確定する）
+        buttonStates[order[i] - 1] = true;
+        LedBackend::set(order[i] - 1, true);
+    }
+    slot.pressCount = count;
+    slot.id = roundNumber;
+    communicator->setRound(roundNumber);
+    buttonPressed = count > 0;
+    firstPressedButton = count > 0 ? order[0] : 0;
+    systemActive = active;
+    reactionArmed = false; // ラウンドの開始時刻はリセットで失われている
+#if ENABLE_TRIGGER_INPUT
+    // トリガー待ちだったかどうかは保存していないため、開始済みとして押下を受け付ける
+    trigger.disable();
+    waitingForTrigger = false;
+    falseStartMask = 0;
+#endif
+    return true;
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::setLatencyOffsets(const uint16_t *offsetMicros)
+{
+    for (uint8_t i = 0; i < N; i++)
+    {
+        uint32_t ticks = ((uint32_t)offsetMicros[i] * sampler.getSampleRate() + 500000UL) / 1000000UL;
+        offsetTicks[i] = ticks > 0xFFFF ? 0xFFFF : (uint16_t)ticks;
+    }
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::setCalibrating(bool enabled)
+{
+#if ENABLE_GESTURES
+    if (enabled)
+    {
+        gestures.clear(); // 基準エッジは操作として数えない
+    }
+#endif
+    if (calibrating && !enabled)
+    {
+        // 校正中の変化はイベントにせず、現在の生の状態を確定した状態とする
+        for (uint8_t i = 0; i < N; i++)
+        {
+            buttonStates[i] = (rawStates >> i) & 1;
+            bouncing[i].edges = 0; // 基準エッジはバウンスとして学習しない
+        }
+    }
+    calibrating = enabled;
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint8_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getRawStates() const
+{
+    return rawStates;
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+uint32_t ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getRawChangedAt(uint8_t buttonIndex) const
+{
+    return rawChangedAt[buttonIndex];
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+const ButtonSampler &ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::getSampler() const
+{
+    return sampler;
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::setScope(ScopeStreamer *scopeStreamer)
+{
+#if ENABLE_SCOPE
+    scope = scopeStreamer;
+#else
+    (void)scopeStreamer;
+#endif
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+bool ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::judgeIncorrect(uint8_t buttonId)
+{
+    if (!arbiter.withdraw(buttonId))
+    {
+        return false;
+    }
+
+    RoundSlot<N> &slot = rounds[current];
+    uint8_t position = 0;
+    while (slot.order[position] != buttonId)
+    {
+        position++;
+    }
+    for (uint8_t i = position + 1; i < slot.pressCount; i++)
+    {
+        slot.order[i - 1] = slot.order[i];
+        slot.times[i - 1] = slot.times[i];
+        slot.seqs[i - 1] = slot.seqs[i];
+        slot.reactions[i - 1] = slot.reactions[i];
+    }
+    slot.pressCount--;
+    buttonPressed = slot.pressCount > 0;
+    firstPressedButton = slot.pressCount > 0 ? slot.order[0] : 0;
+
+    // 離して押し直せば、もう一度受け付ける
+    LedBackend::set(buttonId - 1, false);
+    return true;
+}
+
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::setLed(uint8_t buttonIndex, bool on)
+{
+    if (buttonIndex < N)
+    {
+        LedBackend::set(buttonIndex, on);
+    }
+}
+
+#if ENABLE_GESTURES
+template <uint8_t N, class InputBackend, class LedBackend, class DebouncePolicy>
+void ButtonManagerT<N, InputBackend, LedBackend, DebouncePolicy>::sendGesture(const Gesture &gesture)
+{
+    // 離した時刻は、今の時刻から経過したサンプル数を引いて求める
+    uint32_t now = sampler.getTick();
+    unsigned long releasedAt = communicator->getTimestamp() - sampler.ticksToMillis(now - gesture.releaseTick);
+    unsigned long hold = sampler.ticksToMillis(gesture.releaseTick - gesture.lastPressTick);
+    unsigned long total = sampler.ticksToMillis(gesture.releaseTick - gesture.firstPressTick);
+    communicator->sendGesture(gesture.buttonIndex + 1, gesture.longPress, gesture.taps,
+                              hold > 0xFFFF ? 0xFFFF : (uint16_t)hold, total > 0xFFFF ? 0xFFFF : (uint16_t)total,
+                              releasedAt);
+}
+#endif
+
+// 使用しない方はリンク時に取り除かれる
+template class ButtonManagerT<MAX_BUTTONS, PinMapInput<ConfigPinMap, MAX_BUTTONS>, FixedLedBackend,
+                              StableTimeDebounce>;
+template class ButtonManagerT<MAX_BUTTONS, ConfigInput, ConfigLeds, StableTimeDebounce>;
+
+// サンプリング割り込み: 使用する ButtonManager のボタン入力をここで展開して読む
+// （タイマーは ButtonSampler::begin() で instance を設定してから有効にする）
+ISR(TIMER2_COMPA_vect)
 {
-    debounceDelay = delay;
+    ButtonSampler::instance->sample<ButtonManager::Input>();
 }
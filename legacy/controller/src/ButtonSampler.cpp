@@ -0,0 +1,154 @@
+/**
+ * @file ButtonSampler.cpp
+ * @brief タイマー割り込みによるボタン入力サンプリングクラスの実装
+ */
+
+#include "ButtonSampler.h"
+#include <util/atomic.h>
+
+#if SCAN_SAMPLE_RATE_HZ < 1000 || SCAN_SAMPLE_RATE_HZ > 50000
+#error "SCAN_SAMPLE_RATE_HZ must be between 1000 and 50000"
+#endif
+
+#if (SAMPLE_FIFO_SIZE & (SAMPLE_FIFO_SIZE - 1)) != 0 || SAMPLE_FIFO_SIZE > 128
+#error "SAMPLE_FIFO_SIZE must be a power of two up to 128"
+#endif
+
+ButtonSampler *ButtonSampler::instance = nullptr;
+
+namespace
+{
+/**
+ * @brief Timer2 の分周比とクロック選択ビット
+ */
+struct TimerPrescaler
+{
+    uint16_t divider;
+    uint8_t bits;
+};
+
+const TimerPrescaler TIMER2_PRESCALERS[] = {
+    {1, _BV(CS20)},
+    {8, _BV(CS21)},
+    {32, _BV(CS21) | _BV(CS20)},
+    {64, _BV(CS22)},
+    {128, _BV(CS22) | _BV(CS20)},
+    {256, _BV(CS22) | _BV(CS21)},
+    {1024, _BV(CS22) | _BV(CS21) | _BV(CS20)},
+};
+} // namespace
+
+ButtonSampler::ButtonSampler()
+    : sampleRate(SCAN_SAMPLE_RATE_HZ),
+      timerDivider(1),
+      fifoHead(0),
+      fifoTail(0),
+      tick(0),
+      lastMask(0),
+      missedDeadlineCount(0),
+      overflowCount(0),
+      maxIsrCounts(0)
+{
+}
+
+void ButtonSampler::begin()
+{
+    // 8bit カウンタに収まる最小の分周比を選ぶ
+    uint8_t index = 0;
+    while (index < sizeof(TIMER2_PRESCALERS) / sizeof(TIMER2_PRESCALERS[0]) - 1 &&
+           F_CPU / TIMER2_PRESCALERS[index].divider / SCAN_SAMPLE_RATE_HZ > 256)
+    {
+        index++;
+    }
+    uint16_t top = F_CPU / TIMER2_PRESCALERS[index].divider / SCAN_SAMPLE_RATE_HZ;
+    sampleRate = F_CPU / TIMER2_PRESCALERS[index].divider / top;
+    timerDivider = TIMER2_PRESCALERS[index].divider;
+
+    instance = this;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // CTC モード（OCR2A で一致したら 0 に戻る）
+        TCCR2A = _BV(WGM21);
+        TCCR2B = TIMER2_PRESCALERS[index].bits;
+        OCR2A = (uint8_t)(top - 1);
+        TCNT2 = 0;
+        TIFR2 = _BV(OCF2A);
+        TIMSK2 = _BV(OCIE2A);
+    }
+}
+
+bool ButtonSampler::pop(Sample &out)
+{
+    bool available = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (fifoTail != fifoHead)
+        {
+            // 現在の tick から経過サンプル数（16ビットの差）を引いて、積んだときの tick に戻す
+            uint16_t age = static_cast<uint16_t>(tick) - fifo[fifoTail].tick;
+            out.tick = tick - age;
+            out.mask = fifo[fifoTail].mask;
+            fifoTail = (fifoTail + 1) & (SAMPLE_FIFO_SIZE - 1);
+            available = true;
+        }
+    }
+    return available;
+}
+
+uint32_t ButtonSampler::getTick() const
+{
+    uint32_t value;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        value = tick;
+    }
+    return value;
+}
+
+uint32_t ButtonSampler::getSampleRate() const
+{
+    return sampleRate;
+}
+
+uint32_t ButtonSampler::msToTicks(unsigned long ms) const
+{
+    return (uint32_t)ms * sampleRate / 1000UL;
+}
+
+unsigned long ButtonSampler::ticksToMicros(uint32_t ticks) const
+{
+    return ticks * (1000000UL / sampleRate);
+}
+
+unsigned long ButtonSampler::ticksToMillis(uint32_t ticks) const
+{
+    // ticks * 1000 は数分で桁あふれするため、秒と端数に分けて変換する
+    return ticks / sampleRate * 1000UL + ticks % sampleRate * 1000UL / sampleRate;
+}
+
+unsigned long ButtonSampler::getMissedDeadlineCount() const
+{
+    unsigned long value;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        value = missedDeadlineCount;
+    }
+    return value;
+}
+
+unsigned long ButtonSampler::getOverflowCount() const
+{
+    unsigned long value;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        value = overflowCount;
+    }
+    return value;
+}
+
+uint16_t ButtonSampler::getMaxIsrCycles() const
+{
+    // 1バイトの読み出しは割り込みに分断されない
+    return (uint16_t)maxIsrCounts * timerDivider;
+}
@@ -0,0 +1,286 @@
+/**
+ * @file DebounceLearner.cpp
+ * @brief デバウンス時間の学習クラスの実装
+ */
+
+#include "DebounceLearner.h"
+#include <stddef.h>
+#include <EEPROM.h>
+#include <util/crc16.h>
+
+#if DEBOUNCE_DELAY > 65
+#error "DEBOUNCE_DELAY must be 65 ms or less (windows are kept in 16-bit microseconds)"
+#endif
+
+#if DEBOUNCE_MIN_MS < 1 || DEBOUNCE_MIN_MS > DEBOUNCE_DELAY
+#error "DEBOUNCE_MIN_MS must be between 1 and DEBOUNCE_DELAY"
+#endif
+
+namespace
+{
+const uint16_t DEBOUNCE_MAGIC = 0x5144; // "QD"
+
+/**
+ * @brief EEPROM に保存する学習結果
+ */
+struct DebounceRecord
+{
+    uint16_t magic;                  // DEBOUNCE_MAGIC
+    uint16_t observed[MAX_BUTTONS];  // 観測した変化の回数
+    uint16_t gapUs[MAX_BUTTONS];     // 変化の間隔の最大の推定値（マイクロ秒）
+    uint16_t crc;                    // crc より前の CRC-16
+};
+
+uint16_t recordCrc(const DebounceRecord &record)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < offsetof(DebounceRecord, crc); i++)
+    {
+        crc = _crc16_update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+uint16_t clampMicros(unsigned long micros)
+{
+    return micros > 0xFFFF ? 0xFFFF : (uint16_t)micros;
+}
+} // namespace
+
+DebounceLearner::DebounceLearner()
+    : dirty(false),
+      savedAt(0)
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        profiles[i] = SwitchProfile();
+        windows[i] = DEBOUNCE_DELAY * 1000U;
+        seenBounces[i] = 0;
+    }
+}
+
+void DebounceLearner::begin(ButtonManager &buttonManager)
+{
+    DebounceRecord record;
+    EEPROM.get(DEBOUNCE_EEPROM_ADDRESS, record);
+    bool valid = record.magic == DEBOUNCE_MAGIC && record.crc == recordCrc(record);
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        if (valid)
+        {
+            profiles[i].observed = record.observed[i];
+            profiles[i].gapUs = record.gapUs[i];
+        }
+        seenBounces[i] = buttonManager.getBounceCount(i);
+        windows[i] = computeWindow(i);
+    }
+    buttonManager.setDebounceWindows(windows);
+}
+
+void DebounceLearner::update(ButtonManager &buttonManager)
+{
+    bool learned = false;
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        // メインループは確定より十分速く回るため、1回の update() で同じボタンが2回確定することはまずない
+        // 取りこぼしても学習が1回分遅れるだけ
+        uint8_t count = buttonManager.getBounceCount(i);
+        if (count != seenBounces[i])
+        {
+            seenBounces[i] = count;
+            learn(i, buttonManager.getBounce(i), buttonManager.getSampler());
+            learned = true;
+        }
+    }
+    if (learned)
+    {
+        apply(buttonManager);
+    }
+
+    if (dirty && millis() - savedAt >= DEBOUNCE_SAVE_INTERVAL_MS)
+    {
+        save();
+    }
+}
+
+void DebounceLearner::clear(ButtonManager &buttonManager)
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        profiles[i] = SwitchProfile();
+    }
+    apply(buttonManager);
+    save();
+}
+
+void DebounceLearner::learn(uint8_t index, const BounceProfile &bounce, const ButtonSampler &sampler)
+{
+    SwitchProfile &profile = profiles[index];
+    uint16_t gapUs = clampMicros(sampler.ticksToMicros(bounce.maxGapTicks));
+
+    if (bounce.chatter && profile.observed >= DEBOUNCE_LEARN_COUNT)
+    {
+        // デバウンス時間より長い間隔のバウンスで1回の操作が分かれた疑い: デバウンス時間を倍にする
+        uint32_t doubled = (uint32_t)windows[index] * 2 / DEBOUNCE_MARGIN;
+        profile.gapUs = clampMicros(doubled > gapUs ? doubled : gapUs);
+        if (profile.chatters < 0xFF)
+        {
+            profile.chatters++;
+        }
+        return;
+    }
+
+    uint16_t spanUs = clampMicros(sampler.ticksToMicros(bounce.spanTicks));
+    if (profile.observed == 0)
+    {
+        profile.edges16 = bounce.edges * 16U;
+        profile.spanUs = spanUs;
+    }
+    else
+    {
+        // 移動平均（直近の約8回）
+        profile.edges16 += ((int16_t)(bounce.edges * 16U) - (int16_t)profile.edges16) / 8;
+        profile.spanUs += ((int32_t)spanUs - (int32_t)profile.spanUs) / 8;
+    }
+    if (spanUs > profile.maxSpanUs)
+    {
+        profile.maxSpanUs = spanUs;
+    }
+
+    // 間隔の推定値は観測した最大値まですぐに上げ、ゆっくり下げる
+    if (gapUs >= profile.gapUs)
+    {
+        profile.gapUs = gapUs;
+    }
+    else
+    {
+        profile.gapUs -= (profile.gapUs - gapUs + 63) / 64;
+    }
+
+    if (profile.observed < 0xFFFF)
+    {
+        profile.observed++;
+    }
+}
+
+uint16_t DebounceLearner::computeWindow(uint8_t index) const
+{
+    const SwitchProfile &profile = profiles[index];
+    if (profile.observed < DEBOUNCE_LEARN_COUNT)
+    {
+        return DEBOUNCE_DELAY * 1000U;
+    }
+
+    // ミリ秒単位に切り上げる（小さな変動で保存し直さないように）
+    uint32_t window = ((uint32_t)profile.gapUs * DEBOUNCE_MARGIN + 999UL) / 1000UL * 1000UL;
+    if (window < DEBOUNCE_MIN_MS * 1000UL)
+    {
+        window = DEBOUNCE_MIN_MS * 1000UL;
+    }
+    if (window > DEBOUNCE_DELAY * 1000UL)
+    {
+        window = DEBOUNCE_DELAY * 1000UL;
+    }
+    return (uint16_t)window;
+}
+
+void DebounceLearner::apply(ButtonManager &buttonManager)
+{
+    bool changed = false;
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        uint16_t window = computeWindow(i);
+        if (window != windows[i])
+        {
+            windows[i] = window;
+            changed = true;
+        }
+    }
+    if (changed)
+    {
+        buttonManager.setDebounceWindows(windows);
+        dirty = true;
+    }
+}
+
+void DebounceLearner::send(const SerialCommunicator &serialComm) const
+{
+    // 最も大きい応答のため、JsonDocument を使わずに直接書き出す
+    Reply reply = {this, serialComm.getTimestamp()};
+    serialComm.writeFrame(writeReply, &reply);
+}
+
+void DebounceLearner::writeReply(JsonFrameWriter &writer, const void *context)
+{
+    const Reply &reply = *static_cast<const Reply *>(context);
+    const DebounceLearner &learner = *reply.learner;
+
+    writer.begin(F("debounce"));
+    writer.beginArray(F("window"));
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        writer.item(learner.windows[i]);
+    }
+    writer.endArray();
+    writer.beginArray(F("observed"));
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        writer.item(learner.profiles[i].observed);
+    }
+    writer.endArray();
+    writer.beginArray(F("edges"));
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        writer.itemFloat(learner.profiles[i].edges16 / 16.0f, 4); // 1/16 単位なので 4 桁で正確
+    }
+    writer.endArray();
+    writer.beginArray(F("span"));
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        writer.item(learner.profiles[i].spanUs);
+    }
+    writer.endArray();
+    writer.beginArray(F("maxSpan"));
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        writer.item(learner.profiles[i].maxSpanUs);
+    }
+    writer.endArray();
+    writer.beginArray(F("gap"));
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        writer.item(learner.profiles[i].gapUs);
+    }
+    writer.endArray();
+    writer.beginArray(F("chatter"));
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        writer.item(learner.profiles[i].chatters);
+    }
+    writer.endArray();
+    writer.add(F("timestamp"), reply.timestamp);
+    writer.end();
+}
+
+uint16_t DebounceLearner::getWindow(uint8_t index) const
+{
+    return windows[index];
+}
+
+void DebounceLearner::save()
+{
+    DebounceRecord record;
+    record.magic = DEBOUNCE_MAGIC;
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        record.observed[i] = profiles[i].observed;
+        record.gapUs[i] = profiles[i].gapUs;
+    }
+    record.crc = recordCrc(record);
+
+    // 内容が同じバイトは書き込まない（EEPROM の書き換え回数を減らす）
+    EEPROM.put(DEBOUNCE_EEPROM_ADDRESS, record);
+    dirty = false;
+    savedAt = millis();
+}
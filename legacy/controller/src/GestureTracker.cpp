@@ -0,0 +1,119 @@
+/**
+ * @file GestureTracker.cpp
+ * @brief ジェスチャー判定クラスの実装
+ */
+
+#include "GestureTracker.h"
+
+GestureTracker::GestureTracker()
+    : longPressTicks(0),
+      tapGapTicks(0)
+{
+    clear();
+}
+
+void GestureTracker::begin(const ButtonSampler &buttonSampler)
+{
+    longPressTicks = buttonSampler.msToTicks(GESTURE_LONG_PRESS_MS);
+    tapGapTicks = buttonSampler.msToTicks(GESTURE_TAP_GAP_MS);
+}
+
+bool GestureTracker::press(uint8_t buttonIndex, uint32_t tick, Gesture &gesture)
+{
+    Track &track = tracks[buttonIndex];
+    bool finished = false;
+    if (track.phase == PHASE_HELD)
+    {
+        return false; // 解放を見ていない（最初の押下から数え続ける）
+    }
+    if (track.phase == PHASE_WAITING)
+    {
+        if (tick - track.releaseTick < tapGapTicks && track.taps < 0xFF)
+        {
+            // 連打の続き
+            track.phase = PHASE_HELD;
+            track.taps++;
+            track.lastPressTick = tick;
+            return false;
+        }
+        // メインループが待ちの切れを見る前に次の押下が来た
+        finish(buttonIndex, false, gesture);
+        finished = true;
+    }
+
+    track.phase = PHASE_HELD;
+    track.taps = 1;
+    track.firstPressTick = tick;
+    track.lastPressTick = tick;
+    return finished;
+}
+
+bool GestureTracker::release(uint8_t buttonIndex, uint32_t tick, Gesture &gesture)
+{
+    Track &track = tracks[buttonIndex];
+    if (track.phase != PHASE_HELD)
+    {
+        return false; // 押下を見ていない（復元したラウンド・リセットで取り消した操作）
+    }
+
+    track.releaseTick = tick;
+    if (tick - track.lastPressTick >= longPressTicks)
+    {
+        finish(buttonIndex, true, gesture);
+        return true;
+    }
+    track.phase = PHASE_WAITING;
+    return false;
+}
+
+bool GestureTracker::poll(uint32_t untilTick, Gesture &gesture)
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        if (tracks[i].phase == PHASE_WAITING && untilTick - tracks[i].releaseTick >= tapGapTicks)
+        {
+            finish(i, false, gesture);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GestureTracker::flush(Gesture &gesture)
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        if (tracks[i].phase == PHASE_HELD)
+        {
+            tracks[i].phase = PHASE_IDLE;
+        }
+        else if (tracks[i].phase == PHASE_WAITING)
+        {
+            finish(i, false, gesture);
+            return true;
+        }
+    }
+    return false;
+}
+
+void GestureTracker::clear()
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        tracks[i].phase = PHASE_IDLE;
+        tracks[i].taps = 0;
+    }
+}
+
+void GestureTracker::finish(uint8_t buttonIndex, bool longPress, Gesture &gesture)
+{
+    Track &track = tracks[buttonIndex];
+    gesture.buttonIndex = buttonIndex;
+    gesture.taps = track.taps;
+    gesture.longPress = longPress;
+    gesture.firstPressTick = track.firstPressTick;
+    gesture.lastPressTick = track.lastPressTick;
+    gesture.releaseTick = track.releaseTick;
+    track.phase = PHASE_IDLE;
+    track.taps = 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file JsonFrameWriter.cpp
+ * @brief JSON の直接書き出しクラスの実装
+ */
+
+#include "JsonFrameWriter.h"
+
+JsonFrameWriter::JsonFrameWriter(Print &output)
+    : output(output),
+      first(true)
+{
+}
+
+void JsonFrameWriter::begin(const __FlashStringHelper *type)
+{
+    output.print(F("{\"type\":\""));
+    output.print(type);
+    output.print('"');
+    first = false;
+}
+
+void JsonFrameWriter::add(const __FlashStringHelper *name, unsigned long value)
+{
+    key(name);
+    output.print(value);
+}
+
+void JsonFrameWriter::addSigned(const __FlashStringHelper *name, long value)
+{
+    key(name);
+    output.print(value);
+}
+
+void JsonFrameWriter::addBool(const __FlashStringHelper *name, bool value)
+{
+    key(name);
+    output.print(value ? F("true") : F("false"));
+}
+
+void JsonFrameWriter::beginArray(const __FlashStringHelper *name)
+{
+    key(name);
+    output.print('[');
+    first = true;
+}
+
+void JsonFrameWriter::beginNestedArray()
+{
+    separate();
+    output.print('[');
+    first = true;
+}
+
+void JsonFrameWriter::item(unsigned long value)
+{
+    separate();
+    output.print(value);
+}
+
+void JsonFrameWriter::itemFloat(float value, uint8_t digits)
+{
+    separate();
+    // 整数の値は小数点以下を付けない（JsonDocument の出力と同じ）
+    long whole = static_cast<long>(value);
+    if (static_cast<float>(whole) == value)
+    {
+        output.print(whole);
+    }
+    else
+    {
+        output.print(value, digits);
+    }
+}
+
+void JsonFrameWriter::itemNull()
+{
+    separate();
+    output.print(F("null"));
+}
+
+void JsonFrameWriter::endArray()
+{
+    output.print(']');
+    first = false;
+}
+
+void JsonFrameWriter::end()
+{
+    output.print('}');
+}
+
+void JsonFrameWriter::separate()
+{
+    if (!first)
+    {
+        output.print(',');
+    }
+    first = false;
+}
+
+void JsonFrameWriter::key(const __FlashStringHelper *name)
+{
+    separate();
+    output.print('"');
+    output.print(name);
+    output.print(F("\":"));
+}
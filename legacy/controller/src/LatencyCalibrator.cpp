@@ -0,0 +1,267 @@
+/**
+ * @file LatencyCalibrator.cpp
+ * @brief 検出遅延の校正クラスの実装
+ */
+
+#include "LatencyCalibrator.h"
+#include <stddef.h>
+#include <EEPROM.h>
+#include <util/crc16.h>
+
+namespace
+{
+const uint16_t CALIBRATION_MAGIC = 0x5143; // "QC"
+
+/**
+ * @brief EEPROM に保存する校正結果
+ */
+struct CalibrationRecord
+{
+    uint16_t magic;                   // CALIBRATION_MAGIC
+    uint16_t latencies[MAX_BUTTONS];  // ボタンごとの検出遅延（マイクロ秒、未校正は UNCALIBRATED）
+    uint16_t crc;                     // crc より前の CRC-16
+};
+
+uint16_t recordCrc(const CalibrationRecord &record)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < offsetof(CalibrationRecord, crc); i++)
+    {
+        crc = _crc16_update(crc, bytes[i]);
+    }
+    return crc;
+}
+} // namespace
+
+LatencyCalibrator::LatencyCalibrator()
+    : phase(PHASE_IDLE),
+      buttonIndex(0),
+      sampleCount(0),
+      latencySum(0),
+      edgeTick(0),
+      edgeDelay(0),
+      phaseStartedAt(0)
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        latencies[i] = UNCALIBRATED;
+    }
+}
+
+void LatencyCalibrator::begin(ButtonManager &buttonManager)
+{
+    // 基準エッジのピンは使わないときはハイインピーダンスにしておく（ボタン押下とぶつからないように）
+    releaseEdge();
+
+    CalibrationRecord record;
+    EEPROM.get(CALIBRATION_EEPROM_ADDRESS, record);
+    if (record.magic == CALIBRATION_MAGIC && record.crc == recordCrc(record))
+    {
+        for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+        {
+            latencies[i] = record.latencies[i];
+        }
+    }
+    applyOffsets(buttonManager);
+}
+
+void LatencyCalibrator::start(uint8_t buttonId, ButtonManager &buttonManager, SerialCommunicator &serialComm)
+{
+    if (phase != PHASE_IDLE)
+    {
+        serialComm.sendError(F("Calibration already running"));
+        return;
+    }
+    if (buttonId < 1 || buttonId > MAX_BUTTONS)
+    {
+        serialComm.sendError(F("Invalid button ID"));
+        return;
+    }
+
+    buttonIndex = buttonId - 1;
+    sampleCount = 0;
+    latencySum = 0;
+    buttonManager.setCalibrating(true);
+    phase = PHASE_SETTLE;
+    phaseStartedAt = millis();
+}
+
+void LatencyCalibrator::clear(ButtonManager &buttonManager)
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        latencies[i] = UNCALIBRATED;
+    }
+    save();
+    applyOffsets(buttonManager);
+}
+
+void LatencyCalibrator::update(ButtonManager &buttonManager, SerialCommunicator &serialComm)
+{
+    bool raw = (buttonManager.getRawStates() >> buttonIndex) & 1;
+    unsigned long elapsed = millis() - phaseStartedAt;
+
+    switch (phase)
+    {
+    case PHASE_IDLE:
+        return;
+
+    case PHASE_SETTLE:
+        // 前の計測のエッジを戻してから入力線が落ち着くまで待つ
+        if (elapsed < CALIBRATION_SETTLE_MS)
+        {
+            return;
+        }
+        if (raw)
+        {
+            finish(buttonManager);
+            serialComm.sendError(F("Calibration input is held low"));
+            return;
+        }
+        fireEdge(buttonManager);
+        phase = PHASE_WAITING;
+        phaseStartedAt = millis();
+        return;
+
+    case PHASE_WAITING:
+        if (raw && (int32_t)(buttonManager.getRawChangedAt(buttonIndex) - edgeTick) > 0)
+        {
+            const ButtonSampler &sampler = buttonManager.getSampler();
+            latencySum += sampler.ticksToMicros(buttonManager.getRawChangedAt(buttonIndex) - edgeTick) - edgeDelay;
+            sampleCount++;
+            releaseEdge();
+
+            if (sampleCount < CALIBRATION_SAMPLES)
+            {
+                phase = PHASE_SETTLE;
+                phaseStartedAt = millis();
+                return;
+            }
+
+            uint32_t latency = latencySum / CALIBRATION_SAMPLES;
+            latencies[buttonIndex] = latency < UNCALIBRATED ? (uint16_t)latency : UNCALIBRATED - 1;
+            save();
+            finish(buttonManager);
+            sendResult(serialComm, buttonIndex + 1);
+            return;
+        }
+        if (elapsed >= CALIBRATION_TIMEOUT_MS)
+        {
+            // 基準エッジの配線がこのボタンにつながっていない
+            releaseEdge();
+            finish(buttonManager);
+            serialComm.sendError(F("Calibration edge not detected"));
+        }
+        return;
+    }
+}
+
+void LatencyCalibrator::sendResult(const SerialCommunicator &serialComm, uint8_t buttonId) const
+{
+    JsonDocument doc;
+    doc[F("type")] = F("calibration");
+    if (buttonId != 0)
+    {
+        doc[F("button")] = buttonId;
+    }
+    JsonArray latency = doc[F("latency")].to<JsonArray>();
+    JsonArray offset = doc[F("offset")].to<JsonArray>();
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        if (latencies[i] == UNCALIBRATED)
+        {
+            latency.add(nullptr);
+        }
+        else
+        {
+            latency.add(latencies[i]);
+        }
+        offset.add(getOffset(i));
+    }
+    doc[F("timestamp")] = serialComm.getTimestamp();
+
+    serialComm.writeFrame(doc);
+}
+
+bool LatencyCalibrator::isRunning() const
+{
+    return phase != PHASE_IDLE;
+}
+
+uint16_t LatencyCalibrator::getLatency(uint8_t index) const
+{
+    return latencies[index];
+}
+
+uint16_t LatencyCalibrator::getOffset(uint8_t index) const
+{
+    if (latencies[index] == UNCALIBRATED)
+    {
+        return 0;
+    }
+    uint16_t fastest = latencies[index];
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        if (latencies[i] < fastest)
+        {
+            fastest = latencies[i];
+        }
+    }
+    return latencies[index] - fastest;
+}
+
+void LatencyCalibrator::fireEdge(const ButtonManager &buttonManager)
+{
+    const ButtonSampler &sampler = buttonManager.getSampler();
+
+    // サンプルの直後からずらしてエッジを出し、サンプリング周期より細かい遅延を平均で求める
+    edgeDelay = (uint16_t)(sampler.ticksToMicros(1) * sampleCount / CALIBRATION_SAMPLES);
+    uint32_t tick = sampler.getTick();
+    while (sampler.getTick() == tick)
+    {
+    }
+    edgeTick = tick + 1;
+    delayMicroseconds(edgeDelay);
+
+    // オープンドレインとして LOW に引く（ボタンと同じ向きのエッジ）
+    digitalWrite(CALIBRATION_PIN, LOW);
+    pinMode(CALIBRATION_PIN, OUTPUT);
+}
+
+void LatencyCalibrator::releaseEdge()
+{
+    pinMode(CALIBRATION_PIN, INPUT);
+    digitalWrite(CALIBRATION_PIN, LOW);
+}
+
+void LatencyCalibrator::finish(ButtonManager &buttonManager)
+{
+    phase = PHASE_IDLE;
+    buttonManager.setCalibrating(false);
+    applyOffsets(buttonManager);
+}
+
+void LatencyCalibrator::applyOffsets(ButtonManager &buttonManager) const
+{
+    uint16_t offsets[MAX_BUTTONS];
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        offsets[i] = getOffset(i);
+    }
+    buttonManager.setLatencyOffsets(offsets);
+}
+
+void LatencyCalibrator::save() const
+{
+    CalibrationRecord record;
+    record.magic = CALIBRATION_MAGIC;
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        record.latencies[i] = latencies[i];
+    }
+    record.crc = recordCrc(record);
+
+    // 内容が同じバイトは書き込まない（EEPROM の書き換え回数を減らす）
+    EEPROM.put(CALIBRATION_EEPROM_ADDRESS, record);
+}
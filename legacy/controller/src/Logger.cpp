@@ -24,13 +24,13 @@ void Logger::setup()
 }
 
 /**
- * @brief 情報レベルのログ出力（std::string版）
+ * @brief 情報レベルのログ出力（StringView版）
  *
  * @param message ログメッセージ
  */
-void Logger::info(const std::string &message)
+void Logger::info(StringView message)
 {
-    log(message.c_str(), "INFO");
+    log(message, "INFO");
 }
 
 /**
@@ -44,14 +44,24 @@ void Logger::info(const char *message)
 }
 
 /**
- * @brief デバッグレベルのログ出力（std::string版）
+ * @brief 情報レベルのログ出力（F() 版）
+ *
+ * @param message ログメッセージ
+ */
+void Logger::info(const __FlashStringHelper *message)
+{
+    log(message, "INFO");
+}
+
+/**
+ * @brief デバッグレベルのログ出力（StringView版）
  *
  * @param message ログメッセージ
  */
-void Logger::debug(const std::string &message)
+void Logger::debug(StringView message)
 {
 #ifdef DEBUG
-    log(message.c_str(), "DEBUG");
+    log(message, "DEBUG");
 #endif
 }
 
@@ -68,13 +78,25 @@ void Logger::debug(const char *message)
 }
 
 /**
- * @brief 警告レベルのログ出力（std::string版）
+ * @brief デバッグレベルのログ出力（F() 版）
  *
  * @param message ログメッセージ
  */
-void Logger::warn(const std::string &message)
+void Logger::debug(const __FlashStringHelper *message)
 {
-    log(message.c_str(), "WARN");
+#ifdef DEBUG
+    log(message, "DEBUG");
+#endif
+}
+
+/**
+ * @brief 警告レベルのログ出力（StringView版）
+ *
+ * @param message ログメッセージ
+ */
+void Logger::warn(StringView message)
+{
+    log(message, "WARN");
 }
 
 /**
@@ -88,13 +110,23 @@ void Logger::warn(const char *message)
 }
 
 /**
- * @brief エラーレベルのログ出力（std::string版）
+ * @brief 警告レベルのログ出力（F() 版）
  *
  * @param message ログメッセージ
  */
-void Logger::error(const std::string &message)
+void Logger::warn(const __FlashStringHelper *message)
 {
-    log(message.c_str(), "ERROR");
+    log(message, "WARN");
+}
+
+/**
+ * @brief エラーレベルのログ出力（StringView版）
+ *
+ * @param message ログメッセージ
+ */
+void Logger::error(StringView message)
+{
+    log(message, "ERROR");
 }
 
 /**
@@ -108,13 +140,23 @@ void Logger::error(const char *message)
 }
 
 /**
- * @brief 致命的エラーレベルのログ出力（std::string版）
+ * @brief エラーレベルのログ出力（F() 版）
  *
  * @param message ログメッセージ
  */
-void Logger::fatal(const std::string &message)
+void Logger::error(const __FlashStringHelper *message)
 {
-    log(message.c_str(), "FATAL");
+    log(message, "ERROR");
+}
+
+/**
+ * @brief 致命的エラーレベルのログ出力（StringView版）
+ *
+ * @param message ログメッセージ
+ */
+void Logger::fatal(StringView message)
+{
+    log(message, "FATAL");
 }
 
 /**
@@ -127,61 +169,53 @@ void Logger::fatal(const char *message)
     log(message, "FATAL");
 }
 
+/**
+ * @brief 致命的エラーレベルのログ出力（F() 版）
+ *
+ * @param message ログメッセージ
+ */
+void Logger::fatal(const __FlashStringHelper *message)
+{
+    log(message, "FATAL");
+}
+
 /**
  * @brief 基本的なログ出力処理
  *
+ * 形式: "12345 [INFO] [ModuleName] Message"
+ * バッファに組み立てずに直接書き出すため、メッセージの長さに制限はない
+ *
  * @param message ログメッセージ
  * @param level ログレベル
  */
-void Logger::log(const char *message, const char *level)
+void Logger::log(StringView message, const char *level)
 {
-    char *prefix = createPrefix(level, message);
-    Serial.println(prefix);
+    Serial.print(millis());
+    Serial.print(F(" ["));
+    Serial.print(level);
+    Serial.print(F("] ["));
+    Serial.write(name.data(), name.size());
+    Serial.print(F("] "));
+    Serial.write(message.data(), message.size());
+    Serial.println();
     Serial.flush();
-    delete[] prefix;
 }
 
 /**
- * @brief ログメッセージのプレフィックスを作成
+ * @brief 基本的なログ出力処理（F() 版、メッセージはフラッシュから直接書き出す）
  *
- * @param level ログレベル
  * @param message ログメッセージ
- * @return char* フォーマット済みのログメッセージ
+ * @param level ログレベル
  */
-char *Logger::createPrefix(const char *level, const char *message)
+void Logger::log(const __FlashStringHelper *message, const char *level)
 {
-    // タイムスタンプ、レベル、モジュール名、メッセージを含む形式
-    // 例: "12345 [INFO] [ModuleName] Message"
-
-    unsigned long timestamp = millis(); // size_t → unsigned long に変更
-
-    // バッファサイズを正確に計算（余裕を持たせる）
-    size_t timestampLen = 10; // 最大10桁
-    size_t levelLen = strlen(level);
-    size_t nameLen = name.length();
-    size_t messageLen = strlen(message);
-
-    // フォーマット文字列の固定部分: " [] [] " + null terminator
-    size_t formatOverhead = 6 + 1;
-    size_t bufferSize = timestampLen + levelLen + nameLen + messageLen + formatOverhead + 10; // 安全マージン
-
-    char *buffer = new char[bufferSize];
-
-    // バッファを初期化
-    memset(buffer, 0, bufferSize);
-
-    int written = snprintf(buffer, bufferSize, "%lu [%s] [%s] %s",
-                           timestamp, level, name.c_str(), message);
-
-    // 書き込みが正常に完了したか確認
-    if (written < 0 || written >= (int)bufferSize)
-    {
-        // エラーの場合は安全なメッセージに置き換え
-        delete[] buffer;
-        const char *errorMsg = "LOG_FORMAT_ERROR";
-        buffer = new char[strlen(errorMsg) + 1];
-        strcpy(buffer, errorMsg);
-    }
-
-    return buffer;
+    Serial.print(millis());
+    Serial.print(F(" ["));
+    Serial.print(level);
+    Serial.print(F("] ["));
+    Serial.write(name.data(), name.size());
+    Serial.print(F("] "));
+    Serial.print(message);
+    Serial.println();
+    Serial.flush();
 }
@@ -0,0 +1,216 @@
+/**
+ * @file ReactionStats.cpp
+ * @brief 反応時間の統計クラスの実装
+ */
+
+#include "ReactionStats.h"
+#include <avr/pgmspace.h>
+#include <math.h>
+
+namespace
+{
+// ビン i の上限（ミリ秒、64 * 2^((i+1)/3)）。最後のビンは上限なし
+const uint16_t BIN_LIMITS[ReactionStats::BIN_COUNT - 1] PROGMEM = {
+    81,   102,  128,  161,  203,  256,  323,  406,  512,  645,   813,   1024,
+    1290, 1625, 2048, 2580, 3251, 4096, 5161, 6502, 8192, 10321, 13004,
+};
+} // namespace
+
+ReactionStats::ReactionStats()
+    : seenRound(0),
+      seenPressCount(0)
+{
+    clear();
+}
+
+void ReactionStats::update(const ButtonManager &buttonManager)
+{
+    if (buttonManager.getRound() != seenRound)
+    {
+        // 前回の集計の後にリセットされた場合は、直前のラウンドの残りを先に集計する
+        const RoundSlot<MAX_BUTTONS> &previous = buttonManager.getPreviousRound();
+        if (previous.id == seenRound)
+        {
+            for (; seenPressCount < previous.pressCount; seenPressCount++)
+            {
+                if (previous.reactions[seenPressCount] != ButtonManager::REACTION_UNKNOWN)
+                {
+                    add(previous.order[seenPressCount], previous.reactions[seenPressCount]);
+                }
+            }
+        }
+        seenRound = buttonManager.getRound();
+        seenPressCount = 0;
+    }
+
+    // ラウンド内の押下は増えるだけなので、前回からの増分を集計する
+    for (; seenPressCount < buttonManager.getPressCount(); seenPressCount++)
+    {
+        uint16_t reaction = buttonManager.getPressReaction(seenPressCount);
+        if (reaction != ButtonManager::REACTION_UNKNOWN)
+        {
+            add(buttonManager.getPressedButton(seenPressCount), reaction);
+        }
+    }
+}
+
+void ReactionStats::add(uint8_t buttonId, unsigned long reactionMs)
+{
+    if (buttonId < 1 || buttonId > MAX_BUTTONS)
+    {
+        return;
+    }
+    PlayerStats &player = players[buttonId - 1];
+    uint16_t value = reactionMs < 0xFFFF ? (uint16_t)reactionMs : 0xFFFF;
+
+    if (player.count < 0xFFFF)
+    {
+        // Welford 法
+        player.count++;
+        float delta = value - player.mean;
+        player.mean += delta / player.count;
+        player.m2 += delta * (value - player.mean);
+    }
+    if (value < player.minMs)
+    {
+        player.minMs = value;
+    }
+    if (value > player.maxMs)
+    {
+        player.maxMs = value;
+    }
+
+    uint8_t bin = binIndex(value);
+    if (player.bins[bin] == 0xFF)
+    {
+        // 溢れる前に全体を半分にする（0 でないビンは 1 以上を保つ）
+        for (uint8_t i = 0; i < BIN_COUNT; i++)
+        {
+            player.bins[i] = (uint8_t)((player.bins[i] + 1) >> 1);
+        }
+    }
+    player.bins[bin]++;
+}
+
+void ReactionStats::clear()
+{
+    for (uint8_t p = 0; p < MAX_BUTTONS; p++)
+    {
+        players[p].count = 0;
+        players[p].mean = 0;
+        players[p].m2 = 0;
+        players[p].minMs = 0xFFFF;
+        players[p].maxMs = 0;
+        for (uint8_t i = 0; i < BIN_COUNT; i++)
+        {
+            players[p].bins[i] = 0;
+        }
+    }
+}
+
+void ReactionStats::send(const SerialCommunicator &serialComm) const
+{
+    // 入れ子の配列が多く JsonDocument では 約0.45KB のヒープを使うため、直接書き出す
+    Reply reply = {this, serialComm.getTimestamp()};
+    serialComm.writeFrame(writeReply, &reply);
+}
+
+void ReactionStats::writeReply(JsonFrameWriter &writer, const void *context)
+{
+    const Reply &reply = *static_cast<const Reply *>(context);
+    const ReactionStats &stats = *reply.stats;
+
+    // 1人あたり [件数, 平均, 標準偏差, p50, p90, p99]（ミリ秒、0件なら [0]）
+    writer.begin(F("analytics"));
+    writer.beginArray(F("players"));
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        writer.beginNestedArray();
+        writer.item(stats.getCount(i));
+        if (stats.getCount(i) > 0)
+        {
+            writer.item((unsigned long)(stats.getMean(i) + 0.5f));
+            writer.item((unsigned long)(stats.getStdDev(i) + 0.5f));
+            writer.item(stats.getQuantile(i, 50));
+            writer.item(stats.getQuantile(i, 90));
+            writer.item(stats.getQuantile(i, 99));
+        }
+        writer.endArray();
+    }
+    writer.endArray();
+    writer.add(F("timestamp"), reply.timestamp);
+    writer.end();
+}
+
+uint16_t ReactionStats::getCount(uint8_t index) const
+{
+    return players[index].count;
+}
+
+float ReactionStats::getMean(uint8_t index) const
+{
+    return players[index].mean;
+}
+
+float ReactionStats::getStdDev(uint8_t index) const
+{
+    const PlayerStats &player = players[index];
+    if (player.count < 2)
+    {
+        return 0;
+    }
+    return sqrt(player.m2 / (player.count - 1));
+}
+
+uint16_t ReactionStats::getQuantile(uint8_t index, uint8_t percent) const
+{
+    const PlayerStats &player = players[index];
+    uint16_t total = 0;
+    for (uint8_t i = 0; i < BIN_COUNT; i++)
+    {
+        total += player.bins[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    // 小さい方から数えて rank 番目（1 始まり）が入るビン
+    uint16_t rank = (uint16_t)(((uint32_t)total * percent + 99) / 100);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    uint16_t before = 0;
+    uint8_t bin = 0;
+    for (; bin < BIN_COUNT - 1; bin++)
+    {
+        if (before + player.bins[bin] >= rank)
+        {
+            break;
+        }
+        before += player.bins[bin];
+    }
+
+    // ビンの中では一様に分布しているとみなして補間する（両端のビンは観測した最小値・最大値まで）
+    uint16_t lower = bin > 0 ? pgm_read_word(&BIN_LIMITS[bin - 1]) : 0;
+    uint16_t upper = bin < BIN_COUNT - 1 ? pgm_read_word(&BIN_LIMITS[bin]) : player.maxMs;
+    lower = lower > player.minMs ? lower : player.minMs;
+    upper = upper < player.maxMs ? upper : player.maxMs;
+    if (upper <= lower)
+    {
+        return lower;
+    }
+    uint8_t inBin = player.bins[bin] > 0 ? player.bins[bin] : 1;
+    return lower + (uint16_t)((uint32_t)(upper - lower) * (2 * (rank - before) - 1) / (2 * inBin));
+}
+
+uint8_t ReactionStats::binIndex(uint16_t reactionMs)
+{
+    uint8_t bin = 0;
+    while (bin < BIN_COUNT - 1 && reactionMs >= pgm_read_word(&BIN_LIMITS[bin]))
+    {
+        bin++;
+    }
+    return bin;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file RecoveryStore.cpp
+ * @brief リセットをまたいだラウンド状態の保持クラスの実装
+ */
+
+#include "RecoveryStore.h"
+#include <stddef.h>
+#include <avr/wdt.h>
+#include <util/crc16.h>
+
+namespace
+{
+const uint16_t RECOVERY_MAGIC = 0x5152; // "QR"
+
+/**
+ * @brief .noinit に保存するラウンドの状態
+ */
+struct RecoveryState
+{
+    uint16_t magic;                         // RECOVERY_MAGIC
+    bool armed;                             // システムアクティブ状態
+    uint16_t round;                         // ラウンド番号
+    uint8_t pressCount;                     // 押されたボタン数
+    uint8_t pressOrder[MAX_BUTTONS];        // ボタンID（押下順）
+    uint16_t pressSeqs[MAX_BUTTONS];        // 押下イベントのシーケンス番号
+    unsigned long pressTimes[MAX_BUTTONS];  // 押下時刻（ミリ秒）
+    uint16_t nextSeq;                       // 次に割り当てるシーケンス番号
+    uint16_t firstUnackedSeq;               // 最古の未ACKイベントのシーケンス番号
+    unsigned long lastAliveAt;              // 最後に保存した時刻（ミリ秒）
+    uint16_t crc;                           // crc より前の CRC-16
+};
+
+// 起動時にゼロクリアされない領域（電源投入直後の内容は不定）
+RecoveryState savedState __attribute__((section(".noinit")));
+uint8_t resetFlags __attribute__((section(".noinit")));
+
+uint16_t stateCrc(const RecoveryState &state)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&state);
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < offsetof(RecoveryState, crc); i++)
+    {
+        crc = _crc16_update(crc, bytes[i]);
+    }
+    return crc;
+}
+} // namespace
+
+/**
+ * @brief リセット要因を退避し、ウォッチドッグを止める（main() より前、.init3 で実行）
+ *
+ * ウォッチドッグリセット後は最短のタイムアウトで動き続けるため、setup() を待たずに止める
+ * Optiboot は MCUSR をクリアして r2 に渡すので、MCUSR が 0 の場合は r2 を使う
+ */
+void captureResetFlags() __attribute__((naked, used, section(".init3")));
+void captureResetFlags()
+{
+    uint8_t bootloaderFlags;
+    __asm__ __volatile__("mov %0, r2" : "=r"(bootloaderFlags));
+
+    uint8_t flags = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+    resetFlags = flags != 0 ? flags : bootloaderFlags;
+}
+
+RecoveryStore::RecoveryStore()
+    : warmBoot(false)
+{
+}
+
+bool RecoveryStore::begin()
+{
+    // ウォッチドッグかブラウンアウトによるリセットだけを復元対象にする
+    // リセットボタンやホストの DTR（EXTRF）、電源投入（PORF）は新しいセッションとして扱う
+    uint8_t warmFlags = _BV(WDRF) | _BV(BORF);
+    uint8_t coldFlags = _BV(EXTRF) | _BV(PORF);
+    warmBoot = (resetFlags & warmFlags) != 0 && (resetFlags & coldFlags) == 0 &&
+               savedState.magic == RECOVERY_MAGIC && savedState.crc == stateCrc(savedState);
+
+    if (!warmBoot)
+    {
+        savedState.magic = 0;
+    }
+    return warmBoot;
+}
+
+uint8_t RecoveryStore::getResetFlags()
+{
+    return resetFlags;
+}
+
+void RecoveryStore::restore(ButtonManager &buttonManager, SerialCommunicator &serialComm)
+{
+    if (!warmBoot)
+    {
+        return;
+    }
+
+    // 停止時間は「最後の保存からハングまで」が分からないため、タイムアウトと起動にかかった時間で見積もる
+    unsigned long downtime = WATCHDOG_TIMEOUT_MS + millis();
+    serialComm.resume(savedState.nextSeq, savedState.lastAliveAt + downtime);
+
+    bool restored = buttonManager.restoreRound(savedState.armed, savedState.round, savedState.pressCount,
+                                               savedState.pressOrder, savedState.pressTimes, savedState.pressSeqs);
+    if (restored)
+    {
+        // ACKされていなかった押下は元の番号・時刻のまま送り直す
+        for (uint8_t i = 0; i < savedState.pressCount; i++)
+        {
+            uint16_t seq = savedState.pressSeqs[i];
+            if ((int16_t)(seq - savedState.firstUnackedSeq) >= 0 && (int16_t)(seq - savedState.nextSeq) < 0)
+            {
+                serialComm.requeuePress(seq, savedState.pressOrder[i], savedState.round, savedState.pressTimes[i]);
+            }
+        }
+    }
+
+    serialComm.sendRecovered((resetFlags & _BV(WDRF)) ? F("watchdog") : F("brownout"), downtime);
+    if (!restored)
+    {
+        serialComm.sendError(F("Recovered round state is invalid"));
+    }
+
+    save(buttonManager, serialComm);
+}
+
+void RecoveryStore::update(const ButtonManager &buttonManager, const SerialCommunicator &serialComm)
+{
+    if (buttonManager.getPressCount() != savedState.pressCount ||
+        buttonManager.isSystemActive() != savedState.armed ||
+        buttonManager.getRound() != savedState.round ||
+        serialComm.getNextSeq() != savedState.nextSeq ||
+        serialComm.getFirstUnackedSeq() != savedState.firstUnackedSeq ||
+        serialComm.getTimestamp() - savedState.lastAliveAt >= RECOVERY_SAVE_INTERVAL)
+    {
+        save(buttonManager, serialComm);
+    }
+}
+
+void RecoveryStore::save(const ButtonManager &buttonManager, const SerialCommunicator &serialComm)
+{
+    // 書き込み途中でリセットされた場合は CRC が一致せず、通常の起動になる
+    savedState.armed = buttonManager.isSystemActive();
+    savedState.round = buttonManager.getRound();
+    savedState.pressCount = buttonManager.getPressCount();
+    for (uint8_t i = 0; i < savedState.pressCount; i++)
+    {
+        savedState.pressOrder[i] = buttonManager.getPressedButton(i);
+        savedState.pressSeqs[i] = buttonManager.getPressSeq(i);
+        savedState.pressTimes[i] = buttonManager.getPressTime(i);
+    }
+    savedState.nextSeq = serialComm.getNextSeq();
+    savedState.firstUnackedSeq = serialComm.getFirstUnackedSeq();
+    savedState.lastAliveAt = serialComm.getTimestamp();
+    savedState.magic = RECOVERY_MAGIC;
+    savedState.crc = stateCrc(savedState);
+}
@@ -0,0 +1,236 @@
+/**
+ * @file ScopeStreamer.cpp
+ * @brief 生の入力のストリーミングクラスの実装
+ */
+
+#include "ScopeStreamer.h"
+
+#if SCOPE_FRAME_BYTES > 255
+#error "SCOPE_FRAME_BYTES must be 255 or less"
+#endif
+
+#if SCOPE_FRAME_EDGES < 1 || SCOPE_FRAME_EDGES > SCOPE_BUFFER_EDGES
+#error "SCOPE_FRAME_EDGES must be between 1 and SCOPE_BUFFER_EDGES"
+#endif
+
+ScopeStreamer::ScopeStreamer()
+    : active(false),
+      stopping(false),
+      buttonMask(0),
+      lastMask(0),
+      lastTick(0),
+      lost(0),
+      seenOverflows(0),
+      sentAt(0),
+      edgeHead(0),
+      edgeCount(0),
+      frameLength(0),
+      frameSent(0)
+{
+}
+
+void ScopeStreamer::start(uint8_t mask, uint8_t rawStates, const ButtonSampler &sampler,
+                          SerialCommunicator &serialComm)
+{
+    active = true;
+    stopping = false;
+    buttonMask = mask;
+    lastMask = rawStates & mask;
+    lost = 0;
+    seenOverflows = sampler.getOverflowCount();
+    edgeHead = 0;
+    edgeCount = 0;
+
+    buildFrame(sampler.getTick(), true, false, sampler, serialComm);
+    writeFrame(serialComm);
+}
+
+void ScopeStreamer::stop()
+{
+    if (active)
+    {
+        stopping = true;
+    }
+}
+
+bool ScopeStreamer::isActive() const
+{
+    return active || isSending();
+}
+
+bool ScopeStreamer::isSending() const
+{
+    return frameSent < frameLength;
+}
+
+void ScopeStreamer::record(uint32_t tick, uint8_t mask)
+{
+    if (!active || stopping)
+    {
+        return;
+    }
+
+    // 対象外のボタンだけが変化したサンプルは送らない
+    mask &= buttonMask;
+    if (mask == lastMask)
+    {
+        return;
+    }
+    lastMask = mask;
+
+    if (edgeCount == SCOPE_BUFFER_EDGES)
+    {
+        lost++;
+        return;
+    }
+    Edge &edge = edges[(edgeHead + edgeCount) % SCOPE_BUFFER_EDGES];
+    edge.tick = tick;
+    edge.mask = mask;
+    edgeCount++;
+}
+
+void ScopeStreamer::update(const ButtonSampler &sampler, SerialCommunicator &serialComm)
+{
+    if (isSending())
+    {
+        writeFrame(serialComm);
+        return;
+    }
+    if (!active)
+    {
+        return;
+    }
+
+    // FIFO が溢れている間の変化はサンプラーの時点で失われている
+    unsigned long overflows = sampler.getOverflowCount();
+    lost += overflows - seenOverflows;
+    seenOverflows = overflows;
+
+    // まとめ待ちのイベントがある間はそちらを先に送らせる
+    if (serialComm.getUnsentCount() > 0)
+    {
+        return;
+    }
+
+    uint32_t now = sampler.getTick();
+    if (edgeCount >= SCOPE_FRAME_EDGES ||
+        (edgeCount > 0 && (stopping || now - edges[edgeHead].tick >= sampler.msToTicks(SCOPE_FLUSH_MS))))
+    {
+        buildFrame(now, false, false, sampler, serialComm);
+    }
+    else if (stopping)
+    {
+        buildFrame(now, false, true, sampler, serialComm);
+        active = false;
+        stopping = false;
+    }
+    else if (millis() - sentAt >= SCOPE_IDLE_MS)
+    {
+        buildFrame(now, false, false, sampler, serialComm);
+    }
+    else
+    {
+        return;
+    }
+    writeFrame(serialComm);
+}
+
+void ScopeStreamer::buildFrame(uint32_t tick, bool start, bool end, const ButtonSampler &sampler,
+                               SerialCommunicator &serialComm)
+{
+    uint8_t count = edgeCount < SCOPE_FRAME_EDGES ? edgeCount : SCOPE_FRAME_EDGES;
+    size_t length = 0;
+    while (true)
+    {
+        FrameContent content = {this, tick, sampler.getSampleRate(), start, end, count};
+        length = serialComm.encodeFrame(writeContent, &content, frame, SCOPE_FRAME_BYTES);
+        if (length > 0 || count <= 1)
+        {
+            break;
+        }
+        // 差が大きく収まらない場合は変化を減らして作り直す
+        count--;
+    }
+
+    if (count == 0)
+    {
+        lastTick = tick;
+    }
+    else
+    {
+        lastTick = edges[(edgeHead + count - 1) % SCOPE_BUFFER_EDGES].tick;
+        edgeHead = (edgeHead + count) % SCOPE_BUFFER_EDGES;
+        edgeCount -= count;
+    }
+    sentAt = millis();
+
+    if (length == 0)
+    {
+        // SCOPE_FRAME_BYTES が小さすぎる設定（変化1つも入らない）: 入れようとした変化は失われる
+        lost += count;
+        frameLength = 0;
+        frameSent = 0;
+        return;
+    }
+
+    frameLength = (uint8_t)length;
+    frameSent = 0;
+    serialComm.holdOutput(true);
+}
+
+void ScopeStreamer::writeContent(JsonFrameWriter &writer, const void *context)
+{
+    const FrameContent &content = *static_cast<const FrameContent *>(context);
+    const ScopeStreamer &streamer = *content.streamer;
+
+    // 変化は [直前の変化からのサンプル数, 押下ビット] の組で表す（最初の変化は tick から）
+    writer.begin(F("scope"));
+    if (content.start)
+    {
+        writer.addBool(F("start"), true);
+        writer.add(F("rate"), content.rate);
+        writer.add(F("buttons"), MAX_BUTTONS);
+        writer.add(F("mask"), streamer.buttonMask);
+    }
+    if (content.end)
+    {
+        writer.addBool(F("end"), true);
+    }
+    uint32_t previous = content.start ? content.tick : streamer.lastTick;
+    writer.add(F("tick"), previous);
+    writer.beginArray(F("edges"));
+    if (content.count == 0)
+    {
+        writer.item(content.tick - previous);
+        writer.item(streamer.lastMask);
+    }
+    for (uint8_t i = 0; i < content.count; i++)
+    {
+        const Edge &edge = streamer.edges[(streamer.edgeHead + i) % SCOPE_BUFFER_EDGES];
+        writer.item(edge.tick - previous);
+        writer.item(edge.mask);
+        previous = edge.tick;
+    }
+    writer.endArray();
+    writer.add(F("lost"), streamer.lost);
+    writer.end();
+}
+
+void ScopeStreamer::writeFrame(SerialCommunicator &serialComm)
+{
+    // 送信バッファに入る分だけ書き出す（Serial.write() がブロックしないように）
+    int room = Serial.availableForWrite();
+    if (room <= 0)
+    {
+        return;
+    }
+    uint8_t remaining = frameLength - frameSent;
+    uint8_t chunk = (uint8_t)room < remaining ? (uint8_t)room : remaining;
+    Serial.write(frame + frameSent, chunk);
+    frameSent += chunk;
+
+    if (frameSent == frameLength)
+    {
+        serialComm.holdOutput(false);
+    }
+}
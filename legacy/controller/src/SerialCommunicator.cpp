@@ -5,16 +5,144 @@
 
 #include "SerialCommunicator.h"
 #include "config.h"
+#include <avr/wdt.h>
+#if ENABLE_COBS_FRAMING || ENABLE_BLACK_BOX
+#include <QuizFraming.h>
+#endif
+#if ENABLE_BLACK_BOX
+#include <string.h>
+#include "BlackBox.h"
+#endif
+
+namespace
+{
+/**
+ * @brief 書き出されたバイト列をバッファに溜める（容量を超えた分は捨てて溢れたことを覚える）
+ */
+class BufferPrint : public Print
+{
+public:
+    BufferPrint(uint8_t *buffer, size_t capacity) : data(buffer), size(capacity), length(0) {}
+
+    size_t write(uint8_t byte) override
+    {
+        if (length < size)
+        {
+            data[length] = byte;
+        }
+        length++;
+        return 1;
+    }
+
+    bool overflowed() const { return length > size; }
+
+    size_t getLength() const { return length; }
+
+private:
+    uint8_t *data;
+    size_t size;
+    size_t length;
+};
+
+#if ENABLE_COBS_FRAMING
+/**
+ * @brief 書き出されたバイト列の長さと CRC だけを求める（1回目のシリアライズ用）
+ */
+class ChecksumPrint : public Print
+{
+public:
+    size_t write(uint8_t byte) override
+    {
+        checksum.update(byte);
+        return 1;
+    }
+
+    FrameChecksum checksum;
+};
 
-SerialCommunicator::SerialCommunicator() : baudRate(9600)
+/**
+ * @brief 書き出されたバイト列を COBS で符号化してシリアルに送る（2回目のシリアライズ用）
+ */
+class FramePrint : public Print
+{
+public:
+    FramePrint(Print &output, const FrameChecksum &checksum)
+        : encoder(output, checksum.getLength(), checksum.getCrc())
+    {
+    }
+
+    size_t write(uint8_t byte) override
+    {
+        encoder.put(byte);
+        return 1;
+    }
+
+    void finish() { encoder.finish(); }
+
+private:
+    FrameEncoder<Print> encoder;
+};
+#endif
+
+#if ENABLE_WATCHDOG_RECOVERY
+/**
+ * @brief 書き出しながら WATCHDOG_RESET_BYTES ごとにウォッチドッグをリセットする
+ *
+ * 送信バッファが一杯の間 Serial.write() は待つため、大きなフレームを1回で書くとタイムアウトを超える
+ */
+class WatchdogPrint : public Print
+{
+public:
+    explicit WatchdogPrint(Print &output) : target(output), count(0) {}
+
+    size_t write(uint8_t byte) override
+    {
+        if (++count >= WATCHDOG_RESET_BYTES)
+        {
+            wdt_reset();
+            count = 0;
+        }
+        return target.write(byte);
+    }
+
+private:
+    Print &target;
+    uint8_t count;
+};
+#endif
+} // namespace
+
+SerialCommunicator::SerialCommunicator()
+    : baudRate(9600),
+      pendingHead(0),
+      pendingCount(0),
+      unsentCount(0),
+      batchStartedAt(0),
+      nextSeq(0),
+      currentRound(0),
+      peerAcks(false),
+      held(false),
+      retransmitAttempts(0),
+      retransmitCount(0),
+      droppedCount(0),
+#if ENABLE_BLACK_BOX
+      blackBox(nullptr),
+#endif
+      timeBase(0),
+      recoveryDowntime(0)
 {
 }
 
-void SerialCommunicator::init(int baud)
+void SerialCommunicator::init(int baud, bool waitForPort)
 {
     baudRate = baud;
     Serial.begin(baudRate);
 
+    if (!waitForPort)
+    {
+        return;
+    }
+
     // シリアルポートが接続されるまで待つ
     while (!Serial)
     {
@@ -26,54 +154,361 @@ void SerialCommunicator::init(int baud)
 
 unsigned long SerialCommunicator::getTimestamp() const
 {
-    return millis();
+    return millis() + timeBase;
+}
+
+SerialCommunicator::PendingEvent &SerialCommunicator::pendingAt(uint8_t index)
+{
+    return pending[(pendingHead + index) % RETRANSMIT_WINDOW];
+}
+
+uint16_t SerialCommunicator::emit(EventType type, uint8_t buttonId, const __FlashStringHelper *message, unsigned long capturedAt)
+{
+    PendingEvent event;
+    event.type = type;
+    event.buttonId = buttonId;
+    event.round = currentRound;
+    event.timestamp = getTimestamp();
+    event.message = message;
+#if ENABLE_LATENCY_TRACE
+    event.capturedAt = capturedAt;
+#endif
+    return post(event);
+}
+
+uint16_t SerialCommunicator::post(PendingEvent &event)
+{
+    event.seq = nextSeq++;
+    event.lastSentAt = getTimestamp();
+#if ENABLE_LATENCY_TRACE
+    event.committedAt = micros();
+#endif
+#if ENABLE_BLACK_BOX
+    recordEvent(event, false);
+#endif
+
+    // 押下以外のイベントは、順序を保つためまとめ待ちの押下を先に送る
+    if (event.type != EVENT_BUTTON_PRESS && unsentCount > 0 && !held)
+    {
+        flush();
+    }
+
+    enqueue(event);
+
+    if (event.type == EVENT_BUTTON_PRESS)
+    {
+        if (unsentCount == 1)
+        {
+            batchStartedAt = event.timestamp;
+        }
+        if (PRESS_BATCH_WINDOW == 0 && !held)
+        {
+            flush();
+        }
+        return event.seq;
+    }
+
+    // 保留中は holdOutput(false) でまとめて送る
+    if (!held)
+    {
+        flush();
+    }
+    return event.seq;
+}
+
+void SerialCommunicator::enqueue(const PendingEvent &event)
+{
+    if (pendingCount == RETRANSMIT_WINDOW)
+    {
+        if (unsentCount == pendingCount && !held)
+        {
+            flush();
+        }
+        if (pendingCount == RETRANSMIT_WINDOW)
+        {
+            // ウィンドウが満杯の場合は最古のイベントを破棄（ホストは番号の欠落で検知できる）
+#if ENABLE_BLACK_BOX
+            recordEvent(pendingAt(0), true);
+#endif
+            pendingHead = (pendingHead + 1) % RETRANSMIT_WINDOW;
+            pendingCount--;
+            droppedCount++;
+        }
+    }
+    pendingAt(pendingCount) = event;
+    pendingCount++;
+    unsentCount++;
+}
+
+#if ENABLE_LATENCY_TRACE
+void SerialCommunicator::addTrace(JsonDocument &doc, uint8_t first, uint8_t count)
+{
+    // 送信バッファに残っている分を送り終えてからこのフレームの送信が始まる
+    unsigned long encodedAt = micros();
+    unsigned long backlog = (SERIAL_TX_BUFFER_SIZE - 1) - Serial.availableForWrite();
+    unsigned long txStartAt = encodedAt + backlog * 10000000UL / baudRate; // 1バイト = 10ビット
+
+    JsonArray trace = doc[F("trace")].to<JsonArray>();
+    trace.add(encodedAt);
+    trace.add(txStartAt);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const PendingEvent &event = pendingAt(first + i);
+        trace.add(event.capturedAt);
+        trace.add(event.committedAt);
+    }
 }
+#endif
 
-void SerialCommunicator::sendButtonPress(int buttonId)
+void SerialCommunicator::writeEvent(uint8_t index)
 {
+    const PendingEvent &event = pendingAt(index);
+
     // JSON ドキュメントを作成（スタック上に確保）
     JsonDocument doc;
 
-    doc["type"] = "pressedButton";
-    doc["buttonId"] = buttonId;
-    doc["timestamp"] = getTimestamp();
+    switch (event.type)
+    {
+    case EVENT_BUTTON_PRESS:
+        doc[F("type")] = F("pressedButton");
+        doc[F("buttonId")] = event.buttonId;
+        doc[F("round")] = event.round;
+        break;
+    case EVENT_SYSTEM_RESET:
+        doc[F("type")] = F("systemReset");
+        doc[F("round")] = event.round;
+        break;
+    case EVENT_ERROR:
+        doc[F("type")] = F("error");
+        doc[F("message")] = event.message;
+        break;
+    case EVENT_SYSTEM_READY:
+        doc[F("type")] = F("systemReady");
+        doc[F("version")] = F("1.0.0");
+        break;
+    case EVENT_RECOVERED:
+        doc[F("type")] = F("recovered");
+        doc[F("reason")] = event.message;
+        doc[F("downtime")] = recoveryDowntime;
+        break;
+    case EVENT_ARMED:
+        doc[F("type")] = F("armed");
+        doc[F("round")] = event.round;
+        break;
+    case EVENT_FALSE_START:
+        doc[F("type")] = F("falseStart");
+        doc[F("buttonId")] = event.buttonId;
+        doc[F("round")] = event.round;
+        break;
+    case EVENT_ANSWER_TIMEOUT:
+        doc[F("type")] = F("answerTimeout");
+        doc[F("buttonId")] = event.buttonId;
+        doc[F("round")] = event.round;
+        break;
+    case EVENT_GESTURE:
+        doc[F("type")] = F("gesture");
+        doc[F("buttonId")] = event.buttonId;
+        doc[F("gesture")] = event.message;
+#if ENABLE_GESTURES
+        doc[F("taps")] = event.taps;
+        doc[F("hold")] = event.hold;
+        doc[F("total")] = event.total;
+#endif
+        doc[F("round")] = event.round;
+        break;
+    }
+    doc[F("timestamp")] = event.timestamp;
+#if ENABLE_RELIABLE_DELIVERY
+    doc[F("seq")] = event.seq;
+#endif
+#if ENABLE_LATENCY_TRACE
+    addTrace(doc, index, 1);
+#endif
 
     // シリアルに送信
-    serializeJson(doc, Serial);
-    Serial.println(); // 改行を追加
+    writeFrame(doc);
+}
+
+void SerialCommunicator::writePressBatch(uint8_t first, uint8_t count)
+{
+    const PendingEvent &head = pendingAt(first);
+
+    // 各押下は [ボタンID, 先頭からの経過ミリ秒] の組で表す（送信順 = 押下順）
+    JsonDocument doc;
+    doc[F("type")] = F("pressedButtons");
+    doc[F("round")] = head.round;
+    doc[F("timestamp")] = head.timestamp;
+    JsonArray presses = doc[F("presses")].to<JsonArray>();
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const PendingEvent &event = pendingAt(first + i);
+        JsonArray press = presses.add<JsonArray>();
+        press.add(event.buttonId);
+        press.add(event.timestamp - head.timestamp);
+    }
+#if ENABLE_RELIABLE_DELIVERY
+    doc[F("seq")] = head.seq; // 先頭の番号（以降は連番）
+#endif
+#if ENABLE_LATENCY_TRACE
+    addTrace(doc, first, count);
+#endif
+
+    writeFrame(doc);
+}
+
+void SerialCommunicator::writeRange(uint8_t first, uint8_t count)
+{
+    uint8_t end = first + count;
+    uint8_t i = first;
+    while (i < end)
+    {
+        // 連続した押下イベントを数える（復帰時に戻した押下は番号が飛ぶことがあるので、連番の範囲に限る）
+        // リセットをまたいだ押下はラウンド番号が異なるため別のフレームにする
+        uint8_t run = 1;
+        if (pendingAt(i).type == EVENT_BUTTON_PRESS)
+        {
+            while (i + run < end && pendingAt(i + run).type == EVENT_BUTTON_PRESS &&
+                   pendingAt(i + run).seq == (uint16_t)(pendingAt(i).seq + run) &&
+                   pendingAt(i + run).round == pendingAt(i).round)
+            {
+                run++;
+            }
+        }
+
+        if (run == 1)
+        {
+            writeEvent(i);
+        }
+        else
+        {
+            writePressBatch(i, run);
+        }
+
+        unsigned long now = getTimestamp();
+        for (uint8_t j = 0; j < run; j++)
+        {
+            pendingAt(i + j).lastSentAt = now;
+        }
+        i += run;
+    }
+}
+
+void SerialCommunicator::flush()
+{
+    if (unsentCount == 0)
+    {
+        return;
+    }
+
+    writeRange(pendingCount - unsentCount, unsentCount);
+    unsentCount = 0;
+    releaseSent();
+}
+
+void SerialCommunicator::releaseSent()
+{
+#if !ENABLE_RELIABLE_DELIVERY
+    // ACKを使わない場合、送信済みのイベントを保持する必要はない
+    pendingHead = (pendingHead + pendingCount - unsentCount) % RETRANSMIT_WINDOW;
+    pendingCount = unsentCount;
+#endif
+}
+
+void SerialCommunicator::update()
+{
+    // 保留中は書き出さない（再送のタイムアウトも保留が解けてから判定する）
+    if (held)
+    {
+        return;
+    }
+
+    // まとめ待ちの時間が経過した押下を送信
+    if (unsentCount > 0 && (getTimestamp() - batchStartedAt) >= PRESS_BATCH_WINDOW)
+    {
+        flush();
+    }
+
+#if ENABLE_RELIABLE_DELIVERY
+    uint8_t sentCount = pendingCount - unsentCount;
+
+    // ACKに対応していないホストには再送しない（重複イベントを避ける）
+    // 上限まで再送しても ACK が来ない場合は、ホストが応答するまで（ACK・RESYNC）回線を埋めない
+    if (!peerAcks || sentCount == 0 || retransmitAttempts >= RETRANSMIT_MAX_ATTEMPTS)
+    {
+        return;
+    }
+
+    // 最古のイベントがタイムアウトしたら、受信側の順序を保つため送信済み分を全て再送
+    // 待ち時間は再送するたびに2倍にする（500, 1000, 2000, ... ミリ秒）
+    if ((getTimestamp() - pendingAt(0).lastSentAt) >= ((unsigned long)RETRANSMIT_TIMEOUT << retransmitAttempts))
+    {
+        writeRange(0, sentCount);
+        retransmitCount += sentCount;
+        retransmitAttempts++;
+    }
+#endif
+}
+
+void SerialCommunicator::acknowledge(uint16_t seq)
+{
+    peerAcks = true;
+    retransmitAttempts = 0;
+
+    // 累積ACK: seq 以前の送信済みイベントを全てウィンドウから外す
+    while (pendingCount > unsentCount && (int16_t)(seq - pendingAt(0).seq) >= 0)
+    {
+        pendingHead = (pendingHead + 1) % RETRANSMIT_WINDOW;
+        pendingCount--;
+    }
+}
+
+void SerialCommunicator::resync()
+{
+    peerAcks = true;
+    retransmitAttempts = 0;
+
+    // 再送の起点を先に通知する（これより前の番号は既に破棄済み）
+    JsonDocument doc;
+    doc[F("type")] = F("resync");
+    doc[F("from")] = (uint16_t)(pendingCount > 0 ? pendingAt(0).seq : nextSeq);
+    doc[F("timestamp")] = getTimestamp();
+    writeFrame(doc);
+
+    // まとめ待ちの押下も含めて全て送る
+    writeRange(0, pendingCount);
+    unsentCount = 0;
+    releaseSent();
+}
+
+void SerialCommunicator::setRound(uint16_t round)
+{
+    currentRound = round;
+}
+
+uint16_t SerialCommunicator::sendButtonPress(int buttonId, unsigned long capturedAt)
+{
+    uint16_t seq = emit(EVENT_BUTTON_PRESS, buttonId, nullptr, capturedAt);
 
 #if ENABLE_DEBUG_OUTPUT
     Serial.print(F("[DEBUG] Button "));
     Serial.print(buttonId);
     Serial.println(F(" pressed"));
 #endif
+    return seq;
 }
 
 void SerialCommunicator::sendSystemReset()
 {
-    JsonDocument doc;
-
-    doc["type"] = "systemReset";
-    doc["timestamp"] = getTimestamp();
-
-    serializeJson(doc, Serial);
-    Serial.println();
+    emit(EVENT_SYSTEM_RESET, 0, nullptr);
 
 #if ENABLE_DEBUG_OUTPUT
     Serial.println(F("[DEBUG] System reset"));
 #endif
 }
 
-void SerialCommunicator::sendError(const char *errorMessage)
+void SerialCommunicator::sendError(const __FlashStringHelper *errorMessage)
 {
-    JsonDocument doc;
-
-    doc["type"] = "error";
-    doc["message"] = errorMessage;
-    doc["timestamp"] = getTimestamp();
-
-    serializeJson(doc, Serial);
-    Serial.println();
+    emit(EVENT_ERROR, 0, errorMessage);
 
 #if ENABLE_DEBUG_OUTPUT
     Serial.print(F("[DEBUG] Error: "));
@@ -83,30 +518,290 @@ void SerialCommunicator::sendError(const char *errorMessage)
 
 void SerialCommunicator::sendSystemReady()
 {
-    JsonDocument doc;
+    emit(EVENT_SYSTEM_READY, 0, nullptr);
 
-    doc["type"] = "systemReady";
-    doc["timestamp"] = getTimestamp();
-    doc["version"] = "1.0.0";
+#if ENABLE_DEBUG_OUTPUT
+    Serial.println(F("[DEBUG] System ready"));
+#endif
+}
 
-    serializeJson(doc, Serial);
-    Serial.println();
+void SerialCommunicator::sendRecovered(const __FlashStringHelper *reason, unsigned long downtime)
+{
+    recoveryDowntime = downtime;
+    emit(EVENT_RECOVERED, 0, reason);
 
 #if ENABLE_DEBUG_OUTPUT
-    Serial.println(F("[DEBUG] System ready"));
+    Serial.print(F("[DEBUG] Recovered from "));
+    Serial.println(reason);
+#endif
+}
+
+void SerialCommunicator::sendArmed()
+{
+    emit(EVENT_ARMED, 0, nullptr);
+
+#if ENABLE_DEBUG_OUTPUT
+    Serial.println(F("[DEBUG] Round armed"));
+#endif
+}
+
+void SerialCommunicator::sendFalseStart(uint8_t buttonId)
+{
+    emit(EVENT_FALSE_START, buttonId, nullptr);
+
+#if ENABLE_DEBUG_OUTPUT
+    Serial.print(F("[DEBUG] False start: button "));
+    Serial.println(buttonId);
+#endif
+}
+
+void SerialCommunicator::sendAnswerTimeout(uint8_t buttonId)
+{
+    emit(EVENT_ANSWER_TIMEOUT, buttonId, nullptr);
+
+#if ENABLE_DEBUG_OUTPUT
+    Serial.print(F("[DEBUG] Answer timeout: button "));
+    Serial.println(buttonId);
+#endif
+}
+
+void SerialCommunicator::sendGesture(uint8_t buttonId, bool longPress, uint8_t taps, uint16_t hold, uint16_t total,
+                                     unsigned long releasedAt)
+{
+    PendingEvent event;
+    event.type = EVENT_GESTURE;
+    event.buttonId = buttonId;
+    event.round = currentRound;
+    event.timestamp = releasedAt;
+    event.message = longPress ? F("long") : F("tap");
+#if ENABLE_GESTURES
+    event.taps = taps;
+    event.hold = hold;
+    event.total = total;
+#else
+    (void)taps;
+    (void)hold;
+    (void)total;
+#endif
+#if ENABLE_LATENCY_TRACE
+    event.capturedAt = 0; // 1回の押下ではないため区間に分けない
+#endif
+    post(event);
+
+#if ENABLE_DEBUG_OUTPUT
+    Serial.print(F("[DEBUG] Gesture: button "));
+    Serial.print(buttonId);
+    Serial.print(longPress ? F(" long x") : F(" tap x"));
+    Serial.println(taps);
+#endif
+}
+
+void SerialCommunicator::resume(uint16_t seq, unsigned long timestamp)
+{
+    nextSeq = seq;
+    timeBase = timestamp - millis();
+}
+
+void SerialCommunicator::requeuePress(uint16_t seq, uint8_t buttonId, uint16_t round, unsigned long timestamp)
+{
+    PendingEvent event;
+    event.seq = seq;
+    event.type = EVENT_BUTTON_PRESS;
+    event.buttonId = buttonId;
+    event.round = round;
+    event.timestamp = timestamp;
+    event.message = nullptr;
+    event.lastSentAt = getTimestamp();
+#if ENABLE_LATENCY_TRACE
+    event.capturedAt = 0; // リセット前の時刻は micros() の時間軸が異なるため不明とする
+    event.committedAt = 0;
+#endif
+
+    // 次の復帰イベントと一緒に送信される
+    enqueue(event);
+}
+
+void SerialCommunicator::setBlackBox(BlackBox *box)
+{
+#if ENABLE_BLACK_BOX
+    blackBox = box;
+#else
+    (void)box;
+#endif
+}
+
+#if ENABLE_BLACK_BOX
+void SerialCommunicator::recordEvent(const PendingEvent &event, bool dropped)
+{
+    if (blackBox == nullptr)
+    {
+        return;
+    }
+
+    uint8_t type = BLACK_BOX_DROPPED;
+    uint16_t detail = 0;
+    if (!dropped)
+    {
+        switch (event.type)
+        {
+        case EVENT_BUTTON_PRESS:
+            type = BLACK_BOX_PRESS;
+            break;
+        case EVENT_SYSTEM_RESET:
+            type = BLACK_BOX_RESET;
+            break;
+        case EVENT_ERROR:
+            // メッセージは残さず CRC だけを記録する（ホストが既知のメッセージと照合する）
+            type = BLACK_BOX_ERROR;
+            detail = 0xFFFF;
+            for (PGM_P p = reinterpret_cast<PGM_P>(event.message); pgm_read_byte(p) != 0; p++)
+            {
+                detail = frameCrc16Update(detail, pgm_read_byte(p));
+            }
+            break;
+        case EVENT_SYSTEM_READY:
+            type = BLACK_BOX_READY;
+            break;
+        case EVENT_RECOVERED:
+            type = BLACK_BOX_RECOVERED;
+            detail = recoveryDowntime > 0xFFFF ? 0xFFFF : (uint16_t)recoveryDowntime;
+            break;
+        case EVENT_ARMED:
+            type = BLACK_BOX_ARMED;
+            break;
+        case EVENT_FALSE_START:
+            type = BLACK_BOX_FALSE_START;
+            break;
+        case EVENT_ANSWER_TIMEOUT:
+            type = BLACK_BOX_ANSWER_TIMEOUT;
+            break;
+        case EVENT_GESTURE:
+            type = BLACK_BOX_GESTURE;
+#if ENABLE_GESTURES
+            {
+                // 上位4ビットに押下回数、下位12ビットに最後の押下の長さ（10ミリ秒単位）
+                uint16_t hold = event.hold / 10;
+                detail = (uint16_t)((event.taps > 15 ? 15 : event.taps) << 12) | (hold > 0x0FFF ? 0x0FFF : hold);
+            }
+#endif
+            break;
+        }
+    }
+    blackBox->record(type, event.buttonId, event.round, event.seq, event.timestamp, detail);
+}
+#endif
+
+void SerialCommunicator::holdOutput(bool hold)
+{
+    held = hold;
+
+    // 保留中に溜まったイベントはまとめ待ちの時間に関係なくすぐに送る
+    if (!held && unsentCount > 0)
+    {
+        flush();
+    }
+}
+
+void SerialCommunicator::printFrame(const JsonDocument &doc, Print &output)
+{
+#if ENABLE_COBS_FRAMING
+    // 長さと CRC を先に求めてから符号化する（バッファを使わないため2回シリアライズする）
+    ChecksumPrint checksum;
+    serializeJson(doc, checksum);
+    FramePrint frame(output, checksum.checksum);
+    serializeJson(doc, frame);
+    frame.finish();
+#else
+    serializeJson(doc, output);
+    output.println();
 #endif
 }
 
-void SerialCommunicator::sendDebug(const char *message)
+void SerialCommunicator::printFrame(FrameBody body, const void *context, Print &output)
+{
+#if ENABLE_COBS_FRAMING
+    ChecksumPrint checksum;
+    JsonFrameWriter measure(checksum);
+    body(measure, context);
+    FramePrint frame(output, checksum.checksum);
+    JsonFrameWriter writer(frame);
+    body(writer, context);
+    frame.finish();
+#else
+    JsonFrameWriter writer(output);
+    body(writer, context);
+    output.println();
+#endif
+}
+
+void SerialCommunicator::writeFrame(const JsonDocument &doc) const
+{
+#if ENABLE_WATCHDOG_RECOVERY
+    // 再送ウィンドウ全体やコマンドの応答の書き出しでリセットされないように、書きながらリセットする
+    WatchdogPrint output(Serial);
+    printFrame(doc, output);
+#else
+    printFrame(doc, Serial);
+#endif
+}
+
+void SerialCommunicator::writeFrame(FrameBody body, const void *context) const
+{
+#if ENABLE_WATCHDOG_RECOVERY
+    WatchdogPrint output(Serial);
+    printFrame(body, context, output);
+#else
+    printFrame(body, context, Serial);
+#endif
+}
+
+size_t SerialCommunicator::encodeFrame(FrameBody body, const void *context, uint8_t *buffer, size_t capacity) const
+{
+    BufferPrint output(buffer, capacity);
+    printFrame(body, context, output);
+    return output.overflowed() ? 0 : output.getLength();
+}
+
+void SerialCommunicator::sendDebug(const __FlashStringHelper *message)
 {
 #if ENABLE_DEBUG_OUTPUT
     JsonDocument doc;
 
-    doc["type"] = "debug";
-    doc["message"] = message;
-    doc["timestamp"] = getTimestamp();
+    doc[F("type")] = F("debug");
+    doc[F("message")] = message;
+    doc[F("timestamp")] = getTimestamp();
 
-    serializeJson(doc, Serial);
-    Serial.println();
+    writeFrame(doc);
 #endif
 }
+
+uint8_t SerialCommunicator::getPendingCount() const
+{
+    return pendingCount;
+}
+
+uint8_t SerialCommunicator::getUnsentCount() const
+{
+    return unsentCount;
+}
+
+uint16_t SerialCommunicator::getNextSeq() const
+{
+    return nextSeq;
+}
+
+uint16_t SerialCommunicator::getFirstUnackedSeq() const
+{
+    // const 版の pendingAt() はないため直接参照する
+    return pendingCount > 0 ? pending[pendingHead].seq : nextSeq;
+}
+
+unsigned long SerialCommunicator::getRetransmitCount() const
+{
+    return retransmitCount;
+}
+
+unsigned long SerialCommunicator::getDroppedCount() const
+{
+    return droppedCount;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file StatePublisher.cpp
+ * @brief 状態の購読クラスの実装
+ */
+
+#include "StatePublisher.h"
+
+StatePublisher::StatePublisher()
+    : subscribed(false),
+      version(0),
+      sentActive(false),
+      sentRound(0),
+      sentPressCount(0),
+      lastDeltaAt(0),
+      lastHeartbeatAt(0)
+{
+}
+
+void StatePublisher::subscribe(const ButtonManager &buttonManager, const SerialCommunicator &serialComm)
+{
+    subscribed = true;
+    version++;
+
+    unsigned long now = serialComm.getTimestamp();
+    send(F("state"), FIELD_ACTIVE | FIELD_ROUND | FIELD_PRESSED | FIELD_PREVIOUS | FIELD_HEALTH,
+         buttonManager, serialComm, now);
+
+    remember(buttonManager);
+    lastDeltaAt = now;
+    lastHeartbeatAt = lastDeltaAt;
+}
+
+void StatePublisher::unsubscribe()
+{
+    subscribed = false;
+}
+
+bool StatePublisher::isSubscribed() const
+{
+    return subscribed;
+}
+
+void StatePublisher::update(const ButtonManager &buttonManager, const SerialCommunicator &serialComm)
+{
+    if (!subscribed)
+    {
+        return;
+    }
+
+    unsigned long now = serialComm.getTimestamp();
+    bool activeChanged = buttonManager.isSystemActive() != sentActive;
+    bool roundChanged = buttonManager.getRound() != sentRound;
+    bool pressedChanged = roundChanged || buttonManager.getPressCount() != sentPressCount;
+
+    // 押下イベントの送信を優先し、短時間の変化は1つの差分にまとめる
+    if ((activeChanged || pressedChanged) && serialComm.getUnsentCount() == 0 &&
+        now - lastDeltaAt >= STATE_DELTA_MIN_INTERVAL)
+    {
+        version++;
+
+        uint8_t fields = 0;
+        if (activeChanged)
+        {
+            fields |= FIELD_ACTIVE;
+        }
+        if (roundChanged)
+        {
+            fields |= FIELD_ROUND | FIELD_PREVIOUS;
+        }
+        if (pressedChanged)
+        {
+            fields |= FIELD_PRESSED;
+        }
+        send(F("stateDelta"), fields, buttonManager, serialComm, now);
+
+        remember(buttonManager);
+        lastDeltaAt = now;
+        return;
+    }
+
+    if (now - lastHeartbeatAt >= STATE_HEARTBEAT_INTERVAL)
+    {
+        send(F("heartbeat"), FIELD_HEALTH, buttonManager, serialComm, now);
+
+        lastHeartbeatAt = now;
+    }
+}
+
+void StatePublisher::send(const __FlashStringHelper *type, uint8_t fields, const ButtonManager &buttonManager,
+                          const SerialCommunicator &serialComm, unsigned long timestamp)
+{
+    Message message;
+    message.type = type;
+    message.fields = fields;
+    message.version = version;
+    message.buttonManager = &buttonManager;
+    message.missedDeadlines = buttonManager.getSampler().getMissedDeadlineCount();
+    message.sampleOverflows = buttonManager.getSampler().getOverflowCount();
+    message.pending = serialComm.getPendingCount();
+    message.retransmits = serialComm.getRetransmitCount();
+    message.dropped = serialComm.getDroppedCount();
+    message.timestamp = timestamp;
+
+    serialComm.writeFrame(writeMessage, &message);
+}
+
+void StatePublisher::writeMessage(JsonFrameWriter &writer, const void *context)
+{
+    const Message &message = *static_cast<const Message *>(context);
+    const ButtonManager &buttonManager = *message.buttonManager;
+
+    writer.begin(message.type);
+    writer.add(F("version"), message.version);
+    if (message.fields & FIELD_ACTIVE)
+    {
+        writer.addBool(F("active"), buttonManager.isSystemActive());
+    }
+    if (message.fields & FIELD_ROUND)
+    {
+        writer.add(F("round"), buttonManager.getRound());
+    }
+    if (message.fields & FIELD_PRESSED)
+    {
+        // 現在のラウンドの押下順（ボタンID）
+        writer.beginArray(F("pressed"));
+        for (uint8_t i = 0; i < buttonManager.getPressCount(); i++)
+        {
+            writer.item(buttonManager.getPressedButton(i));
+        }
+        writer.endArray();
+    }
+    if (message.fields & FIELD_PREVIOUS)
+    {
+        // 直前のラウンドの確定した押下順（リセットの前後で押下イベントを取りこぼした場合の照合用）
+        const RoundSlot<MAX_BUTTONS> &previous = buttonManager.getPreviousRound();
+        writer.add(F("previousRound"), previous.id);
+        writer.beginArray(F("previousPressed"));
+        for (uint8_t i = 0; i < previous.pressCount; i++)
+        {
+            writer.item(previous.order[i]);
+        }
+        writer.endArray();
+    }
+    if (message.fields & FIELD_HEALTH)
+    {
+        writer.add(F("missedDeadlines"), message.missedDeadlines);
+        writer.add(F("sampleOverflows"), message.sampleOverflows);
+        writer.add(F("pending"), message.pending);
+        writer.add(F("retransmits"), message.retransmits);
+        writer.add(F("dropped"), message.dropped);
+    }
+    writer.add(F("timestamp"), message.timestamp);
+    writer.end();
+}
+
+void StatePublisher::remember(const ButtonManager &buttonManager)
+{
+    sentActive = buttonManager.isSystemActive();
+    sentRound = buttonManager.getRound();
+    sentPressCount = buttonManager.getPressCount();
+}
@@ -0,0 +1,102 @@
+/**
+ * @file TriggerInput.cpp
+ * @brief ラウンド開始のトリガー入力クラスの実装
+ */
+
+#include "TriggerInput.h"
+#include <util/atomic.h>
+
+// 無効の場合はピン変化割り込みのベクタも使わない
+#if ENABLE_TRIGGER_INPUT
+
+// ボタン（A0-A5）・LED（D2-D7）・シリアル（D0-D1）と割り込みを共有しないよう D8-D13 に限る
+#if TRIGGER_PIN < 8 || TRIGGER_PIN > 13
+#error "TRIGGER_PIN must be one of D8-D13"
+#endif
+
+#if TRIGGER_PIN == CALIBRATION_PIN
+#error "TRIGGER_PIN must differ from CALIBRATION_PIN"
+#endif
+
+TriggerInput *TriggerInput::instance = nullptr;
+
+TriggerInput::TriggerInput()
+    : sampler(nullptr),
+      waiting(false),
+      triggered(false),
+      edgeTick(0)
+{
+}
+
+void TriggerInput::begin(const ButtonSampler &buttonSampler)
+{
+    sampler = &buttonSampler;
+    instance = this;
+
+    // ボタンと同じく LOW で有効（司会のスイッチや合図の回路が GND に引く）
+    pinMode(TRIGGER_PIN, INPUT_PULLUP);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *digitalPinToPCMSK(TRIGGER_PIN) |= _BV(digitalPinToPCMSKbit(TRIGGER_PIN));
+        PCIFR = _BV(digitalPinToPCICRbit(TRIGGER_PIN));
+        *digitalPinToPCICR(TRIGGER_PIN) |= _BV(digitalPinToPCICRbit(TRIGGER_PIN));
+    }
+}
+
+void TriggerInput::enable()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        triggered = false;
+        waiting = true;
+    }
+}
+
+void TriggerInput::disable()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        triggered = false;
+        waiting = false;
+    }
+}
+
+bool TriggerInput::poll(uint32_t &tick)
+{
+    bool available = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (triggered)
+        {
+            tick = edgeTick;
+            triggered = false;
+            available = true;
+        }
+    }
+    return available;
+}
+
+void TriggerInput::handleEdge()
+{
+    // ピン変化割り込みは両方のエッジで入るため、LOW になった方だけを扱う
+    if (!waiting || (*portInputRegister(digitalPinToPort(TRIGGER_PIN)) & digitalPinToBitMask(TRIGGER_PIN)))
+    {
+        return;
+    }
+
+    // このエッジを最初に見るのは次のサンプル（同じサンプルで押下が確定したボタンはフライングではない）
+    edgeTick = sampler->getTick() + 1;
+    triggered = true;
+    waiting = false;
+}
+
+ISR(PCINT0_vect)
+{
+    if (TriggerInput::instance != nullptr)
+    {
+        TriggerInput::instance->handleEdge();
+    }
+}
+
+#endif // ENABLE_TRIGGER_INPUT
@@ -15,12 +15,43 @@
 #include "ButtonConfig.h"
 #include "ButtonManager.h"
 #include "SerialCommunicator.h"
+#include "RecoveryStore.h"
+#include "StatePublisher.h"
+#include "LatencyCalibrator.h"
+#include "ReactionStats.h"
+#include "DebounceLearner.h"
+#include "ScopeStreamer.h"
+#include "BlackBox.h"
+#include "AnswerTimer.h"
 #include "Logger.hpp"
+#include <avr/wdt.h>
+
+#if ENABLE_SCOPE + ENABLE_BLACK_BOX + ENABLE_REACTION_STATS > 1
+#warning "Enabling more than one of ENABLE_SCOPE, ENABLE_BLACK_BOX and ENABLE_REACTION_STATS is estimated to exceed the Uno's 2 KB RAM"
+#endif
 
 // ===== グローバルオブジェクト =====
 ButtonConfig buttonConfig;
 SerialCommunicator serialComm;
 ButtonManager buttonManager(&buttonConfig, &serialComm);
+RecoveryStore recoveryStore;
+StatePublisher statePublisher;
+LatencyCalibrator latencyCalibrator;
+#if ENABLE_REACTION_STATS
+ReactionStats reactionStats;
+#endif
+#if ENABLE_ADAPTIVE_DEBOUNCE
+DebounceLearner debounceLearner;
+#endif
+#if ENABLE_SCOPE
+ScopeStreamer scopeStreamer;
+#endif
+#if ENABLE_BLACK_BOX
+BlackBox blackBox;
+#endif
+#if ENABLE_ANSWER_TIMER
+AnswerTimer answerTimer;
+#endif
 Logger logger = Logger("Main");
 
 // ===== リセット用の変数 =====
@@ -30,6 +61,104 @@ const unsigned long RESET_CHECK_INTERVAL = 100; // リセットチェック間
 // ===== シリアルコマンド処理用バッファ =====
 String inputBuffer = "";
 
+// ===== 空き RAM の計測 =====
+extern char __heap_start;
+extern char *__brkval;
+const uint8_t FREE_RAM_PAINT = 0xA5; // 未使用の RAM に書いておく値
+
+/**
+ * @brief ヒープの終わりからスタックまでの未使用の RAM を FREE_RAM_PAINT で埋める（setup() の最初に呼ぶ）
+ */
+void paintFreeRam()
+{
+    uint8_t *p = reinterpret_cast<uint8_t *>(__brkval != nullptr ? __brkval : &__heap_start);
+    uint8_t *end = reinterpret_cast<uint8_t *>(SP) - 32; // この関数と割り込みのスタックを残す
+    while (p < end)
+    {
+        *p++ = FREE_RAM_PAINT;
+    }
+}
+
+/**
+ * @brief 起動後に一度も使われていない RAM のバイト数を取得
+ *
+ * ヒープとスタックの間で FREE_RAM_PAINT のまま残っている最長の範囲を数える
+ * （ヒープとスタックが最も近づいたときの空き）
+ * @return バイト数
+ */
+unsigned int getMinFreeRam()
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&__heap_start);
+    const uint8_t *end = reinterpret_cast<const uint8_t *>(SP);
+    unsigned int longest = 0;
+    unsigned int run = 0;
+    for (; p < end; p++)
+    {
+        run = *p == FREE_RAM_PAINT ? run + 1 : 0;
+        if (run > longest)
+        {
+            longest = run;
+        }
+    }
+    return longest;
+}
+
+/**
+ * @brief 受信したコマンドが command と一致するか（コマンド名はフラッシュに置き、RAM にコピーしない）
+ * @param command コマンド（F() の文字列）
+ * @return 一致すれば true
+ */
+bool commandIs(const __FlashStringHelper *command)
+{
+    return strcmp_P(inputBuffer.c_str(), reinterpret_cast<PGM_P>(command)) == 0;
+}
+
+/**
+ * @brief 受信したコマンドが prefix で始まるか
+ * @param prefix コマンドの先頭（F() の文字列）
+ * @return 始まれば true
+ */
+bool commandStartsWith(const __FlashStringHelper *prefix)
+{
+    PGM_P text = reinterpret_cast<PGM_P>(prefix);
+    return strncmp_P(inputBuffer.c_str(), text, strlen_P(text)) == 0;
+}
+
+// STATUS の応答（COBS では本文を2回書くため、割り込みで変わる値と空き RAM は先に読んでおく）
+struct StatusReply
+{
+    unsigned long missedDeadlines;
+    unsigned long sampleOverflows;
+    uint16_t isrCycles;
+    unsigned int ramFree;
+    unsigned long timestamp;
+};
+
+/**
+ * @brief STATUS の応答の本文を書く（SerialCommunicator::FrameBody）
+ *
+ * JsonDocument を使わないため、応答の大きさがヒープの使用量に影響しない
+ * @param writer 書き出し先
+ * @param context 応答の値（StatusReply）
+ */
+void writeStatus(JsonFrameWriter &writer, const void *context)
+{
+    const StatusReply &reply = *static_cast<const StatusReply *>(context);
+    writer.begin(F("status"));
+    writer.addBool(F("active"), buttonManager.isSystemActive());
+    writer.addBool(F("pressed"), buttonManager.isButtonPressed());
+    writer.addSigned(F("firstButton"), buttonManager.getFirstPressedButton());
+#if ENABLE_TRIGGER_INPUT
+    writer.addBool(F("waitingForTrigger"), buttonManager.isWaitingForTrigger());
+#endif
+    writer.add(F("missedDeadlines"), reply.missedDeadlines);
+    writer.add(F("sampleOverflows"), reply.sampleOverflows);
+    writer.add(F("isrCycles"), reply.isrCycles);
+    writer.add(F("ramFree"), reply.ramFree);
+    writer.add(F("timestamp"), reply.timestamp);
+    writer.end();
+}
+
 /**
  * @brief シリアルコマンドを処理
  *
@@ -37,6 +166,25 @@ String inputBuffer = "";
  * - "RESET": システムをリセット
  * - "STATUS": 現在の状態を送信
  * - "CONFIG": 設定情報を送信
+ * - "ACK <seq>": seq までのイベントを受信済みとして通知（累積ACK）
+ * - "RESYNC": 未ACKイベントを全て再送
+ * - "SUBSCRIBE": 状態のスナップショットを送信し、以降は変化を通知（STATUS のポーリングの代わり）
+ * - "UNSUBSCRIBE": 状態の通知を停止
+ * - "CALIBRATE <id>": 基準エッジでボタンの検出遅延を計測し、補正量を保存
+ * - "CALIBRATE CLEAR": 全ボタンの校正結果を消去
+ * - "CALIBRATION": 校正結果（検出遅延と補正量）を送信
+ * - "ANALYTICS": ボタンごとの反応時間の統計を送信
+ * - "ANALYTICS RESET": 反応時間の統計を消去
+ * - "DEBOUNCE": ボタンごとのデバウンス時間とバウンスの統計を送信
+ * - "DEBOUNCE RESET": デバウンス時間の学習結果を消去
+ * - "SCOPE": 全ボタンの生の入力の変化の送信を開始（ストリーミング中は状態の通知を止める）
+ * - "SCOPE <id>": 指定したボタンだけの生の入力の変化の送信を開始
+ * - "SCOPE OFF": 生の入力の送信を停止
+ * - "DUMP": EEPROM の動作記録をバイナリで送信
+ * - "ANSWER": 解答時間の計時の状態を送信
+ * - "ANSWER <ms>": 解答時間の制限を設定（0 で計時しない、次の押下から）
+ * - "ANSWER STOP": 計時を止める（正誤の判定後）
+ * - "INCORRECT <id>": 不正解になったボタンを順位から外す（押し直しを受け付ける）
  */
 void processSerialCommand()
 {
@@ -51,40 +199,177 @@ void processSerialCommand()
                 // コマンド処理
                 inputBuffer.trim();
 
-                if (inputBuffer.equals("RESET"))
+                if (commandIs(F("RESET")))
                 {
                     buttonManager.reset();
                 }
-                else if (inputBuffer.equals("STATUS"))
+                else if (commandIs(F("STATUS")))
                 {
-                    JsonDocument doc;
-                    doc["type"] = "status";
-                    doc["active"] = buttonManager.isSystemActive();
-                    doc["pressed"] = buttonManager.isButtonPressed();
-                    doc["firstButton"] = buttonManager.getFirstPressedButton();
-                    doc["timestamp"] = millis();
+                    StatusReply reply;
+                    reply.missedDeadlines = buttonManager.getSampler().getMissedDeadlineCount();
+                    reply.sampleOverflows = buttonManager.getSampler().getOverflowCount();
+                    reply.isrCycles = buttonManager.getSampler().getMaxIsrCycles();
+                    reply.ramFree = getMinFreeRam();
+                    reply.timestamp = serialComm.getTimestamp();
 
-                    serializeJson(doc, Serial);
-                    logger.debug("Sent status update");
+                    serialComm.writeFrame(writeStatus, &reply);
+                    logger.debug(F("Sent status update"));
                 }
-                else if (inputBuffer.equals("CONFIG"))
+                else if (commandIs(F("CONFIG")))
                 {
 #if ENABLE_DEBUG_OUTPUT
                     buttonConfig.printConfig();
 #else
                     JsonDocument doc;
-                    doc["type"] = "config";
-                    doc["buttonCount"] = buttonConfig.getButtonCount();
-                    doc["ledEnabled"] = buttonConfig.isLedEnabled();
-                    doc["timestamp"] = millis();
+                    doc[F("type")] = F("config");
+                    doc[F("buttonCount")] = buttonConfig.getButtonCount();
+                    doc[F("ledEnabled")] = buttonConfig.isLedEnabled();
+                    doc[F("sampleRate")] = buttonManager.getSampler().getSampleRate();
+                    doc[F("timestamp")] = serialComm.getTimestamp();
 
-                    serializeJson(doc, Serial);
-                    logger.debug("Sent config update");
+                    serialComm.writeFrame(doc);
+                    logger.debug(F("Sent config update"));
+#endif
+                }
+                else if (commandStartsWith(F("ACK ")))
+                {
+                    serialComm.acknowledge((uint16_t)inputBuffer.substring(4).toInt());
+                }
+                else if (commandIs(F("RESYNC")))
+                {
+                    serialComm.resync();
+                }
+                else if (commandIs(F("SUBSCRIBE")))
+                {
+                    statePublisher.subscribe(buttonManager, serialComm);
+                }
+                else if (commandIs(F("UNSUBSCRIBE")))
+                {
+                    statePublisher.unsubscribe();
+                }
+                else if (commandIs(F("CALIBRATE CLEAR")))
+                {
+                    latencyCalibrator.clear(buttonManager);
+                    latencyCalibrator.sendResult(serialComm);
+                }
+                else if (commandStartsWith(F("CALIBRATE ")))
+                {
+#if ENABLE_SCOPE
+                    // 基準エッジの計測中にシリアルの書き出しで待たされないようにする
+                    if (scopeStreamer.isActive())
+                    {
+                        serialComm.sendError(F("Scope is active"));
+                    }
+                    else
+#endif
+                    {
+                        latencyCalibrator.start((uint8_t)inputBuffer.substring(10).toInt(), buttonManager, serialComm);
+                    }
+                }
+                else if (commandIs(F("CALIBRATION")))
+                {
+                    latencyCalibrator.sendResult(serialComm);
+                }
+#if ENABLE_REACTION_STATS
+                else if (commandIs(F("ANALYTICS")))
+                {
+                    reactionStats.send(serialComm);
+                }
+                else if (commandIs(F("ANALYTICS RESET")))
+                {
+                    reactionStats.clear();
+                    reactionStats.send(serialComm);
+                }
 #endif
+#if ENABLE_ADAPTIVE_DEBOUNCE
+                else if (commandIs(F("DEBOUNCE")))
+                {
+                    debounceLearner.send(serialComm);
+                }
+                else if (commandIs(F("DEBOUNCE RESET")))
+                {
+                    debounceLearner.clear(buttonManager);
+                    debounceLearner.send(serialComm);
+                }
+#endif
+#if ENABLE_SCOPE
+                else if (commandIs(F("SCOPE OFF")))
+                {
+                    scopeStreamer.stop();
                 }
+                else if (commandIs(F("SCOPE")) || commandStartsWith(F("SCOPE ")))
+                {
+                    long buttonId = inputBuffer.length() > 5 ? inputBuffer.substring(6).toInt() : 0;
+                    if (latencyCalibrator.isRunning())
+                    {
+                        serialComm.sendError(F("Calibration in progress"));
+                    }
+                    else if (buttonId < 0 || buttonId > MAX_BUTTONS)
+                    {
+                        serialComm.sendError(F("Invalid button"));
+                    }
+                    else
+                    {
+                        uint8_t mask = buttonId == 0 ? (uint8_t)((1U << MAX_BUTTONS) - 1) : (uint8_t)(1U << (buttonId - 1));
+                        scopeStreamer.start(mask, buttonManager.getRawStates(), buttonManager.getSampler(), serialComm);
+                    }
+                }
+#endif
+#if ENABLE_BLACK_BOX
+                else if (commandIs(F("DUMP")))
+                {
+#if ENABLE_SCOPE
+                    // 生の入力のフレームとバイナリが混ざらないようにする
+                    if (scopeStreamer.isActive())
+                    {
+                        serialComm.sendError(F("Scope is active"));
+                    }
+                    else
+#endif
+                    {
+                        blackBox.startDump(serialComm);
+                    }
+                }
+#endif
+                else if (commandStartsWith(F("INCORRECT ")))
+                {
+                    // タブレットのプレーヤーなど、ボタンの順位に入っていない場合は何もしない
+                    long buttonId = inputBuffer.substring(10).toInt();
+                    if (buttonId < 1 || buttonId > MAX_BUTTONS)
+                    {
+                        serialComm.sendError(F("Invalid button"));
+                    }
+                    else
+                    {
+                        buttonManager.judgeIncorrect((uint8_t)buttonId);
+                    }
+                }
+#if ENABLE_ANSWER_TIMER
+                else if (commandIs(F("ANSWER")))
+                {
+                    answerTimer.send(serialComm);
+                }
+                else if (commandIs(F("ANSWER STOP")))
+                {
+                    answerTimer.stop(buttonManager);
+                    answerTimer.send(serialComm);
+                }
+                else if (commandStartsWith(F("ANSWER ")))
+                {
+                    long limitMs = inputBuffer.substring(7).toInt();
+                    if (limitMs < 0 || !answerTimer.setLimit((unsigned long)limitMs))
+                    {
+                        serialComm.sendError(F("Invalid answer time"));
+                    }
+                    else
+                    {
+                        answerTimer.send(serialComm);
+                    }
+                }
+#endif
                 else
                 {
-                    serialComm.sendError("Unknown command");
+                    serialComm.sendError(F("Unknown command"));
                 }
 
                 inputBuffer = "";
@@ -104,19 +389,39 @@ void processSerialCommand()
  * - シリアル通信の初期化
  * - ボタン設定の読み込み
  * - ボタンマネージャーの初期化
+ *
+ * ウォッチドッグ・ブラウンアウトによるリセット後（ウォームブート）は、
+ * 接続待ちと設定の検証を省いてリセット前のラウンドの状態を復元する
  */
 void setup()
 {
+    paintFreeRam();
+
+#if ENABLE_WATCHDOG_RECOVERY
+    bool warmBoot = recoveryStore.begin();
+#else
+    bool warmBoot = false;
+#endif
+
     // シリアル通信初期化
-    serialComm.init(9600);
+    serialComm.init(9600, !warmBoot);
+
+#if ENABLE_BLACK_BOX
+    // 起動を記録し、以降に送るイベントも記録する
+    blackBox.begin(RecoveryStore::getResetFlags());
+    serialComm.setBlackBox(&blackBox);
+#endif
 
     // 起動メッセージ
-    logger.debug("");
-    logger.debug("====================================");
-    logger.debug("  Quiz Button System v1.0.0");
-    logger.debug("  Based on detailed design spec");
-    logger.debug("====================================");
-    logger.debug("");
+    if (!warmBoot)
+    {
+        logger.debug(F(""));
+        logger.debug(F("===================================="));
+        logger.debug(F("  Quiz Button System v1.0.0"));
+        logger.debug(F("  Based on detailed design spec"));
+        logger.debug(F("===================================="));
+        logger.debug(F(""));
+    }
 
     // デフォルト設定を読み込み
     buttonConfig.loadDefaultConfig();
@@ -124,11 +429,11 @@ void setup()
     // カスタム設定がある場合はここで設定
     // 例: buttonConfig.setButtonPin(0, 10);
 
-    // 設定の検証
-    if (!buttonConfig.validate())
+    // 設定の検証（ウォームブート時はリセット前に検証済み）
+    if (!warmBoot && !buttonConfig.validate())
     {
-        serialComm.sendError("Configuration validation failed");
-        logger.debug("[ERROR] Invalid configuration detected!");
+        serialComm.sendError(F("Configuration validation failed"));
+        logger.debug(F("[ERROR] Invalid configuration detected!"));
         while (1)
         {
             // 設定エラーの場合は停止
@@ -139,28 +444,141 @@ void setup()
     // ボタンマネージャー初期化
     buttonManager.init();
 
-    // システム準備完了を通知
-    serialComm.sendSystemReady();
+    // 保存されている検出遅延の補正量を読み込む
+    latencyCalibrator.begin(buttonManager);
+
+#if ENABLE_ADAPTIVE_DEBOUNCE
+    // 学習済みのデバウンス時間を読み込む
+    debounceLearner.begin(buttonManager);
+#endif
+
+#if ENABLE_SCOPE
+    // SCOPE の間はデバウンス前のサンプルも送る
+    buttonManager.setScope(&scopeStreamer);
+#endif
 
-    logger.debug("System ready. Waiting for button press...");
-    logger.debug("Commands: RESET, STATUS, CONFIG");
+    if (warmBoot)
+    {
+        // ラウンドの状態を復元して復帰を通知
+        recoveryStore.restore(buttonManager, serialComm);
+    }
+    else
+    {
+        // システム準備完了を通知
+        serialComm.sendSystemReady();
+
+        logger.debug(F("System ready. Waiting for button press..."));
+        logger.debug(F("Commands: RESET, STATUS, CONFIG, ACK, RESYNC, SUBSCRIBE, UNSUBSCRIBE, CALIBRATE, CALIBRATION, ANALYTICS, DEBOUNCE, SCOPE, DUMP, ANSWER, INCORRECT"));
+    }
+
+#if ENABLE_ANSWER_TIMER
+    // 復元したラウンドの押下からは計時しない
+    answerTimer.begin(buttonManager);
+#endif
+
+#if ENABLE_WATCHDOG_RECOVERY
+    wdt_enable(WATCHDOG_TIMEOUT);
+#endif
+}
+
+/**
+ * @brief フレームやバイナリを少しずつ書き出している途中かを取得
+ *
+ * 途中の間はコマンドの応答や状態通知を書き出すとそれらの途中に割り込んでしまう
+ * @return 書き出し中なら true
+ */
+bool isOutputBusy()
+{
+#if ENABLE_SCOPE
+    if (scopeStreamer.isSending())
+    {
+        return true;
+    }
+#endif
+#if ENABLE_BLACK_BOX
+    if (blackBox.isSending())
+    {
+        return true;
+    }
+#endif
+    return false;
 }
 
 /**
  * @brief メインループ
  *
  * 繰り返し実行される処理
+ * ボタン入力はタイマー割り込みでサンプリングされるため、待機せずに回し続ける
  * - ボタン状態の監視
- * - シリアルコマンドの処理
+ * - 解答時間の計時と LED の点滅
+ * - 検出遅延の校正（校正中のみ）
+ * - 反応時間の集計
+ * - デバウンス時間の学習
+ * - シリアルコマンドの処理（生の入力のフレーム・動作記録のバイナリを書き出している途中は待たせる）
+ * - 未ACKイベントの再送
+ * - 生の入力の送信（SCOPE の間のみ）
+ * - 動作記録の EEPROM への書き込み・DUMP のバイナリの書き出し
+ * - 購読中の状態通知（SCOPE・DUMP の間は止める）
+ * - ウォッチドッグのリセットとラウンド状態の保存
  */
 void loop()
 {
+#if ENABLE_WATCHDOG_RECOVERY
+    wdt_reset();
+#endif
+
     // ボタン状態を更新
     buttonManager.update();
 
-    // シリアルコマンドを処理
-    processSerialCommand();
+#if ENABLE_ANSWER_TIMER
+    // 最初の押下で計時を始め、時間切れを送信
+    answerTimer.update(buttonManager, serialComm);
+#endif
+
+    // 校正中なら計測を進める
+    latencyCalibrator.update(buttonManager, serialComm);
 
-    // CPU負荷軽減のため少し待機
-    delay(10);
+#if ENABLE_REACTION_STATS
+    // 新しい押下の反応時間を集計
+    reactionStats.update(buttonManager);
+#endif
+
+#if ENABLE_ADAPTIVE_DEBOUNCE
+    // 新しく確定した変化のバウンスを学習
+    debounceLearner.update(buttonManager);
+#endif
+
+    // 応答がフレームの途中に割り込まないよう、書き出し中のコマンドは受信バッファに残しておく
+    if (!isOutputBusy())
+    {
+        // シリアルコマンドを処理
+        processSerialCommand();
+    }
+
+    // タイムアウトしたイベントを再送
+    serialComm.update();
+
+#if ENABLE_SCOPE
+    // 生の入力の変化を送信バッファの空きの分だけ書き出す
+    scopeStreamer.update(buttonManager.getSampler(), serialComm);
+    bool scopeActive = scopeStreamer.isActive();
+#else
+    bool scopeActive = false;
+#endif
+
+#if ENABLE_BLACK_BOX
+    // 記録を EEPROM に書き込む（DUMP の間はバイナリを書き出す）
+    blackBox.update(serialComm);
+#endif
+
+    if (!scopeActive && !isOutputBusy())
+    {
+        // 購読中なら状態の変化・ハートビートを通知
+        statePublisher.update(buttonManager, serialComm);
+    }
+
+#if ENABLE_WATCHDOG_RECOVERY
+    // リセットに備えてラウンドの状態を保存
+    recoveryStore.update(buttonManager, serialComm);
+#endif
 }
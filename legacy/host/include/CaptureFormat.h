@@ -0,0 +1,67 @@
+/**
+ * @file CaptureFormat.h
+ * @brief コントローラー通信の記録ファイル（.qcap）の形式
+ *
+ * 追記専用のバイナリ形式。ファイルヘッダの後にレコードが並ぶ
+ * 1レコードは1回の read() で受信した生のバイト列と、その中で完成した行を
+ * デコードしたイベントからなる。全フィールドはリトルエンディアン
+ * 書き込み途中で終了したファイルは、最後の不完全なレコードだけを無視して読める
+ */
+
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include <cstdint>
+
+const char CAPTURE_MAGIC[4] = {'Q', 'C', 'A', 'P'};
+const uint16_t CAPTURE_VERSION = 1;
+
+#pragma pack(push, 1)
+
+/**
+ * @brief ファイルヘッダ
+ */
+struct CaptureFileHeader
+{
+    char magic[4];         // "QCAP"
+    uint16_t version;      // CAPTURE_VERSION
+    uint16_t headerSize;   // sizeof(CaptureFileHeader)
+    uint32_t baud;         // 記録時のボーレート
+    uint32_t reserved;
+    uint64_t createdUnixNs; // 記録開始時の壁時計（参考用）
+};
+
+/**
+ * @brief レコードヘッダ
+ *
+ * この後に rawLength バイトの生データと eventCount 個の CaptureEvent が続く
+ */
+struct CaptureRecordHeader
+{
+    uint32_t length;    // レコード全体のバイト数
+    uint64_t arrivalNs; // 受信時刻（CLOCK_MONOTONIC_RAW）
+    uint16_t rawLength; // 生データのバイト数
+    uint8_t eventCount; // デコード済みイベント数
+    uint8_t reserved;
+};
+
+/**
+ * @brief デコード済みイベント（まとめ送信の押下は1件ずつに展開済み）
+ */
+struct CaptureEvent
+{
+    uint8_t kind;       // EventKind
+    uint8_t buttonId;   // ボタンID（押下のみ）
+    uint16_t seq;       // シーケンス番号
+    uint16_t flags;     // INGEST_FLAG_*（IngestRecord.h と共通）
+    uint16_t from;      // resync の再送起点
+    uint32_t timestamp; // コントローラーの時刻（ミリ秒）
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(CaptureFileHeader) == 24, "CaptureFileHeader must be 24 bytes");
+static_assert(sizeof(CaptureRecordHeader) == 16, "CaptureRecordHeader must be 16 bytes");
+static_assert(sizeof(CaptureEvent) == 12, "CaptureEvent must be 12 bytes");
+
+#endif // CAPTURE_FORMAT_H
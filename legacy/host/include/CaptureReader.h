@@ -0,0 +1,81 @@
+/**
+ * @file CaptureReader.h
+ * @brief 記録ファイル（.qcap）を読むクラス
+ *
+ * ファイルを mmap し、レコードをコピーせずに先頭から順に取り出す
+ */
+
+#ifndef CAPTURE_READER_H
+#define CAPTURE_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "CaptureFormat.h"
+
+/**
+ * @brief 読み出した1レコード（ファイルの mmap 領域を指す）
+ */
+struct CaptureRecord
+{
+    uint64_t arrivalNs = 0;
+    std::string_view raw;
+    uint8_t eventCount = 0;
+    const char *events = nullptr; // CaptureEvent の並び（境界が揃っていないので eventAt() で読む）
+
+    /**
+     * @brief i番目のイベントを取得
+     * @param index 0 から eventCount - 1
+     * @return イベント
+     */
+    CaptureEvent eventAt(uint8_t index) const;
+};
+
+class CaptureReader
+{
+public:
+    CaptureReader() = default;
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader &) = delete;
+    CaptureReader &operator=(const CaptureReader &) = delete;
+
+    /**
+     * @brief 記録ファイルを開く
+     * @param path ファイルパス
+     * @return 記録ファイルとして読める場合 true
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief 次のレコードを取り出す
+     * @param record 読み出し先
+     * @return レコードがある場合 true（末尾の不完全なレコードは無視）
+     */
+    bool next(CaptureRecord &record);
+
+    /**
+     * @brief 先頭のレコードに戻る
+     */
+    void rewind();
+
+    const CaptureFileHeader &getHeader() const { return header; }
+
+    /**
+     * @brief ファイルが途中で切れていたか（最後まで読んだ後に有効）
+     * @return 不完全なレコードがあった場合 true
+     */
+    bool isTruncated() const { return truncated; }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+    bool truncated = false;
+    CaptureFileHeader header{};
+
+    void unmap();
+};
+
+#endif // CAPTURE_READER_H
@@ -0,0 +1,81 @@
+/**
+ * @file CaptureWriter.h
+ * @brief 記録ファイル（.qcap）への追記を行うクラス
+ */
+
+#ifndef CAPTURE_WRITER_H
+#define CAPTURE_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "CaptureFormat.h"
+#include "ControllerEvent.h"
+
+/**
+ * @brief デコード済みイベントを記録形式に変換（まとめ送信の押下は1件ずつに展開）
+ * @param event デコード済みイベント
+ * @param out 出力先（ControllerEvent::MAX_PRESSES 件以上）
+ * @return 出力した件数
+ */
+int toCaptureEvents(const ControllerEvent &event, CaptureEvent *out);
+
+class CaptureWriter
+{
+public:
+    CaptureWriter() = default;
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter &) = delete;
+    CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+    /**
+     * @brief 記録ファイルを開く（既存のファイルには追記し、空ならヘッダを書く）
+     * @param path ファイルパス
+     * @param baud 記録するボーレート（ヘッダ用）
+     * @return 成功: true
+     */
+    bool open(const std::string &path, int baud);
+
+    /**
+     * @brief ファイルを閉じる
+     */
+    void close();
+
+    bool isOpen() const { return fd >= 0; }
+
+    /**
+     * @brief レコードを開始
+     * @param arrivalNs 受信時刻
+     * @param raw 受信した生データ
+     */
+    void beginRecord(uint64_t arrivalNs, std::string_view raw);
+
+    /**
+     * @brief 開始中のレコードにデコード済みイベントを追加（押下は1件ずつに展開）
+     * @param event デコード済みイベント
+     */
+    void addEvent(const ControllerEvent &event);
+
+    /**
+     * @brief 開始中のレコードを確定して書き込む
+     */
+    void endRecord();
+
+    /**
+     * @brief リンク状態の変化を1レコードとして書き込む
+     * @param kind EventKind::LinkUp または EventKind::LinkDown
+     * @param arrivalNs 発生時刻
+     */
+    void writeLink(EventKind kind, uint64_t arrivalNs);
+
+    unsigned long getRecordCount() const { return recordCount; }
+
+private:
+    int fd = -1;
+    std::string record; // 組み立て中のレコード
+    uint8_t eventCount = 0;
+    unsigned long recordCount = 0;
+};
+
+#endif // CAPTURE_WRITER_H
@@ -0,0 +1,34 @@
+/**
+ * @file Clock.h
+ * @brief ホスト側のタイムスタンプ取得
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+#include <time.h>
+
+/**
+ * @brief NTP補正の影響を受けない単調時刻を取得（CLOCK_MONOTONIC_RAW）
+ * @return ナノ秒
+ */
+inline uint64_t monotonicRawNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+/**
+ * @brief CLOCK_MONOTONIC の時刻を取得（Node.js の process.hrtime と同じ時計）
+ * @return ナノ秒
+ */
+inline uint64_t monotonicNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+#endif // CLOCK_H
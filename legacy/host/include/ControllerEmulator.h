@@ -0,0 +1,177 @@
+/**
+ * @file ControllerEmulator.h
+ * @brief コントローラーのシリアルプロトコルを再現するエミュレーター
+ *
+ * ファームウェアの SerialCommunicator・StatePublisher と同じ規則でフレームを生成する
+ * - シーケンス番号、再送ウィンドウ（溢れたら最古を破棄）、累積ACK、タイムアウト再送（指数バックオフ・回数の上限）、RESYNC
+ * - 同時押しのまとめ送信（pressedButtons、連番の押下のみ）
+ * - RESET / STATUS / CONFIG / SUBSCRIBE / UNSUBSCRIBE の応答
+ * 入出力は持たず、生成した行（\r\n 付き）はフレームごとにコールバックへ渡す
+ * cobsFraming では行の代わりに COBS + CRC-16 のフレーム（ENABLE_COBS_FRAMING と同じ形式）を渡す
+ * 時刻は呼び出し側が CLOCK_MONOTONIC のナノ秒で与える（timestamp は起動からのミリ秒）
+ */
+
+#ifndef CONTROLLER_EMULATOR_H
+#define CONTROLLER_EMULATOR_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ControllerEmulator
+{
+public:
+    /**
+     * @brief ファームウェアの設定（既定値は controller/include/config.h と同じ）
+     */
+    struct Config
+    {
+        uint8_t buttonCount = 6;
+        uint8_t window = 8;                   // RETRANSMIT_WINDOW
+        uint32_t retransmitTimeoutMs = 500;   // RETRANSMIT_TIMEOUT
+        uint8_t retransmitMaxAttempts = 5;    // RETRANSMIT_MAX_ATTEMPTS
+        uint32_t batchWindowMs = 2;           // PRESS_BATCH_WINDOW
+        uint32_t deltaMinIntervalMs = 100;    // STATE_DELTA_MIN_INTERVAL
+        uint32_t heartbeatIntervalMs = 5000;  // STATE_HEARTBEAT_INTERVAL
+        unsigned long sampleRate = 20000;     // CONFIG の sampleRate
+        bool cobsFraming = false;             // ENABLE_COBS_FRAMING
+    };
+
+    /**
+     * @brief 生成した1フレーム（1行、\r\n 付き。cobsFraming では区切りの 0x00 を含むフレーム）を受け取る
+     */
+    using FrameSink = std::function<void(std::string_view frame)>;
+
+    /**
+     * @brief イベントがACKされたときに呼ばれる
+     *
+     * 引数はボタンID（押下以外のイベントは 0）と、最初の送信からの経過時間
+     */
+    using AckHandler = std::function<void(uint8_t buttonId, uint64_t latencyNs)>;
+
+    ControllerEmulator(const Config &config, FrameSink sink);
+
+    void setAckHandler(AckHandler handler) { onAck = std::move(handler); }
+
+    /**
+     * @brief 電源投入と同じ状態から起動し、systemReady（seq 0）を送る
+     * @param nowNs 現在時刻
+     */
+    void boot(uint64_t nowNs);
+
+    /**
+     * @brief ボタン押下（ラウンド内で最初の押下のみ送信される）
+     * @param buttonId ボタンID（1〜buttonCount）
+     * @param nowNs 現在時刻
+     * @return 押下として記録された場合 true
+     */
+    bool press(uint8_t buttonId, uint64_t nowNs);
+
+    /**
+     * @brief ラウンドをリセットし、systemReset を送る（RESET コマンドと同じ）
+     * @param nowNs 現在時刻
+     */
+    void resetRound(uint64_t nowNs);
+
+    /**
+     * @brief PC から届いた1行のコマンドを処理する
+     * @param line 改行を除いたコマンド
+     * @param nowNs 現在時刻
+     */
+    void handleCommand(std::string_view line, uint64_t nowNs);
+
+    /**
+     * @brief まとめ待ちの送信・タイムアウト再送・状態通知を行う（メインループで呼ぶ）
+     * @param nowNs 現在時刻
+     */
+    void update(uint64_t nowNs);
+
+    /**
+     * @brief 次に update() が必要になる時刻
+     * @return CLOCK_MONOTONIC のナノ秒（予定がない場合 UINT64_MAX）
+     */
+    uint64_t nextDeadlineNs() const;
+
+    uint8_t getButtonCount() const { return config.buttonCount; }
+    uint8_t getPressCount() const { return static_cast<uint8_t>(pressOrder.size()); }
+    bool isPressed(uint8_t buttonId) const;
+    bool isPeerAcking() const { return peerAcks; }
+    uint8_t getPendingCount() const { return static_cast<uint8_t>(pending.size()); }
+    uint16_t getNextSeq() const { return nextSeq; }
+    unsigned long getAckedCount() const { return ackedCount; }
+    unsigned long getRetransmitCount() const { return retransmitCount; }
+    unsigned long getDroppedCount() const { return droppedCount; }
+
+private:
+    enum EventType
+    {
+        EVENT_BUTTON_PRESS,
+        EVENT_SYSTEM_RESET,
+        EVENT_ERROR,
+        EVENT_SYSTEM_READY
+    };
+
+    struct PendingEvent
+    {
+        uint16_t seq;
+        EventType type;
+        uint8_t buttonId;
+        uint16_t round;           // 発生時のラウンド番号
+        unsigned long timestamp;  // ミリ秒
+        const char *message;
+        unsigned long lastSentAt; // ミリ秒
+        uint64_t firstSentNs;     // 0: 未送信
+    };
+
+    Config config;
+    FrameSink sink;
+    AckHandler onAck;
+
+    uint64_t bootNs = 0;
+    std::vector<PendingEvent> pending; // 先頭が最古（最大 config.window 件）
+    size_t unsentCount = 0;
+    unsigned long batchStartedAt = 0;
+    uint16_t nextSeq = 0;
+    bool peerAcks = false;
+    uint8_t retransmitAttempts = 0; // 最後の ACK・RESYNC 以降のタイムアウト再送の回数
+    unsigned long ackedCount = 0;
+    unsigned long retransmitCount = 0;
+    unsigned long droppedCount = 0;
+
+    // ラウンドの状態
+    uint16_t round = 0;
+    std::vector<uint8_t> pressOrder;
+
+    // SUBSCRIBE の状態
+    bool subscribed = false;
+    uint16_t stateVersion = 0;
+    uint16_t sentRound = 0;
+    size_t sentPressCount = 0;
+    unsigned long lastDeltaAt = 0;
+    unsigned long lastHeartbeatAt = 0;
+
+    std::string line; // フレームの組み立て用
+    std::string framed; // COBS で符号化したフレーム（cobsFraming）
+
+    unsigned long millisAt(uint64_t nowNs) const;
+    bool retransmitPending() const;
+    unsigned long retransmitTimeout() const;
+    void emit(EventType type, uint8_t buttonId, const char *message, uint64_t nowNs);
+    void enqueue(const PendingEvent &event, uint64_t nowNs);
+    void flush(uint64_t nowNs);
+    void writeRange(size_t first, size_t count, uint64_t nowNs);
+    void writeEvent(const PendingEvent &event);
+    void writePressBatch(size_t first, size_t count);
+    void acknowledge(uint16_t seq, uint64_t nowNs);
+    void resync(uint64_t nowNs);
+    void sendStatus(uint64_t nowNs);
+    void sendConfig(uint64_t nowNs);
+    void sendState(const char *type, bool full, uint64_t nowNs);
+    void appendPressed();
+    void appendHealth();
+    void send();
+};
+
+#endif // CONTROLLER_EMULATOR_H
@@ -0,0 +1,95 @@
+/**
+ * @file ControllerEvent.h
+ * @brief コントローラーから受信したイベントの表現
+ *
+ * SerialCommunicator が送信するJSONフレームをデコードした結果を保持する
+ * 文字列は受信バッファ内を指すビューで、次の受信までの間だけ有効
+ */
+
+#ifndef CONTROLLER_EVENT_H
+#define CONTROLLER_EVENT_H
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief イベント種類（IngestRecord の kind としてもそのまま使う）
+ */
+enum class EventKind : uint8_t
+{
+    Unknown = 0,     // JSONとして解釈できない行（ログ出力など）
+    ButtonPress = 1, // pressedButton / pressedButtons の各押下
+    SystemReset = 2,
+    Error = 3,
+    SystemReady = 4,
+    Resync = 5,
+    Debug = 6,
+    Status = 7, // status / config / calibration / analytics / debounce / blackBox / answerTimer などのコマンド応答、state / stateDelta / heartbeat（SUBSCRIBE）
+    Recovered = 8, // ウォッチドッグ等のリセットから状態を復元した（reason / downtime は元の行にある）
+    Armed = 9,      // トリガー入力でラウンドを開始した（ENABLE_TRIGGER_INPUT）
+    FalseStart = 10, // ラウンドの開始前に押された（ボタンIDは buttonId）
+    Scope = 11,      // SCOPE で送られた生の入力の変化（scope、edges は元の行にある）
+    AnswerTimeout = 12, // 最初の押下からの解答時間が切れた（ボタンIDは buttonId、ENABLE_ANSWER_TIMER）
+    Gesture = 13,       // 1回の操作（連打・長押し）が確定した（buttonId / longPress / taps / hold / total、ENABLE_GESTURES）
+    LinkUp = 16,   // シリアルデバイスを開いた（ホスト側で生成）
+    LinkDown = 17, // シリアルデバイスが切断された（ホスト側で生成）
+};
+
+/**
+ * @brief まとめて送られた押下の1件
+ */
+struct PressEntry
+{
+    uint8_t buttonId;  // ボタンID（1-6）
+    uint32_t offsetMs; // フレーム先頭の押下からの経過ミリ秒
+};
+
+/**
+ * @brief scope フレームの変化の1件
+ */
+struct ScopeEdge
+{
+    uint32_t deltaTicks; // 直前の変化（先頭はフレームの tick）からのサンプル数
+    uint8_t mask;        // 変化後の押下ビット（bit i = ボタンインデックス i）
+};
+
+/**
+ * @brief デコード済みのコントローラーイベント
+ */
+struct ControllerEvent
+{
+    static const int MAX_PRESSES = 8;                   // 1フレームに含まれる押下の最大数
+    static const int MAX_TRACE = 2 + 2 * MAX_PRESSES; // trace の最大要素数
+    static const int MAX_SCOPE_EDGES = 32;              // scope の1フレームに含まれる変化の最大数
+
+    EventKind kind = EventKind::Unknown;
+    bool hasSeq = false;     // seq フィールドがあったか
+    uint16_t seq = 0;        // シーケンス番号（まとめ送信時は先頭の番号）
+    uint32_t timestamp = 0;  // コントローラーの時刻（ミリ秒）
+    uint16_t from = 0;       // resync の再送起点
+    uint8_t buttonId = 0;    // falseStart / answerTimeout / gesture のボタンID（押下は presses に入る）
+    bool hasRound = false;   // round フィールドがあったか
+    uint16_t round = 0;      // 押下・systemReset・armed・falseStart・answerTimeout・gesture が属するラウンド番号
+    uint8_t pressCount = 0;  // presses の有効数
+    PressEntry presses[MAX_PRESSES];
+    uint8_t traceCount = 0; // trace の有効数（ENABLE_LATENCY_TRACE 有効時のみ 0 以外）
+    uint32_t trace[MAX_TRACE]; // [エンコード開始, 送信開始, (入力変化, 確定) × イベント数]（コントローラーの micros()）
+    bool scopeStart = false;  // scope の開始フレームか
+    bool scopeEnd = false;    // scope の終了フレームか
+    uint32_t sampleRate = 0;  // scope の開始フレームのサンプリング周波数（Hz）
+    uint8_t scopeMask = 0;    // scope の開始フレームの対象のボタン（bit i = ボタンインデックス i）
+    uint32_t tick = 0;        // scope の変化の起点のサンプル番号
+    uint32_t lost = 0;        // scope の送信が追いつかずに失われた変化の数（開始からの累計）
+    uint8_t edgeCount = 0;    // edges の有効数
+    ScopeEdge edges[MAX_SCOPE_EDGES];
+    uint32_t rawBytes = 0;    // 行の後に続くバイナリのバイト数（DUMP の blackBox、LineFramer::skipRaw() で読み飛ばす）
+    uint16_t rawCrc = 0;      // そのバイナリの CRC-16/CCITT-FALSE
+    bool longPress = false;   // gesture の最後の押下が長押しか（"long"）
+    uint8_t taps = 0;         // gesture の押下回数
+    uint16_t hold = 0;        // gesture の最後の押下の長さ（ミリ秒、timestamp は最後に離した時刻）
+    uint16_t total = 0;       // gesture の最初の押下から最後の解放まで（ミリ秒）
+    std::string_view message; // error / debug のメッセージ（エスケープ未処理）
+    std::string_view raw;     // 元の行（改行を除く）
+};
+
+#endif // CONTROLLER_EVENT_H
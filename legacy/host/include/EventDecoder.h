@@ -0,0 +1,36 @@
+/**
+ * @file EventDecoder.h
+ * @brief コントローラーのJSON行をゼロコピーでデコードするクラス
+ *
+ * SerialCommunicator が出力するフラットなJSONオブジェクトだけを対象にした
+ * 軽量スキャナで、メモリ確保を行わずに受信バッファ上で直接解析する
+ */
+
+#ifndef EVENT_DECODER_H
+#define EVENT_DECODER_H
+
+#include <string_view>
+#include "ControllerEvent.h"
+
+class EventDecoder
+{
+public:
+    /**
+     * @brief 1行をデコード
+     * @param line 改行を除いた1行
+     * @param event デコード結果（文字列は line を指す）
+     * @return JSONとして解釈できた場合 true（false の場合 kind は Unknown）
+     */
+    bool decode(std::string_view line, ControllerEvent &event);
+
+    /**
+     * @brief JSONとして解釈できなかった行数を取得
+     * @return 起動後の失敗数
+     */
+    unsigned long getMalformedCount() const { return malformedCount; }
+
+private:
+    unsigned long malformedCount = 0;
+};
+
+#endif // EVENT_DECODER_H
@@ -0,0 +1,36 @@
+/**
+ * @file IngestRecord.h
+ * @brief quiz-ingest が購読者に配信するバイナリレコードの形式
+ *
+ * 全フィールドはリトルエンディアン。ヘッダの後に length - sizeof(ヘッダ) バイトの
+ * ペイロードが続く（error / debug はメッセージ、Unknown / Status / Recovered / Scope / Gesture は元の行）
+ * まとめ送信された押下は1件ずつのレコードに展開して配信する
+ */
+
+#ifndef INGEST_RECORD_H
+#define INGEST_RECORD_H
+
+#include <cstdint>
+
+#pragma pack(push, 1)
+struct IngestRecordHeader
+{
+    uint16_t length;    // ペイロードを含むレコード全体のバイト数
+    uint8_t kind;       // EventKind
+    uint8_t buttonId;   // ボタンID（押下・フライング・解答時間切れ・ジェスチャーのみ）
+    uint16_t seq;       // シーケンス番号（展開済み: 押下ごとの番号）
+    uint16_t flags;     // INGEST_FLAG_*
+    uint32_t timestamp; // コントローラーの時刻（ミリ秒、展開済み）
+    uint16_t from;      // resync の再送起点
+    uint16_t round;     // ラウンド番号（INGEST_FLAG_HAS_ROUND のみ）
+    uint64_t arrivalNs; // ホストでの受信時刻（CLOCK_MONOTONIC_RAW）
+};
+#pragma pack(pop)
+
+static_assert(sizeof(IngestRecordHeader) == 24, "IngestRecordHeader must be 24 bytes");
+
+const uint16_t INGEST_FLAG_HAS_SEQ = 0x0001; // seq が有効
+const uint16_t INGEST_FLAG_BATCHED = 0x0002; // pressedButtons から展開した押下
+const uint16_t INGEST_FLAG_HAS_ROUND = 0x0004; // round が有効
+
+#endif // INGEST_RECORD_H
@@ -0,0 +1,189 @@
+/**
+ * @file IngestRing.h
+ * @brief quiz-ingest の配信レコードを載せる共有メモリのリングバッファ（書き手1・読み手多数）
+ *
+ * Unix ソケットの配信（IngestServer）と同じ IngestRecord を、POSIX 共有メモリ（shm_open）上の
+ * 固定長スロットに順に書く。読み手はそれぞれ自分の読み位置だけを持ち、書き手は読み手を待たない
+ * （読み手が眠らない間は書き込みの手間は読み手の数によらないが、眠った読み手を起こす FUTEX_WAKE は
+ *  起こす読み手の数だけ重くなる）
+ *
+ * - 各スロットは書き込み中に 0、書き終えると「位置 + 1」になるシーケンス番号を持つ（seqlock）
+ *   読み手はレコードを共有メモリ上で直接読み、読み終えた後に番号が変わっていないことを確かめる
+ * - 書き手が一周して追い越したレコードは失われる。読み手は番号の飛びで検知し、件数を数えて最古のレコードから読み直す
+ * - スロットに収まらないペイロードは切り詰めて INGEST_FLAG_TRUNCATED を立てる
+ * - 待つ読み手は少し回って待ってから futex で眠る。書き手は前回起こした後に眠ろうとした読み手がいる場合だけ
+ *   FUTEX_WAKE を呼ぶため、起きた読み手が読み進めている間の書き込みはまとめて1回の起床で済む
+ *
+ * 読み手はコマンドを送れないため、ACK・RESET を送るサーバーはこれまでどおりソケットで購読する
+ */
+
+#ifndef INGEST_RING_H
+#define INGEST_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "IngestRecord.h"
+
+const uint32_t INGEST_RING_MAGIC = 0x47524951; // "QIRG"
+const uint16_t INGEST_RING_VERSION = 1;
+const uint32_t INGEST_RING_SLOT_SIZE = 512;       // スロットのバイト数（先頭 8 バイトはシーケンス番号）
+const uint32_t INGEST_RING_DEFAULT_SLOTS = 4096;  // スロット数の既定値（2のべき乗）
+
+const uint16_t INGEST_FLAG_TRUNCATED = 0x0008; // ペイロードをスロットに収まるように切り詰めた（共有メモリのみ）
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring counters must be lock-free to share across processes");
+
+/**
+ * @brief 共有メモリの先頭に置く管理領域
+ *
+ * 書き手が更新する値と読み手が書く値（waiters）はキャッシュラインを分ける
+ */
+struct IngestRingHeader
+{
+    uint32_t magic;     // INGEST_RING_MAGIC
+    uint16_t version;   // INGEST_RING_VERSION
+    uint16_t slotSize;  // INGEST_RING_SLOT_SIZE
+    uint32_t slotCount; // スロット数（2のべき乗）
+    uint32_t writerPid; // 書き手のプロセスID
+    uint64_t createdNs; // 作成時刻（CLOCK_MONOTONIC_RAW、作り直しの検知用）
+
+    alignas(64) std::atomic<uint64_t> head; // 次に書く位置（これより前は書き終えている）
+    std::atomic<uint32_t> notify;           // 書くたびに増える（futex で待つ値）
+    std::atomic<uint32_t> closed;           // 書き手が終了した
+
+    alignas(64) std::atomic<uint32_t> waiters; // 前回起こした後に futex で眠ろうとした読み手の数（書き手が起こすときに 0 に戻す）
+};
+
+/**
+ * @brief リングに書き込む側（quiz-ingest）
+ */
+class IngestRingWriter
+{
+public:
+    IngestRingWriter() = default;
+    ~IngestRingWriter();
+
+    IngestRingWriter(const IngestRingWriter &) = delete;
+    IngestRingWriter &operator=(const IngestRingWriter &) = delete;
+
+    /**
+     * @brief 共有メモリを作成する（同名の既存のものは作り直す）
+     * @param name 共有メモリの名前（"/quiz-ingest" など、先頭は /）
+     * @param slotCount スロット数（2のべき乗）
+     * @return 成功: true
+     */
+    bool create(const std::string &name, uint32_t slotCount = INGEST_RING_DEFAULT_SLOTS);
+
+    /**
+     * @brief 閉じて共有メモリの名前を削除する（読み手には closed で知らせ、開いている分はそのまま読める）
+     */
+    void close();
+
+    bool isOpen() const { return header != nullptr; }
+
+    /**
+     * @brief レコードを1件書き込む
+     * @param record IngestRecordHeader で始まるレコード（length バイト）
+     */
+    void write(const char *record);
+
+    /**
+     * @brief 連続したレコードを順に書き込む（IngestServer が1フレーム分をまとめて渡す）
+     * @param records レコードの並び
+     * @param length 全体のバイト数
+     */
+    void writeAll(const char *records, size_t length);
+
+    uint64_t getWrittenCount() const;
+    unsigned long getTruncatedCount() const { return truncatedCount; }
+    unsigned long getWakeCount() const { return wakeCount; }
+
+private:
+    IngestRingHeader *header = nullptr;
+    char *slots = nullptr;
+    size_t mappedSize = 0;
+    uint32_t mask = 0;
+    std::string shmName;
+    unsigned long truncatedCount = 0;
+    unsigned long wakeCount = 0;
+};
+
+/**
+ * @brief リングを読む側（購読するプロセスごと・スレッドごとに1つ）
+ *
+ * next() で得たレコードは共有メモリを直接指す。処理した後に commit() を呼び、
+ * false が返った場合は読んでいる間に上書きされたので、そのレコードから得た結果は捨てる
+ */
+class IngestRingReader
+{
+public:
+    enum class Status
+    {
+        Ok,     // レコードがある
+        Empty,  // まだ書かれていない
+        Closed, // 書き手が終了し、全て読み終えた
+    };
+
+    IngestRingReader() = default;
+    ~IngestRingReader();
+
+    IngestRingReader(const IngestRingReader &) = delete;
+    IngestRingReader &operator=(const IngestRingReader &) = delete;
+
+    /**
+     * @brief 既存の共有メモリを開く（読み手が書くのは futex で待つ間の waiters だけ）
+     * @param name 共有メモリの名前
+     * @param fromOldest true: 残っている最古のレコードから読む, false: これから書かれるレコードから読む
+     * @return 成功: true（形式が違う場合は errno = EPROTO）
+     */
+    bool open(const std::string &name, bool fromOldest = false);
+
+    void close();
+
+    /**
+     * @brief 次のレコードを取り出す（待たない）
+     *
+     * 追い越されていた場合は失った件数を数え、残っている最古のレコードから読み直す
+     * @param record レコードのヘッダ（共有メモリ内）
+     * @param payload ペイロード（共有メモリ内）
+     * @return 状態
+     */
+    Status next(const IngestRecordHeader *&record, std::string_view &payload);
+
+    /**
+     * @brief next() で得たレコードを読み終えて、読み位置を進める
+     * @return 読んでいる間に上書きされなかった場合 true（false の場合は失った件数に数える）
+     */
+    bool commit();
+
+    /**
+     * @brief 新しいレコードが書かれるか書き手が終了するまで待つ
+     * @param timeoutMs 最大の待ち時間（ミリ秒、負: 無期限）
+     * @return 読めるレコードがあるか書き手が終了した場合 true
+     */
+    bool wait(int timeoutMs);
+
+    /**
+     * @brief 書き手がまだ書いていないレコードの数を除いた、読み残しの件数
+     * @return 件数（追い越されている場合はスロット数より大きい）
+     */
+    uint64_t getBacklog() const;
+
+    const IngestRingHeader *getHeader() const { return header; }
+    uint64_t getPosition() const { return position; }
+    uint64_t getLostCount() const { return lostCount; }
+
+private:
+    const IngestRingHeader *header = nullptr;
+    const char *slots = nullptr;
+    size_t mappedSize = 0;
+    uint32_t mask = 0;
+    uint64_t position = 0;  // 次に読む位置
+    bool reading = false;   // next() で Ok を返し、まだ commit() していない
+    uint64_t lostCount = 0; // 追い越されて読めなかったレコードの数
+};
+
+#endif // INGEST_RING_H
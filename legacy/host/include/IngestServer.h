@@ -0,0 +1,122 @@
+/**
+ * @file IngestServer.h
+ * @brief デコード済みイベントをUnixドメインソケットで配信するクラス
+ *
+ * 購読者には IngestRecord 形式のバイナリレコードを配信し、
+ * 購読者から届いた行（RESET、ACK などのコマンド）はコールバックで呼び出し元に渡す
+ * 登録・解除は呼び出し元の epoll インスタンスに対して行う
+ * 共有メモリのリング（IngestRing）を設定した場合は、同じレコードをリングにも書く
+ */
+
+#ifndef INGEST_SERVER_H
+#define INGEST_SERVER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "ControllerEvent.h"
+
+class IngestRingWriter;
+
+class IngestServer
+{
+public:
+    using CommandHandler = std::function<void(std::string_view line)>;
+
+    /**
+     * @brief コンストラクタ
+     * @param epollFd 登録先の epoll インスタンス
+     */
+    explicit IngestServer(int epollFd);
+    ~IngestServer();
+
+    IngestServer(const IngestServer &) = delete;
+    IngestServer &operator=(const IngestServer &) = delete;
+
+    /**
+     * @brief ソケットを作成して待ち受けを開始
+     * @param path ソケットのパス（既存のファイルは削除される）
+     * @return 成功: true
+     */
+    bool listen(const std::string &path);
+
+    /**
+     * @brief 購読者から届いたコマンド行の処理先を設定
+     * @param handler コールバック
+     */
+    void setCommandHandler(CommandHandler handler) { onCommand = std::move(handler); }
+
+    /**
+     * @brief 配信するレコードを書き込む共有メモリのリングを設定
+     * @param writer 作成済みのリング（nullptr: 書かない）
+     */
+    void setRing(IngestRingWriter *writer) { ring = writer; }
+
+    /**
+     * @brief この fd が IngestServer の管理下か
+     * @param fd ファイルディスクリプタ
+     * @return 管理下なら true
+     */
+    bool owns(int fd) const;
+
+    /**
+     * @brief epoll のイベントを処理
+     * @param fd 対象の fd
+     * @param events epoll のイベントマスク
+     */
+    void handleEvent(int fd, uint32_t events);
+
+    /**
+     * @brief イベントを全購読者に配信（まとめ送信の押下は展開する）
+     * @param event デコード済みイベント
+     * @param arrivalNs 受信時刻
+     */
+    void publish(const ControllerEvent &event, uint64_t arrivalNs);
+
+    /**
+     * @brief リンク状態の変化（LinkUp / LinkDown）を配信
+     * @param kind EventKind::LinkUp または EventKind::LinkDown
+     * @param arrivalNs 発生時刻
+     */
+    void publishLink(EventKind kind, uint64_t arrivalNs);
+
+    size_t getClientCount() const { return clients.size(); }
+    unsigned long getPublishedCount() const { return publishedCount; }
+    unsigned long getDroppedClientCount() const { return droppedClientCount; }
+
+private:
+    /**
+     * @brief 購読者ごとの送受信バッファ
+     */
+    struct Client
+    {
+        std::string rxBuffer; // 未完成のコマンド行
+        std::string txBuffer; // 未送信のレコード
+        bool wantsWrite = false;
+    };
+
+    static const size_t MAX_CLIENT_BACKLOG = 1 << 20; // これを超えて溜まった購読者は切断
+
+    int epollFd;
+    int listenFd = -1;
+    std::string socketPath;
+    std::unordered_map<int, Client> clients;
+    CommandHandler onCommand;
+    IngestRingWriter *ring = nullptr;
+    std::string scratch; // レコード組み立て用（確保を使い回す）
+    unsigned long publishedCount = 0;
+    unsigned long droppedClientCount = 0;
+
+    void acceptClients();
+    void readClient(int fd, Client &client);
+    bool flushClient(int fd, Client &client);
+    void removeClient(int fd);
+    void broadcast(const char *data, size_t length);
+    void deliver(const char *data, size_t length);
+    void appendRecord(std::string &out, const ControllerEvent &event, uint8_t buttonId, uint16_t seq,
+                      uint32_t timestamp, uint16_t flags, uint64_t arrivalNs, std::string_view payload);
+};
+
+#endif // INGEST_SERVER_H
@@ -0,0 +1,161 @@
+/**
+ * @file LineFramer.h
+ * @brief 受信バイト列を改行区切りの行に分割するクラス
+ *
+ * 受信データはこのクラスのバッファに直接読み込み、行はバッファ内を指す
+ * ビューとして取り出す（コピーしない）
+ *
+ * コントローラーが COBS フレーム（ENABLE_COBS_FRAMING）で送ってくる場合は、0x00 で始まるフレームの
+ * CRC が合った時点でフレームモードに切り替え、以降は 0x00 区切りのフレームをその場で復号して本文を行として返す
+ * CRC が合わないフレームは捨てて次の 0x00 から読み直す
+ *
+ * 行モードのコントローラーでもポートを開いたときや自動リセットで 0x00 が紛れ込むため、0x00 だけでは切り替えない
+ * - 行モード: 0x00 から次の 0x00 までが正しいフレームでなければ、0x00 を雑音として捨てて行として読み続ける
+ *   （次の 0x00 が来る前に JSON の行が届いた場合も雑音とみなす）
+ * - フレームモード: 改行で終わる JSON の行が届くか、壊れたフレームが続いた場合は行モードに戻す
+ * clear() で行モードに戻る
+ *
+ * 行・フレームの後ろにバイナリが続く場合（DUMP の blackBox）は、takeRaw() で取り出すか
+ * skipRaw() で読み飛ばす（バイナリは改行や 0x00 を含むため、行として読むと同期を失う）
+ */
+
+#ifndef LINE_FRAMER_H
+#define LINE_FRAMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class LineFramer
+{
+public:
+    /**
+     * @brief コンストラクタ
+     * @param capacity バッファサイズ（1行の最大長）
+     */
+    explicit LineFramer(size_t capacity = 4096);
+
+    /**
+     * @brief 受信データの書き込み先を取得
+     *
+     * 呼び出すと、それまでに取り出した行のビューは無効になる
+     * @return 書き込み先の先頭
+     */
+    char *writePtr();
+
+    /**
+     * @brief 書き込み可能なバイト数を取得（writePtr() の後に呼ぶ）
+     * @return バイト数
+     */
+    size_t writable() const;
+
+    /**
+     * @brief 書き込んだバイト数を確定
+     * @param length バイト数
+     */
+    void commit(size_t length);
+
+    /**
+     * @brief 次の完成した行を取り出す
+     * @param line 行（改行・末尾の\rを除く。フレームモードでは復号した本文）
+     * @return 行がある場合 true
+     */
+    bool next(std::string_view &line);
+
+    /**
+     * @brief 直前に取り出した行・フレームの後ろに続くバイナリを取り出す
+     *
+     * まだ届いていない分は、次の commit() の後に続けて呼んで取り出す
+     * @param dst 書き込み先（nullptr なら読み捨てる）
+     * @param length 取り出したいバイト数
+     * @return 取り出したバイト数
+     */
+    size_t takeRaw(char *dst, size_t length);
+
+    /**
+     * @brief 直前に取り出した行・フレームの後ろに続くバイナリを読み飛ばす
+     *
+     * 読み飛ばしは next() が行う（まだ届いていない分は届いてから読み飛ばす）
+     * @param length バイト数
+     */
+    void skipRaw(size_t length);
+
+    /**
+     * @brief 未完成の行を破棄する（再接続時など）
+     */
+    void clear();
+
+    /**
+     * @brief バッファに収まらず破棄した行数を取得
+     * @return 破棄数
+     */
+    unsigned long getOverflowCount() const { return overflowCount; }
+
+    /**
+     * @brief 壊れていて捨てたフレーム数を取得（フレームモードのみ）
+     * @return 破棄数
+     */
+    unsigned long getBadFrameCount() const { return badFrameCount; }
+
+    /**
+     * @brief フレームモードかどうかを取得
+     * @return COBS フレームを受信している場合 true
+     */
+    bool isFramed() const { return framed; }
+
+private:
+    std::vector<char> buffer;
+    size_t begin = 0;    // 未処理データの先頭
+    size_t end = 0;      // 未処理データの末尾
+    size_t scanPos = 0;  // 区切り探索の再開位置
+    bool discarding = false; // 長すぎる行の残りを読み捨て中
+    bool framed = false;     // COBS フレームを受信中
+    size_t rawRemaining = 0; // 読み飛ばすバイナリの残り（skipRaw）
+    unsigned int badFrameRun = 0; // フレームモードで続けて壊れていたフレームの数
+    std::vector<uint8_t> probe;   // 行モードで見つけたフレームの候補を復号する場所
+    unsigned long overflowCount = 0;
+    unsigned long badFrameCount = 0;
+
+    /**
+     * @brief 行モードで次の行を取り出す（正しいフレームが届いた場合はフレームモードに切り替えて本文を返す）
+     * @param line 行
+     * @return 行がある場合 true
+     */
+    bool nextLine(std::string_view &line);
+
+    /**
+     * @brief フレームモードで次のフレームを取り出す（行モードに戻した場合は false）
+     * @param line 復号した本文
+     * @return フレームがある場合 true
+     */
+    bool nextFrame(std::string_view &line);
+
+    /**
+     * @brief probeFrame() の結果
+     */
+    enum class Probe
+    {
+        Frame, // 正しいフレーム
+        Noise, // フレームではない（0x00 は雑音）
+        Wait   // まだ決められない（続きを待つ）
+    };
+
+    /**
+     * @brief 行モードで見つけた 0x00 から始まるフレームの候補を確かめる
+     * @param zero 0x00 の位置
+     * @param line 正しいフレームの場合は復号した本文
+     * @return 結果
+     */
+    Probe probeFrame(size_t zero, std::string_view &line);
+
+    /**
+     * @brief 範囲に改行で終わる JSON の行があるかを調べる
+     * @param from 先頭
+     * @param to 末尾
+     * @return ある場合 true
+     */
+    bool hasJsonLine(size_t from, size_t to) const;
+};
+
+#endif // LINE_FRAMER_H
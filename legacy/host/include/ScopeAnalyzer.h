@@ -0,0 +1,162 @@
+/**
+ * @file ScopeAnalyzer.h
+ * @brief scope フレーム（SCOPE）からボタンごとの波形を組み立て、バウンスを集計するクラス
+ *
+ * コントローラーはサンプリングした生の入力の変化だけを [差分サンプル数, 押下ビット] の列で送る
+ * 変化の間隔が settle 未満で続いたものを1回の操作（エピソード）としてまとめ、次の値を求める
+ * - 変化の回数・最初から最後の変化までの長さ（span）
+ * - 最短のパルス幅（変化の間隔の最小）・変化の間隔の最大（デバウンス時間はこれより長くする必要がある）
+ * - 向き（押下・解放、元の状態に戻ったものはグリッチ）
+ * 時刻はサンプル番号で、折り返しを展開して 64 ビットで扱う
+ */
+
+#ifndef SCOPE_ANALYZER_H
+#define SCOPE_ANALYZER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ControllerEvent.h"
+
+class ScopeAnalyzer
+{
+public:
+    static const int MAX_BUTTONS = 8;                  // 押下ビットの幅
+    static const size_t MAX_EPISODE_EDGES = 256;      // 1エピソードで波形として覚えておく変化の数
+    static const size_t MAX_QUEUED_EPISODES = 1024;   // popEpisode() されずに溜められるエピソードの数
+
+    /**
+     * @brief エピソードの向き
+     */
+    enum Direction
+    {
+        DIRECTION_PRESS,   // 離された状態から押された状態になった
+        DIRECTION_RELEASE, // 押された状態から離された状態になった
+        DIRECTION_GLITCH   // 元の状態に戻った（ノイズ・接触不良）
+    };
+
+    /**
+     * @brief 1回の操作の変化
+     */
+    struct Episode
+    {
+        uint8_t buttonIndex = 0;
+        Direction direction = DIRECTION_PRESS;
+        bool initialLevel = false;   // 最初の変化の前の状態（true: 押下）
+        uint64_t startTick = 0;      // 最初の変化
+        uint64_t endTick = 0;        // 最後の変化
+        uint32_t edges = 0;          // 変化の回数（1: バウンスなし）
+        uint64_t minPulseTicks = 0;  // 変化の間隔の最小（edges == 1 なら 0）
+        uint64_t maxGapTicks = 0;    // 変化の間隔の最大（edges == 1 なら 0）
+        bool lost = false;           // 途中でコントローラーが変化を取りこぼした
+        std::vector<std::pair<uint64_t, bool>> levels; // 変化（時刻, 変化後の状態）、MAX_EPISODE_EDGES まで
+    };
+
+    /**
+     * @brief ボタンごとの集計
+     */
+    struct ButtonStats
+    {
+        unsigned long presses = 0;
+        unsigned long releases = 0;
+        unsigned long glitches = 0;
+        unsigned long bouncy = 0;     // 変化が2回以上あったエピソード
+        uint64_t edges = 0;           // 変化の総数
+        uint32_t maxEdges = 0;        // 1エピソードの変化の回数の最大
+        uint64_t spanSumTicks = 0;
+        uint64_t maxSpanTicks = 0;
+        uint64_t minPulseTicks = UINT64_MAX;
+        uint64_t maxGapTicks = 0;
+    };
+
+    /**
+     * @brief コンストラクタ
+     * @param settleUs この時間変化がなければエピソードを閉じる（マイクロ秒）
+     */
+    explicit ScopeAnalyzer(uint32_t settleUs);
+
+    /**
+     * @brief scope フレームを取り込む（EventKind::Scope 以外は無視）
+     * @param event デコード済みイベント
+     */
+    void addFrame(const ControllerEvent &event);
+
+    /**
+     * @brief 開いているエピソードを全て閉じる（終了時）
+     */
+    void finish();
+
+    /**
+     * @brief 閉じたエピソードを古い順に取り出す
+     * @param episode 取り出したエピソード
+     * @return エピソードがある場合 true
+     */
+    bool popEpisode(Episode &episode);
+
+    /**
+     * @brief エピソードの波形を1行の文字列にする（'#': 押下、'_': 離されている、'|': 1文字の間に変化あり）
+     * @param episode エピソード
+     * @param width 文字数
+     * @return 波形
+     */
+    std::string render(const Episode &episode, size_t width) const;
+
+    /**
+     * @brief ボタンごとの集計を表示
+     * @param out 出力先
+     */
+    void printSummary(FILE *out) const;
+
+    double ticksToUs(uint64_t ticks) const;
+
+    bool isStarted() const { return started; }
+    uint32_t getSampleRate() const { return sampleRate; }
+    uint8_t getButtonMask() const { return buttonMask; }
+    uint32_t getLostCount() const { return lost; }
+    unsigned long getFrameCount() const { return frameCount; }
+    const ButtonStats &getStats(uint8_t buttonIndex) const { return stats[buttonIndex]; }
+
+private:
+    /**
+     * @brief ボタンごとの開いているエピソード
+     */
+    struct Track
+    {
+        bool level = false; // 現在の状態
+        bool open = false;  // エピソードが開いているか
+        uint64_t lastTick = 0;
+        Episode episode;
+    };
+
+    uint32_t settleUs;
+    uint64_t settleTicks = 0;
+    bool started = false;
+    uint32_t sampleRate = 0;
+    uint8_t buttonMask = 0;
+    uint8_t state = 0;          // 最後の変化の後の押下ビット
+    uint64_t now = 0;           // 折り返しを展開した最後の変化のサンプル番号
+    uint32_t lost = 0;
+    unsigned long frameCount = 0;
+
+    Track tracks[MAX_BUTTONS];
+    ButtonStats stats[MAX_BUTTONS];
+    std::deque<Episode> finished;
+
+    /**
+     * @brief フレームの tick を折り返しを展開したサンプル番号にする
+     */
+    uint64_t extendTick(uint32_t tick) const;
+
+    /**
+     * @brief tick までに settle を過ぎたエピソードを閉じる
+     */
+    void closeSettled(uint64_t tick);
+
+    void addEdge(uint8_t index, uint64_t tick, bool level);
+    void closeEpisode(uint8_t index);
+};
+
+#endif // SCOPE_ANALYZER_H
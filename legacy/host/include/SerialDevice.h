@@ -0,0 +1,64 @@
+/**
+ * @file SerialDevice.h
+ * @brief シリアルデバイス（または pty）をノンブロッキングで扱うクラス
+ */
+
+#ifndef SERIAL_DEVICE_H
+#define SERIAL_DEVICE_H
+
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+class SerialDevice
+{
+public:
+    SerialDevice() = default;
+    ~SerialDevice();
+
+    SerialDevice(const SerialDevice &) = delete;
+    SerialDevice &operator=(const SerialDevice &) = delete;
+
+    /**
+     * @brief デバイスを開き、rawモード・指定ボーレートに設定
+     * @param path デバイスパス（/dev/ttyACM0、pty のスレーブなど）
+     * @param baud ボーレート
+     * @return 成功: true
+     */
+    bool open(const std::string &path, int baud);
+
+    /**
+     * @brief デバイスを閉じる（未送信データは破棄）
+     */
+    void close();
+
+    /**
+     * @brief 読み取り
+     * @param dst 読み込み先
+     * @param length 最大バイト数
+     * @return 読んだバイト数、データなし: -EAGAIN、切断・エラー: 0 または負のerrno
+     */
+    ssize_t readSome(char *dst, size_t length);
+
+    /**
+     * @brief 送信データをキューに積み、送れるだけ送る
+     * @param data 送信データ
+     */
+    void write(std::string_view data);
+
+    /**
+     * @brief キューに残った送信データを送る
+     * @return 全て送れた場合 true
+     */
+    bool flush();
+
+    bool isOpen() const { return fd >= 0; }
+    bool hasPendingOutput() const { return !txBuffer.empty(); }
+    int getFd() const { return fd; }
+
+private:
+    int fd = -1;
+    std::string txBuffer;
+};
+
+#endif // SERIAL_DEVICE_H
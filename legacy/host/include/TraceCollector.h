@@ -0,0 +1,167 @@
+/**
+ * @file TraceCollector.h
+ * @brief 押下から Socket.IO の配信までの区間ごとの遅延を集計するクラス
+ *
+ * シーケンス番号をトレースIDとして、次の時刻を1件のトレースにまとめる
+ * - コントローラー: 入力変化・デバウンス確定・エンコード開始・送信開始（trace フィールド、micros()）
+ * - quiz-ingest: 受信・配信
+ * - サーバー: io.emit の開始・終了（購読者から届く TRACE EMIT 行）
+ *
+ * 時刻はすべて CLOCK_MONOTONIC（Node.js の process.hrtime と同じ時計）にそろえる
+ * コントローラーの時刻は、送信開始から行の受信完了までの最短値を基準にずれを推定して換算する
+ * 結果は Chrome トレース形式の JSON（chrome://tracing、Perfetto で表示可能）に書き出し、
+ * 区間ごとのヒストグラムを latencyHistograms として同じファイルに付ける
+ */
+
+#ifndef TRACE_COLLECTOR_H
+#define TRACE_COLLECTOR_H
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "ControllerEvent.h"
+
+class TraceCollector
+{
+public:
+    /**
+     * @brief 区間
+     */
+    enum Stage
+    {
+        STAGE_DEBOUNCE,     // 入力変化 → デバウンス確定
+        STAGE_BATCH,        // 確定 → エンコード開始（まとめ待ち・ループ待ち）
+        STAGE_TX_QUEUE,     // エンコード開始 → 送信開始（送信バッファ待ち）
+        STAGE_UART,         // 送信開始 → ホストでの受信（回線・USB・カーネル）
+        STAGE_HOST_PARSE,   // 受信 → 配信（quiz-ingest のデコード）
+        STAGE_SERVER_QUEUE, // 配信 → io.emit 開始（ソケット・サーバーの処理）
+        STAGE_FANOUT,       // io.emit 開始 → 終了
+        STAGE_TOTAL,        // 入力変化（不明なら受信）→ io.emit 終了
+        STAGE_COUNT
+    };
+
+    /**
+     * @brief コンストラクタ
+     * @param baud シリアルのボーレート（回線上の転送時間の計算に使う）
+     */
+    explicit TraceCollector(int baud);
+    ~TraceCollector();
+
+    TraceCollector(const TraceCollector &) = delete;
+    TraceCollector &operator=(const TraceCollector &) = delete;
+
+    /**
+     * @brief 出力ファイルを開く
+     * @param path Chrome トレース形式の JSON ファイル
+     * @return 成功: true
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief 未完了のトレースを確定し、ヒストグラムを書いてファイルを閉じる
+     */
+    void close();
+
+    bool isOpen() const { return file != nullptr; }
+
+    /**
+     * @brief デコード済みイベントを登録（まとめ送信の押下は1件ずつのトレースにする）
+     * @param event デコード済みイベント
+     * @param arrivalNs 受信時刻（CLOCK_MONOTONIC）
+     * @param publishedNs 購読者への配信時刻（CLOCK_MONOTONIC）
+     */
+    void addEvent(const ControllerEvent &event, uint64_t arrivalNs, uint64_t publishedNs);
+
+    /**
+     * @brief 購読者から届いた TRACE 行を処理する
+     *
+     * "TRACE EMIT <seq> <開始ns> <終了ns>"（CLOCK_MONOTONIC）
+     * @param line コマンド行
+     * @return TRACE 行だった場合 true（コントローラーへは転送しない）
+     */
+    bool handleCommand(std::string_view line);
+
+    /**
+     * @brief サーバーからの通知が来ないまま一定時間経ったトレースを確定する
+     * @param nowNs 現在時刻（CLOCK_MONOTONIC）
+     */
+    void expire(uint64_t nowNs);
+
+    /**
+     * @brief 区間ごとの件数・平均・パーセンタイルを表示
+     * @param out 出力先
+     */
+    void printSummary(FILE *out) const;
+
+    static const char *stageName(Stage stage);
+
+private:
+    static const int BUCKET_COUNT = 40;                     // log2(マイクロ秒) のバケット数
+    static const uint64_t EMIT_TIMEOUT_NS = 2000000000ULL;  // サーバーの通知を待つ時間
+    static const size_t RECENT_SEQ_COUNT = 256;             // 再送の重複を除くために覚えておく番号の数
+    static constexpr double MAX_CLOCK_SKEW = 2000e-6;       // コントローラーの発振子の誤差の上限
+
+    /**
+     * @brief 区間ごとのヒストグラム
+     */
+    struct Histogram
+    {
+        uint64_t count = 0;
+        uint64_t negative = 0; // 時計の推定誤差で負になった件数（0 として集計）
+        uint64_t sumNs = 0;
+        uint64_t minNs = UINT64_MAX;
+        uint64_t maxNs = 0;
+        uint64_t buckets[BUCKET_COUNT] = {}; // [0]: 1µs 未満、[k]: 2^(k-1)µs 以上 2^k µs 未満
+
+        void add(int64_t ns);
+        uint64_t percentileUpperNs(double p) const;
+    };
+
+    /**
+     * @brief 1件のトレース（時刻は CLOCK_MONOTONIC ナノ秒、0 は不明）
+     */
+    struct Trace
+    {
+        uint16_t seq = 0;
+        uint8_t buttonId = 0;
+        EventKind kind = EventKind::Unknown;
+        int64_t capturedNs = 0;
+        int64_t committedNs = 0;
+        int64_t encodedNs = 0;
+        int64_t txStartNs = 0;
+        int64_t arrivalNs = 0;
+        int64_t publishedNs = 0;
+        int64_t emitStartNs = 0;
+        int64_t emitEndNs = 0;
+    };
+
+    int baud;
+    FILE *file = nullptr;
+    int64_t originNs = -1;   // 出力の時刻の基準（最初のイベントの受信時刻）
+    uint32_t namedThreads = 0; // thread_name を書いたボタン（bit = ボタンID）
+
+    // コントローラーの時刻の換算
+    bool synced = false;
+    uint64_t controllerUs = 0; // 折り返しを展開した最後の送信開始時刻
+    int64_t offsetNs = 0;      // ホスト時刻 - コントローラー時刻 の推定値
+    int64_t offsetAtNs = 0;    // offsetNs を更新したホスト時刻
+
+    std::unordered_map<uint16_t, Trace> pending; // サーバーの通知待ち（押下のみ）
+    std::deque<uint16_t> recentSeqs;
+    Histogram histograms[STAGE_COUNT];
+    unsigned long unmatchedEmits = 0;
+
+    uint64_t extendControllerTime(uint32_t us) const;
+    void updateOffset(uint64_t txStartUs, int64_t sampleNs, int64_t nowNs);
+    int64_t toHostNs(uint32_t us) const;
+    bool seenRecently(uint16_t seq) const;
+    void finalize(const Trace &trace);
+    void addSpan(Stage stage, const Trace &trace, int64_t startNs, int64_t endNs);
+    void writeThreadName(uint8_t buttonId);
+    void writeHistograms();
+};
+
+#endif // TRACE_COLLECTOR_H
@@ -0,0 +1,101 @@
+/**
+ * @file CaptureReader.cpp
+ * @brief 記録ファイル読み出しクラスの実装
+ */
+
+#include "CaptureReader.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CaptureEvent CaptureRecord::eventAt(uint8_t index) const
+{
+    CaptureEvent event;
+    std::memcpy(&event, events + index * sizeof(CaptureEvent), sizeof(event));
+    return event;
+}
+
+CaptureReader::~CaptureReader()
+{
+    unmap();
+}
+
+bool CaptureReader::open(const std::string &path)
+{
+    unmap();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(CaptureFileHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+    data = static_cast<const char *>(mapped);
+    size = static_cast<size_t>(st.st_size);
+
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != CAPTURE_VERSION ||
+        header.headerSize < sizeof(CaptureFileHeader) || header.headerSize > size)
+    {
+        unmap();
+        return false;
+    }
+    rewind();
+    return true;
+}
+
+bool CaptureReader::next(CaptureRecord &record)
+{
+    if (data == nullptr || size - offset < sizeof(CaptureRecordHeader))
+    {
+        truncated = data != nullptr && offset != size;
+        return false;
+    }
+
+    CaptureRecordHeader recordHeader;
+    std::memcpy(&recordHeader, data + offset, sizeof(recordHeader));
+    size_t expected = sizeof(recordHeader) + recordHeader.rawLength + recordHeader.eventCount * sizeof(CaptureEvent);
+    if (recordHeader.length != expected || size - offset < expected)
+    {
+        truncated = true;
+        return false;
+    }
+
+    const char *body = data + offset + sizeof(recordHeader);
+    record.arrivalNs = recordHeader.arrivalNs;
+    record.raw = std::string_view(body, recordHeader.rawLength);
+    record.eventCount = recordHeader.eventCount;
+    record.events = body + recordHeader.rawLength;
+    offset += expected;
+    return true;
+}
+
+void CaptureReader::rewind()
+{
+    offset = header.headerSize;
+    truncated = false;
+}
+
+void CaptureReader::unmap()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<char *>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+}
@@ -0,0 +1,175 @@
+/**
+ * @file CaptureWriter.cpp
+ * @brief 記録ファイル書き込みクラスの実装
+ */
+
+#include "CaptureWriter.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "IngestRecord.h"
+
+namespace
+{
+
+/**
+ * @brief 全て書き切るまで write() を繰り返す
+ */
+bool writeAll(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t n = ::write(fd, data, length);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+int toCaptureEvents(const ControllerEvent &event, CaptureEvent *out)
+{
+    CaptureEvent base;
+    std::memset(&base, 0, sizeof(base));
+    base.kind = static_cast<uint8_t>(event.kind);
+    base.flags = event.hasSeq ? INGEST_FLAG_HAS_SEQ : 0;
+    base.from = event.from;
+    base.seq = event.seq;
+    base.timestamp = event.timestamp;
+
+    if (event.kind != EventKind::ButtonPress)
+    {
+        out[0] = base;
+        return 1;
+    }
+
+    if (event.pressCount > 1)
+    {
+        base.flags |= INGEST_FLAG_BATCHED;
+    }
+    for (uint8_t i = 0; i < event.pressCount; i++)
+    {
+        out[i] = base;
+        out[i].buttonId = event.presses[i].buttonId;
+        out[i].seq = static_cast<uint16_t>(event.seq + i);
+        out[i].timestamp = event.timestamp + event.presses[i].offsetMs;
+    }
+    return event.pressCount;
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const std::string &path, int baud)
+{
+    close();
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0)
+    {
+        timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+
+        CaptureFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+        header.version = CAPTURE_VERSION;
+        header.headerSize = sizeof(header);
+        header.baud = static_cast<uint32_t>(baud);
+        header.createdUnixNs = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+        if (!writeAll(fd, reinterpret_cast<const char *>(&header), sizeof(header)))
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void CaptureWriter::beginRecord(uint64_t arrivalNs, std::string_view raw)
+{
+    if (raw.size() > 0xFFFF)
+    {
+        raw = raw.substr(0, 0xFFFF);
+    }
+
+    CaptureRecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.arrivalNs = arrivalNs;
+    header.rawLength = static_cast<uint16_t>(raw.size());
+
+    record.clear();
+    record.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    record.append(raw.data(), raw.size());
+    eventCount = 0;
+}
+
+void CaptureWriter::addEvent(const ControllerEvent &event)
+{
+    CaptureEvent expanded[ControllerEvent::MAX_PRESSES];
+    int count = toCaptureEvents(event, expanded);
+    for (int i = 0; i < count && eventCount < 0xFF; i++)
+    {
+        record.append(reinterpret_cast<const char *>(&expanded[i]), sizeof(CaptureEvent));
+        eventCount++;
+    }
+}
+
+void CaptureWriter::endRecord()
+{
+    if (fd < 0 || record.size() < sizeof(CaptureRecordHeader))
+    {
+        return;
+    }
+
+    // 長さとイベント数はレコードの完成時に確定する
+    CaptureRecordHeader *header = reinterpret_cast<CaptureRecordHeader *>(&record[0]);
+    header->length = static_cast<uint32_t>(record.size());
+    header->eventCount = eventCount;
+
+    // O_APPEND + 1回の write() でレコード単位に追記する
+    if (writeAll(fd, record.data(), record.size()))
+    {
+        recordCount++;
+    }
+    record.clear();
+}
+
+void CaptureWriter::writeLink(EventKind kind, uint64_t arrivalNs)
+{
+    ControllerEvent event;
+    event.kind = kind;
+    beginRecord(arrivalNs, std::string_view());
+    addEvent(event);
+    endRecord();
+}
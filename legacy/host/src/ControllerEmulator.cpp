@@ -0,0 +1,488 @@
+/**
+ * @file ControllerEmulator.cpp
+ * @brief コントローラーのプロトコルエミュレーターの実装
+ */
+
+#include "ControllerEmulator.h"
+
+#include <QuizFraming.h>
+
+#include <cstdlib>
+
+namespace
+{
+/**
+ * @brief FrameEncoder の出力先（文字列に追記する）
+ */
+struct StringOutput
+{
+    std::string &target;
+
+    void write(uint8_t byte) { target.push_back(static_cast<char>(byte)); }
+};
+} // namespace
+
+ControllerEmulator::ControllerEmulator(const Config &config, FrameSink sink)
+    : config(config), sink(std::move(sink))
+{
+    pending.reserve(config.window);
+    pressOrder.reserve(config.buttonCount);
+}
+
+void ControllerEmulator::boot(uint64_t nowNs)
+{
+    bootNs = nowNs;
+    pending.clear();
+    unsentCount = 0;
+    batchStartedAt = 0;
+    nextSeq = 0;
+    peerAcks = false;
+    round = 0;
+    pressOrder.clear();
+    subscribed = false;
+
+    emit(EVENT_SYSTEM_READY, 0, nullptr, nowNs);
+}
+
+bool ControllerEmulator::isPressed(uint8_t buttonId) const
+{
+    for (uint8_t id : pressOrder)
+    {
+        if (id == buttonId)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ControllerEmulator::press(uint8_t buttonId, uint64_t nowNs)
+{
+    if (buttonId < 1 || buttonId > config.buttonCount || isPressed(buttonId))
+    {
+        return false;
+    }
+    pressOrder.push_back(buttonId);
+    emit(EVENT_BUTTON_PRESS, buttonId, nullptr, nowNs);
+    return true;
+}
+
+void ControllerEmulator::resetRound(uint64_t nowNs)
+{
+    pressOrder.clear();
+    round++;
+    emit(EVENT_SYSTEM_RESET, 0, nullptr, nowNs);
+}
+
+void ControllerEmulator::handleCommand(std::string_view command, uint64_t nowNs)
+{
+    // main.cpp の processSerialCommand() と同じく前後の空白を除いて比較する
+    while (!command.empty() && (command.front() == ' ' || command.front() == '\t'))
+    {
+        command.remove_prefix(1);
+    }
+    while (!command.empty() && (command.back() == ' ' || command.back() == '\t' || command.back() == '\r'))
+    {
+        command.remove_suffix(1);
+    }
+    if (command.empty())
+    {
+        return;
+    }
+
+    if (command == "RESET")
+    {
+        resetRound(nowNs);
+    }
+    else if (command == "STATUS")
+    {
+        sendStatus(nowNs);
+    }
+    else if (command == "CONFIG")
+    {
+        sendConfig(nowNs);
+    }
+    else if (command.substr(0, 4) == "ACK ")
+    {
+        // String::toInt() と同じく数値でなければ 0
+        std::string number(command.substr(4));
+        acknowledge(static_cast<uint16_t>(std::atol(number.c_str())), nowNs);
+    }
+    else if (command == "RESYNC")
+    {
+        resync(nowNs);
+    }
+    else if (command == "SUBSCRIBE")
+    {
+        subscribed = true;
+        stateVersion++;
+        sendState("state", true, nowNs);
+        lastHeartbeatAt = lastDeltaAt;
+    }
+    else if (command == "UNSUBSCRIBE")
+    {
+        subscribed = false;
+    }
+    else
+    {
+        emit(EVENT_ERROR, 0, "Unknown command", nowNs);
+    }
+}
+
+void ControllerEmulator::update(uint64_t nowNs)
+{
+    unsigned long now = millisAt(nowNs);
+
+    if (unsentCount > 0 && now - batchStartedAt >= config.batchWindowMs)
+    {
+        flush(nowNs);
+    }
+
+    size_t sentCount = pending.size() - unsentCount;
+    if (retransmitPending() && now - pending.front().lastSentAt >= retransmitTimeout())
+    {
+        writeRange(0, sentCount, nowNs);
+        retransmitCount += sentCount;
+        retransmitAttempts++;
+    }
+
+    if (subscribed)
+    {
+        bool changed = round != sentRound || pressOrder.size() != sentPressCount;
+        if (changed && unsentCount == 0 && now - lastDeltaAt >= config.deltaMinIntervalMs)
+        {
+            stateVersion++;
+            sendState("stateDelta", false, nowNs);
+        }
+        else if (now - lastHeartbeatAt >= config.heartbeatIntervalMs)
+        {
+            sendState("heartbeat", false, nowNs);
+            lastHeartbeatAt = now;
+        }
+    }
+}
+
+uint64_t ControllerEmulator::nextDeadlineNs() const
+{
+    const uint64_t msNs = 1000000ULL;
+    uint64_t deadline = UINT64_MAX;
+    auto consider = [&](unsigned long atMs) {
+        uint64_t ns = bootNs + static_cast<uint64_t>(atMs) * msNs;
+        deadline = ns < deadline ? ns : deadline;
+    };
+
+    if (unsentCount > 0)
+    {
+        consider(batchStartedAt + config.batchWindowMs);
+    }
+    if (retransmitPending())
+    {
+        consider(pending.front().lastSentAt + retransmitTimeout());
+    }
+    if (subscribed)
+    {
+        if (round != sentRound || pressOrder.size() != sentPressCount)
+        {
+            consider(lastDeltaAt + config.deltaMinIntervalMs);
+        }
+        consider(lastHeartbeatAt + config.heartbeatIntervalMs);
+    }
+    return deadline;
+}
+
+bool ControllerEmulator::retransmitPending() const
+{
+    // 上限まで再送しても ACK が来ない場合は、次の ACK・RESYNC まで再送しない
+    return peerAcks && pending.size() > unsentCount && retransmitAttempts < config.retransmitMaxAttempts;
+}
+
+unsigned long ControllerEmulator::retransmitTimeout() const
+{
+    // ACK が来ないまま再送するたびに2倍
+    return static_cast<unsigned long>(config.retransmitTimeoutMs) << retransmitAttempts;
+}
+
+unsigned long ControllerEmulator::millisAt(uint64_t nowNs) const
+{
+    // millis() と同じく 32bit で折り返す
+    return static_cast<unsigned long>(static_cast<uint32_t>((nowNs - bootNs) / 1000000ULL));
+}
+
+void ControllerEmulator::emit(EventType type, uint8_t buttonId, const char *message, uint64_t nowNs)
+{
+    PendingEvent event;
+    event.seq = nextSeq++;
+    event.type = type;
+    event.buttonId = buttonId;
+    event.round = round;
+    event.timestamp = millisAt(nowNs);
+    event.message = message;
+    event.lastSentAt = event.timestamp;
+    event.firstSentNs = 0;
+
+    // 押下以外のイベントは、順序を保つためまとめ待ちの押下を先に送る
+    if (type != EVENT_BUTTON_PRESS && unsentCount > 0)
+    {
+        flush(nowNs);
+    }
+
+    enqueue(event, nowNs);
+
+    if (type == EVENT_BUTTON_PRESS)
+    {
+        if (unsentCount == 1)
+        {
+            batchStartedAt = event.timestamp;
+        }
+        if (config.batchWindowMs == 0)
+        {
+            flush(nowNs);
+        }
+        return;
+    }
+    flush(nowNs);
+}
+
+void ControllerEmulator::enqueue(const PendingEvent &event, uint64_t nowNs)
+{
+    if (pending.size() == config.window)
+    {
+        if (unsentCount == pending.size())
+        {
+            flush(nowNs);
+        }
+        if (pending.size() == config.window)
+        {
+            // ウィンドウが満杯の場合は最古のイベントを破棄（ホストは番号の欠落で検知できる）
+            pending.erase(pending.begin());
+            droppedCount++;
+        }
+    }
+    pending.push_back(event);
+    unsentCount++;
+}
+
+void ControllerEmulator::flush(uint64_t nowNs)
+{
+    if (unsentCount == 0)
+    {
+        return;
+    }
+    writeRange(pending.size() - unsentCount, unsentCount, nowNs);
+    unsentCount = 0;
+}
+
+void ControllerEmulator::writeRange(size_t first, size_t count, uint64_t nowNs)
+{
+    size_t end = first + count;
+    size_t i = first;
+    while (i < end)
+    {
+        // 連続した押下イベントを数える（連番の範囲に限る）
+        size_t run = 1;
+        if (pending[i].type == EVENT_BUTTON_PRESS)
+        {
+            while (i + run < end && pending[i + run].type == EVENT_BUTTON_PRESS &&
+                   pending[i + run].seq == static_cast<uint16_t>(pending[i].seq + run))
+            {
+                run++;
+            }
+        }
+
+        if (run == 1)
+        {
+            writeEvent(pending[i]);
+        }
+        else
+        {
+            writePressBatch(i, run);
+        }
+
+        unsigned long now = millisAt(nowNs);
+        for (size_t j = 0; j < run; j++)
+        {
+            pending[i + j].lastSentAt = now;
+            if (pending[i + j].firstSentNs == 0)
+            {
+                pending[i + j].firstSentNs = nowNs;
+            }
+        }
+        i += run;
+    }
+}
+
+void ControllerEmulator::writeEvent(const PendingEvent &event)
+{
+    switch (event.type)
+    {
+    case EVENT_BUTTON_PRESS:
+        line = "{\"type\":\"pressedButton\",\"buttonId\":" + std::to_string(event.buttonId);
+        line += ",\"round\":" + std::to_string(event.round);
+        break;
+    case EVENT_SYSTEM_RESET:
+        line = "{\"type\":\"systemReset\",\"round\":" + std::to_string(event.round);
+        break;
+    case EVENT_ERROR:
+        line = "{\"type\":\"error\",\"message\":\"";
+        line += event.message;
+        line += '"';
+        break;
+    case EVENT_SYSTEM_READY:
+        line = "{\"type\":\"systemReady\",\"version\":\"1.0.0\"";
+        break;
+    }
+    line += ",\"timestamp\":" + std::to_string(event.timestamp);
+    line += ",\"seq\":" + std::to_string(event.seq) + "}";
+    send();
+}
+
+void ControllerEmulator::writePressBatch(size_t first, size_t count)
+{
+    const PendingEvent &head = pending[first];
+    line = "{\"type\":\"pressedButtons\",\"round\":" + std::to_string(head.round);
+    line += ",\"timestamp\":" + std::to_string(head.timestamp) + ",\"presses\":[";
+    for (size_t i = 0; i < count; i++)
+    {
+        const PendingEvent &event = pending[first + i];
+        line += i == 0 ? "[" : ",[";
+        line += std::to_string(event.buttonId) + "," + std::to_string(event.timestamp - head.timestamp) + "]";
+    }
+    line += "],\"seq\":" + std::to_string(head.seq) + "}";
+    send();
+}
+
+void ControllerEmulator::acknowledge(uint16_t seq, uint64_t nowNs)
+{
+    peerAcks = true;
+    retransmitAttempts = 0;
+
+    // 累積ACK: seq 以前の送信済みイベントを全てウィンドウから外す
+    size_t sentCount = pending.size() - unsentCount;
+    size_t acked = 0;
+    while (acked < sentCount && static_cast<int16_t>(seq - pending[acked].seq) >= 0)
+    {
+        if (onAck)
+        {
+            onAck(pending[acked].type == EVENT_BUTTON_PRESS ? pending[acked].buttonId : 0,
+                  nowNs - pending[acked].firstSentNs);
+        }
+        acked++;
+    }
+    pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(acked));
+    ackedCount += acked;
+}
+
+void ControllerEmulator::resync(uint64_t nowNs)
+{
+    peerAcks = true;
+    retransmitAttempts = 0;
+
+    // 再送の起点を先に通知する（これより前の番号は既に破棄済み）
+    uint16_t from = pending.empty() ? nextSeq : pending.front().seq;
+    line = "{\"type\":\"resync\",\"from\":" + std::to_string(from) +
+           ",\"timestamp\":" + std::to_string(millisAt(nowNs)) + "}";
+    send();
+
+    // まとめ待ちの押下も含めて全て送る
+    writeRange(0, pending.size(), nowNs);
+    unsentCount = 0;
+}
+
+void ControllerEmulator::sendStatus(uint64_t nowNs)
+{
+    line = "{\"type\":\"status\",\"active\":true,\"pressed\":";
+    line += pressOrder.empty() ? "false" : "true";
+    line += ",\"firstButton\":" + std::to_string(pressOrder.empty() ? 0 : pressOrder.front());
+    line += ",\"missedDeadlines\":0,\"sampleOverflows\":0,\"timestamp\":" + std::to_string(millisAt(nowNs)) + "}";
+    send();
+}
+
+void ControllerEmulator::sendConfig(uint64_t nowNs)
+{
+    line = "{\"type\":\"config\",\"buttonCount\":" + std::to_string(config.buttonCount);
+    line += ",\"ledEnabled\":true,\"sampleRate\":" + std::to_string(config.sampleRate);
+    line += ",\"timestamp\":" + std::to_string(millisAt(nowNs)) + "}";
+    send();
+}
+
+void ControllerEmulator::sendState(const char *type, bool full, uint64_t nowNs)
+{
+    bool heartbeat = std::string_view(type) == "heartbeat";
+    bool roundChanged = full || round != sentRound;
+    bool pressedChanged = roundChanged || pressOrder.size() != sentPressCount;
+
+    line = "{\"type\":\"";
+    line += type;
+    line += "\",\"version\":" + std::to_string(stateVersion);
+    if (!heartbeat)
+    {
+        if (full)
+        {
+            line += ",\"active\":true";
+        }
+        if (roundChanged)
+        {
+            line += ",\"round\":" + std::to_string(round);
+        }
+        if (pressedChanged)
+        {
+            appendPressed();
+        }
+    }
+    if (full || heartbeat)
+    {
+        appendHealth();
+    }
+    line += ",\"timestamp\":" + std::to_string(millisAt(nowNs)) + "}";
+    send();
+
+    if (!heartbeat)
+    {
+        sentRound = round;
+        sentPressCount = pressOrder.size();
+        lastDeltaAt = millisAt(nowNs);
+    }
+}
+
+void ControllerEmulator::appendPressed()
+{
+    line += ",\"pressed\":[";
+    for (size_t i = 0; i < pressOrder.size(); i++)
+    {
+        line += (i == 0 ? "" : ",") + std::to_string(pressOrder[i]);
+    }
+    line += "]";
+}
+
+void ControllerEmulator::appendHealth()
+{
+    line += ",\"missedDeadlines\":0,\"sampleOverflows\":0,\"pending\":" + std::to_string(pending.size());
+    line += ",\"retransmits\":" + std::to_string(retransmitCount);
+    line += ",\"dropped\":" + std::to_string(droppedCount);
+}
+
+void ControllerEmulator::send()
+{
+    if (!config.cobsFraming)
+    {
+        line += "\r\n"; // Serial.println() と同じ改行
+        sink(line);
+        return;
+    }
+
+    // ファームウェアの SerialCommunicator::writeFrame() と同じく、CRC を求めてから符号化する
+    FrameChecksum checksum;
+    for (char c : line)
+    {
+        checksum.update(static_cast<uint8_t>(c));
+    }
+    framed.clear();
+    StringOutput output{framed};
+    FrameEncoder<StringOutput> encoder(output, checksum.getLength(), checksum.getCrc());
+    for (char c : line)
+    {
+        encoder.put(static_cast<uint8_t>(c));
+    }
+    encoder.finish();
+    sink(framed);
+}
@@ -0,0 +1,485 @@
+/**
+ * @file EventDecoder.cpp
+ * @brief コントローラーのJSON行デコーダーの実装
+ */
+
+#include "EventDecoder.h"
+
+#include <cstdint>
+
+namespace
+{
+
+/**
+ * @brief 1行分のJSONを先頭から読み進めるスキャナ
+ *
+ * 文字列はエスケープを解除せず、元のバッファを指すビューとして返す
+ */
+class Scanner
+{
+public:
+    explicit Scanner(std::string_view text)
+        : cur(text.data()), end(text.data() + text.size()) {}
+
+    void skipWhitespace()
+    {
+        while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\n'))
+        {
+            cur++;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skipWhitespace();
+        if (cur < end && *cur == c)
+        {
+            cur++;
+            return true;
+        }
+        return false;
+    }
+
+    bool atEnd()
+    {
+        skipWhitespace();
+        return cur == end;
+    }
+
+    bool readString(std::string_view &out)
+    {
+        if (!consume('"'))
+        {
+            return false;
+        }
+        const char *start = cur;
+        while (cur < end && *cur != '"')
+        {
+            if (*cur == '\\')
+            {
+                cur++; // エスケープされた文字を読み飛ばす
+            }
+            cur++;
+        }
+        if (cur >= end)
+        {
+            return false;
+        }
+        out = std::string_view(start, cur - start);
+        cur++;
+        return true;
+    }
+
+    bool readInteger(int64_t &out)
+    {
+        skipWhitespace();
+        bool negative = false;
+        if (cur < end && *cur == '-')
+        {
+            negative = true;
+            cur++;
+        }
+        if (cur >= end || *cur < '0' || *cur > '9')
+        {
+            return false;
+        }
+        int64_t value = 0;
+        while (cur < end && *cur >= '0' && *cur <= '9')
+        {
+            value = value * 10 + (*cur - '0');
+            cur++;
+        }
+        // 小数部・指数部は切り捨てる
+        while (cur < end && (*cur == '.' || *cur == 'e' || *cur == 'E' || *cur == '+' || *cur == '-' ||
+                             (*cur >= '0' && *cur <= '9')))
+        {
+            cur++;
+        }
+        out = negative ? -value : value;
+        return true;
+    }
+
+    bool readBool(bool &out)
+    {
+        skipWhitespace();
+        std::string_view rest(cur, end - cur);
+        if (rest.substr(0, 4) == "true")
+        {
+            out = true;
+            cur += 4;
+            return true;
+        }
+        if (rest.substr(0, 5) == "false")
+        {
+            out = false;
+            cur += 5;
+            return true;
+        }
+        return false;
+    }
+
+    bool skipValue()
+    {
+        skipWhitespace();
+        if (cur >= end)
+        {
+            return false;
+        }
+        if (*cur == '"')
+        {
+            std::string_view ignored;
+            return readString(ignored);
+        }
+        if (*cur == '{' || *cur == '[')
+        {
+            char close = (*cur == '{') ? '}' : ']';
+            cur++;
+            if (consume(close))
+            {
+                return true;
+            }
+            do
+            {
+                if (close == '}')
+                {
+                    std::string_view key;
+                    if (!readString(key) || !consume(':'))
+                    {
+                        return false;
+                    }
+                }
+                if (!skipValue())
+                {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(close);
+        }
+        // 数値・true・false・null
+        const char *start = cur;
+        while (cur < end && *cur != ',' && *cur != '}' && *cur != ']' && *cur != ' ')
+        {
+            cur++;
+        }
+        return cur > start;
+    }
+
+private:
+    const char *cur;
+    const char *end;
+};
+
+/**
+ * @brief "presses": [[id, dt], ...] を読み取る
+ */
+bool readPresses(Scanner &scanner, ControllerEvent &event)
+{
+    if (!scanner.consume('['))
+    {
+        return false;
+    }
+    if (scanner.consume(']'))
+    {
+        return true;
+    }
+    do
+    {
+        int64_t buttonId = 0;
+        int64_t offset = 0;
+        if (!scanner.consume('[') || !scanner.readInteger(buttonId) || !scanner.consume(',') ||
+            !scanner.readInteger(offset) || !scanner.consume(']'))
+        {
+            return false;
+        }
+        if (event.pressCount < ControllerEvent::MAX_PRESSES)
+        {
+            event.presses[event.pressCount].buttonId = static_cast<uint8_t>(buttonId);
+            event.presses[event.pressCount].offsetMs = static_cast<uint32_t>(offset);
+            event.pressCount++;
+        }
+    } while (scanner.consume(','));
+    return scanner.consume(']');
+}
+
+/**
+ * @brief "trace": [encode, txStart, captured, committed, ...] を読み取る
+ */
+bool readTrace(Scanner &scanner, ControllerEvent &event)
+{
+    if (!scanner.consume('['))
+    {
+        return false;
+    }
+    if (scanner.consume(']'))
+    {
+        return true;
+    }
+    do
+    {
+        int64_t value = 0;
+        if (!scanner.readInteger(value))
+        {
+            return false;
+        }
+        if (event.traceCount < ControllerEvent::MAX_TRACE)
+        {
+            event.trace[event.traceCount++] = static_cast<uint32_t>(value);
+        }
+    } while (scanner.consume(','));
+    return scanner.consume(']');
+}
+
+/**
+ * @brief "edges": [dt, mask, dt, mask, ...] を読み取る
+ */
+bool readEdges(Scanner &scanner, ControllerEvent &event)
+{
+    if (!scanner.consume('['))
+    {
+        return false;
+    }
+    if (scanner.consume(']'))
+    {
+        return true;
+    }
+    do
+    {
+        int64_t delta = 0;
+        int64_t mask = 0;
+        if (!scanner.readInteger(delta) || !scanner.consume(',') || !scanner.readInteger(mask))
+        {
+            return false;
+        }
+        if (event.edgeCount < ControllerEvent::MAX_SCOPE_EDGES)
+        {
+            event.edges[event.edgeCount].deltaTicks = static_cast<uint32_t>(delta);
+            event.edges[event.edgeCount].mask = static_cast<uint8_t>(mask);
+            event.edgeCount++;
+        }
+    } while (scanner.consume(','));
+    return scanner.consume(']');
+}
+
+EventKind kindFromType(std::string_view type)
+{
+    if (type == "pressedButton" || type == "pressedButtons")
+    {
+        return EventKind::ButtonPress;
+    }
+    if (type == "systemReset")
+    {
+        return EventKind::SystemReset;
+    }
+    if (type == "error")
+    {
+        return EventKind::Error;
+    }
+    if (type == "systemReady")
+    {
+        return EventKind::SystemReady;
+    }
+    if (type == "resync")
+    {
+        return EventKind::Resync;
+    }
+    if (type == "recovered")
+    {
+        return EventKind::Recovered;
+    }
+    if (type == "debug")
+    {
+        return EventKind::Debug;
+    }
+    if (type == "armed")
+    {
+        return EventKind::Armed;
+    }
+    if (type == "falseStart")
+    {
+        return EventKind::FalseStart;
+    }
+    if (type == "scope")
+    {
+        return EventKind::Scope;
+    }
+    if (type == "answerTimeout")
+    {
+        return EventKind::AnswerTimeout;
+    }
+    if (type == "gesture")
+    {
+        return EventKind::Gesture;
+    }
+    if (type == "status" || type == "config" || type == "state" || type == "stateDelta" || type == "heartbeat" ||
+        type == "calibration" || type == "analytics" || type == "debounce" || type == "blackBox" ||
+        type == "answerTimer")
+    {
+        return EventKind::Status;
+    }
+    return EventKind::Unknown;
+}
+
+} // namespace
+
+bool EventDecoder::decode(std::string_view line, ControllerEvent &event)
+{
+    event = ControllerEvent();
+    event.raw = line;
+
+    Scanner scanner(line);
+    std::string_view type;
+    int64_t buttonId = 0;
+    bool ok = scanner.consume('{');
+
+    if (ok && !scanner.consume('}'))
+    {
+        do
+        {
+            std::string_view key;
+            if (!scanner.readString(key) || !scanner.consume(':'))
+            {
+                ok = false;
+                break;
+            }
+
+            int64_t number = 0;
+            if (key == "type")
+            {
+                ok = scanner.readString(type);
+            }
+            else if (key == "seq")
+            {
+                ok = scanner.readInteger(number);
+                event.hasSeq = true;
+                event.seq = static_cast<uint16_t>(number);
+            }
+            else if (key == "timestamp")
+            {
+                ok = scanner.readInteger(number);
+                event.timestamp = static_cast<uint32_t>(number);
+            }
+            else if (key == "buttonId")
+            {
+                ok = scanner.readInteger(buttonId);
+            }
+            else if (key == "round")
+            {
+                ok = scanner.readInteger(number);
+                event.hasRound = true;
+                event.round = static_cast<uint16_t>(number);
+            }
+            else if (key == "from")
+            {
+                ok = scanner.readInteger(number);
+                event.from = static_cast<uint16_t>(number);
+            }
+            else if (key == "message")
+            {
+                ok = scanner.readString(event.message);
+            }
+            else if (key == "presses")
+            {
+                ok = readPresses(scanner, event);
+            }
+            else if (key == "trace")
+            {
+                ok = readTrace(scanner, event);
+            }
+            else if (key == "edges" && type == "scope")
+            {
+                // debounce の edges（ボタンごとの平均）とは形式が違うため、type の後に来た scope のものだけ読む
+                ok = readEdges(scanner, event);
+            }
+            else if (key == "tick")
+            {
+                ok = scanner.readInteger(number);
+                event.tick = static_cast<uint32_t>(number);
+            }
+            else if (key == "lost")
+            {
+                ok = scanner.readInteger(number);
+                event.lost = static_cast<uint32_t>(number);
+            }
+            else if (key == "rate")
+            {
+                ok = scanner.readInteger(number);
+                event.sampleRate = static_cast<uint32_t>(number);
+            }
+            else if (key == "mask")
+            {
+                ok = scanner.readInteger(number);
+                event.scopeMask = static_cast<uint8_t>(number);
+            }
+            else if (key == "bytes" && type == "blackBox")
+            {
+                ok = scanner.readInteger(number);
+                event.rawBytes = static_cast<uint32_t>(number);
+            }
+            else if (key == "crc" && type == "blackBox")
+            {
+                ok = scanner.readInteger(number);
+                event.rawCrc = static_cast<uint16_t>(number);
+            }
+            else if (key == "gesture" && type == "gesture")
+            {
+                // 他のフレームの項目と取り違えないよう、gesture の項目は type の後に来たものだけ読む
+                std::string_view gesture;
+                ok = scanner.readString(gesture);
+                event.longPress = gesture == "long";
+            }
+            else if (key == "taps" && type == "gesture")
+            {
+                ok = scanner.readInteger(number);
+                event.taps = static_cast<uint8_t>(number);
+            }
+            else if (key == "hold" && type == "gesture")
+            {
+                ok = scanner.readInteger(number);
+                event.hold = static_cast<uint16_t>(number);
+            }
+            else if (key == "total" && type == "gesture")
+            {
+                ok = scanner.readInteger(number);
+                event.total = static_cast<uint16_t>(number);
+            }
+            else if (key == "start")
+            {
+                ok = scanner.readBool(event.scopeStart);
+            }
+            else if (key == "end")
+            {
+                ok = scanner.readBool(event.scopeEnd);
+            }
+            else
+            {
+                ok = scanner.skipValue();
+            }
+        } while (ok && scanner.consume(','));
+
+        ok = ok && scanner.consume('}');
+    }
+
+    if (!ok || !scanner.atEnd())
+    {
+        event = ControllerEvent();
+        event.raw = line;
+        malformedCount++;
+        return false;
+    }
+
+    event.kind = kindFromType(type);
+
+    // 単発の押下も presses の1件として扱う
+    if (type == "pressedButton")
+    {
+        event.presses[0].buttonId = static_cast<uint8_t>(buttonId);
+        event.presses[0].offsetMs = 0;
+        event.pressCount = 1;
+    }
+    else if (event.kind == EventKind::FalseStart || event.kind == EventKind::AnswerTimeout ||
+             event.kind == EventKind::Gesture)
+    {
+        event.buttonId = static_cast<uint8_t>(buttonId);
+    }
+    return true;
+}
@@ -0,0 +1,402 @@
+/**
+ * @file IngestRing.cpp
+ * @brief 共有メモリのリングバッファの実装
+ */
+
+#include "IngestRing.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include "Clock.h"
+
+namespace
+{
+
+// スロットの先頭はシーケンス番号（0: 書き込み中・未使用、それ以外: 位置 + 1）、その後ろにレコード
+const size_t SLOT_DATA_OFFSET = sizeof(std::atomic<uint64_t>);
+const size_t MAX_RECORD_LENGTH = INGEST_RING_SLOT_SIZE - SLOT_DATA_OFFSET;
+const size_t SLOTS_OFFSET = (sizeof(IngestRingHeader) + 63) & ~static_cast<size_t>(63);
+
+// 眠る前に回って待つ時間（書き込みが続いている間は眠らず、書き手に起こしてもらう必要をなくす）
+// CPU が1つの場合は回っている間に書き手が動けないため、すぐ眠る
+const uint64_t WAIT_SPIN_NS = 20000;
+const bool SPIN_BEFORE_SLEEP = std::thread::hardware_concurrency() > 1;
+
+static_assert(INGEST_RING_SLOT_SIZE % 64 == 0, "Slots must not share cache lines");
+static_assert(MAX_RECORD_LENGTH >= sizeof(IngestRecordHeader), "A slot must hold a record header");
+
+size_t ringSize(uint32_t slotCount)
+{
+    return SLOTS_OFFSET + static_cast<size_t>(slotCount) * INGEST_RING_SLOT_SIZE;
+}
+
+std::atomic<uint64_t> &slotSequence(const char *slot)
+{
+    return *reinterpret_cast<std::atomic<uint64_t> *>(const_cast<char *>(slot));
+}
+
+uint32_t *futexWord(const std::atomic<uint32_t> &word)
+{
+    return reinterpret_cast<uint32_t *>(const_cast<std::atomic<uint32_t> *>(&word));
+}
+
+// 共有メモリは複数のプロセスから見るため FUTEX_PRIVATE_FLAG は付けない
+void futexWakeAll(const std::atomic<uint32_t> &word)
+{
+    syscall(SYS_futex, futexWord(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void futexWait(const std::atomic<uint32_t> &word, uint32_t expected, int timeoutMs)
+{
+    timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+    syscall(SYS_futex, futexWord(word), FUTEX_WAIT, expected, timeoutMs < 0 ? nullptr : &timeout, nullptr, 0);
+}
+
+} // namespace
+
+IngestRingWriter::~IngestRingWriter()
+{
+    close();
+}
+
+bool IngestRingWriter::create(const std::string &name, uint32_t slotCount)
+{
+    if (slotCount < 2 || (slotCount & (slotCount - 1)) != 0)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    // 前回の書き手が残したもの（異常終了など）は作り直す（古い方を開いている読み手はそのまま読める）
+    ::shm_unlink(name.c_str());
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    size_t size = ringSize(slotCount);
+    if (::ftruncate(fd, static_cast<off_t>(size)) < 0)
+    {
+        int error = errno;
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        errno = error;
+        return false;
+    }
+    void *addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        int error = errno;
+        ::shm_unlink(name.c_str());
+        errno = error;
+        return false;
+    }
+
+    // ftruncate した領域は 0 で埋まっている（全スロットのシーケンス番号が 0 = 未使用）
+    header = new (addr) IngestRingHeader();
+    header->slotSize = INGEST_RING_SLOT_SIZE;
+    header->slotCount = slotCount;
+    header->writerPid = static_cast<uint32_t>(::getpid());
+    header->createdNs = monotonicRawNs();
+    header->head.store(0, std::memory_order_relaxed);
+    header->notify.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->waiters.store(0, std::memory_order_relaxed);
+    header->version = INGEST_RING_VERSION;
+    // 読み手は magic で初期化が終わったことを確かめる
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = INGEST_RING_MAGIC;
+
+    slots = static_cast<char *>(addr) + SLOTS_OFFSET;
+    mappedSize = size;
+    mask = slotCount - 1;
+    shmName = name;
+    return true;
+}
+
+void IngestRingWriter::close()
+{
+    if (header == nullptr)
+    {
+        return;
+    }
+
+    header->closed.store(1, std::memory_order_seq_cst);
+    header->notify.fetch_add(1, std::memory_order_seq_cst);
+    futexWakeAll(header->notify);
+
+    ::munmap(header, mappedSize);
+    ::shm_unlink(shmName.c_str());
+    header = nullptr;
+    slots = nullptr;
+    mappedSize = 0;
+}
+
+void IngestRingWriter::write(const char *record)
+{
+    writeAll(record, reinterpret_cast<const IngestRecordHeader *>(record)->length);
+}
+
+void IngestRingWriter::writeAll(const char *records, size_t length)
+{
+    if (header == nullptr)
+    {
+        return;
+    }
+
+    uint64_t position = header->head.load(std::memory_order_relaxed);
+    size_t offset = 0;
+    while (length - offset >= sizeof(IngestRecordHeader))
+    {
+        IngestRecordHeader recordHeader;
+        std::memcpy(&recordHeader, records + offset, sizeof(recordHeader));
+        size_t recordLength = recordHeader.length;
+        if (recordLength < sizeof(recordHeader) || recordLength > length - offset)
+        {
+            break;
+        }
+
+        char *slot = slots + static_cast<size_t>(position & mask) * INGEST_RING_SLOT_SIZE;
+        std::atomic<uint64_t> &sequence = slotSequence(slot);
+
+        // 書き込み中は 0 にして、読み手が書きかけの内容を使わないようにする（seqlock）
+        sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        char *data = slot + SLOT_DATA_OFFSET;
+        if (recordLength > MAX_RECORD_LENGTH)
+        {
+            recordHeader.length = static_cast<uint16_t>(MAX_RECORD_LENGTH);
+            recordHeader.flags |= INGEST_FLAG_TRUNCATED;
+            std::memcpy(data, &recordHeader, sizeof(recordHeader));
+            std::memcpy(data + sizeof(recordHeader), records + offset + sizeof(recordHeader),
+                        MAX_RECORD_LENGTH - sizeof(recordHeader));
+            truncatedCount++;
+        }
+        else
+        {
+            std::memcpy(data, records + offset, recordLength);
+        }
+
+        sequence.store(position + 1, std::memory_order_release);
+        position++;
+        header->head.store(position, std::memory_order_release);
+        offset += recordLength;
+    }
+
+    // 前回起こした後に眠ろうとした読み手がいる場合だけ起こす（head と waiters の順序は読み手の wait() と対になる）
+    // waiters は起こすときに 0 に戻すため、起きた読み手がまだ読んでいる間の書き込みではシステムコールを呼ばない
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->waiters.load(std::memory_order_relaxed) > 0 && header->waiters.exchange(0, std::memory_order_seq_cst) > 0)
+    {
+        header->notify.fetch_add(1, std::memory_order_seq_cst);
+        futexWakeAll(header->notify);
+        wakeCount++;
+    }
+}
+
+uint64_t IngestRingWriter::getWrittenCount() const
+{
+    return header != nullptr ? header->head.load(std::memory_order_relaxed) : 0;
+}
+
+IngestRingReader::~IngestRingReader()
+{
+    close();
+}
+
+bool IngestRingReader::open(const std::string &name, bool fromOldest)
+{
+    close();
+
+    // 書くのは waiters だけだが、futex で待つために読み書きで開く
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < SLOTS_OFFSET)
+    {
+        ::close(fd);
+        errno = EPROTO;
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void *addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // magic を確かめてから残りの項目を読む（書き手は最後に magic を書く）
+    IngestRingHeader *mapped = static_cast<IngestRingHeader *>(addr);
+    bool valid = mapped->magic == INGEST_RING_MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t slotCount = mapped->slotCount;
+    valid = valid && mapped->version == INGEST_RING_VERSION && mapped->slotSize == INGEST_RING_SLOT_SIZE &&
+            slotCount >= 2 && (slotCount & (slotCount - 1)) == 0 && size >= ringSize(slotCount);
+    if (!valid)
+    {
+        ::munmap(addr, size);
+        errno = EPROTO;
+        return false;
+    }
+
+    header = mapped;
+    slots = static_cast<const char *>(addr) + SLOTS_OFFSET;
+    mappedSize = size;
+    mask = slotCount - 1;
+    lostCount = 0;
+    reading = false;
+
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    position = head;
+    if (fromOldest)
+    {
+        // head と同じスロットは次に上書きされるため、その次から読む
+        position = head >= slotCount ? head - slotCount + 1 : 0;
+    }
+    return true;
+}
+
+void IngestRingReader::close()
+{
+    if (header == nullptr)
+    {
+        return;
+    }
+    ::munmap(const_cast<IngestRingHeader *>(header), mappedSize);
+    header = nullptr;
+    slots = nullptr;
+    mappedSize = 0;
+    reading = false;
+}
+
+IngestRingReader::Status IngestRingReader::next(const IngestRecordHeader *&record, std::string_view &payload)
+{
+    if (header == nullptr)
+    {
+        return Status::Closed;
+    }
+    reading = false;
+
+    for (;;)
+    {
+        uint64_t head = header->head.load(std::memory_order_acquire);
+        if (position >= head)
+        {
+            // closed は最後の head より後に書かれるため、closed を見た後の head が最終
+            if (header->closed.load(std::memory_order_acquire) && position >= header->head.load(std::memory_order_acquire))
+            {
+                return Status::Closed;
+            }
+            return Status::Empty;
+        }
+        if (head - position > mask)
+        {
+            // 一周以上遅れた: 残っている最古のレコードから読み直す
+            uint64_t oldest = head - mask;
+            lostCount += oldest - position;
+            position = oldest;
+        }
+
+        const char *slot = slots + static_cast<size_t>(position & mask) * INGEST_RING_SLOT_SIZE;
+        if (slotSequence(slot).load(std::memory_order_acquire) != position + 1)
+        {
+            // 読み始める前に上書きが始まった
+            lostCount++;
+            position++;
+            continue;
+        }
+
+        // 書き換え中の長さを読んでもスロットの外を指さないように制限する（内容は commit() で確かめる）
+        record = reinterpret_cast<const IngestRecordHeader *>(slot + SLOT_DATA_OFFSET);
+        size_t length = record->length;
+        if (length < sizeof(IngestRecordHeader) || length > MAX_RECORD_LENGTH)
+        {
+            length = sizeof(IngestRecordHeader);
+        }
+        payload = std::string_view(slot + SLOT_DATA_OFFSET + sizeof(IngestRecordHeader),
+                                   length - sizeof(IngestRecordHeader));
+        reading = true;
+        return Status::Ok;
+    }
+}
+
+bool IngestRingReader::commit()
+{
+    if (!reading)
+    {
+        return false;
+    }
+    reading = false;
+
+    // 読んだ内容より後に番号を読み直す（seqlock の検証）
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const char *slot = slots + static_cast<size_t>(position & mask) * INGEST_RING_SLOT_SIZE;
+    bool intact = slotSequence(slot).load(std::memory_order_relaxed) == position + 1;
+    if (!intact)
+    {
+        lostCount++;
+    }
+    position++;
+    return intact;
+}
+
+bool IngestRingReader::wait(int timeoutMs)
+{
+    if (header == nullptr)
+    {
+        return false;
+    }
+
+    if (SPIN_BEFORE_SLEEP && timeoutMs != 0)
+    {
+        uint64_t untilNs = monotonicRawNs() + WAIT_SPIN_NS;
+        do
+        {
+            if (header->head.load(std::memory_order_acquire) > position ||
+                header->closed.load(std::memory_order_acquire) != 0)
+            {
+                return true;
+            }
+        } while (monotonicRawNs() < untilNs);
+    }
+
+    // waiters は書き手が起こすときに 0 に戻す（眠らずに戻った分は次の書き込みで1回余分に起こされるだけ）
+    IngestRingHeader *shared = const_cast<IngestRingHeader *>(header);
+    shared->waiters.fetch_add(1, std::memory_order_seq_cst);
+    uint32_t observed = shared->notify.load(std::memory_order_seq_cst);
+    if (shared->head.load(std::memory_order_seq_cst) <= position && !shared->closed.load(std::memory_order_seq_cst))
+    {
+        futexWait(shared->notify, observed, timeoutMs);
+    }
+
+    return header->head.load(std::memory_order_acquire) > position ||
+           header->closed.load(std::memory_order_acquire) != 0;
+}
+
+uint64_t IngestRingReader::getBacklog() const
+{
+    if (header == nullptr)
+    {
+        return 0;
+    }
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    return head > position ? head - position : 0;
+}
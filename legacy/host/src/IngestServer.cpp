@@ -0,0 +1,297 @@
+/**
+ * @file IngestServer.cpp
+ * @brief イベント配信クラスの実装
+ */
+
+#include "IngestServer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "IngestRecord.h"
+#include "IngestRing.h"
+
+IngestServer::IngestServer(int epollFd) : epollFd(epollFd)
+{
+}
+
+IngestServer::~IngestServer()
+{
+    while (!clients.empty())
+    {
+        removeClient(clients.begin()->first);
+    }
+    if (listenFd >= 0)
+    {
+        ::close(listenFd);
+        ::unlink(socketPath.c_str());
+    }
+}
+
+bool IngestServer::listen(const std::string &path)
+{
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+    {
+        return false;
+    }
+    ::unlink(path.c_str());
+    if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(listenFd, 16) < 0)
+    {
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    socketPath = path;
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) == 0;
+}
+
+bool IngestServer::owns(int fd) const
+{
+    return fd == listenFd || clients.count(fd) != 0;
+}
+
+void IngestServer::handleEvent(int fd, uint32_t events)
+{
+    if (fd == listenFd)
+    {
+        acceptClients();
+        return;
+    }
+
+    auto it = clients.find(fd);
+    if (it == clients.end())
+    {
+        return;
+    }
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        removeClient(fd);
+        return;
+    }
+    if (events & EPOLLOUT)
+    {
+        if (!flushClient(fd, it->second))
+        {
+            return;
+        }
+    }
+    if (events & EPOLLIN)
+    {
+        readClient(fd, it->second);
+    }
+}
+
+void IngestServer::acceptClients()
+{
+    for (;;)
+    {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            ::close(fd);
+            continue;
+        }
+        clients.emplace(fd, Client());
+    }
+}
+
+void IngestServer::readClient(int fd, Client &client)
+{
+    char buf[512];
+    for (;;)
+    {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+        {
+            removeClient(fd);
+            return;
+        }
+        if (n < 0)
+        {
+            break;
+        }
+        client.rxBuffer.append(buf, static_cast<size_t>(n));
+    }
+
+    // 完成したコマンド行を呼び出し元に渡す
+    size_t start = 0;
+    size_t newline;
+    while ((newline = client.rxBuffer.find('\n', start)) != std::string::npos)
+    {
+        std::string_view line(client.rxBuffer.data() + start, newline - start);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (!line.empty() && onCommand)
+        {
+            onCommand(line);
+        }
+        start = newline + 1;
+    }
+    client.rxBuffer.erase(0, start);
+}
+
+bool IngestServer::flushClient(int fd, Client &client)
+{
+    while (!client.txBuffer.empty())
+    {
+        ssize_t n = ::send(fd, client.txBuffer.data(), client.txBuffer.size(), MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN)
+            {
+                break;
+            }
+            removeClient(fd);
+            return false;
+        }
+        client.txBuffer.erase(0, static_cast<size_t>(n));
+    }
+
+    // 送り残しがある間だけ書き込み可能通知を受け取る
+    bool wantsWrite = !client.txBuffer.empty();
+    if (wantsWrite != client.wantsWrite)
+    {
+        epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP | (wantsWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+        client.wantsWrite = wantsWrite;
+    }
+    return true;
+}
+
+void IngestServer::removeClient(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    clients.erase(fd);
+}
+
+void IngestServer::broadcast(const char *data, size_t length)
+{
+    for (auto it = clients.begin(); it != clients.end();)
+    {
+        int fd = it->first;
+        Client &client = it->second;
+        ++it; // flushClient / removeClient で現在の要素が消えてもよいように先に進める
+
+        if (client.txBuffer.size() + length > MAX_CLIENT_BACKLOG)
+        {
+            // 読まない購読者のために取り込みを止めない
+            removeClient(fd);
+            droppedClientCount++;
+            continue;
+        }
+        bool idle = client.txBuffer.empty();
+        client.txBuffer.append(data, length);
+        if (idle)
+        {
+            flushClient(fd, client);
+        }
+    }
+}
+
+void IngestServer::appendRecord(std::string &out, const ControllerEvent &event, uint8_t buttonId, uint16_t seq,
+                                uint32_t timestamp, uint16_t flags, uint64_t arrivalNs, std::string_view payload)
+{
+    if (payload.size() > 0xFFFF - sizeof(IngestRecordHeader))
+    {
+        payload = payload.substr(0, 0xFFFF - sizeof(IngestRecordHeader));
+    }
+
+    IngestRecordHeader header;
+    header.length = static_cast<uint16_t>(sizeof(header) + payload.size());
+    header.kind = static_cast<uint8_t>(event.kind);
+    header.buttonId = buttonId;
+    header.seq = seq;
+    header.flags = flags | (event.hasSeq ? INGEST_FLAG_HAS_SEQ : 0) | (event.hasRound ? INGEST_FLAG_HAS_ROUND : 0);
+    header.timestamp = timestamp;
+    header.from = event.from;
+    header.round = event.round;
+    header.arrivalNs = arrivalNs;
+
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.append(payload.data(), payload.size());
+    publishedCount++;
+}
+
+void IngestServer::publish(const ControllerEvent &event, uint64_t arrivalNs)
+{
+    if (clients.empty() && ring == nullptr)
+    {
+        return;
+    }
+
+    // 1フレーム分のレコードをまとめて書き、購読者ごとの送信を1回にする
+    std::string &records = scratch;
+    records.clear();
+    if (event.kind == EventKind::ButtonPress)
+    {
+        uint16_t flags = event.pressCount > 1 ? INGEST_FLAG_BATCHED : 0;
+        for (uint8_t i = 0; i < event.pressCount; i++)
+        {
+            const PressEntry &press = event.presses[i];
+            appendRecord(records, event, press.buttonId, static_cast<uint16_t>(event.seq + i),
+                         event.timestamp + press.offsetMs, flags, arrivalNs, std::string_view());
+        }
+    }
+    else
+    {
+        bool hasMessage = event.kind == EventKind::Error || event.kind == EventKind::Debug;
+        bool forwardRaw = event.kind == EventKind::Unknown || event.kind == EventKind::Status ||
+                          event.kind == EventKind::Recovered || event.kind == EventKind::Scope ||
+                          event.kind == EventKind::Gesture;
+        std::string_view payload = hasMessage ? event.message : (forwardRaw ? event.raw : std::string_view());
+        appendRecord(records, event, event.buttonId, event.seq, event.timestamp, 0, arrivalNs, payload);
+    }
+    deliver(records.data(), records.size());
+}
+
+void IngestServer::publishLink(EventKind kind, uint64_t arrivalNs)
+{
+    ControllerEvent event;
+    event.kind = kind;
+    scratch.clear();
+    appendRecord(scratch, event, 0, 0, 0, 0, arrivalNs, std::string_view());
+    deliver(scratch.data(), scratch.size());
+}
+
+void IngestServer::deliver(const char *data, size_t length)
+{
+    if (ring != nullptr)
+    {
+        ring->writeAll(data, length);
+    }
+    broadcast(data, length);
+}
@@ -0,0 +1,309 @@
+/**
+ * @file LineFramer.cpp
+ * @brief 行分割クラスの実装
+ */
+
+#include "LineFramer.h"
+
+#include <QuizFraming.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+// 続けて壊れていたら行モードに戻すフレームの数
+const unsigned int FRAME_FALLBACK_BAD_FRAMES = 4;
+
+/**
+ * @brief コントローラーが送る JSON の行か（{" で始まり } で終わり、制御文字を含まない）
+ *
+ * COBS のフレームは先頭がブロック長のバイトで、途中の改行も CRC かブロック長のバイトなので、
+ * フレームの一部がこの形になることはまずない
+ */
+bool isJsonLine(const char *data, size_t length)
+{
+    if (length > 0 && data[length - 1] == '\r')
+    {
+        length--;
+    }
+    if (length < 2 || data[0] != '{' || data[1] != '"' || data[length - 1] != '}')
+    {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char byte = static_cast<unsigned char>(data[i]);
+        if (byte < 0x20 || byte == 0x7F)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+LineFramer::LineFramer(size_t capacity) : buffer(capacity)
+{
+}
+
+char *LineFramer::writePtr()
+{
+    if (begin == end)
+    {
+        begin = end = scanPos = 0;
+    }
+    else if (end == buffer.size())
+    {
+        if (begin > 0)
+        {
+            // 未処理データを先頭に詰める
+            std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            scanPos -= begin;
+            begin = 0;
+        }
+        else
+        {
+            // バッファ全体が1行に満たない: 次の区切りまで読み捨てる
+            begin = end = scanPos = 0;
+            discarding = true;
+            overflowCount++;
+        }
+    }
+    return buffer.data() + end;
+}
+
+size_t LineFramer::writable() const
+{
+    return buffer.size() - end;
+}
+
+void LineFramer::commit(size_t length)
+{
+    end += length;
+}
+
+size_t LineFramer::takeRaw(char *dst, size_t length)
+{
+    size_t n = std::min(length, end - begin);
+    if (dst != nullptr)
+    {
+        std::memcpy(dst, buffer.data() + begin, n);
+    }
+    begin += n;
+    scanPos = std::max(scanPos, begin);
+    return n;
+}
+
+void LineFramer::skipRaw(size_t length)
+{
+    rawRemaining += length;
+}
+
+bool LineFramer::next(std::string_view &line)
+{
+    if (rawRemaining > 0)
+    {
+        rawRemaining -= takeRaw(nullptr, rawRemaining);
+        if (rawRemaining > 0)
+        {
+            return false;
+        }
+    }
+
+    for (;;)
+    {
+        bool wasFramed = framed;
+        bool found = framed ? nextFrame(line) : nextLine(line);
+        if (found || framed == wasFramed)
+        {
+            return found;
+        }
+        // フレームモードから行モードに戻した: 残りを行として読み直す
+    }
+}
+
+bool LineFramer::nextLine(std::string_view &line)
+{
+    while (scanPos < end)
+    {
+        const char *base = buffer.data();
+        const void *found = std::memchr(base + scanPos, '\n', end - scanPos);
+        size_t limit = found != nullptr ? static_cast<const char *>(found) - base : end;
+
+        // 改行より前に 0x00 があれば、コントローラーが COBS フレームで送っているかを確かめる
+        const void *zero = std::memchr(base + scanPos, FRAME_DELIMITER, limit - scanPos);
+        if (zero != nullptr)
+        {
+            size_t at = static_cast<const char *>(zero) - base;
+            Probe probe = probeFrame(at, line);
+            if (probe == Probe::Wait)
+            {
+                scanPos = at;
+                return false;
+            }
+            if (probe == Probe::Frame)
+            {
+                return true;
+            }
+            // 雑音の 0x00: それより前の不完全な行と一緒に捨て、続きを行として読む
+            discarding = false;
+            begin = scanPos = at + 1;
+            continue;
+        }
+
+        if (found == nullptr)
+        {
+            scanPos = end;
+            return false;
+        }
+
+        size_t newline = limit;
+        size_t lineEnd = newline;
+        if (lineEnd > begin && base[lineEnd - 1] == '\r')
+        {
+            lineEnd--;
+        }
+        std::string_view candidate(base + begin, lineEnd - begin);
+        begin = scanPos = newline + 1;
+
+        if (discarding)
+        {
+            discarding = false;
+            continue;
+        }
+        line = candidate;
+        return true;
+    }
+    return false;
+}
+
+LineFramer::Probe LineFramer::probeFrame(size_t zero, std::string_view &line)
+{
+    const char *base = buffer.data();
+
+    // 区切りが続く場合は最後の 0x00 からフレームが始まる
+    size_t start = zero;
+    while (start + 1 < end && base[start + 1] == FRAME_DELIMITER)
+    {
+        start++;
+    }
+    const void *close = std::memchr(base + start + 1, FRAME_DELIMITER, end - start - 1);
+    if (close == nullptr)
+    {
+        // 閉じる 0x00 より先に JSON の行が届いた場合はフレームではない
+        return hasJsonLine(start + 1, end) ? Probe::Noise : Probe::Wait;
+    }
+
+    // 雑音だった場合は元のバイト列を行として読み直すため、別の場所で復号する
+    size_t delimiter = static_cast<const char *>(close) - base;
+    size_t length = delimiter - start - 1;
+    if (length == 0 || hasJsonLine(start + 1, delimiter))
+    {
+        return Probe::Noise;
+    }
+    probe.assign(base + start + 1, base + delimiter);
+    size_t bodyLength = 0;
+    if (frameDecode(probe.data(), probe.size(), bodyLength) != FRAME_OK)
+    {
+        return Probe::Noise;
+    }
+
+    // 0x00 より前の不完全な行は捨て、以降をフレームとして読む
+    framed = true;
+    discarding = false;
+    badFrameRun = 0;
+    begin = scanPos = delimiter;
+    line = std::string_view(reinterpret_cast<const char *>(probe.data()), bodyLength);
+    return Probe::Frame;
+}
+
+bool LineFramer::hasJsonLine(size_t from, size_t to) const
+{
+    const char *base = buffer.data();
+    while (from < to)
+    {
+        const void *found = std::memchr(base + from, '\n', to - from);
+        if (found == nullptr)
+        {
+            return false;
+        }
+        size_t newline = static_cast<const char *>(found) - base;
+        if (isJsonLine(base + from, newline - from))
+        {
+            return true;
+        }
+        from = newline + 1;
+    }
+    return false;
+}
+
+bool LineFramer::nextFrame(std::string_view &line)
+{
+    while (scanPos < end)
+    {
+        char *base = buffer.data();
+        const void *found = std::memchr(base + scanPos, FRAME_DELIMITER, end - scanPos);
+        size_t limit = found != nullptr ? static_cast<const char *>(found) - base : end;
+
+        // 行モードのコントローラーに替わった（書き換え・設定の変更）: 行として読み直す
+        if (!discarding && hasJsonLine(begin, limit))
+        {
+            framed = false;
+            scanPos = begin;
+            return false;
+        }
+        if (found == nullptr)
+        {
+            scanPos = end;
+            return false;
+        }
+
+        size_t delimiter = limit;
+        uint8_t *frame = reinterpret_cast<uint8_t *>(base + begin);
+        size_t length = delimiter - begin;
+        begin = scanPos = delimiter + 1;
+
+        if (discarding)
+        {
+            discarding = false;
+            continue;
+        }
+
+        // 区切りの間はその場で復号する（本文は元の位置より短い）
+        size_t bodyLength = 0;
+        FrameStatus status = frameDecode(frame, length, bodyLength);
+        if (status == FRAME_EMPTY)
+        {
+            continue;
+        }
+        if (status != FRAME_OK)
+        {
+            badFrameCount++;
+            if (++badFrameRun >= FRAME_FALLBACK_BAD_FRAMES)
+            {
+                // フレームが届いていない: 行モードに戻し、次に正しいフレームが届くまで行として読む
+                framed = false;
+                badFrameRun = 0;
+                return false;
+            }
+            continue;
+        }
+        badFrameRun = 0;
+        line = std::string_view(reinterpret_cast<const char *>(frame), bodyLength);
+        return true;
+    }
+    return false;
+}
+
+void LineFramer::clear()
+{
+    begin = end = scanPos = 0;
+    discarding = false;
+    framed = false;
+    rawRemaining = 0;
+    badFrameRun = 0;
+}
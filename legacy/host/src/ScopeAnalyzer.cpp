@@ -0,0 +1,262 @@
+/**
+ * @file ScopeAnalyzer.cpp
+ * @brief scope フレームの集計クラスの実装
+ */
+
+#include "ScopeAnalyzer.h"
+
+#include <algorithm>
+
+ScopeAnalyzer::ScopeAnalyzer(uint32_t settleUs)
+    : settleUs(settleUs)
+{
+}
+
+double ScopeAnalyzer::ticksToUs(uint64_t ticks) const
+{
+    return sampleRate > 0 ? static_cast<double>(ticks) * 1e6 / sampleRate : 0.0;
+}
+
+uint64_t ScopeAnalyzer::extendTick(uint32_t tick) const
+{
+    // 前回の変化からの差として扱う（フレームの間隔はサンプル番号の一周より十分短い）
+    return now + static_cast<uint32_t>(tick - static_cast<uint32_t>(now));
+}
+
+void ScopeAnalyzer::addFrame(const ControllerEvent &event)
+{
+    if (event.kind != EventKind::Scope)
+    {
+        return;
+    }
+
+    if (event.scopeStart)
+    {
+        // 開始（対象のボタンの切り替えを含む）: 開いているエピソードは途中で切れる
+        finish();
+        started = true;
+        sampleRate = event.sampleRate;
+        buttonMask = event.scopeMask;
+        settleTicks = std::max<uint64_t>(1, static_cast<uint64_t>(settleUs) * sampleRate / 1000000ULL);
+        now = event.tick;
+        state = event.edgeCount > 0 ? event.edges[0].mask : 0;
+        for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+        {
+            tracks[i].level = (state >> i) & 1;
+        }
+        lost = event.lost;
+        frameCount++;
+        return;
+    }
+    if (!started)
+    {
+        return; // 開始フレームを見ていない（途中から受信した）
+    }
+    frameCount++;
+
+    bool lostNow = event.lost != lost;
+    lost = event.lost;
+    if (lostNow)
+    {
+        for (Track &track : tracks)
+        {
+            if (track.open)
+            {
+                track.episode.lost = true;
+            }
+        }
+    }
+
+    uint64_t tick = extendTick(event.tick);
+    for (uint8_t e = 0; e < event.edgeCount; e++)
+    {
+        tick += event.edges[e].deltaTicks;
+        closeSettled(tick);
+
+        uint8_t mask = event.edges[e].mask;
+        uint8_t changed = (mask ^ state) & buttonMask;
+        for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+        {
+            if ((changed >> i) & 1)
+            {
+                addEdge(i, tick, (mask >> i) & 1);
+            }
+        }
+        state = mask;
+        now = tick;
+    }
+    // 変化のない現在の状態（無変化の通知・終了）で時刻だけ進む
+    closeSettled(now);
+
+    if (event.scopeEnd)
+    {
+        finish();
+        started = false;
+    }
+}
+
+void ScopeAnalyzer::closeSettled(uint64_t tick)
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        if (tracks[i].open && tick - tracks[i].lastTick >= settleTicks)
+        {
+            closeEpisode(i);
+        }
+    }
+}
+
+void ScopeAnalyzer::addEdge(uint8_t index, uint64_t tick, bool level)
+{
+    Track &track = tracks[index];
+    Episode &episode = track.episode;
+    if (!track.open)
+    {
+        episode = Episode();
+        episode.buttonIndex = index;
+        episode.initialLevel = track.level;
+        episode.startTick = tick;
+        episode.minPulseTicks = UINT64_MAX;
+        track.open = true;
+    }
+    else
+    {
+        uint64_t gap = tick - track.lastTick;
+        episode.minPulseTicks = std::min(episode.minPulseTicks, gap);
+        episode.maxGapTicks = std::max(episode.maxGapTicks, gap);
+    }
+
+    episode.edges++;
+    episode.endTick = tick;
+    if (episode.levels.size() < MAX_EPISODE_EDGES)
+    {
+        episode.levels.emplace_back(tick, level);
+    }
+    track.level = level;
+    track.lastTick = tick;
+}
+
+void ScopeAnalyzer::closeEpisode(uint8_t index)
+{
+    Track &track = tracks[index];
+    Episode &episode = track.episode;
+    track.open = false;
+    if (episode.edges == 1)
+    {
+        episode.minPulseTicks = 0;
+    }
+
+    if (track.level == episode.initialLevel)
+    {
+        episode.direction = DIRECTION_GLITCH;
+    }
+    else
+    {
+        episode.direction = track.level ? DIRECTION_PRESS : DIRECTION_RELEASE;
+    }
+
+    ButtonStats &s = stats[index];
+    switch (episode.direction)
+    {
+    case DIRECTION_PRESS:
+        s.presses++;
+        break;
+    case DIRECTION_RELEASE:
+        s.releases++;
+        break;
+    case DIRECTION_GLITCH:
+        s.glitches++;
+        break;
+    }
+    uint64_t span = episode.endTick - episode.startTick;
+    s.edges += episode.edges;
+    s.maxEdges = std::max(s.maxEdges, episode.edges);
+    s.spanSumTicks += span;
+    s.maxSpanTicks = std::max(s.maxSpanTicks, span);
+    if (episode.edges > 1)
+    {
+        s.bouncy++;
+        s.minPulseTicks = std::min(s.minPulseTicks, episode.minPulseTicks);
+        s.maxGapTicks = std::max(s.maxGapTicks, episode.maxGapTicks);
+    }
+
+    if (finished.size() == MAX_QUEUED_EPISODES)
+    {
+        finished.pop_front();
+    }
+    finished.push_back(std::move(episode));
+}
+
+void ScopeAnalyzer::finish()
+{
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        if (tracks[i].open)
+        {
+            closeEpisode(i);
+        }
+    }
+}
+
+bool ScopeAnalyzer::popEpisode(Episode &episode)
+{
+    if (finished.empty())
+    {
+        return false;
+    }
+    episode = std::move(finished.front());
+    finished.pop_front();
+    return true;
+}
+
+std::string ScopeAnalyzer::render(const Episode &episode, size_t width) const
+{
+    if (width == 0)
+    {
+        return std::string();
+    }
+
+    // 前後に span の 1/8（最低1サンプル）の余白を付け、1文字あたりのサンプル数を切り上げる
+    uint64_t span = episode.endTick - episode.startTick;
+    uint64_t margin = span / 8 + 1;
+    uint64_t from = episode.startTick - std::min(margin, episode.startTick);
+    uint64_t columnTicks = (span + 2 * margin + width - 1) / width;
+
+    std::string line(width, ' ');
+    bool level = episode.initialLevel;
+    size_t next = 0;
+    for (size_t column = 0; column < width; column++)
+    {
+        uint64_t columnEnd = from + (column + 1) * columnTicks;
+        bool changed = false;
+        while (next < episode.levels.size() && episode.levels[next].first < columnEnd)
+        {
+            changed = changed || episode.levels[next].second != level;
+            level = episode.levels[next].second;
+            next++;
+        }
+        line[column] = changed ? '|' : (level ? '#' : '_');
+    }
+    return line;
+}
+
+void ScopeAnalyzer::printSummary(FILE *out) const
+{
+    std::fprintf(out, "ボタン 押下 解放 グリッチ バウンスあり 変化/回(平均,最大) span平均(µs) span最大(µs) 最短パルス(µs) 間隔最大(µs)\n");
+    for (uint8_t i = 0; i < MAX_BUTTONS; i++)
+    {
+        // 途中で対象を切り替えた場合に備え、エピソードのあったボタンも表示する
+        const ButtonStats &s = stats[i];
+        unsigned long episodes = s.presses + s.releases + s.glitches;
+        if (!((buttonMask >> i) & 1) && episodes == 0)
+        {
+            continue;
+        }
+        double meanEdges = episodes > 0 ? static_cast<double>(s.edges) / episodes : 0.0;
+        double meanSpan = episodes > 0 ? ticksToUs(s.spanSumTicks) / episodes : 0.0;
+        std::fprintf(out, "%6u %4lu %4lu %8lu %12lu %9.1f %7u %12.0f %12.0f %14.0f %12.0f\n", i + 1, s.presses,
+                     s.releases, s.glitches, s.bouncy, meanEdges, s.maxEdges, meanSpan, ticksToUs(s.maxSpanTicks),
+                     s.bouncy > 0 ? ticksToUs(s.minPulseTicks) : 0.0, ticksToUs(s.maxGapTicks));
+    }
+    std::fprintf(out, "取りこぼした変化: %u（送信が追いつかない・サンプラーの FIFO 溢れ）\n", lost);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file SerialDevice.cpp
+ * @brief シリアルデバイスクラスの実装
+ */
+
+#include "SerialDevice.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace
+{
+
+speed_t toSpeed(int baud)
+{
+    switch (baud)
+    {
+    case 9600:
+        return B9600;
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    case 57600:
+        return B57600;
+    case 115200:
+        return B115200;
+    case 230400:
+        return B230400;
+    default:
+        return B0;
+    }
+}
+
+} // namespace
+
+SerialDevice::~SerialDevice()
+{
+    close();
+}
+
+bool SerialDevice::open(const std::string &path, int baud)
+{
+    close();
+
+    speed_t speed = toSpeed(baud);
+    if (speed == B0)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cflag |= CLOCAL | CREAD;
+        // VMIN=0 だとデータなしで 0 が返り切断と区別できないため 1 にする（O_NONBLOCK で EAGAIN になる）
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return true;
+}
+
+void SerialDevice::close()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    txBuffer.clear();
+}
+
+ssize_t SerialDevice::readSome(char *dst, size_t length)
+{
+    ssize_t n = ::read(fd, dst, length);
+    if (n < 0)
+    {
+        return (errno == EAGAIN || errno == EINTR) ? -EAGAIN : -errno;
+    }
+    return n;
+}
+
+void SerialDevice::write(std::string_view data)
+{
+    txBuffer.append(data.data(), data.size());
+    flush();
+}
+
+bool SerialDevice::flush()
+{
+    while (!txBuffer.empty() && fd >= 0)
+    {
+        ssize_t n = ::write(fd, txBuffer.data(), txBuffer.size());
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false; // EAGAIN など: 書き込み可能になってから再送
+        }
+        txBuffer.erase(0, static_cast<size_t>(n));
+    }
+    return txBuffer.empty();
+}
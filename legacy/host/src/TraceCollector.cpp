@@ -0,0 +1,405 @@
+/**
+ * @file TraceCollector.cpp
+ * @brief 区間ごとの遅延集計クラスの実装
+ */
+
+#include "TraceCollector.h"
+
+#include <algorithm>
+#include <charconv>
+
+TraceCollector::TraceCollector(int baud)
+    : baud(baud)
+{
+}
+
+TraceCollector::~TraceCollector()
+{
+    close();
+}
+
+bool TraceCollector::open(const std::string &path)
+{
+    close();
+    file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"quiz latency\"}}");
+    return true;
+}
+
+void TraceCollector::close()
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+    for (const auto &entry : pending)
+    {
+        finalize(entry.second);
+    }
+    pending.clear();
+
+    std::fprintf(file, "\n],\n");
+    writeHistograms();
+    std::fprintf(file, "}\n");
+    std::fclose(file);
+    file = nullptr;
+}
+
+const char *TraceCollector::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case STAGE_DEBOUNCE:
+        return "debounce";
+    case STAGE_BATCH:
+        return "batch";
+    case STAGE_TX_QUEUE:
+        return "txQueue";
+    case STAGE_UART:
+        return "uart";
+    case STAGE_HOST_PARSE:
+        return "hostParse";
+    case STAGE_SERVER_QUEUE:
+        return "serverQueue";
+    case STAGE_FANOUT:
+        return "fanout";
+    case STAGE_TOTAL:
+        return "total";
+    default:
+        return "unknown";
+    }
+}
+
+void TraceCollector::Histogram::add(int64_t ns)
+{
+    if (ns < 0)
+    {
+        negative++;
+        ns = 0;
+    }
+    uint64_t value = static_cast<uint64_t>(ns);
+    count++;
+    sumNs += value;
+    minNs = std::min(minNs, value);
+    maxNs = std::max(maxNs, value);
+
+    uint64_t us = value / 1000;
+    int bucket = 0;
+    while (us > 0 && bucket < BUCKET_COUNT - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    buckets[bucket]++;
+}
+
+uint64_t TraceCollector::Histogram::percentileUpperNs(double p) const
+{
+    uint64_t target = static_cast<uint64_t>(p * static_cast<double>(count) + 0.5);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++)
+    {
+        seen += buckets[i];
+        if (seen >= target && seen > 0)
+        {
+            return std::min<uint64_t>(maxNs, (1ULL << i) * 1000ULL);
+        }
+    }
+    return maxNs;
+}
+
+uint64_t TraceCollector::extendControllerTime(uint32_t us) const
+{
+    // micros() は約71分で折り返すため、直前の送信開始時刻からの差で展開する
+    return controllerUs + static_cast<int64_t>(static_cast<int32_t>(us - static_cast<uint32_t>(controllerUs)));
+}
+
+void TraceCollector::updateOffset(uint64_t txStartUs, int64_t sampleNs, int64_t nowNs)
+{
+    // 遅延が最短だったフレームを基準にする。発振子の誤差でずれが増える分だけは上方向にも追従させる
+    // 大きく外れた場合はコントローラーが再起動したとみなしてやり直す
+    int64_t allowed = offsetNs + static_cast<int64_t>(static_cast<double>(nowNs - offsetAtNs) * MAX_CLOCK_SKEW);
+    if (!synced || sampleNs < allowed - 1000000000LL || sampleNs > allowed + 1000000000LL)
+    {
+        offsetNs = sampleNs;
+        synced = true;
+    }
+    else
+    {
+        offsetNs = std::min(sampleNs, allowed);
+    }
+    offsetAtNs = nowNs;
+    controllerUs = txStartUs;
+}
+
+int64_t TraceCollector::toHostNs(uint32_t us) const
+{
+    return static_cast<int64_t>(extendControllerTime(us)) * 1000 + offsetNs;
+}
+
+bool TraceCollector::seenRecently(uint16_t seq) const
+{
+    return pending.count(seq) > 0 || std::find(recentSeqs.begin(), recentSeqs.end(), seq) != recentSeqs.end();
+}
+
+void TraceCollector::addEvent(const ControllerEvent &event, uint64_t arrivalNs, uint64_t publishedNs)
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+    if (event.kind == EventKind::SystemReady)
+    {
+        // 番号も時刻も 0 からやり直し
+        synced = false;
+        recentSeqs.clear();
+        pending.clear();
+    }
+    else if (event.kind == EventKind::Recovered)
+    {
+        synced = false; // 番号は続くが micros() はやり直し
+    }
+    if (!event.hasSeq || event.kind == EventKind::Resync)
+    {
+        return;
+    }
+
+    int64_t arrival = static_cast<int64_t>(arrivalNs);
+    bool hasControllerTimes = event.traceCount >= 2;
+    if (hasControllerTimes)
+    {
+        // 行末（CR LF を含む）が届くまでの回線上の時間を差し引いた到着時刻とのずれ
+        int64_t wireNs = static_cast<int64_t>(event.raw.size() + 2) * 10 * 1000000000LL / baud;
+        uint64_t txStartUs = synced ? extendControllerTime(event.trace[1]) : event.trace[1];
+        updateOffset(txStartUs, arrival - wireNs - static_cast<int64_t>(txStartUs) * 1000, arrival);
+    }
+
+    int count = event.kind == EventKind::ButtonPress ? event.pressCount : 1;
+    for (int i = 0; i < count; i++)
+    {
+        Trace trace;
+        trace.seq = static_cast<uint16_t>(event.seq + i);
+        trace.kind = event.kind;
+        trace.buttonId = event.kind == EventKind::ButtonPress ? event.presses[i].buttonId : 0;
+        trace.arrivalNs = arrival;
+        trace.publishedNs = static_cast<int64_t>(publishedNs);
+        if (seenRecently(trace.seq))
+        {
+            continue; // 再送による重複
+        }
+
+        if (hasControllerTimes)
+        {
+            trace.encodedNs = toHostNs(event.trace[0]);
+            trace.txStartNs = toHostNs(event.trace[1]);
+            int index = 2 + 2 * i;
+            if (index + 1 < event.traceCount && event.trace[index + 1] != 0)
+            {
+                // 入力変化が 0 のイベント（押下以外・復帰前の押下）は確定から
+                trace.capturedNs = event.trace[index] != 0 ? toHostNs(event.trace[index]) : 0;
+                trace.committedNs = toHostNs(event.trace[index + 1]);
+            }
+        }
+
+        recentSeqs.push_back(trace.seq);
+        if (recentSeqs.size() > RECENT_SEQ_COUNT)
+        {
+            recentSeqs.pop_front();
+        }
+
+        if (event.kind == EventKind::ButtonPress)
+        {
+            pending[trace.seq] = trace;
+        }
+        else
+        {
+            finalize(trace);
+        }
+    }
+
+    expire(arrivalNs);
+}
+
+bool TraceCollector::handleCommand(std::string_view line)
+{
+    static const std::string_view PREFIX = "TRACE ";
+    if (line.substr(0, PREFIX.size()) != PREFIX)
+    {
+        return false;
+    }
+
+    // TRACE EMIT <seq> <開始ns> <終了ns>
+    std::string_view rest = line.substr(PREFIX.size());
+    static const std::string_view EMIT = "EMIT ";
+    if (rest.substr(0, EMIT.size()) != EMIT)
+    {
+        return true;
+    }
+    const char *cur = rest.data() + EMIT.size();
+    const char *end = rest.data() + rest.size();
+    unsigned seq = 0;
+    int64_t startNs = 0;
+    int64_t endNs = 0;
+    auto r1 = std::from_chars(cur, end, seq);
+    auto r2 = std::from_chars(r1.ptr + (r1.ptr < end ? 1 : 0), end, startNs);
+    auto r3 = std::from_chars(r2.ptr + (r2.ptr < end ? 1 : 0), end, endNs);
+    if (r1.ec != std::errc() || r2.ec != std::errc() || r3.ec != std::errc())
+    {
+        return true;
+    }
+
+    auto it = pending.find(static_cast<uint16_t>(seq));
+    if (it == pending.end())
+    {
+        unmatchedEmits++;
+        return true;
+    }
+    it->second.emitStartNs = startNs;
+    it->second.emitEndNs = endNs;
+    if (file != nullptr)
+    {
+        finalize(it->second);
+    }
+    pending.erase(it);
+    return true;
+}
+
+void TraceCollector::expire(uint64_t nowNs)
+{
+    for (auto it = pending.begin(); it != pending.end();)
+    {
+        // 受け付けられなかった押下（クイズが非アクティブ・押下済み）はサーバーが配信しない
+        if (static_cast<int64_t>(nowNs) - it->second.arrivalNs > static_cast<int64_t>(EMIT_TIMEOUT_NS))
+        {
+            finalize(it->second);
+            it = pending.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void TraceCollector::finalize(const Trace &trace)
+{
+    if (originNs < 0)
+    {
+        originNs = trace.capturedNs != 0 ? trace.capturedNs
+                 : trace.committedNs != 0 ? trace.committedNs
+                                          : trace.arrivalNs;
+    }
+    writeThreadName(trace.buttonId);
+
+    if (trace.capturedNs != 0)
+    {
+        addSpan(STAGE_DEBOUNCE, trace, trace.capturedNs, trace.committedNs);
+    }
+    if (trace.committedNs != 0)
+    {
+        addSpan(STAGE_BATCH, trace, trace.committedNs, trace.encodedNs);
+    }
+    if (trace.encodedNs != 0)
+    {
+        addSpan(STAGE_TX_QUEUE, trace, trace.encodedNs, trace.txStartNs);
+        addSpan(STAGE_UART, trace, trace.txStartNs, trace.arrivalNs);
+    }
+    addSpan(STAGE_HOST_PARSE, trace, trace.arrivalNs, trace.publishedNs);
+
+    int64_t endNs = trace.publishedNs;
+    if (trace.emitStartNs != 0)
+    {
+        addSpan(STAGE_SERVER_QUEUE, trace, trace.publishedNs, trace.emitStartNs);
+        addSpan(STAGE_FANOUT, trace, trace.emitStartNs, trace.emitEndNs);
+        endNs = trace.emitEndNs;
+    }
+    if (trace.kind == EventKind::ButtonPress)
+    {
+        int64_t startNs = trace.capturedNs != 0 ? trace.capturedNs : trace.arrivalNs;
+        histograms[STAGE_TOTAL].add(endNs - startNs);
+    }
+}
+
+void TraceCollector::addSpan(Stage stage, const Trace &trace, int64_t startNs, int64_t endNs)
+{
+    histograms[stage].add(endNs - startNs);
+
+    // 1件の押下の区間をボタンごとの行に並べる（押下以外は行 0）
+    double ts = static_cast<double>(startNs - originNs) / 1000.0;
+    double dur = static_cast<double>(std::max<int64_t>(endNs - startNs, 0)) / 1000.0;
+    std::fprintf(file,
+                 ",\n{\"ph\":\"X\",\"cat\":\"latency\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                 "\"args\":{\"seq\":%u}}",
+                 stageName(stage), trace.buttonId, ts, dur, trace.seq);
+}
+
+void TraceCollector::writeThreadName(uint8_t buttonId)
+{
+    if (buttonId >= 32 || (namedThreads >> buttonId) & 1)
+    {
+        return;
+    }
+    namedThreads |= 1u << buttonId;
+    if (buttonId == 0)
+    {
+        std::fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"system\"}}");
+    }
+    else
+    {
+        std::fprintf(file,
+                     ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Button %u\"}}",
+                     buttonId, buttonId);
+    }
+}
+
+void TraceCollector::writeHistograms()
+{
+    // バケットは [下限µs, 件数]（空のバケットは省略）
+    std::fprintf(file, "\"latencyHistograms\":{");
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        const Histogram &h = histograms[s];
+        std::fprintf(file, "%s\n\"%s\":{\"count\":%llu,\"negative\":%llu,\"minUs\":%.3f,\"meanUs\":%.3f,\"maxUs\":%.3f,\"buckets\":[",
+                     s == 0 ? "" : ",", stageName(static_cast<Stage>(s)), static_cast<unsigned long long>(h.count),
+                     static_cast<unsigned long long>(h.negative), h.count > 0 ? h.minNs / 1000.0 : 0.0,
+                     h.count > 0 ? static_cast<double>(h.sumNs) / h.count / 1000.0 : 0.0, h.maxNs / 1000.0);
+        bool first = true;
+        for (int i = 0; i < BUCKET_COUNT; i++)
+        {
+            if (h.buckets[i] == 0)
+            {
+                continue;
+            }
+            std::fprintf(file, "%s[%llu,%llu]", first ? "" : ",", i == 0 ? 0ULL : (1ULL << (i - 1)),
+                         static_cast<unsigned long long>(h.buckets[i]));
+            first = false;
+        }
+        std::fprintf(file, "]}");
+    }
+    std::fprintf(file, "\n}");
+}
+
+void TraceCollector::printSummary(FILE *out) const
+{
+    std::fprintf(out, "%-12s %8s %10s %10s %10s %10s\n", "区間", "件数", "平均µs", "p50≦µs", "p99≦µs", "最大µs");
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        const Histogram &h = histograms[s];
+        if (h.count == 0)
+        {
+            continue;
+        }
+        std::fprintf(out, "%-12s %8llu %10.1f %10.1f %10.1f %10.1f\n", stageName(static_cast<Stage>(s)),
+                     static_cast<unsigned long long>(h.count), static_cast<double>(h.sumNs) / h.count / 1000.0,
+                     h.percentileUpperNs(0.5) / 1000.0, h.percentileUpperNs(0.99) / 1000.0, h.maxNs / 1000.0);
+    }
+    if (unmatchedEmits > 0)
+    {
+        std::fprintf(out, "対応する押下がなかった TRACE EMIT: %lu\n", unmatchedEmits);
+    }
+}
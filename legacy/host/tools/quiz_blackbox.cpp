@@ -0,0 +1,410 @@
+/**
+ * @file quiz_blackbox.cpp
+ * @brief コントローラーの動作記録（DUMP）を読み出して表示するツール
+ *
+ * コントローラーに "DUMP" を送り、blackBox フレームに続くバイナリ（lib/QuizBlackBox の形式）を受け取る
+ * - --device: シリアルデバイスに直接接続（quiz-ingest を止めて使う）
+ * - --input: --output で保存したファイルを表示（コマンドは送らない）
+ * 保存ファイルは受信したままの blackBox の行・改行・バイナリを並べたもの
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <string>
+
+#include <QuizBlackBox.h>
+#include <QuizFraming.h>
+
+#include "EventDecoder.h"
+#include "LineFramer.h"
+#include "SerialDevice.h"
+
+namespace
+{
+
+struct Options
+{
+    std::string device;
+    int baud = 9600;
+    std::string inputPath;
+    std::string outputPath;
+    double timeoutSec = 5; // 応答を待つ時間（バイナリの転送時間は別に足す）
+};
+
+using Clock = std::chrono::steady_clock;
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-blackbox (--device <パス> | --input <ファイル>) [オプション]\n"
+        "\n"
+        "コントローラーが EEPROM に残した直近の動作記録（起動・リセット・押下・エラー）を表示する\n"
+        "\n"
+        "オプション:\n"
+        "  -d, --device <パス>     シリアルデバイスに接続して DUMP を送る\n"
+        "  -b, --baud <bps>        ボーレート (デフォルト: 9600)\n"
+        "  -i, --input <パス>      保存したファイルを表示\n"
+        "  -o, --output <パス>     受信した内容をファイルに保存\n"
+        "  -t, --timeout <秒>      応答を待つ時間 (デフォルト: 5)\n"
+        "  -h, --help              このヘルプを表示\n");
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--device" || arg == "-d") && hasValue)
+        {
+            options.device = argv[++i];
+        }
+        else if ((arg == "--baud" || arg == "-b") && hasValue)
+        {
+            options.baud = std::atoi(argv[++i]);
+        }
+        else if ((arg == "--input" || arg == "-i") && hasValue)
+        {
+            options.inputPath = argv[++i];
+        }
+        else if ((arg == "--output" || arg == "-o") && hasValue)
+        {
+            options.outputPath = argv[++i];
+        }
+        else if ((arg == "--timeout" || arg == "-t") && hasValue)
+        {
+            options.timeoutSec = std::atof(argv[++i]);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options.device.empty() != options.inputPath.empty() && options.baud > 0 && options.timeoutSec > 0;
+}
+
+bool isBlackBoxHeader(std::string_view line)
+{
+    return line.find("\"type\":\"blackBox\"") != std::string_view::npos;
+}
+
+/**
+ * @brief DUMP を送り、blackBox の行とそれに続くバイナリを受け取る
+ * @return 受信できた場合 true
+ */
+bool receiveDump(const Options &options, std::string &header, std::string &payload)
+{
+    SerialDevice serial;
+    if (!serial.open(options.device, options.baud))
+    {
+        std::fprintf(stderr, "%s を開けません: %s\n", options.device.c_str(), std::strerror(errno));
+        return false;
+    }
+    serial.write("DUMP\n");
+    serial.flush();
+
+    LineFramer framer;
+    EventDecoder decoder;
+    ControllerEvent event;
+    bool headerReceived = false;
+    size_t expected = 0;
+    Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                                    std::chrono::duration<double>(options.timeoutSec));
+
+    while (!headerReceived || payload.size() < expected)
+    {
+        int waitMs = static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count());
+        if (waitMs <= 0)
+        {
+            std::fprintf(stderr, headerReceived ? "バイナリが途中までしか届きませんでした（%zu / %zu バイト）\n"
+                                                : "応答がありません（ENABLE_BLACK_BOX が無効なファームウェアの可能性）\n",
+                         payload.size(), expected);
+            return false;
+        }
+        pollfd pfd = {serial.getFd(), POLLIN, 0};
+        int ready = ::poll(&pfd, 1, waitMs);
+        if (ready < 0 && errno != EINTR)
+        {
+            return false;
+        }
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        char *dst = framer.writePtr();
+        ssize_t n = serial.readSome(dst, framer.writable());
+        if (n == -EAGAIN)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            std::fprintf(stderr, "%s が切断されました\n", options.device.c_str());
+            return false;
+        }
+        framer.commit(static_cast<size_t>(n));
+
+        std::string_view line;
+        while (!headerReceived && framer.next(line))
+        {
+            if (!decoder.decode(line, event))
+            {
+                continue;
+            }
+            if (event.kind == EventKind::Error)
+            {
+                std::fprintf(stderr, "コントローラーのエラー: %.*s\n", static_cast<int>(event.message.size()),
+                             event.message.data());
+                return false;
+            }
+            if (event.kind == EventKind::Status && isBlackBoxHeader(line))
+            {
+                header.assign(line);
+                expected = event.rawBytes;
+                headerReceived = true;
+                // 9600bps で 1 バイト約 1ms。転送にかかる分だけ待ち時間を延ばす
+                deadline += std::chrono::milliseconds(expected * 10000 / static_cast<size_t>(options.baud) + 1);
+            }
+        }
+        if (headerReceived)
+        {
+            size_t offset = payload.size();
+            payload.resize(expected);
+            payload.resize(offset + framer.takeRaw(&payload[offset], expected - offset));
+        }
+    }
+    return true;
+}
+
+bool readInput(const std::string &path, std::string &header, std::string &payload)
+{
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "%s を開けません: %s\n", path.c_str(), std::strerror(errno));
+        return false;
+    }
+    std::string content;
+    char chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        content.append(chunk, n);
+    }
+    std::fclose(file);
+
+    size_t newline = content.find('\n');
+    if (newline == std::string::npos)
+    {
+        std::fprintf(stderr, "%s は保存した動作記録ではありません\n", path.c_str());
+        return false;
+    }
+    header = content.substr(0, newline);
+    payload = content.substr(newline + 1);
+    return true;
+}
+
+bool writeOutput(const std::string &path, const std::string &header, const std::string &payload)
+{
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "%s を作成できません: %s\n", path.c_str(), std::strerror(errno));
+        return false;
+    }
+    bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size() && std::fputc('\n', file) != EOF &&
+              std::fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+/**
+ * @brief リセット要因（MCUSR）を表示用の文字列にする
+ */
+std::string resetCause(uint16_t flags)
+{
+    static const struct
+    {
+        uint8_t bit;
+        const char *name;
+    } CAUSES[] = {{0x01, "電源投入"}, {0x02, "外部リセット"}, {0x04, "ブラウンアウト"}, {0x08, "ウォッチドッグ"}};
+
+    std::string text;
+    for (const auto &cause : CAUSES)
+    {
+        if (flags & cause.bit)
+        {
+            text += text.empty() ? cause.name : std::string("・") + cause.name;
+        }
+    }
+    return text.empty() ? "不明" : text;
+}
+
+/**
+ * @brief エラーメッセージの CRC から元のメッセージを探す（コントローラーが送るエラーの一覧）
+ */
+const char *errorMessage(uint16_t crc)
+{
+    static const char *const MESSAGES[] = {
+        "Invalid button configuration",  "Configuration validation failed", "Recovered round state is invalid",
+        "Unknown command",               "Invalid button",                  "Scope is active",
+        "Calibration in progress",       "Calibration already running",     "Invalid button ID",
+        "Calibration input is held low", "Calibration edge not detected",
+    };
+    for (const char *message : MESSAGES)
+    {
+        if (frameCrc16(reinterpret_cast<const uint8_t *>(message), std::strlen(message)) == crc)
+        {
+            return message;
+        }
+    }
+    return nullptr;
+}
+
+void printEntries(const std::string &payload)
+{
+    std::printf("  番号     時刻(ms) ラウンド   seq  内容\n");
+
+    bool hasPrevious = false;
+    uint16_t previousIndex = 0;
+    uint16_t pressRound = 0;
+    int pressCount = 0;
+    unsigned long broken = 0;
+    for (size_t offset = 0; offset + BLACK_BOX_ENTRY_SIZE <= payload.size(); offset += BLACK_BOX_ENTRY_SIZE)
+    {
+        BlackBoxEntry entry;
+        if (!blackBoxDecode(reinterpret_cast<const uint8_t *>(payload.data() + offset), entry))
+        {
+            broken++;
+            continue;
+        }
+        uint16_t missing = static_cast<uint16_t>(entry.index - previousIndex - 1);
+        if (hasPrevious && missing > 0)
+        {
+            // コントローラーのキューが溢れて捨てた件
+            std::printf("  （%u 件は記録されていません）\n", missing);
+        }
+        hasPrevious = true;
+        previousIndex = entry.index;
+
+        std::printf("%6u %12u %8u %5u  ", entry.index, entry.timestamp, entry.round, entry.seq);
+        switch (entry.type)
+        {
+        case BLACK_BOX_BOOT:
+            std::printf("起動（%s、時刻は起動からの経過）\n", resetCause(entry.detail).c_str());
+            pressCount = 0;
+            break;
+        case BLACK_BOX_READY:
+            std::printf("起動完了\n");
+            break;
+        case BLACK_BOX_RECOVERED:
+            std::printf("ラウンドの状態を復元（停止 %ums）\n", entry.detail);
+            break;
+        case BLACK_BOX_RESET:
+            std::printf("リセット\n");
+            break;
+        case BLACK_BOX_ARMED:
+            std::printf("開始（トリガー入力）\n");
+            break;
+        case BLACK_BOX_PRESS:
+            if (pressCount == 0 || entry.round != pressRound)
+            {
+                pressRound = entry.round;
+                pressCount = 0;
+            }
+            pressCount++;
+            std::printf("押下 ボタン%u（ラウンド内 %d 件目）\n", entry.buttonId, pressCount);
+            break;
+        case BLACK_BOX_FALSE_START:
+            std::printf("フライング ボタン%u\n", entry.buttonId);
+            break;
+        case BLACK_BOX_ERROR:
+        {
+            const char *message = errorMessage(entry.detail);
+            if (message != nullptr)
+            {
+                std::printf("エラー: %s\n", message);
+            }
+            else
+            {
+                std::printf("エラー（CRC 0x%04x）\n", entry.detail);
+            }
+            break;
+        }
+        case BLACK_BOX_ANSWER_TIMEOUT:
+            std::printf("解答時間切れ ボタン%u\n", entry.buttonId);
+            break;
+        case BLACK_BOX_GESTURE:
+            std::printf("ジェスチャー ボタン%u %u回（最後の押下 %u ms）\n", entry.buttonId, entry.detail >> 12,
+                        (entry.detail & 0x0FFF) * 10);
+            break;
+        case BLACK_BOX_DROPPED:
+            std::printf("再送ウィンドウ溢れで seq %u を破棄\n", entry.seq);
+            break;
+        default:
+            std::printf("不明な種類 %u\n", entry.type);
+            break;
+        }
+    }
+
+    if (broken > 0)
+    {
+        std::printf("CRC が合わない件: %lu\n", broken);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::string headerLine;
+    std::string payload;
+    bool received = options.device.empty() ? readInput(options.inputPath, headerLine, payload)
+                                           : receiveDump(options, headerLine, payload);
+    if (!received)
+    {
+        return 1;
+    }
+
+    if (!options.outputPath.empty() && !writeOutput(options.outputPath, headerLine, payload))
+    {
+        std::fprintf(stderr, "%s に保存できませんでした\n", options.outputPath.c_str());
+        return 1;
+    }
+
+    EventDecoder decoder;
+    ControllerEvent header;
+    if (!decoder.decode(headerLine, header) || !isBlackBoxHeader(headerLine))
+    {
+        std::fprintf(stderr, "blackBox の行を解釈できません: %s\n", headerLine.c_str());
+        return 1;
+    }
+    if (payload.size() != header.rawBytes)
+    {
+        std::fprintf(stderr, "バイナリの長さが一致しません（%zu / %u バイト）\n", payload.size(), header.rawBytes);
+        return 1;
+    }
+    uint16_t crc = frameCrc16(reinterpret_cast<const uint8_t *>(payload.data()), payload.size());
+    if (crc != header.rawCrc)
+    {
+        std::fprintf(stderr, "バイナリの CRC が一致しません（0x%04x / 0x%04x）\n", crc, header.rawCrc);
+        return 1;
+    }
+
+    std::printf("%s\n", headerLine.c_str());
+    printEntries(payload);
+    return 0;
+}
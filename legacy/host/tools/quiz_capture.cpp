@@ -0,0 +1,288 @@
+/**
+ * @file quiz_capture.cpp
+ * @brief 記録ファイル（.qcap）の確認・検証・ベンチマークを行うツール
+ *
+ * - info:   ファイルの概要を表示
+ * - dump:   記録されたイベントを表示
+ * - verify: 生データを現在のデコーダーで再デコードし、記録時の結果と一致するか確認
+ * - bench:  生データのデコードを繰り返し、スループットを計測
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "CaptureReader.h"
+#include "CaptureWriter.h"
+#include "EventDecoder.h"
+#include "IngestRecord.h"
+#include "LineFramer.h"
+
+namespace
+{
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-capture <コマンド> <記録ファイル> [オプション]\n"
+        "\n"
+        "コマンド:\n"
+        "  info                    ファイルの概要を表示\n"
+        "  dump                    記録されたイベントを表示\n"
+        "  verify                  生データを再デコードして記録と比較\n"
+        "  bench [秒数]            再デコードを繰り返してスループットを計測 (デフォルト: 3)\n");
+}
+
+void printTime(uint64_t ns)
+{
+    std::printf("%llu.%06llu", static_cast<unsigned long long>(ns / 1000000000ULL),
+                static_cast<unsigned long long>((ns / 1000ULL) % 1000000ULL));
+}
+
+bool sameEvent(const CaptureEvent &a, const CaptureEvent &b)
+{
+    return std::memcmp(&a, &b, sizeof(CaptureEvent)) == 0;
+}
+
+/**
+ * @brief 記録された生データをフレーマーとデコーダーに通す
+ *
+ * 受信時と同じく read() 単位でフレーマーへ書き込み、LinkUp で未完成の行を破棄する
+ * @param onRecord レコードごとに (record, decoded, decodedCount, isLink) で呼ばれる
+ * @return 再デコードした行数
+ */
+template <typename Callback>
+unsigned long redecode(CaptureReader &reader, LineFramer &framer, EventDecoder &decoder, Callback onRecord)
+{
+    static const int MAX_DECODED = 256;
+    CaptureEvent decoded[MAX_DECODED + ControllerEvent::MAX_PRESSES];
+    ControllerEvent event;
+    CaptureRecord record;
+    unsigned long lineCount = 0;
+
+    reader.rewind();
+    framer.clear();
+    while (reader.next(record))
+    {
+        if (record.raw.empty())
+        {
+            if (record.eventCount > 0 && record.eventAt(0).kind == static_cast<uint8_t>(EventKind::LinkUp))
+            {
+                framer.clear();
+            }
+            onRecord(record, decoded, record.eventCount > 0 ? 1 : 0, true);
+            continue;
+        }
+
+        int decodedCount = 0;
+        std::string_view remaining = record.raw;
+        while (!remaining.empty())
+        {
+            char *dst = framer.writePtr();
+            size_t n = std::min(framer.writable(), remaining.size());
+            std::memcpy(dst, remaining.data(), n);
+            framer.commit(n);
+            remaining.remove_prefix(n);
+
+            std::string_view line;
+            while (framer.next(line))
+            {
+                if (line.empty())
+                {
+                    continue;
+                }
+                lineCount++;
+                decoder.decode(line, event);
+                framer.skipRaw(event.rawBytes);
+                if (decodedCount < MAX_DECODED)
+                {
+                    decodedCount += toCaptureEvents(event, decoded + decodedCount);
+                }
+            }
+        }
+        onRecord(record, decoded, decodedCount, false);
+    }
+    return lineCount;
+}
+
+int commandInfo(CaptureReader &reader)
+{
+    const CaptureFileHeader &header = reader.getHeader();
+    unsigned long records = 0;
+    unsigned long events = 0;
+    unsigned long presses = 0;
+    unsigned long links = 0;
+    size_t rawBytes = 0;
+    uint64_t firstNs = 0;
+    uint64_t lastNs = 0;
+
+    CaptureRecord record;
+    while (reader.next(record))
+    {
+        if (records == 0)
+        {
+            firstNs = record.arrivalNs;
+        }
+        lastNs = record.arrivalNs;
+        records++;
+        rawBytes += record.raw.size();
+        events += record.eventCount;
+        for (uint8_t i = 0; i < record.eventCount; i++)
+        {
+            uint8_t kind = record.eventAt(i).kind;
+            if (kind == static_cast<uint8_t>(EventKind::ButtonPress))
+            {
+                presses++;
+            }
+            else if (kind == static_cast<uint8_t>(EventKind::LinkUp) ||
+                     kind == static_cast<uint8_t>(EventKind::LinkDown))
+            {
+                links++;
+            }
+        }
+    }
+
+    std::printf("バージョン:     %u\n", header.version);
+    std::printf("ボーレート:     %u\n", header.baud);
+    std::printf("レコード数:     %lu\n", records);
+    std::printf("生データ:       %zu バイト\n", rawBytes);
+    std::printf("イベント数:     %lu（押下 %lu、接続・切断 %lu）\n", events, presses, links);
+    std::printf("記録時間:       %.3f 秒\n", static_cast<double>(lastNs - firstNs) / 1e9);
+    if (reader.isTruncated())
+    {
+        std::printf("末尾の不完全なレコードを無視しました\n");
+    }
+    return 0;
+}
+
+int commandDump(CaptureReader &reader)
+{
+    CaptureRecord record;
+    while (reader.next(record))
+    {
+        for (uint8_t i = 0; i < record.eventCount; i++)
+        {
+            CaptureEvent event = record.eventAt(i);
+            printTime(record.arrivalNs);
+            std::printf(" kind=%u", event.kind);
+            if (event.flags & INGEST_FLAG_HAS_SEQ)
+            {
+                std::printf(" seq=%u", event.seq);
+            }
+            if (event.kind == static_cast<uint8_t>(EventKind::ButtonPress))
+            {
+                std::printf(" button=%u%s", event.buttonId, (event.flags & INGEST_FLAG_BATCHED) ? " batched" : "");
+            }
+            std::printf(" timestamp=%u\n", event.timestamp);
+        }
+    }
+    return 0;
+}
+
+int commandVerify(CaptureReader &reader)
+{
+    LineFramer framer;
+    EventDecoder decoder;
+    unsigned long records = 0;
+    unsigned long mismatches = 0;
+
+    unsigned long lines = redecode(reader, framer, decoder,
+                                   [&](const CaptureRecord &record, const CaptureEvent *decoded, int count, bool link) {
+                                       records++;
+                                       if (link)
+                                       {
+                                           return;
+                                       }
+                                       bool match = count == record.eventCount;
+                                       for (int i = 0; match && i < count; i++)
+                                       {
+                                           match = sameEvent(decoded[i], record.eventAt(static_cast<uint8_t>(i)));
+                                       }
+                                       if (!match)
+                                       {
+                                           mismatches++;
+                                           std::printf("不一致: レコード %lu（時刻 ", records);
+                                           printTime(record.arrivalNs);
+                                           std::printf("、記録 %u 件 / 再デコード %d 件）\n", record.eventCount, count);
+                                       }
+                                   });
+
+    std::printf("レコード: %lu, 行: %lu, 解析失敗: %lu, 不一致: %lu\n", records, lines,
+                decoder.getMalformedCount(), mismatches);
+    return mismatches == 0 ? 0 : 2;
+}
+
+int commandBench(CaptureReader &reader, double seconds)
+{
+    LineFramer framer;
+    EventDecoder decoder;
+    unsigned long passes = 0;
+    unsigned long lines = 0;
+    unsigned long events = 0;
+    size_t bytes = 0;
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    double elapsed = 0;
+    do
+    {
+        lines += redecode(reader, framer, decoder,
+                          [&](const CaptureRecord &record, const CaptureEvent *, int count, bool link) {
+                              bytes += record.raw.size();
+                              events += link ? 0 : static_cast<unsigned long>(count);
+                          });
+        passes++;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < seconds);
+
+    if (bytes == 0)
+    {
+        std::printf("生データがありません\n");
+        return 1;
+    }
+    std::printf("%lu 回 / %.3f 秒\n", passes, elapsed);
+    std::printf("%.1f MB/s, %.0f 行/s, %.0f イベント/s, 1行あたり %.1f ns\n", bytes / elapsed / 1e6, lines / elapsed,
+                events / elapsed, elapsed * 1e9 / static_cast<double>(lines ? lines : 1));
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+    CaptureReader reader;
+    if (!reader.open(argv[2]))
+    {
+        std::fprintf(stderr, "%s は記録ファイルとして読めません\n", argv[2]);
+        return 1;
+    }
+
+    if (command == "info")
+    {
+        return commandInfo(reader);
+    }
+    if (command == "dump")
+    {
+        return commandDump(reader);
+    }
+    if (command == "verify")
+    {
+        return commandVerify(reader);
+    }
+    if (command == "bench")
+    {
+        return commandBench(reader, argc > 3 ? std::atof(argv[3]) : 3.0);
+    }
+    printUsage();
+    return 1;
+}
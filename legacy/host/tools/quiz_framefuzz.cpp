@@ -0,0 +1,611 @@
+/**
+ * @file quiz_framefuzz.cpp
+ * @brief コントローラーと共有するフレーム化（QuizFraming: COBS + CRC-16）の往復検査とファジング
+ *
+ * AddressSanitizer / UndefinedBehaviorSanitizer を付けてビルドし、乱数の種から作った入力で次を確かめる
+ * - 往復: 本文を FrameChecksum + FrameEncoder で符号化し、参照実装の COBS と同じバイト列になること、
+ *   区切り以外に 0x00 を含まないこと、frameDecode() で元の本文に戻ること
+ * - 復号: 0x00 を含む本文も参照実装で符号化すれば frameDecode() で元に戻ること
+ * - 破損: 符号化したフレームを壊して（ビット反転・切り詰め・挿入・0x00 の混入）復号しても範囲外を読み書きせず、
+ *   FRAME_OK の場合は本文の CRC が末尾の CRC と一致すること
+ * - 受信の切り替え: JSON の行・フレーム・紛れ込んだ 0x00 を混ぜたバイト列を細かく区切って LineFramer に渡し、
+ *   全ての行と本文がそのまま取り出せること（0x00 だけではフレームモードに切り替わらないこと、
+ *   行モードのコントローラーに替わったら行モードに戻ること）
+ *
+ * 失敗した入力は16進で表示して終了コード 1 で終わる（同じ --seed で再現できる）
+ * clang では -DQUIZ_FRAMEFUZZ_LIBFUZZER で libFuzzer の入口（LLVMFuzzerTestOneInput）としてもビルドできる
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "LineFramer.h"
+#include "QuizFraming.h"
+
+namespace
+{
+
+typedef std::vector<uint8_t> Bytes;
+
+/**
+ * @brief FrameEncoder の出力先（std::string に追記する）
+ */
+struct StringOutput
+{
+    std::string bytes;
+
+    void write(uint8_t byte) { bytes.push_back(static_cast<char>(byte)); }
+};
+
+/**
+ * @brief 参照実装の COBS（区切りを含まない）
+ *
+ * 一般的な実装と同じだが、FrameEncoder と同じく、最後のブロックが 0xFF（後ろに 0x00 がない）で
+ * ちょうど終わる場合は空のブロック（0x01）を付けない（frameDecode() はどちらも受け付ける）
+ */
+Bytes cobsEncode(const Bytes &data)
+{
+    Bytes out;
+    size_t codeAt = 0;
+    uint8_t code = 1;
+    bool afterFullBlock = false;
+    out.push_back(0);
+    for (uint8_t byte : data)
+    {
+        if (byte == 0)
+        {
+            out[codeAt] = code;
+            codeAt = out.size();
+            out.push_back(0);
+            code = 1;
+            afterFullBlock = false;
+            continue;
+        }
+        out.push_back(byte);
+        code++;
+        if (code == 0xFF)
+        {
+            out[codeAt] = code;
+            codeAt = out.size();
+            out.push_back(0);
+            code = 1;
+            afterFullBlock = true;
+        }
+    }
+    if (code == 1 && afterFullBlock)
+    {
+        out.pop_back();
+    }
+    else
+    {
+        out[codeAt] = code;
+    }
+    return out;
+}
+
+Bytes withCrc(const Bytes &body)
+{
+    Bytes data = body;
+    uint16_t crc = frameCrc16(body.data(), body.size());
+    data.push_back(static_cast<uint8_t>(crc >> 8));
+    data.push_back(static_cast<uint8_t>(crc));
+    return data;
+}
+
+void printHex(const char *label, const uint8_t *data, size_t length)
+{
+    std::fprintf(stderr, "%s (%zu バイト):", label, length);
+    for (size_t i = 0; i < length; i++)
+    {
+        std::fprintf(stderr, "%s%02x", i % 32 == 0 ? "\n  " : " ", data[i]);
+    }
+    std::fprintf(stderr, "\n");
+}
+
+/**
+ * @brief 失敗を表示する
+ * @return 常に false
+ */
+bool fail(const char *what, const Bytes &input)
+{
+    std::fprintf(stderr, "失敗: %s\n", what);
+    printHex("入力", input.data(), input.size());
+    return false;
+}
+
+/**
+ * @brief frameDecode() を入力と同じ長さのヒープ領域で呼ぶ（範囲外の読み書きを AddressSanitizer で検出する）
+ */
+FrameStatus decodeExact(const uint8_t *data, size_t length, Bytes &body)
+{
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[length > 0 ? length : 1]);
+    if (length > 0)
+    {
+        std::memcpy(buffer.get(), data, length);
+    }
+    size_t bodyLength = 0;
+    FrameStatus status = frameDecode(buffer.get(), length, bodyLength);
+    if (status == FRAME_OK)
+    {
+        body.assign(buffer.get(), buffer.get() + bodyLength);
+    }
+    return status;
+}
+
+/**
+ * @brief 任意のバイト列を1フレームとして復号し、結果が矛盾しないことを確かめる
+ */
+bool checkDecode(const uint8_t *data, size_t length, FrameStatus &status)
+{
+    Bytes body;
+    status = decodeExact(data, length, body);
+    Bytes input(data, data + length);
+    if (length == 0)
+    {
+        return status == FRAME_EMPTY || fail("空の入力が FRAME_EMPTY にならない", input);
+    }
+    if (std::memchr(data, FRAME_DELIMITER, length) != nullptr && status == FRAME_OK)
+    {
+        return fail("区切りを含む入力が FRAME_OK になった", input);
+    }
+    if (status != FRAME_OK)
+    {
+        return true;
+    }
+    if (body.size() + FRAME_CRC_SIZE > length)
+    {
+        return fail("本文が入力より長い", input);
+    }
+    // 復号結果を符号化し直すと、同じ本文・CRC に戻る（COBS の表現は一意ではないため入力とは比べない）
+    Bytes reencoded = cobsEncode(withCrc(body));
+    Bytes again;
+    if (decodeExact(reencoded.data(), reencoded.size(), again) != FRAME_OK || again != body)
+    {
+        return fail("FRAME_OK の本文を符号化し直すと元に戻らない", input);
+    }
+    return true;
+}
+
+/**
+ * @brief 本文を FrameEncoder で符号化し、参照実装との一致と往復を確かめる
+ * @param body 本文（0x00 を含まないこと）
+ * @param encoded 符号化したフレーム（区切りを除く）
+ */
+bool checkRoundTrip(const Bytes &body, Bytes &encoded)
+{
+    FrameChecksum checksum;
+    for (uint8_t byte : body)
+    {
+        checksum.update(byte);
+    }
+    StringOutput output;
+    FrameEncoder<StringOutput> encoder(output, checksum.getLength(), checksum.getCrc());
+    for (uint8_t byte : body)
+    {
+        encoder.put(byte);
+    }
+    encoder.finish();
+
+    const std::string &frame = output.bytes;
+    if (frame.size() < 2 || frame.front() != 0 || frame.back() != 0)
+    {
+        return fail("フレームの前後に区切りがない", body);
+    }
+    encoded.assign(frame.begin() + 1, frame.end() - 1);
+    if (std::memchr(encoded.data(), FRAME_DELIMITER, encoded.size()) != nullptr)
+    {
+        return fail("符号化したフレームの途中に 0x00 がある", body);
+    }
+    if (encoded != cobsEncode(withCrc(body)))
+    {
+        printHex("FrameEncoder", encoded.data(), encoded.size());
+        Bytes reference = cobsEncode(withCrc(body));
+        printHex("参照実装", reference.data(), reference.size());
+        return fail("FrameEncoder の出力が参照実装と異なる", body);
+    }
+
+    Bytes decoded;
+    if (decodeExact(encoded.data(), encoded.size(), decoded) != FRAME_OK || decoded != body)
+    {
+        return fail("符号化したフレームを復号すると元の本文に戻らない", body);
+    }
+    return true;
+}
+
+/**
+ * @brief 0x00 を含む本文を参照実装で符号化し、frameDecode() で元に戻ることを確かめる
+ */
+bool checkReferenceDecode(const Bytes &body)
+{
+    Bytes encoded = cobsEncode(withCrc(body));
+    Bytes decoded;
+    if (decodeExact(encoded.data(), encoded.size(), decoded) != FRAME_OK || decoded != body)
+    {
+        return fail("参照実装で符号化したフレームが復号できない", body);
+    }
+    return true;
+}
+
+/**
+ * @brief 符号化したフレームを壊す
+ */
+void mutate(Bytes &data, std::mt19937 &random)
+{
+    int count = 1 + static_cast<int>(random() % 4);
+    for (int i = 0; i < count; i++)
+    {
+        size_t at = data.empty() ? 0 : random() % data.size();
+        switch (random() % 5)
+        {
+        case 0: // ビット反転
+            if (!data.empty())
+            {
+                data[at] ^= static_cast<uint8_t>(1u << (random() % 8));
+            }
+            break;
+        case 1: // 切り詰め
+            data.resize(at);
+            break;
+        case 2: // 挿入
+            data.insert(data.begin() + static_cast<std::ptrdiff_t>(at), static_cast<uint8_t>(random()));
+            break;
+        case 3: // 区切りの混入
+            if (!data.empty())
+            {
+                data[at] = FRAME_DELIMITER;
+            }
+            break;
+        default: // ブロック長の書き換え
+            if (!data.empty())
+            {
+                data[at] = static_cast<uint8_t>(random() % 2 ? 0xFF : 1 + random() % 0xFE);
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @brief 本文を作る（長さは 254 バイトのブロックの境界付近を多めにする）
+ */
+Bytes makeBody(std::mt19937 &random, size_t maxLength, bool allowZero)
+{
+    size_t length;
+    switch (random() % 4)
+    {
+    case 0:
+        length = (random() % 3) * 0xFE + random() % 5;
+        length = length >= 2 ? length - 2 : length;
+        break;
+    case 1:
+        length = random() % 16;
+        break;
+    default:
+        length = random() % (maxLength + 1);
+        break;
+    }
+    if (length > maxLength)
+    {
+        length = maxLength;
+    }
+
+    Bytes body(length);
+    bool json = random() % 2 == 0;
+    for (uint8_t &byte : body)
+    {
+        byte = json ? static_cast<uint8_t>(0x20 + random() % 0x5F) : static_cast<uint8_t>(random());
+        if (byte == 0 && !allowZero)
+        {
+            byte = 1;
+        }
+    }
+    if (allowZero && !body.empty())
+    {
+        body[random() % body.size()] = 0;
+    }
+    return body;
+}
+
+/**
+ * @brief 本文をフレームに符号化する（前後の区切りを含む）
+ */
+std::string encodeFrame(const std::string &body)
+{
+    FrameChecksum checksum;
+    for (char byte : body)
+    {
+        checksum.update(static_cast<uint8_t>(byte));
+    }
+    StringOutput output;
+    FrameEncoder<StringOutput> encoder(output, checksum.getLength(), checksum.getCrc());
+    for (char byte : body)
+    {
+        encoder.put(static_cast<uint8_t>(byte));
+    }
+    encoder.finish();
+    return output.bytes;
+}
+
+/**
+ * @brief コントローラーが送る形の JSON（行の本文・フレームの本文）
+ */
+std::string makeEvent(std::mt19937 &random, unsigned long index)
+{
+    std::string event = "{\"type\":\"pressedButton\",\"buttonId\":" + std::to_string(1 + random() % 6) +
+                        ",\"seq\":" + std::to_string(index);
+    size_t padding = random() % 4 == 0 ? random() % 300 : 0;
+    if (padding > 0)
+    {
+        event += ",\"message\":\"" + std::string(padding, static_cast<char>('a' + random() % 26)) + "\"";
+    }
+    return event + "}";
+}
+
+/**
+ * @brief バイト列を乱数の長さに区切って LineFramer に渡し、取り出した行を返す
+ */
+std::vector<std::string> feedFramer(LineFramer &framer, const std::string &stream, std::mt19937 &random)
+{
+    std::vector<std::string> lines;
+    size_t offset = 0;
+    while (offset < stream.size())
+    {
+        char *dst = framer.writePtr();
+        size_t length = std::min({framer.writable(), stream.size() - offset, static_cast<size_t>(1 + random() % 64)});
+        std::memcpy(dst, stream.data() + offset, length);
+        framer.commit(length);
+        offset += length;
+
+        std::string_view line;
+        while (framer.next(line))
+        {
+            lines.emplace_back(line);
+        }
+    }
+    return lines;
+}
+
+bool failFramer(const char *what, const std::string &stream, const std::vector<std::string> &expected,
+                const std::vector<std::string> &actual)
+{
+    std::fprintf(stderr, "期待した行 %zu 件、取り出した行 %zu 件\n", expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size() || i < actual.size(); i++)
+    {
+        const char *want = i < expected.size() ? expected[i].c_str() : "(なし)";
+        const char *got = i < actual.size() ? actual[i].c_str() : "(なし)";
+        if (std::strcmp(want, got) != 0)
+        {
+            std::fprintf(stderr, "  %zu 件目: 期待 %s\n           実際 %s\n", i, want, got);
+            break;
+        }
+    }
+    return fail(what, Bytes(stream.begin(), stream.end()));
+}
+
+/**
+ * @brief 決まった並びで、0x00 ではフレームモードに切り替わらないことなどを確かめる（不具合の再現）
+ */
+bool checkFramerCases(std::mt19937 &random)
+{
+    const std::string ready = "{\"type\":\"systemReady\"}";
+    const std::string press1 = "{\"type\":\"pressedButton\",\"buttonId\":1}";
+    const std::string press2 = "{\"type\":\"pressedButton\",\"buttonId\":2}";
+    const std::string nul(1, '\0');
+    struct Case
+    {
+        const char *name;
+        std::string stream;
+        std::vector<std::string> expected;
+        bool framed;
+    };
+    const Case cases[] = {
+        {"行モードで 0x00 が1つ紛れ込む", ready + "\n" + nul + press1 + "\n" + press2 + "\n", {ready, press1, press2}, false},
+        {"ポートを開いたときの雑音と 0x00", std::string("\xff\x80") + nul + "\xfe" + nul + nul + ready + "\r\n" + press1 + "\r\n",
+         {ready, press1}, false},
+        {"行の途中の 0x00", ready + "\n{\"type\"" + nul + press1 + "\n", {ready, press1}, false},
+        {"起動時の出力の後にフレーム", "boot\n" + encodeFrame(ready) + encodeFrame(press1), {"boot", ready, press1}, true},
+        {"フレームの後に行モード", encodeFrame(ready) + press1 + "\n" + press2 + "\n", {ready, press1, press2}, false},
+        {"行モードからフレームへ", ready + "\n" + nul + press1 + "\n" + encodeFrame(press2), {ready, press1, press2}, true},
+        {"壊れたフレームが続いた後の行", encodeFrame(ready) + nul + "\x05" "abcd" + nul + "\x03" "ab" + nul + "\x04" "abc" + nul +
+                                             "\x02" "a" + nul + "boot\n" + press1 + "\n",
+         {ready, "boot", press1}, false},
+    };
+    for (const Case &test : cases)
+    {
+        LineFramer framer;
+        std::vector<std::string> lines = feedFramer(framer, test.stream, random);
+        if (lines != test.expected)
+        {
+            return failFramer(test.name, test.stream, test.expected, lines);
+        }
+        if (framer.isFramed() != test.framed)
+        {
+            return failFramer(test.framed ? "フレームモードにならない" : "フレームモードのまま", test.stream,
+                              test.expected, lines);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 行・フレーム・紛れ込んだ 0x00 を乱数で混ぜたバイト列から、全ての行と本文が取り出せることを確かめる
+ */
+bool checkFramerStream(std::mt19937 &random, unsigned long index)
+{
+    std::string stream;
+    std::vector<std::string> expected;
+    bool framed = random() % 2 == 0;
+    int events = 1 + static_cast<int>(random() % 40);
+    for (int i = 0; i < events; i++)
+    {
+        if (random() % 16 == 0)
+        {
+            // ファームウェアの書き換え・設定の変更で送り方が替わる
+            framed = !framed;
+        }
+        std::string event = makeEvent(random, index * 64 + static_cast<unsigned long>(i));
+        expected.push_back(event);
+        if (framed)
+        {
+            stream += encodeFrame(event);
+        }
+        else
+        {
+            if (random() % 8 == 0)
+            {
+                // 行の間に紛れ込んだ 0x00（ポートを開いたときの雑音・自動リセット）
+                stream.append(1 + random() % 2, '\0');
+            }
+            stream += event + (random() % 2 == 0 ? "\n" : "\r\n");
+        }
+    }
+
+    LineFramer framer;
+    std::vector<std::string> lines = feedFramer(framer, stream, random);
+    if (lines != expected)
+    {
+        return failFramer("行とフレームを混ぜたバイト列から全てを取り出せない", stream, expected, lines);
+    }
+    return true;
+}
+
+struct Options
+{
+    unsigned long iterations = 200000;
+    unsigned long seed = 1;
+    size_t maxLength = 600;
+};
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-framefuzz [オプション]\n"
+        "\n"
+        "オプション:\n"
+        "  -n, --iterations <数>   検査する本文の数 (デフォルト: 200000)\n"
+        "  -s, --seed <値>         乱数の種 (デフォルト: 1、0: 時刻から)\n"
+        "  -l, --max-length <数>   本文の最大バイト数 (デフォルト: 600)\n"
+        "  -h, --help              このヘルプを表示\n");
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--iterations" || arg == "-n") && hasValue)
+        {
+            options.iterations = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if ((arg == "--seed" || arg == "-s") && hasValue)
+        {
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if ((arg == "--max-length" || arg == "-l") && hasValue)
+        {
+            options.maxLength = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+#ifdef QUIZ_FRAMEFUZZ_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // 入力をそのまま復号し、0x00 を除いたものを本文として往復させる
+    FrameStatus status;
+    if (!checkDecode(data, size, status))
+    {
+        std::abort();
+    }
+    Bytes body;
+    for (size_t i = 0; i < size; i++)
+    {
+        if (data[i] != 0)
+        {
+            body.push_back(data[i]);
+        }
+    }
+    Bytes encoded;
+    if (!checkRoundTrip(body, encoded))
+    {
+        std::abort();
+    }
+
+    // 同じ入力を受信したバイト列として LineFramer に渡す（範囲外を読み書きしないこと）
+    LineFramer framer;
+    std::mt19937 random(static_cast<std::mt19937::result_type>(size));
+    feedFramer(framer, std::string(reinterpret_cast<const char *>(data), size), random);
+    return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+    if (options.seed == 0)
+    {
+        options.seed = std::random_device()();
+    }
+    std::mt19937 random(static_cast<std::mt19937::result_type>(options.seed));
+
+    if (!checkFramerCases(random))
+    {
+        return 1;
+    }
+
+    unsigned long counts[4] = {0, 0, 0, 0};
+    for (unsigned long i = 0; i < options.iterations; i++)
+    {
+        Bytes body = makeBody(random, options.maxLength, false);
+        Bytes encoded;
+        if (!checkRoundTrip(body, encoded) || !checkReferenceDecode(makeBody(random, options.maxLength, true)))
+        {
+            std::fprintf(stderr, "種 %lu の %lu 件目\n", options.seed, i);
+            return 1;
+        }
+
+        mutate(encoded, random);
+        FrameStatus status;
+        if (!checkDecode(encoded.data(), encoded.size(), status))
+        {
+            std::fprintf(stderr, "種 %lu の %lu 件目（破損）\n", options.seed, i);
+            return 1;
+        }
+        counts[status]++;
+
+        if (i % 16 == 0 && !checkFramerStream(random, i))
+        {
+            std::fprintf(stderr, "種 %lu の %lu 件目（受信の切り替え）\n", options.seed, i);
+            return 1;
+        }
+    }
+
+    std::printf("本文 %lu 件 OK（種 %lu）。破損させたフレームの復号結果: OK %lu, 空 %lu, 不正 %lu, CRC 不一致 %lu\n",
+                options.iterations, options.seed, counts[FRAME_OK], counts[FRAME_EMPTY], counts[FRAME_MALFORMED],
+                counts[FRAME_BAD_CRC]);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,432 @@
+/**
+ * @file quiz_ingest.cpp
+ * @brief コントローラーのシリアル出力を取り込み、ローカルの購読者に配信するデーモン
+ *
+ * シリアルデバイスを epoll で監視し、受信時刻を CLOCK_MONOTONIC_RAW で記録したうえで
+ * 行をゼロコピーでデコードして Unix ドメインソケットの購読者へ配信する
+ * 購読者から届いた行はそのままコントローラーへのコマンドとして転送する
+ * --record を指定すると受信データを記録ファイル（.qcap）に追記する
+ * --trace を指定すると押下からサーバーの配信までの区間ごとの遅延を Chrome トレース形式で書き出す
+ * --shm を指定すると同じレコードを共有メモリのリングにも書き、複数の読み手がソケットを使わずに読める
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "CaptureWriter.h"
+#include "Clock.h"
+#include "EventDecoder.h"
+#include "IngestRing.h"
+#include "IngestServer.h"
+#include "LineFramer.h"
+#include "SerialDevice.h"
+#include "TraceCollector.h"
+
+namespace
+{
+
+struct Options
+{
+    std::string device;
+    int baud = 9600;
+    std::string socketPath = "/tmp/quiz-ingest.sock";
+    std::string recordPath;
+    std::string tracePath;
+    std::string shmName;
+    uint32_t shmSlots = INGEST_RING_DEFAULT_SLOTS;
+    bool dump = false;
+};
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-ingest --device <パス> [オプション]\n"
+        "\n"
+        "オプション:\n"
+        "  -d, --device <パス>     シリアルデバイス (例: /dev/ttyACM0, pty のスレーブ)\n"
+        "  -b, --baud <値>         ボーレート (デフォルト: 9600)\n"
+        "  -s, --socket <パス>     配信用 Unix ソケット (デフォルト: /tmp/quiz-ingest.sock)\n"
+        "  -r, --record <パス>     受信データを記録ファイル (.qcap) に追記\n"
+        "  -t, --trace <パス>      区間ごとの遅延を Chrome トレース形式の JSON に書き出す\n"
+        "      --shm <名前>        共有メモリのリングにも配信 (例: /quiz-ingest)\n"
+        "      --shm-slots <数>    リングのスロット数、2のべき乗 (デフォルト: 4096)\n"
+        "      --dump              デコードしたイベントを標準出力に表示\n"
+        "  -h, --help              このヘルプを表示\n");
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--device" || arg == "-d") && hasValue)
+        {
+            options.device = argv[++i];
+        }
+        else if ((arg == "--baud" || arg == "-b") && hasValue)
+        {
+            options.baud = std::atoi(argv[++i]);
+        }
+        else if ((arg == "--socket" || arg == "-s") && hasValue)
+        {
+            options.socketPath = argv[++i];
+        }
+        else if ((arg == "--record" || arg == "-r") && hasValue)
+        {
+            options.recordPath = argv[++i];
+        }
+        else if ((arg == "--trace" || arg == "-t") && hasValue)
+        {
+            options.tracePath = argv[++i];
+        }
+        else if (arg == "--shm" && hasValue)
+        {
+            options.shmName = argv[++i];
+        }
+        else if (arg == "--shm-slots" && hasValue)
+        {
+            options.shmSlots = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--dump")
+        {
+            options.dump = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !options.device.empty();
+}
+
+const char *kindName(EventKind kind)
+{
+    switch (kind)
+    {
+    case EventKind::ButtonPress:
+        return "press";
+    case EventKind::SystemReset:
+        return "reset";
+    case EventKind::Error:
+        return "error";
+    case EventKind::SystemReady:
+        return "ready";
+    case EventKind::Resync:
+        return "resync";
+    case EventKind::Debug:
+        return "debug";
+    case EventKind::Status:
+        return "status";
+    case EventKind::Recovered:
+        return "recover";
+    case EventKind::Armed:
+        return "armed";
+    case EventKind::FalseStart:
+        return "false";
+    case EventKind::Scope:
+        return "scope";
+    case EventKind::AnswerTimeout:
+        return "timeout";
+    case EventKind::Gesture:
+        return "gesture";
+    default:
+        return "unknown";
+    }
+}
+
+void dumpEvent(const ControllerEvent &event, uint64_t arrivalNs)
+{
+    std::printf("%llu.%06llu %-7s", static_cast<unsigned long long>(arrivalNs / 1000000000ULL),
+                static_cast<unsigned long long>((arrivalNs / 1000ULL) % 1000000ULL), kindName(event.kind));
+    if (event.hasSeq)
+    {
+        std::printf(" seq=%u", event.seq);
+    }
+    if (event.hasRound)
+    {
+        std::printf(" round=%u", event.round);
+    }
+    for (uint8_t i = 0; i < event.pressCount; i++)
+    {
+        std::printf(" button=%u(+%ums)", event.presses[i].buttonId, event.presses[i].offsetMs);
+    }
+    if (event.kind == EventKind::FalseStart || event.kind == EventKind::AnswerTimeout)
+    {
+        std::printf(" button=%u", event.buttonId);
+    }
+    if (event.kind == EventKind::Gesture)
+    {
+        std::printf(" button=%u %s x%u hold=%ums total=%ums", event.buttonId, event.longPress ? "long" : "tap",
+                    event.taps, event.hold, event.total);
+    }
+    if (event.kind == EventKind::Unknown || event.kind == EventKind::Status || event.kind == EventKind::Recovered ||
+        event.kind == EventKind::Scope)
+    {
+        std::printf(" %.*s", static_cast<int>(event.raw.size()), event.raw.data());
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+void addToEpoll(int epollFd, int fd, uint32_t events)
+{
+    epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    // SIGINT / SIGTERM は signalfd で受けてループを抜ける
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    addToEpoll(epollFd, signalFd, EPOLLIN);
+
+    // 切断時の再接続タイマー
+    int reconnectFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    addToEpoll(epollFd, reconnectFd, EPOLLIN);
+
+    IngestServer server(epollFd);
+    if (!server.listen(options.socketPath))
+    {
+        std::fprintf(stderr, "ソケット %s を開けません: %s\n", options.socketPath.c_str(), std::strerror(errno));
+        return 1;
+    }
+
+    IngestRingWriter ring;
+    if (!options.shmName.empty())
+    {
+        if (!ring.create(options.shmName, options.shmSlots))
+        {
+            std::fprintf(stderr, "共有メモリ %s を作成できません: %s\n", options.shmName.c_str(), std::strerror(errno));
+            return 1;
+        }
+        server.setRing(&ring);
+    }
+
+    CaptureWriter recorder;
+    if (!options.recordPath.empty() && !recorder.open(options.recordPath, options.baud))
+    {
+        std::fprintf(stderr, "記録ファイル %s を開けません: %s\n", options.recordPath.c_str(), std::strerror(errno));
+        return 1;
+    }
+
+    TraceCollector tracer(options.baud);
+    if (!options.tracePath.empty() && !tracer.open(options.tracePath))
+    {
+        std::fprintf(stderr, "トレースファイル %s を開けません: %s\n", options.tracePath.c_str(), std::strerror(errno));
+        return 1;
+    }
+
+    SerialDevice serial;
+    LineFramer framer;
+    EventDecoder decoder;
+    ControllerEvent event;
+    unsigned long lineCount = 0;
+
+    auto scheduleReconnect = [&]() {
+        itimerspec spec;
+        std::memset(&spec, 0, sizeof(spec));
+        spec.it_value.tv_sec = 1;
+        timerfd_settime(reconnectFd, 0, &spec, nullptr);
+    };
+
+    auto openSerial = [&]() {
+        if (!serial.open(options.device, options.baud))
+        {
+            std::fprintf(stderr, "%s を開けません: %s（1秒後に再試行）\n", options.device.c_str(),
+                         std::strerror(errno));
+            scheduleReconnect();
+            return;
+        }
+        framer.clear();
+        addToEpoll(epollFd, serial.getFd(), EPOLLIN);
+        std::fprintf(stderr, "%s に接続しました\n", options.device.c_str());
+        uint64_t nowNs = monotonicRawNs();
+        server.publishLink(EventKind::LinkUp, nowNs);
+        if (recorder.isOpen())
+        {
+            recorder.writeLink(EventKind::LinkUp, nowNs);
+        }
+    };
+
+    auto closeSerial = [&]() {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, serial.getFd(), nullptr);
+        serial.close();
+        std::fprintf(stderr, "%s が切断されました\n", options.device.c_str());
+        uint64_t nowNs = monotonicRawNs();
+        server.publishLink(EventKind::LinkDown, nowNs);
+        if (recorder.isOpen())
+        {
+            recorder.writeLink(EventKind::LinkDown, nowNs);
+        }
+        scheduleReconnect();
+    };
+
+    auto updateSerialInterest = [&]() {
+        epoll_event ev;
+        ev.events = EPOLLIN | (serial.hasPendingOutput() ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        ev.data.fd = serial.getFd();
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, serial.getFd(), &ev);
+    };
+
+    // 購読者からのコマンドはコントローラーへ転送（サーバーの TRACE 行はここで受け取る）
+    server.setCommandHandler([&](std::string_view line) {
+        if (tracer.handleCommand(line) || !serial.isOpen())
+        {
+            return;
+        }
+        std::string command(line);
+        command += '\n';
+        serial.write(command);
+        updateSerialInterest();
+    });
+
+    openSerial();
+
+    bool running = true;
+    epoll_event events[32];
+    while (running)
+    {
+        int count = epoll_wait(epollFd, events, 32, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int fd = events[i].data.fd;
+            uint32_t flags = events[i].events;
+
+            if (fd == signalFd)
+            {
+                running = false;
+            }
+            else if (fd == reconnectFd)
+            {
+                uint64_t expirations;
+                (void)::read(reconnectFd, &expirations, sizeof(expirations));
+                openSerial();
+            }
+            else if (serial.isOpen() && fd == serial.getFd())
+            {
+                if (flags & EPOLLOUT)
+                {
+                    serial.flush();
+                    updateSerialInterest();
+                }
+
+                bool disconnected = (flags & EPOLLERR) != 0;
+                while (!disconnected && (flags & (EPOLLIN | EPOLLHUP)))
+                {
+                    // 受信データはフレーマーのバッファへ直接読み込む
+                    char *dst = framer.writePtr();
+                    ssize_t n = serial.readSome(dst, framer.writable());
+                    if (n == -EAGAIN)
+                    {
+                        break;
+                    }
+                    if (n <= 0)
+                    {
+                        disconnected = true;
+                        break;
+                    }
+                    uint64_t arrivalNs = monotonicRawNs();
+                    uint64_t traceArrivalNs = tracer.isOpen() ? monotonicNs() : 0;
+                    framer.commit(static_cast<size_t>(n));
+                    if (recorder.isOpen())
+                    {
+                        recorder.beginRecord(arrivalNs, std::string_view(dst, static_cast<size_t>(n)));
+                    }
+
+                    std::string_view line;
+                    while (framer.next(line))
+                    {
+                        if (line.empty())
+                        {
+                            continue;
+                        }
+                        lineCount++;
+                        decoder.decode(line, event);
+                        // DUMP の応答に続くバイナリは行として読まない
+                        framer.skipRaw(event.rawBytes);
+                        server.publish(event, arrivalNs);
+                        if (tracer.isOpen())
+                        {
+                            tracer.addEvent(event, traceArrivalNs, monotonicNs());
+                        }
+                        if (recorder.isOpen())
+                        {
+                            recorder.addEvent(event);
+                        }
+                        if (options.dump)
+                        {
+                            dumpEvent(event, arrivalNs);
+                        }
+                    }
+                    if (recorder.isOpen())
+                    {
+                        recorder.endRecord();
+                    }
+                }
+                if (disconnected)
+                {
+                    closeSerial();
+                }
+            }
+            else if (server.owns(fd))
+            {
+                server.handleEvent(fd, flags);
+            }
+        }
+    }
+
+    if (tracer.isOpen())
+    {
+        tracer.close();
+        tracer.printSummary(stderr);
+    }
+
+    std::fprintf(stderr,
+                 "受信行: %lu, 解析失敗: %lu, 長すぎる行: %lu, 壊れたフレーム: %lu, 配信レコード: %lu, 切断した購読者: %lu, 記録レコード: %lu\n",
+                 lineCount, decoder.getMalformedCount(), framer.getOverflowCount(), framer.getBadFrameCount(),
+                 server.getPublishedCount(), server.getDroppedClientCount(), recorder.getRecordCount());
+    if (ring.isOpen())
+    {
+        std::fprintf(stderr, "共有メモリ: 書き込み %llu, 切り詰め %lu, 起床 %lu\n",
+                     static_cast<unsigned long long>(ring.getWrittenCount()), ring.getTruncatedCount(),
+                     ring.getWakeCount());
+        ring.close();
+    }
+    return 0;
+}
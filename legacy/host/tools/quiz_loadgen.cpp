@@ -0,0 +1,1133 @@
+/**
+ * @file quiz_loadgen.cpp
+ * @brief ホスト側（quiz-ingest・サーバー）の負荷試験用にコントローラーの出力を大量に生成するツール
+ *
+ * ControllerEmulator でファームウェアと同じプロトコル（seq・ACK・再送・RESYNC・まとめ送信）を話す
+ * コントローラーを複数台動かし、pty または TCP（Wokwi と同じ localhost:4000）で公開する
+ * - 押下の発生間隔: 一定（uniform）、ポアソン到着（poisson）、同時押しの嵐（storm）
+ * - 障害の注入: 行の欠落・重複・破損・分割書き込み、デバッグ出力の混入、再起動、切断
+ * - 受信側が返した ACK から、取りこぼさずに処理できた毎秒イベント数と ACK 遅延を表示
+ * - --ramp で発生率を段階的に上げ、受信側が追いつけなくなる点（飽和点）を探す
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pty.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Clock.h"
+#include "ControllerEmulator.h"
+
+namespace
+{
+
+enum class Pattern
+{
+    Uniform,
+    Poisson,
+    Storm
+};
+
+struct Options
+{
+    int controllers = 1;
+    bool pty = false;
+    std::string link;        // pty スレーブへのシンボリックリンク（複数台なら末尾に .<番号>）
+    int listenPort = -1;     // TCP で公開するポート
+    double rate = 10;        // 1台あたりの押下の発生率（毎秒）
+    Pattern pattern = Pattern::Poisson;
+    int burst = 6;           // storm: 1回の嵐で押されるボタン数
+    double spreadMs = 1;     // storm: 1回の嵐の押下が散らばる時間
+    double duration = 0;     // 実行時間（秒、0: 停止するまで）
+    double reportInterval = 1;
+    double ramp = 0;         // 段階ごとに増やす発生率（0: 一定）
+    double stepSeconds = 5;  // 1段階の長さ
+    double maxLagMs = 100;   // 追いつけていると判定する ACK 遅延（p99）の上限
+    int baud = 0;            // 送信速度の上限（0: 制限なし）
+    int window = 8;          // 再送ウィンドウ（ファームウェアの RETRANSMIT_WINDOW）
+    bool cobs = false;       // COBS フレームで送る（ファームウェアの ENABLE_COBS_FRAMING）
+    double dropRate = 0;     // 行を送らない確率
+    double duplicateRate = 0; // 行を2回送る確率
+    double malformRate = 0;  // 行を壊して送る確率
+    double splitRate = 0;    // 行を2回に分けて送る確率
+    double noiseRate = 0;    // 行の前にデバッグ出力を混ぜる確率
+    double rebootEvery = 0;  // コントローラーを再起動する平均間隔（秒、0: しない）
+    double reconnectEvery = 0; // 接続を切る平均間隔（秒、0: しない）
+    unsigned long seed = 0;  // 乱数の種（0: 時刻から）
+    bool echo = false;
+};
+
+/**
+ * @brief 送信待ちのデータ
+ */
+struct Chunk
+{
+    std::string bytes;
+    uint64_t notBeforeNs; // この時刻まで送らない（分割書き込みの後半）
+};
+
+/**
+ * @brief 集計（区間ごと・全体）
+ */
+struct Counters
+{
+    unsigned long generated = 0;   // 生成した押下
+    unsigned long acked = 0;       // ACK された押下
+    unsigned long frames = 0;      // 生成したフレーム
+    unsigned long bytes = 0;       // 書き込んだバイト数
+    unsigned long lostBytes = 0;   // 未接続のため捨てたバイト数
+    unsigned long faults = 0;      // 注入した障害
+    uint64_t stalledNs = 0;        // 送信が詰まって押下を生成できなかった時間
+    std::vector<uint64_t> ackLatencies;
+
+    void reset() { *this = Counters(); }
+};
+
+/**
+ * @brief エミュレートする1台のコントローラー
+ */
+struct Controller
+{
+    int index = 0;
+    std::unique_ptr<ControllerEmulator> emulator;
+    int fd = -1;      // pty のマスター、または TCP の接続
+    int slaveFd = -1; // pty のスレーブ（受信側が閉じても EIO にならないよう開いておく）
+    bool isPty = false;
+    std::string link;
+    std::deque<Chunk> tx;
+    size_t txBytes = 0;
+    size_t headWritten = 0; // 先頭のチャンクのうち書き込み済みのバイト数
+    std::string rx;
+    double byteCredit = 0;  // --baud: 送信できるバイト数
+    uint64_t creditAt = 0;
+    uint64_t nextPressNs = 0;
+    int burstLeft = 0;
+    uint64_t stalledSince = 0;
+    uint64_t nextRebootNs = UINT64_MAX;
+    uint64_t nextReconnectNs = UINT64_MAX;
+};
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-loadgen (--pty | --link <パス> | --listen <ポート>) [オプション]\n"
+        "\n"
+        "接続:\n"
+        "      --pty               コントローラーごとに pty を作成してスレーブのパスを表示\n"
+        "  -l, --link <パス>       pty スレーブへのシンボリックリンクを作成 (--pty を含む、複数台なら <パス>.<番号>)\n"
+        "      --listen <ポート>   TCP で待ち受け、接続ごとに1台を割り当てる (サーバーの --simulator は 4000)\n"
+        "  -n, --controllers <数>  コントローラーの台数 (デフォルト: 1)\n"
+        "\n"
+        "負荷:\n"
+        "  -r, --rate <毎秒>       1台あたりの押下の発生率 (デフォルト: 10)\n"
+        "  -p, --pattern <種類>    uniform | poisson | storm (デフォルト: poisson)\n"
+        "      --burst <数>        storm: 1回の同時押しのボタン数 (デフォルト: 6)\n"
+        "      --spread <ms>       storm: 同時押しが散らばる時間 (デフォルト: 1)\n"
+        "  -d, --duration <秒>     実行時間 (デフォルト: Ctrl+C まで)\n"
+        "      --ramp <毎秒>       段階ごとに発生率を増やし、追いつけなくなったら終了\n"
+        "      --step <秒>         --ramp の1段階の長さ (デフォルト: 5)\n"
+        "      --max-lag <ms>      追いつけていると判定する ACK 遅延 p99 の上限 (デフォルト: 100)\n"
+        "      --baud <bps>        送信速度を実機のボーレートに制限 (デフォルト: 制限なし)\n"
+        "      --window <数>       再送ウィンドウ (デフォルト: 8、ファームウェアと同じ)\n"
+        "      --cobs              行の代わりに COBS + CRC-16 のフレームで送る (ENABLE_COBS_FRAMING)\n"
+        "      --report <秒>       集計の表示間隔 (デフォルト: 1)\n"
+        "\n"
+        "障害の注入（確率は 0〜1、フレームごと）:\n"
+        "      --drop <確率>       行を送らない（seq の欠落）\n"
+        "      --duplicate <確率>  行を2回送る\n"
+        "      --malform <確率>    行を壊して送る（途中で切る・文字化け・閉じ括弧なし）\n"
+        "      --split <確率>      行を2回に分けて数ミリ秒おいて送る\n"
+        "      --noise <確率>      行の前にデバッグ出力（JSON でない行）を混ぜる\n"
+        "      --reboot <秒>       平均この間隔でコントローラーを再起動（systemReady からやり直し）\n"
+        "      --reconnect <秒>    平均この間隔で接続を切る（pty は作り直す）\n"
+        "\n"
+        "その他:\n"
+        "      --seed <数>         乱数の種\n"
+        "      --echo              受信したコマンドを表示\n"
+        "  -h, --help              このヘルプを表示\n");
+}
+
+bool parsePattern(const std::string &name, Pattern &pattern)
+{
+    if (name == "uniform")
+    {
+        pattern = Pattern::Uniform;
+    }
+    else if (name == "poisson")
+    {
+        pattern = Pattern::Poisson;
+    }
+    else if (name == "storm")
+    {
+        pattern = Pattern::Storm;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--pty")
+        {
+            options.pty = true;
+        }
+        else if ((arg == "--link" || arg == "-l") && hasValue)
+        {
+            options.link = argv[++i];
+            options.pty = true;
+        }
+        else if (arg == "--listen" && hasValue)
+        {
+            options.listenPort = std::atoi(argv[++i]);
+        }
+        else if ((arg == "--controllers" || arg == "-n") && hasValue)
+        {
+            options.controllers = std::atoi(argv[++i]);
+        }
+        else if ((arg == "--rate" || arg == "-r") && hasValue)
+        {
+            options.rate = std::atof(argv[++i]);
+        }
+        else if ((arg == "--pattern" || arg == "-p") && hasValue)
+        {
+            if (!parsePattern(argv[++i], options.pattern))
+            {
+                return false;
+            }
+        }
+        else if (arg == "--burst" && hasValue)
+        {
+            options.burst = std::atoi(argv[++i]);
+        }
+        else if (arg == "--spread" && hasValue)
+        {
+            options.spreadMs = std::atof(argv[++i]);
+        }
+        else if ((arg == "--duration" || arg == "-d") && hasValue)
+        {
+            options.duration = std::atof(argv[++i]);
+        }
+        else if (arg == "--ramp" && hasValue)
+        {
+            options.ramp = std::atof(argv[++i]);
+        }
+        else if (arg == "--step" && hasValue)
+        {
+            options.stepSeconds = std::atof(argv[++i]);
+        }
+        else if (arg == "--max-lag" && hasValue)
+        {
+            options.maxLagMs = std::atof(argv[++i]);
+        }
+        else if (arg == "--baud" && hasValue)
+        {
+            options.baud = std::atoi(argv[++i]);
+        }
+        else if (arg == "--window" && hasValue)
+        {
+            options.window = std::atoi(argv[++i]);
+        }
+        else if (arg == "--cobs")
+        {
+            options.cobs = true;
+        }
+        else if (arg == "--report" && hasValue)
+        {
+            options.reportInterval = std::atof(argv[++i]);
+        }
+        else if (arg == "--drop" && hasValue)
+        {
+            options.dropRate = std::atof(argv[++i]);
+        }
+        else if (arg == "--duplicate" && hasValue)
+        {
+            options.duplicateRate = std::atof(argv[++i]);
+        }
+        else if (arg == "--malform" && hasValue)
+        {
+            options.malformRate = std::atof(argv[++i]);
+        }
+        else if (arg == "--split" && hasValue)
+        {
+            options.splitRate = std::atof(argv[++i]);
+        }
+        else if (arg == "--noise" && hasValue)
+        {
+            options.noiseRate = std::atof(argv[++i]);
+        }
+        else if (arg == "--reboot" && hasValue)
+        {
+            options.rebootEvery = std::atof(argv[++i]);
+        }
+        else if (arg == "--reconnect" && hasValue)
+        {
+            options.reconnectEvery = std::atof(argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--echo")
+        {
+            options.echo = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options.pty != (options.listenPort >= 0) && options.controllers >= 1 && options.rate > 0 &&
+           options.burst >= 1 && options.burst <= 6 && options.window >= 1 && options.window <= 255 &&
+           options.reportInterval > 0 && options.stepSeconds > 0;
+}
+
+int openListener(int port, int backlog)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd, backlog) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 負荷生成の全体（コントローラー・乱数・集計）
+ */
+class LoadGenerator
+{
+public:
+    explicit LoadGenerator(const Options &options)
+        : options(options), rng(options.seed != 0 ? options.seed : static_cast<unsigned long>(monotonicNs())),
+          rate(options.rate)
+    {
+        // 実機の送信バッファ（64バイト）が詰まると Serial.write() で止まるのと同じく、
+        // 送信待ちが溜まったら押下の生成を止める（速度制限なしの場合は受信側の読み遅れの検出用）
+        txLimit = options.baud > 0 ? 64 : 65536;
+    }
+
+    ~LoadGenerator()
+    {
+        for (Controller &controller : controllers)
+        {
+            closeTransport(controller);
+        }
+        if (listenFd >= 0)
+        {
+            ::close(listenFd);
+        }
+    }
+
+    bool start()
+    {
+        controllers.resize(static_cast<size_t>(options.controllers));
+        uint64_t now = monotonicNs();
+        ControllerEmulator::Config config;
+        config.window = static_cast<uint8_t>(options.window);
+        config.cobsFraming = options.cobs;
+        for (size_t i = 0; i < controllers.size(); i++)
+        {
+            Controller &controller = controllers[i];
+            controller.index = static_cast<int>(i);
+            controller.isPty = options.pty;
+            if (options.pty && !options.link.empty())
+            {
+                controller.link = controllers.size() == 1 ? options.link : options.link + "." + std::to_string(i);
+            }
+            Controller *self = &controller;
+            controller.emulator.reset(new ControllerEmulator(config, [this, self](std::string_view frame) {
+                sendFrame(*self, frame);
+            }));
+            controller.emulator->setAckHandler([this](uint8_t buttonId, uint64_t latencyNs) {
+                if (buttonId == 0)
+                {
+                    return; // 押下の発生率と比べるため、押下以外のイベントは数えない
+                }
+                if (!ackSeen)
+                {
+                    // 受信側が接続して ACK を返し始めるまでの分は判定に含めない
+                    ackSeen = true;
+                    restartStep(monotonicNs());
+                }
+                interval.acked++;
+                total.acked++;
+                interval.ackLatencies.push_back(latencyNs);
+                step.ackLatencies.push_back(latencyNs);
+                step.acked++;
+            });
+            if (options.pty && !openPty(controller))
+            {
+                return false;
+            }
+            controller.emulator->boot(now);
+            controller.nextPressNs = now;
+            schedulePress(controller, now);
+            controller.nextRebootNs = scheduleFault(options.rebootEvery, now);
+            controller.nextReconnectNs = scheduleFault(options.reconnectEvery, now);
+        }
+
+        if (options.listenPort >= 0)
+        {
+            listenFd = openListener(options.listenPort, options.controllers);
+            if (listenFd < 0)
+            {
+                std::fprintf(stderr, "ポート %d で待ち受けできません: %s\n", options.listenPort, std::strerror(errno));
+                return false;
+            }
+            std::fprintf(stderr, "localhost:%d で待ち受けています（%d 台）\n", options.listenPort, options.controllers);
+        }
+
+        startNs = now;
+        nextReportNs = now + secondsToNs(options.reportInterval);
+        nextStepNs = now + secondsToNs(options.stepSeconds);
+        return true;
+    }
+
+    void run()
+    {
+        std::vector<pollfd> fds;
+        while (!stopRequested && !finished)
+        {
+            uint64_t now = monotonicNs();
+            if (options.duration > 0 && now - startNs >= secondsToNs(options.duration))
+            {
+                break;
+            }
+
+            uint64_t deadline = nextReportNs;
+            if (options.ramp > 0)
+            {
+                deadline = std::min(deadline, nextStepNs);
+            }
+            for (Controller &controller : controllers)
+            {
+                tick(controller, now);
+                deadline = std::min(deadline, controllerDeadline(controller));
+            }
+
+            fds.clear();
+            if (listenFd >= 0)
+            {
+                fds.push_back(pollfd{listenFd, POLLIN, 0});
+            }
+            for (Controller &controller : controllers)
+            {
+                if (controller.fd >= 0)
+                {
+                    short events = POLLIN;
+                    if (wantsWrite(controller, now))
+                    {
+                        events |= POLLOUT;
+                    }
+                    fds.push_back(pollfd{controller.fd, events, 0});
+                }
+            }
+
+            now = monotonicNs();
+            int64_t waitNs = deadline > now ? static_cast<int64_t>(deadline - now) : 0;
+            timespec timeout;
+            timeout.tv_sec = static_cast<time_t>(waitNs / 1000000000LL);
+            timeout.tv_nsec = static_cast<long>(waitNs % 1000000000LL);
+            if (ppoll(fds.data(), fds.size(), &timeout, nullptr) < 0 && errno != EINTR)
+            {
+                std::fprintf(stderr, "poll エラー: %s\n", std::strerror(errno));
+                break;
+            }
+
+            for (const pollfd &pfd : fds)
+            {
+                if (pfd.revents == 0)
+                {
+                    continue;
+                }
+                if (pfd.fd == listenFd)
+                {
+                    acceptClients();
+                    continue;
+                }
+                for (Controller &controller : controllers)
+                {
+                    if (controller.fd == pfd.fd)
+                    {
+                        if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+                        {
+                            readCommands(controller);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            now = monotonicNs();
+            if (now >= nextReportNs)
+            {
+                report(now);
+            }
+            if (options.ramp > 0 && now >= nextStepNs)
+            {
+                finishStep(now);
+            }
+        }
+        printSummary(monotonicNs());
+    }
+
+private:
+    const Options &options;
+    std::mt19937_64 rng;
+    std::vector<Controller> controllers;
+    int listenFd = -1;
+    size_t txLimit;
+
+    double rate; // 現在の発生率（1台あたり）
+    uint64_t startNs = 0;
+    uint64_t nextReportNs = 0;
+    uint64_t lastReportNs = 0;
+    uint64_t nextStepNs = 0;
+    uint64_t stepStartNs = 0;
+    double sustainedRate = 0; // 追いつけた最大の発生率（全台の合計）
+    unsigned long stepDropped = 0; // 段階の開始時点のウィンドウ溢れの累計
+    bool ackSeen = false;
+    bool finished = false;
+    Counters interval;
+    Counters step;
+    Counters total;
+
+    static uint64_t secondsToNs(double seconds) { return static_cast<uint64_t>(seconds * 1e9); }
+
+    double uniform() { return std::uniform_real_distribution<double>(0.0, 1.0)(rng); }
+
+    bool chance(double probability) { return probability > 0 && uniform() < probability; }
+
+    /**
+     * @brief 平均 meanSeconds の指数分布で次の障害の時刻を決める
+     */
+    uint64_t scheduleFault(double meanSeconds, uint64_t now)
+    {
+        if (meanSeconds <= 0)
+        {
+            return UINT64_MAX;
+        }
+        return now + secondsToNs(std::exponential_distribution<double>(1.0 / meanSeconds)(rng));
+    }
+
+    void schedulePress(Controller &controller, uint64_t now)
+    {
+        double gap = 0;
+        switch (options.pattern)
+        {
+        case Pattern::Uniform:
+            gap = 1.0 / rate;
+            break;
+        case Pattern::Poisson:
+            gap = std::exponential_distribution<double>(rate)(rng);
+            break;
+        case Pattern::Storm:
+            if (controller.burstLeft > 0)
+            {
+                // 同時押しの中の間隔
+                gap = uniform() * options.spreadMs / 1000.0 / options.burst;
+            }
+            else
+            {
+                controller.burstLeft = options.burst;
+                gap = std::exponential_distribution<double>(rate / options.burst)(rng);
+            }
+            controller.burstLeft--;
+            break;
+        }
+        controller.nextPressNs += secondsToNs(gap);
+    }
+
+    /**
+     * @brief ラウンド内でまだ押されていないボタンを1つ押す（全員押したらラウンドをリセット）
+     */
+    void pressRandomButton(Controller &controller, uint64_t now)
+    {
+        ControllerEmulator &emulator = *controller.emulator;
+        if (emulator.getPressCount() == emulator.getButtonCount())
+        {
+            emulator.resetRound(now);
+        }
+        int remaining = emulator.getButtonCount() - emulator.getPressCount();
+        int pick = std::uniform_int_distribution<int>(0, remaining - 1)(rng);
+        for (uint8_t id = 1; id <= emulator.getButtonCount(); id++)
+        {
+            if (!emulator.isPressed(id) && pick-- == 0)
+            {
+                emulator.press(id, now);
+                break;
+            }
+        }
+        interval.generated++;
+        step.generated++;
+        total.generated++;
+    }
+
+    void tick(Controller &controller, uint64_t now)
+    {
+        if (now >= controller.nextRebootNs)
+        {
+            // 送信途中の行はそこで途切れる
+            controller.tx.erase(controller.tx.begin() + (controller.headWritten > 0 ? 1 : 0), controller.tx.end());
+            recountTx(controller);
+            controller.emulator->boot(now);
+            controller.nextRebootNs = scheduleFault(options.rebootEvery, now);
+            countFault();
+        }
+        if (now >= controller.nextReconnectNs)
+        {
+            reconnect(controller);
+            controller.nextReconnectNs = scheduleFault(options.reconnectEvery, now);
+            countFault();
+        }
+
+        // 送信が詰まっている間は押下を生成しない（実機のメインループが Serial.write() で止まるのと同じ）
+        while (controller.nextPressNs <= now)
+        {
+            if (controller.txBytes >= txLimit)
+            {
+                if (controller.stalledSince == 0)
+                {
+                    controller.stalledSince = now;
+                }
+                break;
+            }
+            if (controller.stalledSince != 0)
+            {
+                // 詰まっていた間の押下は失われたものとして、予定を現在に合わせる
+                interval.stalledNs += now - controller.stalledSince;
+                step.stalledNs += now - controller.stalledSince;
+                total.stalledNs += now - controller.stalledSince;
+                controller.stalledSince = 0;
+                controller.nextPressNs = now;
+            }
+            pressRandomButton(controller, controller.nextPressNs);
+            schedulePress(controller, now);
+        }
+
+        controller.emulator->update(now);
+        pump(controller, now);
+    }
+
+    uint64_t controllerDeadline(const Controller &controller) const
+    {
+        uint64_t deadline = std::min(controller.emulator->nextDeadlineNs(),
+                                     std::min(controller.nextRebootNs, controller.nextReconnectNs));
+        if (controller.txBytes < txLimit)
+        {
+            deadline = std::min(deadline, controller.nextPressNs);
+        }
+        if (!controller.tx.empty())
+        {
+            uint64_t due = controller.tx.front().notBeforeNs;
+            if (options.baud > 0 && controller.byteCredit < 1)
+            {
+                due = std::max(due, controller.creditAt + static_cast<uint64_t>(10e9 / options.baud));
+            }
+            deadline = std::min(deadline, due);
+        }
+        return deadline;
+    }
+
+    /**
+     * @brief 1フレームに障害を注入して送信待ちに積む
+     */
+    void sendFrame(Controller &controller, std::string_view frame)
+    {
+        interval.frames++;
+        total.frames++;
+        uint64_t now = monotonicNs();
+
+        if (chance(options.noiseRate))
+        {
+            // ENABLE_DEBUG_OUTPUT のファームウェアが混ぜる行
+            queue(controller, "[DEBUG] Button " + std::to_string(1 + rng() % 6) + " pressed\r\n", now);
+            countFault();
+        }
+        if (chance(options.dropRate))
+        {
+            countFault();
+            return;
+        }
+
+        std::string bytes(frame);
+        if (chance(options.malformRate))
+        {
+            malform(bytes);
+            countFault();
+        }
+
+        if (chance(options.splitRate) && bytes.size() > 1)
+        {
+            size_t cut = 1 + rng() % (bytes.size() - 1);
+            queue(controller, bytes.substr(0, cut), now);
+            queue(controller, bytes.substr(cut), now + 1000000ULL + rng() % 9000000ULL);
+            countFault();
+        }
+        else
+        {
+            queue(controller, bytes, now);
+        }
+
+        if (chance(options.duplicateRate))
+        {
+            queue(controller, bytes, now);
+            countFault();
+        }
+    }
+
+    void malform(std::string &bytes)
+    {
+        const std::string terminator = options.cobs ? std::string(1, '\0') : std::string("\r\n");
+        size_t body = bytes.size() - terminator.size(); // 行末（フレームの区切り）を除いた長さ
+        switch (rng() % 3)
+        {
+        case 0:
+            // 途中で途切れる
+            bytes.resize(rng() % body);
+            bytes += terminator;
+            break;
+        case 1:
+            // 文字化け（ノイズ・ボーレート不一致）
+            for (int i = 0; i < 3; i++)
+            {
+                bytes[rng() % body] = static_cast<char>(0x80 | (rng() & 0x7f));
+            }
+            break;
+        default:
+            // 閉じ括弧なし
+            bytes.erase(body - 1, 1);
+            break;
+        }
+    }
+
+    void countFault()
+    {
+        interval.faults++;
+        total.faults++;
+    }
+
+    void queue(Controller &controller, std::string bytes, uint64_t notBeforeNs)
+    {
+        // 前のチャンクより先には送らない
+        if (!controller.tx.empty())
+        {
+            notBeforeNs = std::max(notBeforeNs, controller.tx.back().notBeforeNs);
+        }
+        controller.txBytes += bytes.size();
+        controller.tx.push_back(Chunk{std::move(bytes), notBeforeNs});
+    }
+
+    void recountTx(Controller &controller)
+    {
+        controller.txBytes = 0;
+        for (const Chunk &chunk : controller.tx)
+        {
+            controller.txBytes += chunk.bytes.size();
+        }
+        controller.txBytes -= std::min(controller.txBytes, controller.headWritten);
+    }
+
+    bool wantsWrite(const Controller &controller, uint64_t now) const
+    {
+        return !controller.tx.empty() && controller.tx.front().notBeforeNs <= now &&
+               (options.baud == 0 || controller.byteCredit >= 1);
+    }
+
+    /**
+     * @brief 送信待ちのデータを書き込めるだけ書き込む
+     */
+    void pump(Controller &controller, uint64_t now)
+    {
+        if (options.baud > 0)
+        {
+            // 1バイト = 10ビット、送信バッファ分（64バイト）までは溜められる
+            controller.byteCredit += static_cast<double>(now - controller.creditAt) * options.baud / 10e9;
+            controller.byteCredit = std::min(controller.byteCredit, 64.0);
+            controller.creditAt = now;
+        }
+
+        while (!controller.tx.empty() && controller.tx.front().notBeforeNs <= now)
+        {
+            Chunk &chunk = controller.tx.front();
+            size_t length = chunk.bytes.size() - controller.headWritten;
+            if (options.baud > 0)
+            {
+                length = std::min(length, static_cast<size_t>(controller.byteCredit));
+                if (length == 0)
+                {
+                    return;
+                }
+            }
+
+            ssize_t written;
+            if (controller.fd < 0)
+            {
+                // 未接続: 実機と同じく出力は失われる
+                written = static_cast<ssize_t>(length);
+                interval.lostBytes += length;
+                total.lostBytes += length;
+            }
+            else
+            {
+                written = controller.isPty
+                              ? ::write(controller.fd, chunk.bytes.data() + controller.headWritten, length)
+                              : ::send(controller.fd, chunk.bytes.data() + controller.headWritten, length, MSG_NOSIGNAL);
+                if (written < 0)
+                {
+                    if (errno != EAGAIN && errno != EINTR && !controller.isPty)
+                    {
+                        closeClient(controller);
+                    }
+                    return;
+                }
+                interval.bytes += static_cast<unsigned long>(written);
+                total.bytes += static_cast<unsigned long>(written);
+            }
+
+            if (options.baud > 0)
+            {
+                controller.byteCredit -= static_cast<double>(written);
+            }
+            controller.txBytes -= static_cast<size_t>(written);
+            controller.headWritten += static_cast<size_t>(written);
+            if (controller.headWritten < chunk.bytes.size())
+            {
+                return;
+            }
+            controller.tx.pop_front();
+            controller.headWritten = 0;
+        }
+    }
+
+    void readCommands(Controller &controller)
+    {
+        char buf[1024];
+        ssize_t n = ::read(controller.fd, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            // pty はスレーブを開いたままなので、ここに来るのは TCP の切断のみ
+            if (!controller.isPty && (n == 0 || (errno != EAGAIN && errno != EINTR)))
+            {
+                closeClient(controller);
+            }
+            return;
+        }
+        if (options.echo)
+        {
+            std::fwrite(buf, 1, static_cast<size_t>(n), stderr);
+        }
+
+        controller.rx.append(buf, static_cast<size_t>(n));
+        uint64_t now = monotonicNs();
+        size_t begin = 0;
+        for (;;)
+        {
+            size_t end = controller.rx.find_first_of("\r\n", begin);
+            if (end == std::string::npos)
+            {
+                break;
+            }
+            controller.emulator->handleCommand(std::string_view(controller.rx).substr(begin, end - begin), now);
+            begin = end + 1;
+        }
+        controller.rx.erase(0, begin);
+        if (controller.rx.size() > 256)
+        {
+            controller.rx.clear(); // 改行のないゴミ
+        }
+    }
+
+    bool openPty(Controller &controller)
+    {
+        char slaveName[256];
+        if (openpty(&controller.fd, &controller.slaveFd, slaveName, nullptr, nullptr) < 0)
+        {
+            std::fprintf(stderr, "pty を作成できません: %s\n", std::strerror(errno));
+            return false;
+        }
+        fcntl(controller.fd, F_SETFL, fcntl(controller.fd, F_GETFL) | O_NONBLOCK);
+
+        // エコーや改行変換をしない（受信側が自分のコマンドを読まないように）
+        termios tio;
+        tcgetattr(controller.slaveFd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(controller.slaveFd, TCSANOW, &tio);
+
+        std::printf("%s\n", slaveName);
+        std::fflush(stdout);
+        if (!controller.link.empty())
+        {
+            ::unlink(controller.link.c_str());
+            if (::symlink(slaveName, controller.link.c_str()) < 0)
+            {
+                std::fprintf(stderr, "%s を作成できません: %s\n", controller.link.c_str(), std::strerror(errno));
+            }
+        }
+        return true;
+    }
+
+    void acceptClients()
+    {
+        for (;;)
+        {
+            int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                return;
+            }
+            auto freeController = std::find_if(controllers.begin(), controllers.end(),
+                                               [](const Controller &controller) { return controller.fd < 0; });
+            if (freeController == controllers.end())
+            {
+                std::fprintf(stderr, "空いているコントローラーがないため接続を閉じます\n");
+                ::close(fd);
+                continue;
+            }
+            freeController->fd = fd;
+            std::fprintf(stderr, "コントローラー %d にクライアントが接続しました\n", freeController->index);
+        }
+    }
+
+    void closeClient(Controller &controller)
+    {
+        std::fprintf(stderr, "コントローラー %d のクライアントが切断しました\n", controller.index);
+        ::close(controller.fd);
+        controller.fd = -1;
+        controller.rx.clear();
+    }
+
+    void closeTransport(Controller &controller)
+    {
+        if (controller.fd >= 0)
+        {
+            ::close(controller.fd);
+            controller.fd = -1;
+        }
+        if (controller.slaveFd >= 0)
+        {
+            ::close(controller.slaveFd);
+            controller.slaveFd = -1;
+        }
+        if (!controller.link.empty())
+        {
+            ::unlink(controller.link.c_str());
+        }
+    }
+
+    void reconnect(Controller &controller)
+    {
+        if (controller.isPty)
+        {
+            // USB の抜き差しと同じく、デバイスごと作り直す（リンクは新しいスレーブを指す）
+            closeTransport(controller);
+            openPty(controller);
+        }
+        else if (controller.fd >= 0)
+        {
+            closeClient(controller);
+        }
+    }
+
+    static uint64_t percentile(std::vector<uint64_t> &values, double p)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+        size_t index = std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())));
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+        return values[index];
+    }
+
+    bool anyPeerAcking() const
+    {
+        return std::any_of(controllers.begin(), controllers.end(),
+                           [](const Controller &controller) { return controller.emulator->isPeerAcking(); });
+    }
+
+    void report(uint64_t now)
+    {
+        double seconds = static_cast<double>(now - (lastReportNs != 0 ? lastReportNs : startNs)) / 1e9;
+        unsigned pending = 0;
+        unsigned long retransmits = 0;
+        unsigned long dropped = 0;
+        for (const Controller &controller : controllers)
+        {
+            pending += controller.emulator->getPendingCount();
+            retransmits += controller.emulator->getRetransmitCount();
+            dropped += controller.emulator->getDroppedCount();
+        }
+
+        std::fprintf(stderr,
+                     "[%7.1fs] 目標 %.0f/s 生成 %.0f/s ACK %.0f/s 遅延 p50 %.2fms p99 %.2fms 未ACK %u 再送 %lu "
+                     "破棄 %lu 障害 %lu 詰まり %.0fms %.1fKB/s\n",
+                     static_cast<double>(now - startNs) / 1e9, rate * options.controllers,
+                     static_cast<double>(interval.generated) / seconds, static_cast<double>(interval.acked) / seconds,
+                     static_cast<double>(percentile(interval.ackLatencies, 0.50)) / 1e6,
+                     static_cast<double>(percentile(interval.ackLatencies, 0.99)) / 1e6, pending, retransmits,
+                     dropped, interval.faults, static_cast<double>(interval.stalledNs) / 1e6,
+                     static_cast<double>(interval.bytes) / seconds / 1024.0);
+
+        interval.reset();
+        lastReportNs = now;
+        nextReportNs = now + secondsToNs(options.reportInterval);
+    }
+
+    /**
+     * @brief --ramp の1段階を判定し、追いつけていれば発生率を上げる
+     *
+     * 受信側が ACK を返す場合は「ACK 率が目標の 95% 以上、ACK 遅延 p99 が --max-lag 以下、
+     * ウィンドウ溢れ・送信の詰まりなし」、返さない場合は「生成率が目標の 95% 以上、詰まりなし」を追いつけているとする
+     */
+    void finishStep(uint64_t now)
+    {
+        double seconds = static_cast<double>(now - (stepStartNs != 0 ? stepStartNs : startNs)) / 1e9;
+        double target = rate * options.controllers;
+        double generated = static_cast<double>(step.generated) / seconds;
+        double acked = static_cast<double>(step.acked) / seconds;
+        double p99Ms = static_cast<double>(percentile(step.ackLatencies, 0.99)) / 1e6;
+        unsigned long dropped = 0;
+        for (const Controller &controller : controllers)
+        {
+            dropped += controller.emulator->getDroppedCount();
+        }
+
+        bool keptUp;
+        if (anyPeerAcking())
+        {
+            keptUp = acked >= target * 0.95 && p99Ms <= options.maxLagMs && dropped == stepDropped &&
+                     step.stalledNs == 0;
+        }
+        else
+        {
+            keptUp = generated >= target * 0.95 && step.stalledNs == 0;
+        }
+        std::fprintf(stderr, "== 段階 %.0f/s: 生成 %.0f/s ACK %.0f/s p99 %.2fms 溢れ %lu 詰まり %.0fms → %s\n", target,
+                     generated, acked, p99Ms, dropped - stepDropped, static_cast<double>(step.stalledNs) / 1e6,
+                     keptUp ? "追いついている" : "追いつけない");
+
+        if (!keptUp)
+        {
+            finished = true;
+            return;
+        }
+        sustainedRate = target;
+        rate += options.ramp;
+        restartStep(now);
+    }
+
+    void restartStep(uint64_t now)
+    {
+        stepDropped = 0;
+        for (const Controller &controller : controllers)
+        {
+            stepDropped += controller.emulator->getDroppedCount();
+        }
+        step.reset();
+        stepStartNs = now;
+        nextStepNs = now + secondsToNs(options.stepSeconds);
+    }
+
+    void printSummary(uint64_t now)
+    {
+        double seconds = static_cast<double>(now - startNs) / 1e9;
+        unsigned long retransmits = 0;
+        unsigned long dropped = 0;
+        for (const Controller &controller : controllers)
+        {
+            retransmits += controller.emulator->getRetransmitCount();
+            dropped += controller.emulator->getDroppedCount();
+        }
+
+        std::printf("実行時間: %.1f 秒, コントローラー %d 台\n", seconds, options.controllers);
+        std::printf("押下: 生成 %lu 件 (%.1f/s), ACK %lu 件 (%.1f/s)\n", total.generated,
+                    static_cast<double>(total.generated) / seconds, total.acked,
+                    static_cast<double>(total.acked) / seconds);
+        std::printf("フレーム %lu 件, 書き込み %lu バイト (%.1f KB/s), 未接続で失われた %lu バイト\n", total.frames,
+                    total.bytes, static_cast<double>(total.bytes) / seconds / 1024.0, total.lostBytes);
+        std::printf("再送 %lu 件, ウィンドウ溢れ %lu 件, 注入した障害 %lu 件, 送信の詰まり %.0fms\n", retransmits,
+                    dropped, total.faults, static_cast<double>(total.stalledNs) / 1e6);
+        if (!anyPeerAcking())
+        {
+            std::printf("受信側から ACK が届かなかったため、ACK による計測はできませんでした\n");
+        }
+        if (options.ramp > 0)
+        {
+            if (sustainedRate > 0)
+            {
+                std::printf("追いつけた最大の発生率: %.0f/s（全台の合計）\n", sustainedRate);
+            }
+            else
+            {
+                std::printf("最初の段階（%.0f/s）から追いつけませんでした\n", options.rate * options.controllers);
+            }
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    LoadGenerator generator(options);
+    if (!generator.start())
+    {
+        return 1;
+    }
+    generator.run();
+    return 0;
+}
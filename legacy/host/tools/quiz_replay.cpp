@@ -0,0 +1,279 @@
+/**
+ * @file quiz_replay.cpp
+ * @brief 記録したコントローラー出力を pty に流し込むツール
+ *
+ * 擬似端末を作成してスレーブ側のパスを表示し、マスター側へ記録済みのデータを書き込む
+ * quiz-ingest やサーバーを実機なしで動かすために使う
+ * - 記録ファイル（.qcap）: 受信時の read() 単位・受信間隔のまま再生（--speed で倍速）
+ * - テキストファイル: 1行ずつ一定間隔で再生
+ * スレーブ側から届いたコマンド（ACK など）は --echo で標準エラーに表示する
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <pty.h>
+#include <poll.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#include "CaptureReader.h"
+
+namespace
+{
+
+struct Options
+{
+    std::string input;
+    std::string link;        // スレーブのパスを指すシンボリックリンク
+    int intervalMs = 100;    // テキスト再生時の行ごとの送信間隔
+    int startDelayMs = 1000; // 接続を待つ時間
+    double speed = 1.0;      // 再生速度（0: 待ち時間なし）
+    bool loop = false;
+    bool echoCommands = false;
+};
+
+/**
+ * @brief 再生する1回分の書き込み
+ */
+struct Frame
+{
+    uint64_t offsetNs; // 再生開始からの時刻（等速時）
+    std::string bytes;
+};
+
+using Clock = std::chrono::steady_clock;
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-replay <記録ファイル> [オプション]\n"
+        "\n"
+        "記録ファイルは quiz-ingest --record の .qcap、またはコントローラーの出力を\n"
+        "1行ずつ保存したテキスト\n"
+        "\n"
+        "オプション:\n"
+        "  -l, --link <パス>       pty スレーブへのシンボリックリンクを作成\n"
+        "  -x, --speed <倍率>      再生速度 (デフォルト: 1、0 で待ち時間なし)\n"
+        "  -i, --interval <ms>     テキスト再生時の行の送信間隔 (デフォルト: 100)\n"
+        "      --delay <ms>        送信開始までの待ち時間 (デフォルト: 1000)\n"
+        "      --loop              最後まで送ったら先頭から繰り返す\n"
+        "      --echo              受信したコマンドを表示\n"
+        "  -h, --help              このヘルプを表示\n");
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--link" || arg == "-l") && hasValue)
+        {
+            options.link = argv[++i];
+        }
+        else if ((arg == "--speed" || arg == "-x") && hasValue)
+        {
+            options.speed = std::atof(argv[++i]);
+        }
+        else if ((arg == "--interval" || arg == "-i") && hasValue)
+        {
+            options.intervalMs = std::atoi(argv[++i]);
+        }
+        else if (arg == "--delay" && hasValue)
+        {
+            options.startDelayMs = std::atoi(argv[++i]);
+        }
+        else if (arg == "--loop")
+        {
+            options.loop = true;
+        }
+        else if (arg == "--echo")
+        {
+            options.echoCommands = true;
+        }
+        else if (!arg.empty() && arg[0] != '-' && options.input.empty())
+        {
+            options.input = arg;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !options.input.empty() && options.speed >= 0;
+}
+
+/**
+ * @brief 記録ファイルから受信単位のフレームを読み込む
+ */
+bool loadCapture(const std::string &path, std::vector<Frame> &frames)
+{
+    CaptureReader reader;
+    if (!reader.open(path))
+    {
+        return false;
+    }
+
+    CaptureRecord record;
+    uint64_t firstNs = 0;
+    while (reader.next(record))
+    {
+        if (record.raw.empty())
+        {
+            continue; // LinkUp / LinkDown
+        }
+        if (frames.empty())
+        {
+            firstNs = record.arrivalNs;
+        }
+        frames.push_back(Frame{record.arrivalNs - firstNs, std::string(record.raw)});
+    }
+    if (reader.isTruncated())
+    {
+        std::fprintf(stderr, "警告: 記録ファイルの末尾が不完全です（最後のレコードを無視）\n");
+    }
+    return true;
+}
+
+/**
+ * @brief テキストファイルから1行ずつのフレームを読み込む
+ */
+bool loadText(const std::string &path, int intervalMs, std::vector<Frame> &frames)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            uint64_t offsetNs = static_cast<uint64_t>(frames.size()) * intervalMs * 1000000ULL;
+            frames.push_back(Frame{offsetNs, line + "\r\n"}); // Serial.println() と同じ改行
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 指定時刻までスレーブ側から届いたデータを読み捨てる（必要なら表示）
+ */
+void drainCommandsUntil(int masterFd, bool echo, Clock::time_point deadline)
+{
+    pollfd pfd;
+    pfd.fd = masterFd;
+    pfd.events = POLLIN;
+    for (;;)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (poll(&pfd, 1, remaining > 0 ? static_cast<int>(remaining) : 0) <= 0)
+        {
+            return;
+        }
+        char buf[256];
+        ssize_t n = ::read(masterFd, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            return;
+        }
+        if (echo)
+        {
+            std::fwrite(buf, 1, static_cast<size_t>(n), stderr);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<Frame> frames;
+    if (!loadCapture(options.input, frames) && !loadText(options.input, options.intervalMs, frames))
+    {
+        std::fprintf(stderr, "%s を開けません\n", options.input.c_str());
+        return 1;
+    }
+
+    int masterFd;
+    int slaveFd;
+    char slaveName[256];
+    if (openpty(&masterFd, &slaveFd, slaveName, nullptr, nullptr) < 0)
+    {
+        std::fprintf(stderr, "pty を作成できません: %s\n", std::strerror(errno));
+        return 1;
+    }
+
+    // エコーや改行変換をしない（受信側が自分のコマンドを読まないように）
+    termios tio;
+    tcgetattr(slaveFd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slaveFd, TCSANOW, &tio);
+
+    std::printf("%s\n", slaveName);
+    std::fflush(stdout);
+    if (!options.link.empty())
+    {
+        ::unlink(options.link.c_str());
+        if (::symlink(slaveName, options.link.c_str()) < 0)
+        {
+            std::fprintf(stderr, "%s を作成できません: %s\n", options.link.c_str(), std::strerror(errno));
+        }
+    }
+
+    drainCommandsUntil(masterFd, options.echoCommands,
+                       Clock::now() + std::chrono::milliseconds(options.startDelayMs));
+
+    size_t totalBytes = 0;
+    auto playStart = Clock::now();
+    do
+    {
+        auto start = Clock::now();
+        for (const Frame &frame : frames)
+        {
+            if (options.speed > 0)
+            {
+                auto due = start + std::chrono::nanoseconds(static_cast<int64_t>(frame.offsetNs / options.speed));
+                drainCommandsUntil(masterFd, options.echoCommands, due);
+            }
+            if (::write(masterFd, frame.bytes.data(), frame.bytes.size()) < 0)
+            {
+                std::fprintf(stderr, "書き込みエラー: %s\n", std::strerror(errno));
+                return 1;
+            }
+            totalBytes += frame.bytes.size();
+        }
+    } while (options.loop);
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - playStart).count();
+    std::fprintf(stderr, "%zu バイトを %.3f 秒で再生しました\n", totalBytes, elapsed);
+
+    // 受信側が最後のデータを読み切るまで少し待つ
+    drainCommandsUntil(masterFd, options.echoCommands, Clock::now() + std::chrono::milliseconds(500));
+
+    if (!options.link.empty())
+    {
+        ::unlink(options.link.c_str());
+    }
+    ::close(slaveFd);
+    ::close(masterFd);
+    return 0;
+}
@@ -0,0 +1,328 @@
+/**
+ * @file quiz_ringbench.cpp
+ * @brief 共有メモリのリング（IngestRing）の読み手の数に対する遅延・スループットを測るベンチマーク
+ *
+ * quiz-ingest と同じ IngestRingWriter で IngestRecord を書き、読み手のスレッドごとに
+ * IngestRingReader を開いて読む。読み手の数を変えながら次の値を表示する
+ * - 書き手の毎秒レコード数と1件あたりの時間（読み手が増えたときにどれだけ遅くなるか）
+ * - 読み手ごとの毎秒レコード数（最小・平均）と、追い越されて失ったレコードの数
+ * - 書き込み時刻（arrivalNs）から読み手が読み終えるまでの遅延（全読み手の p50 / p99 / p99.9 / 最大）
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Clock.h"
+#include "ControllerEvent.h"
+#include "IngestRing.h"
+
+namespace
+{
+
+enum class WaitMode
+{
+    Spin,
+    Futex
+};
+
+struct Options
+{
+    std::vector<int> readerCounts = {1, 2, 4, 8};
+    unsigned long records = 1000000;
+    double rate = 0; // 書き込みの速さ（毎秒、0: 全速）
+    uint32_t slots = INGEST_RING_DEFAULT_SLOTS;
+    size_t payload = 0;
+    WaitMode wait = WaitMode::Futex;
+};
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-ringbench [オプション]\n"
+        "\n"
+        "オプション:\n"
+        "  -n, --readers <数,...>  読み手の数 (デフォルト: 1,2,4,8)\n"
+        "  -c, --records <数>      書き込むレコード数 (デフォルト: 1000000)\n"
+        "  -r, --rate <毎秒>       書き込みの速さ (デフォルト: 0 = 全速)\n"
+        "      --slots <数>        リングのスロット数、2のべき乗 (デフォルト: 4096)\n"
+        "      --payload <バイト>  レコードごとのペイロード (デフォルト: 0)\n"
+        "      --wait <方式>       spin | futex、空のときの読み手の待ち方 (デフォルト: futex)\n"
+        "  -h, --help              このヘルプを表示\n");
+}
+
+bool parseReaderCounts(const char *text, std::vector<int> &counts)
+{
+    counts.clear();
+    const char *p = text;
+    while (*p != '\0')
+    {
+        char *end;
+        long value = std::strtol(p, &end, 10);
+        if (end == p || value < 1 || value > 256)
+        {
+            return false;
+        }
+        counts.push_back(static_cast<int>(value));
+        p = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0')
+        {
+            return false;
+        }
+    }
+    return !counts.empty();
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--readers" || arg == "-n") && hasValue)
+        {
+            if (!parseReaderCounts(argv[++i], options.readerCounts))
+            {
+                return false;
+            }
+        }
+        else if ((arg == "--records" || arg == "-c") && hasValue)
+        {
+            options.records = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if ((arg == "--rate" || arg == "-r") && hasValue)
+        {
+            options.rate = std::atof(argv[++i]);
+        }
+        else if (arg == "--slots" && hasValue)
+        {
+            options.slots = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--payload" && hasValue)
+        {
+            options.payload = std::min<size_t>(std::strtoul(argv[++i], nullptr, 10), 0xFFFF - sizeof(IngestRecordHeader));
+        }
+        else if (arg == "--wait" && hasValue)
+        {
+            std::string mode = argv[++i];
+            if (mode == "spin")
+            {
+                options.wait = WaitMode::Spin;
+            }
+            else if (mode == "futex")
+            {
+                options.wait = WaitMode::Futex;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return options.records > 0;
+}
+
+/**
+ * @brief 読み手1つ分の結果
+ */
+struct ReaderResult
+{
+    bool opened = false;
+    unsigned long readCount = 0;
+    uint64_t lostCount = 0;
+    uint64_t finishedNs = 0;
+    std::vector<uint64_t> latencies; // 書き込みから読み終えるまで（ナノ秒）
+};
+
+void runReader(const std::string &name, const Options &options, std::atomic<int> &ready, ReaderResult &result)
+{
+    IngestRingReader reader;
+    result.opened = reader.open(name);
+    ready.fetch_add(1);
+    if (!result.opened)
+    {
+        return;
+    }
+    result.latencies.reserve(options.records);
+
+    const IngestRecordHeader *record;
+    std::string_view payload;
+    for (;;)
+    {
+        IngestRingReader::Status status = reader.next(record, payload);
+        if (status == IngestRingReader::Status::Ok)
+        {
+            // ヘッダは packed のため memcpy で取り出す
+            uint64_t arrivalNs;
+            std::memcpy(&arrivalNs, reinterpret_cast<const char *>(record) + offsetof(IngestRecordHeader, arrivalNs),
+                        sizeof(arrivalNs));
+            uint64_t nowNs = monotonicRawNs();
+            if (reader.commit())
+            {
+                result.readCount++;
+                result.latencies.push_back(nowNs - arrivalNs);
+            }
+        }
+        else if (status == IngestRingReader::Status::Closed)
+        {
+            break;
+        }
+        else if (options.wait == WaitMode::Futex)
+        {
+            reader.wait(100);
+        }
+    }
+    result.finishedNs = monotonicRawNs();
+    result.lostCount = reader.getLostCount();
+}
+
+uint64_t percentile(std::vector<uint64_t> &values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())));
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+    return values[index];
+}
+
+bool runRound(const Options &options, int readerCount)
+{
+    std::string name = "/quiz-ringbench." + std::to_string(::getpid());
+    IngestRingWriter writer;
+    if (!writer.create(name, options.slots))
+    {
+        std::fprintf(stderr, "共有メモリ %s を作成できません: %s\n", name.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    std::atomic<int> ready(0);
+    std::vector<ReaderResult> results(static_cast<size_t>(readerCount));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < readerCount; i++)
+    {
+        threads.emplace_back(runReader, std::cref(name), std::cref(options), std::ref(ready),
+                             std::ref(results[static_cast<size_t>(i)]));
+    }
+    while (ready.load() < readerCount)
+    {
+        std::this_thread::yield();
+    }
+
+    // quiz-ingest と同じく押下のレコードを1件ずつ書く
+    std::string record(sizeof(IngestRecordHeader) + options.payload, 'x');
+    IngestRecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.length = static_cast<uint16_t>(record.size());
+    header.kind = static_cast<uint8_t>(EventKind::ButtonPress);
+    header.flags = INGEST_FLAG_HAS_SEQ;
+
+    uint64_t startNs = monotonicRawNs();
+    for (unsigned long i = 0; i < options.records; i++)
+    {
+        if (options.rate > 0)
+        {
+            uint64_t dueNs = startNs + static_cast<uint64_t>(static_cast<double>(i) * 1e9 / options.rate);
+            while (monotonicRawNs() < dueNs)
+            {
+            }
+        }
+        header.buttonId = static_cast<uint8_t>(i % 6 + 1);
+        header.seq = static_cast<uint16_t>(i);
+        header.arrivalNs = monotonicRawNs();
+        std::memcpy(&record[0], &header, sizeof(header));
+        writer.write(record.data());
+    }
+    uint64_t writeNs = monotonicRawNs() - startNs;
+    unsigned long truncated = writer.getTruncatedCount();
+    unsigned long wakes = writer.getWakeCount();
+    writer.close();
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::vector<uint64_t> latencies;
+    double minRate = 0;
+    double sumRate = 0;
+    uint64_t lost = 0;
+    for (ReaderResult &result : results)
+    {
+        if (!result.opened)
+        {
+            std::fprintf(stderr, "読み手が共有メモリを開けませんでした\n");
+            return false;
+        }
+        double seconds = static_cast<double>(result.finishedNs - startNs) / 1e9;
+        double readRate = seconds > 0 ? static_cast<double>(result.readCount) / seconds : 0;
+        minRate = &result == &results.front() ? readRate : std::min(minRate, readRate);
+        sumRate += readRate;
+        lost += result.lostCount;
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        std::vector<uint64_t>().swap(result.latencies);
+    }
+
+    double writeSeconds = static_cast<double>(writeNs) / 1e9;
+    std::printf("読み手 %3d: 書き込み %10.0f 件/秒 (%6.1f ns/件), 読み手ごと 最小 %10.0f / 平均 %10.0f 件/秒, "
+                "取りこぼし %llu",
+                readerCount, static_cast<double>(options.records) / writeSeconds,
+                static_cast<double>(writeNs) / static_cast<double>(options.records), minRate, sumRate / readerCount,
+                static_cast<unsigned long long>(lost));
+    if (truncated > 0)
+    {
+        std::printf(", 切り詰め %lu", truncated);
+    }
+    std::printf("\n            遅延 p50 %.2f / p99 %.2f / p99.9 %.2f / 最大 %.2f µs, 起床 %lu\n",
+                static_cast<double>(percentile(latencies, 0.50)) / 1000.0,
+                static_cast<double>(percentile(latencies, 0.99)) / 1000.0,
+                static_cast<double>(percentile(latencies, 0.999)) / 1000.0,
+                latencies.empty() ? 0.0 : static_cast<double>(*std::max_element(latencies.begin(), latencies.end())) / 1000.0,
+                wakes);
+    std::fflush(stdout);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    unsigned int cores = std::thread::hardware_concurrency();
+    std::printf("レコード %lu 件, ペイロード %zu バイト, スロット %u, 待ち方 %s, 書き込み %s, CPU %u\n",
+                options.records, options.payload, options.slots, options.wait == WaitMode::Spin ? "spin" : "futex",
+                options.rate > 0 ? (std::to_string(static_cast<long>(options.rate)) + " 件/秒").c_str() : "全速",
+                cores);
+    for (int readerCount : options.readerCounts)
+    {
+        if (options.wait == WaitMode::Spin && cores > 0 && static_cast<unsigned int>(readerCount) >= cores)
+        {
+            std::fprintf(stderr, "注意: spin で読み手 %d は CPU 数 %u 以上のため、書き手と CPU を奪い合います\n",
+                         readerCount, cores);
+        }
+        if (!runRound(options, readerCount))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,435 @@
+/**
+ * @file quiz_scope.cpp
+ * @brief コントローラーの生の入力（SCOPE）を受信し、バウンスの波形と統計を表示するツール
+ *
+ * コントローラーに "SCOPE [id]" を送り、scope フレームを ScopeAnalyzer でエピソードにまとめる
+ * - --device: シリアルデバイスに直接接続（quiz-ingest を止めて使う）
+ * - --socket: quiz-ingest の購読者として接続（コマンドは quiz-ingest 経由で転送される）
+ * - --capture: quiz-ingest --record の記録ファイルに含まれる scope フレームを解析（コマンドは送らない）
+ * 終了時（--duration の経過・Ctrl-C）に "SCOPE OFF" を送り、ボタンごとの統計を表示する
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "CaptureReader.h"
+#include "EventDecoder.h"
+#include "IngestRecord.h"
+#include "LineFramer.h"
+#include "ScopeAnalyzer.h"
+#include "SerialDevice.h"
+
+namespace
+{
+
+struct Options
+{
+    std::string device;
+    int baud = 9600;
+    std::string socketPath;
+    std::string capturePath;
+    int buttonId = 0;        // 0: 全ボタン
+    int settleUs = 5000;     // エピソードを閉じるまでの無変化時間
+    int width = 64;          // 波形の文字数
+    double durationSec = 0;  // 0: Ctrl-C まで
+    bool quiet = false;      // 波形を表示しない
+};
+
+volatile sig_atomic_t stopRequested = 0;
+
+void handleSignal(int)
+{
+    stopRequested = 1;
+}
+
+using Clock = std::chrono::steady_clock;
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-scope (--device <パス> | --socket <パス> | --capture <記録ファイル>) [オプション]\n"
+        "\n"
+        "コントローラーの生の入力の変化（SCOPE）を受信し、ボタンごとのバウンスを表示する\n"
+        "\n"
+        "オプション:\n"
+        "  -d, --device <パス>     シリアルデバイスに直接接続\n"
+        "  -b, --baud <bps>        ボーレート (デフォルト: 9600)\n"
+        "  -s, --socket <パス>     quiz-ingest のソケットに接続\n"
+        "  -c, --capture <パス>    記録ファイル（.qcap）の scope フレームを解析\n"
+        "  -n, --button <ID>       対象のボタン (デフォルト: 0 = 全ボタン)\n"
+        "      --settle <µs>       この時間変化がなければ1回の操作とする (デフォルト: 5000)\n"
+        "  -w, --width <文字数>    波形の幅 (デフォルト: 64)\n"
+        "  -t, --duration <秒>     受信する時間 (デフォルト: 0 = Ctrl-C まで)\n"
+        "  -q, --quiet             波形を表示せず統計だけを表示\n"
+        "  -h, --help              このヘルプを表示\n");
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--device" || arg == "-d") && hasValue)
+        {
+            options.device = argv[++i];
+        }
+        else if ((arg == "--baud" || arg == "-b") && hasValue)
+        {
+            options.baud = std::atoi(argv[++i]);
+        }
+        else if ((arg == "--socket" || arg == "-s") && hasValue)
+        {
+            options.socketPath = argv[++i];
+        }
+        else if ((arg == "--capture" || arg == "-c") && hasValue)
+        {
+            options.capturePath = argv[++i];
+        }
+        else if ((arg == "--button" || arg == "-n") && hasValue)
+        {
+            options.buttonId = std::atoi(argv[++i]);
+        }
+        else if (arg == "--settle" && hasValue)
+        {
+            options.settleUs = std::atoi(argv[++i]);
+        }
+        else if ((arg == "--width" || arg == "-w") && hasValue)
+        {
+            options.width = std::atoi(argv[++i]);
+        }
+        else if ((arg == "--duration" || arg == "-t") && hasValue)
+        {
+            options.durationSec = std::atof(argv[++i]);
+        }
+        else if (arg == "--quiet" || arg == "-q")
+        {
+            options.quiet = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    int sources = !options.device.empty() + !options.socketPath.empty() + !options.capturePath.empty();
+    return sources == 1 && options.buttonId >= 0 && options.buttonId <= ScopeAnalyzer::MAX_BUTTONS &&
+           options.settleUs > 0 && options.width > 0 && options.durationSec >= 0;
+}
+
+const char *directionName(ScopeAnalyzer::Direction direction)
+{
+    switch (direction)
+    {
+    case ScopeAnalyzer::DIRECTION_PRESS:
+        return "押下";
+    case ScopeAnalyzer::DIRECTION_RELEASE:
+        return "解放";
+    case ScopeAnalyzer::DIRECTION_GLITCH:
+        return "グリッチ";
+    }
+    return "";
+}
+
+/**
+ * @brief 閉じたエピソードを表示する
+ */
+void printEpisodes(ScopeAnalyzer &analyzer, const Options &options)
+{
+    ScopeAnalyzer::Episode episode;
+    while (analyzer.popEpisode(episode))
+    {
+        if (options.quiet)
+        {
+            continue;
+        }
+        std::printf("[ボタン%u] %s 変化 %u回 span %.0fµs", episode.buttonIndex + 1, directionName(episode.direction),
+                    episode.edges, analyzer.ticksToUs(episode.endTick - episode.startTick));
+        if (episode.edges > 1)
+        {
+            std::printf(" 最短パルス %.0fµs 間隔最大 %.0fµs", analyzer.ticksToUs(episode.minPulseTicks),
+                        analyzer.ticksToUs(episode.maxGapTicks));
+        }
+        std::printf("%s\n  %s\n", episode.lost ? "（取りこぼしあり）" : "",
+                    analyzer.render(episode, static_cast<size_t>(options.width)).c_str());
+    }
+    std::fflush(stdout);
+}
+
+/**
+ * @brief 1行をデコードし、scope フレームなら解析器に渡す
+ */
+void handleLine(std::string_view line, EventDecoder &decoder, ScopeAnalyzer &analyzer, const Options &options)
+{
+    ControllerEvent event;
+    if (!decoder.decode(line, event))
+    {
+        return;
+    }
+    if (event.kind == EventKind::Scope)
+    {
+        analyzer.addFrame(event);
+        printEpisodes(analyzer, options);
+    }
+    else if (event.kind == EventKind::Error)
+    {
+        std::fprintf(stderr, "コントローラーのエラー: %.*s\n", static_cast<int>(event.message.size()),
+                     event.message.data());
+    }
+}
+
+int analyzeCapture(const Options &options, EventDecoder &decoder, ScopeAnalyzer &analyzer)
+{
+    CaptureReader reader;
+    if (!reader.open(options.capturePath))
+    {
+        std::fprintf(stderr, "記録ファイル %s を開けません: %s\n", options.capturePath.c_str(), std::strerror(errno));
+        return 1;
+    }
+
+    LineFramer framer;
+    CaptureRecord record;
+    while (reader.next(record))
+    {
+        if (record.raw.empty())
+        {
+            framer.clear(); // LinkUp / LinkDown
+            continue;
+        }
+        std::string_view remaining = record.raw;
+        while (!remaining.empty())
+        {
+            char *dst = framer.writePtr();
+            size_t n = std::min(framer.writable(), remaining.size());
+            std::memcpy(dst, remaining.data(), n);
+            framer.commit(n);
+            remaining.remove_prefix(n);
+
+            std::string_view line;
+            while (framer.next(line))
+            {
+                handleLine(line, decoder, analyzer, options);
+            }
+        }
+    }
+    return 0;
+}
+
+int connectSocket(const std::string &path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief quiz-ingest のレコードから scope フレーム（ペイロードは元の行）を取り出す
+ * @return 処理したバイト数
+ */
+size_t handleRecords(const std::string &buffer, EventDecoder &decoder, ScopeAnalyzer &analyzer,
+                     const Options &options)
+{
+    size_t offset = 0;
+    while (buffer.size() - offset >= sizeof(IngestRecordHeader))
+    {
+        IngestRecordHeader header;
+        std::memcpy(&header, buffer.data() + offset, sizeof(header));
+        if (header.length < sizeof(header))
+        {
+            return buffer.size(); // 壊れている: 読み捨てる
+        }
+        if (buffer.size() - offset < header.length)
+        {
+            break;
+        }
+        EventKind kind = static_cast<EventKind>(header.kind);
+        if (kind == EventKind::Scope || kind == EventKind::Error)
+        {
+            std::string_view payload(buffer.data() + offset + sizeof(header), header.length - sizeof(header));
+            if (kind == EventKind::Scope)
+            {
+                handleLine(payload, decoder, analyzer, options);
+            }
+            else
+            {
+                std::fprintf(stderr, "コントローラーのエラー: %.*s\n", static_cast<int>(payload.size()),
+                             payload.data());
+            }
+        }
+        offset += header.length;
+    }
+    return offset;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    EventDecoder decoder;
+    ScopeAnalyzer analyzer(static_cast<uint32_t>(options.settleUs));
+
+    if (!options.capturePath.empty())
+    {
+        int result = analyzeCapture(options, decoder, analyzer);
+        analyzer.finish();
+        printEpisodes(analyzer, options);
+        analyzer.printSummary(stdout);
+        return result;
+    }
+
+    SerialDevice serial;
+    int socketFd = -1;
+    if (!options.device.empty())
+    {
+        if (!serial.open(options.device, options.baud))
+        {
+            std::fprintf(stderr, "%s を開けません: %s\n", options.device.c_str(), std::strerror(errno));
+            return 1;
+        }
+    }
+    else
+    {
+        socketFd = connectSocket(options.socketPath);
+        if (socketFd < 0)
+        {
+            std::fprintf(stderr, "ソケット %s に接続できません: %s\n", options.socketPath.c_str(),
+                         std::strerror(errno));
+            return 1;
+        }
+    }
+
+    auto sendCommand = [&](const std::string &command) {
+        if (socketFd >= 0)
+        {
+            (void)::send(socketFd, command.data(), command.size(), MSG_NOSIGNAL);
+        }
+        else
+        {
+            serial.write(command);
+            serial.flush();
+        }
+    };
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    sendCommand(options.buttonId == 0 ? std::string("SCOPE\n") : "SCOPE " + std::to_string(options.buttonId) + "\n");
+
+    LineFramer framer;
+    std::string records;
+    char chunk[4096];
+    Clock::time_point startedAt = Clock::now();
+    Clock::time_point stopAt;
+    bool stopping = false;
+    bool started = false;
+    int fd = socketFd >= 0 ? socketFd : serial.getFd();
+
+    while (true)
+    {
+        Clock::time_point now = Clock::now();
+        bool expired = options.durationSec > 0 &&
+                       std::chrono::duration<double>(now - startedAt).count() >= options.durationSec;
+        if (!stopping && (stopRequested || expired))
+        {
+            // 溜まっている変化と終了フレームが届くまで少し待つ
+            sendCommand("SCOPE OFF\n");
+            stopping = true;
+            stopAt = now + std::chrono::seconds(2);
+        }
+        if (stopping && (now >= stopAt || (started && !analyzer.isStarted())))
+        {
+            break;
+        }
+        started = started || analyzer.isStarted();
+
+        pollfd pfd = {fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 100);
+        if (ready < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (ready <= 0)
+        {
+            continue;
+        }
+
+        if (socketFd >= 0)
+        {
+            ssize_t n = ::read(socketFd, chunk, sizeof(chunk));
+            if (n <= 0)
+            {
+                std::fprintf(stderr, "quiz-ingest から切断されました\n");
+                break;
+            }
+            records.append(chunk, static_cast<size_t>(n));
+            records.erase(0, handleRecords(records, decoder, analyzer, options));
+        }
+        else
+        {
+            char *dst = framer.writePtr();
+            ssize_t n = serial.readSome(dst, framer.writable());
+            if (n == -EAGAIN)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                std::fprintf(stderr, "%s が切断されました\n", options.device.c_str());
+                break;
+            }
+            framer.commit(static_cast<size_t>(n));
+            std::string_view line;
+            while (framer.next(line))
+            {
+                handleLine(line, decoder, analyzer, options);
+            }
+        }
+    }
+
+    if (socketFd >= 0)
+    {
+        ::close(socketFd);
+    }
+    analyzer.finish();
+    printEpisodes(analyzer, options);
+
+    if (analyzer.getFrameCount() == 0)
+    {
+        std::fprintf(stderr, "scope フレームを受信しませんでした（ENABLE_SCOPE が無効なファームウェアの可能性）\n");
+        return 2;
+    }
+    std::printf("サンプリング周波数: %u Hz、フレーム: %lu\n", analyzer.getSampleRate(), analyzer.getFrameCount());
+    analyzer.printSummary(stdout);
+    return 0;
+}
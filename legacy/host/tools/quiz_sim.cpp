@@ -0,0 +1,786 @@
+/**
+ * @file quiz_sim.cpp
+ * @brief simavr 上で実際のファームウェア（firmware.elf）を動かすシミュレーター
+ *
+ * Wokwi と同じ ELF を読み込み、オフラインでサイクル単位の動作を再現する
+ * - 刺激ファイルに従って A0〜A5 のボタンピンを操作し、シリアルコマンドを送る
+ * - UART の出力（行、ENABLE_COBS_FRAMING では 0x00 区切りのフレーム）をサイクル数付きで記録する
+ * - 押下から、そのボタンIDを含む pressedButton / pressedButtons の送信開始までの遅延をサイクル単位で計測する
+ * - UART を pty と TCP（Wokwi と同じ localhost:4000）で公開し、サーバーの --simulator モードから接続できる
+ */
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <netinet/in.h>
+#include <pty.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#include "EventDecoder.h"
+#include "LineFramer.h"
+
+extern "C"
+{
+#include <avr_ioport.h>
+#include <avr_uart.h>
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_irq.h>
+}
+
+namespace
+{
+
+struct Options
+{
+    std::string firmware;
+    std::string mcu = "atmega328p";
+    uint32_t frequency = 16000000;
+    std::string stimulus;   // 刺激ファイル
+    std::string capture;    // UART 出力の記録先
+    std::string link;       // pty スレーブへのシンボリックリンク
+    bool pty = false;
+    int listenPort = -1;    // TCP で UART を公開するポート
+    double tailMs = 500;    // 最後の刺激の後に動かす時間
+    int buttonPins[6] = {2, 4, 1, 3, 5, 0}; // ボタンID 1〜6 のポートCのビット（config.h の BUTTON_*_PIN）
+    bool realtime = false;  // 実時間に合わせて実行
+    bool echo = false;
+};
+
+/**
+ * @brief 刺激ファイルの1行
+ */
+struct Stimulus
+{
+    enum Action
+    {
+        PRESS,
+        RELEASE,
+        SEND,
+        END
+    };
+
+    uint64_t cycle; // 実行するサイクル
+    Action action;
+    int pin;          // ポートCのビット（A0 = 0）
+    std::string text; // 送信するコマンド
+};
+
+/**
+ * @brief 押下の計測結果
+ */
+struct PressMeasurement
+{
+    int pin;
+    int buttonId;          // 0: ボタンに割り当てられていないピン
+    uint64_t pressCycle;
+    uint64_t firstTxCycle; // 0: 未送信（コントローラーが受け付けなかった）
+};
+
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+void printUsage()
+{
+    std::printf(
+        "使用方法: quiz-sim <firmware.elf> [オプション]\n"
+        "\n"
+        "オプション:\n"
+        "  -m, --mcu <名前>        MCU (デフォルト: atmega328p)\n"
+        "  -f, --freq <Hz>         クロック周波数 (デフォルト: 16000000)\n"
+        "  -s, --stimulus <パス>   刺激ファイル\n"
+        "  -c, --capture <パス>    UART 出力をサイクル数付きで記録\n"
+        "      --pty               UART を pty で公開\n"
+        "  -l, --link <パス>       pty スレーブへのシンボリックリンクを作成 (--pty を含む)\n"
+        "      --listen <ポート>   UART を TCP で公開 (サーバーの --simulator は 4000)\n"
+        "      --tail <ms>         最後の刺激の後に実行する時間 (デフォルト: 500)\n"
+        "      --buttons <ピン,...> ボタンID 1〜6 のピン (デフォルト: A2,A4,A1,A3,A5,A0)\n"
+        "      --realtime          実時間に合わせて実行 (pty / TCP 使用時は常に有効)\n"
+        "      --echo              UART 出力を標準エラーに表示\n"
+        "  -h, --help              このヘルプを表示\n"
+        "\n"
+        "刺激ファイルの形式（1行1操作、# 以降はコメント）:\n"
+        "  <時刻ms> press <A0-A5>\n"
+        "  <時刻ms> release <A0-A5>\n"
+        "  <時刻ms> send <コマンド>\n"
+        "  <時刻ms> end\n");
+}
+
+/**
+ * @brief "A0"〜"A5" をポートCのビットに変換
+ * @return ビット番号、不正な場合は -1
+ */
+int parsePin(const std::string &name)
+{
+    if (name.size() == 2 && (name[0] == 'A' || name[0] == 'a') && name[1] >= '0' && name[1] <= '5')
+    {
+        return name[1] - '0';
+    }
+    return -1;
+}
+
+/**
+ * @brief "A2,A4,A1,A3,A5,A0" をボタンID 1〜6 のピンに変換
+ * @return 6個のピンを指定できた場合 true
+ */
+bool parseButtonPins(const std::string &list, int *pins)
+{
+    std::istringstream in(list);
+    std::string name;
+    int count = 0;
+    while (std::getline(in, name, ','))
+    {
+        if (count == 6 || (pins[count] = parsePin(name)) < 0)
+        {
+            return false;
+        }
+        count++;
+    }
+    return count == 6;
+}
+
+bool parseArgs(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if ((arg == "--mcu" || arg == "-m") && hasValue)
+        {
+            options.mcu = argv[++i];
+        }
+        else if ((arg == "--freq" || arg == "-f") && hasValue)
+        {
+            options.frequency = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if ((arg == "--stimulus" || arg == "-s") && hasValue)
+        {
+            options.stimulus = argv[++i];
+        }
+        else if ((arg == "--capture" || arg == "-c") && hasValue)
+        {
+            options.capture = argv[++i];
+        }
+        else if (arg == "--pty")
+        {
+            options.pty = true;
+        }
+        else if ((arg == "--link" || arg == "-l") && hasValue)
+        {
+            options.link = argv[++i];
+            options.pty = true;
+        }
+        else if (arg == "--listen" && hasValue)
+        {
+            options.listenPort = std::atoi(argv[++i]);
+        }
+        else if (arg == "--tail" && hasValue)
+        {
+            options.tailMs = std::atof(argv[++i]);
+        }
+        else if (arg == "--buttons" && hasValue)
+        {
+            if (!parseButtonPins(argv[++i], options.buttonPins))
+            {
+                return false;
+            }
+        }
+        else if (arg == "--realtime")
+        {
+            options.realtime = true;
+        }
+        else if (arg == "--echo")
+        {
+            options.echo = true;
+        }
+        else if (!arg.empty() && arg[0] != '-' && options.firmware.empty())
+        {
+            options.firmware = arg;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !options.firmware.empty();
+}
+
+bool loadStimulus(const std::string &path, uint32_t frequency, std::vector<Stimulus> &out)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::fprintf(stderr, "%s を開けません\n", path.c_str());
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream in(line);
+        double timeMs;
+        std::string action;
+        if (!(in >> timeMs))
+        {
+            continue; // 空行
+        }
+        in >> action;
+
+        Stimulus stimulus;
+        stimulus.cycle = static_cast<uint64_t>(timeMs * frequency / 1000.0);
+        stimulus.pin = -1;
+        if (action == "press" || action == "release")
+        {
+            std::string pin;
+            in >> pin;
+            stimulus.action = action == "press" ? Stimulus::PRESS : Stimulus::RELEASE;
+            stimulus.pin = parsePin(pin);
+        }
+        else if (action == "send")
+        {
+            stimulus.action = Stimulus::SEND;
+            std::getline(in >> std::ws, stimulus.text);
+            stimulus.text += '\n';
+        }
+        else if (action == "end")
+        {
+            stimulus.action = Stimulus::END;
+        }
+        else
+        {
+            std::fprintf(stderr, "%s:%d: 不明な操作 '%s'\n", path.c_str(), lineNumber, action.c_str());
+            return false;
+        }
+
+        if ((stimulus.action == Stimulus::PRESS || stimulus.action == Stimulus::RELEASE) && stimulus.pin < 0)
+        {
+            std::fprintf(stderr, "%s:%d: ピンは A0〜A5 で指定してください\n", path.c_str(), lineNumber);
+            return false;
+        }
+        if (!out.empty() && stimulus.cycle < out.back().cycle)
+        {
+            std::fprintf(stderr, "%s:%d: 時刻が前の行より前です\n", path.c_str(), lineNumber);
+            return false;
+        }
+        out.push_back(stimulus);
+    }
+    return true;
+}
+
+int openListener(int port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || ::listen(fd, 1) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+uint64_t wallNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief ピンに割り当てられたボタンIDを取得
+ * @return 1〜6、割り当てがない場合は 0
+ */
+int buttonIdOf(const Options &options, int pin)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        if (options.buttonPins[i] == pin)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief シミュレーション全体の状態（simavr のコールバックから参照する）
+ */
+struct Simulation
+{
+    avr_t *avr = nullptr;
+    avr_irq_t *uartInput = nullptr;
+    bool uartXon = true;
+
+    std::deque<uint8_t> pendingInput; // UART へ渡す前の受信データ
+
+    // UART 出力を行・フレームに分割する（COBS フレームはサーバーと同じ規則で自動的に切り替わる）
+    LineFramer framer;
+    EventDecoder decoder;
+    bool lineStarted = false;    // 組み立て中の行・フレームがあるか
+    uint64_t lineStartCycle = 0; // その先頭バイトのサイクル（フレームは先頭の 0x00）
+    uint64_t delimiterCycle = 0; // 直前のバイトが 0x00 だった場合、そのサイクル（0: 直前は 0x00 ではない）
+    uint32_t rawRemaining = 0;   // 行の後に続くバイナリ（DUMP の blackBox）の残り
+    bool hasPressSeq = false;    // 押下を受信したか
+    uint16_t lastPressSeq = 0;   // 受信した押下の最大の seq（再送を除くため）
+
+    std::vector<PressMeasurement> presses;
+    size_t firstOpenPress = 0; // これより前の押下は systemReset で締め切ったラウンドのもの
+
+    FILE *capture = nullptr;
+    bool echo = false;
+    int ptyFd = -1;
+    int clientFd = -1;
+
+    double cyclesToUs(uint64_t cycles) const { return static_cast<double>(cycles) * 1e6 / avr->frequency; }
+
+    void forward(int fd, uint8_t byte)
+    {
+        if (fd >= 0)
+        {
+            (void)::write(fd, &byte, 1);
+        }
+    }
+
+    void onUartOutput(uint8_t byte)
+    {
+        uint64_t cycle = avr->cycle;
+
+        forward(ptyFd, byte);
+        forward(clientFd, byte);
+
+        // 改行とバイナリは行の先頭にしない（0x00 はその直後にフレームが始まった場合だけ先頭にする）
+        if (rawRemaining > 0)
+        {
+            rawRemaining--;
+        }
+        else if (!lineStarted && byte == 0x00)
+        {
+            delimiterCycle = cycle;
+        }
+        else if (!lineStarted && byte != '\n' && byte != '\r')
+        {
+            lineStarted = true;
+            lineStartCycle = delimiterCycle != 0 ? delimiterCycle : cycle;
+        }
+        if (byte != 0x00)
+        {
+            delimiterCycle = 0;
+        }
+
+        *framer.writePtr() = static_cast<char>(byte);
+        framer.commit(1);
+        std::string_view line;
+        while (framer.next(line))
+        {
+            lineStarted = false;
+            onLine(line);
+        }
+    }
+
+    /**
+     * @brief 行・フレームを1つ受信した（lineStartCycle はその先頭バイトのサイクル）
+     */
+    void onLine(std::string_view line)
+    {
+        if (capture != nullptr)
+        {
+            std::fprintf(capture, "%llu %.1f %.*s\n", static_cast<unsigned long long>(lineStartCycle),
+                         cyclesToUs(lineStartCycle), static_cast<int>(line.size()), line.data());
+        }
+        if (echo)
+        {
+            std::fprintf(stderr, "[%12.1fus] %.*s\n", cyclesToUs(lineStartCycle), static_cast<int>(line.size()),
+                         line.data());
+        }
+
+        ControllerEvent event;
+        decoder.decode(line, event);
+        framer.skipRaw(event.rawBytes);
+        rawRemaining = event.rawBytes;
+
+        if (event.kind == EventKind::SystemReady)
+        {
+            hasPressSeq = false; // 再起動で seq は 0 からやり直す
+        }
+        else if (event.kind == EventKind::SystemReset)
+        {
+            // 前のラウンドで受け付けられなかった押下を、次のラウンドの送信に対応づけない
+            while (firstOpenPress < presses.size() && presses[firstOpenPress].pressCycle < lineStartCycle)
+            {
+                firstOpenPress++;
+            }
+        }
+        else if (event.kind == EventKind::ButtonPress)
+        {
+            for (uint8_t i = 0; i < event.pressCount; i++)
+            {
+                if (event.hasSeq)
+                {
+                    // まとめ送信の各押下は先頭の seq からの連番
+                    uint16_t seq = static_cast<uint16_t>(event.seq + i);
+                    if (hasPressSeq && static_cast<int16_t>(seq - lastPressSeq) <= 0)
+                    {
+                        continue; // 再送
+                    }
+                    hasPressSeq = true;
+                    lastPressSeq = seq;
+                }
+                matchPress(event.presses[i].buttonId);
+            }
+        }
+    }
+
+    /**
+     * @brief 送信された押下を、同じボタンの最初の未送信の押下に対応づける
+     *
+     * チャタリング・同じラウンドでの2回目・ロックアウト中の押下はコントローラーが送らないため、送信なしのまま残る
+     * （再送は呼び出し側で seq を見て除く）
+     */
+    void matchPress(int buttonId)
+    {
+        for (size_t i = firstOpenPress; i < presses.size() && presses[i].pressCycle < lineStartCycle; i++)
+        {
+            PressMeasurement &press = presses[i];
+            if (press.buttonId == buttonId && press.firstTxCycle == 0)
+            {
+                press.firstTxCycle = lineStartCycle;
+                return;
+            }
+        }
+    }
+
+    void feedUart()
+    {
+        while (uartXon && !pendingInput.empty())
+        {
+            uint8_t byte = pendingInput.front();
+            pendingInput.pop_front();
+            avr_raise_irq(uartInput, byte);
+        }
+    }
+};
+
+void uartOutputHook(struct avr_irq_t *, uint32_t value, void *param)
+{
+    static_cast<Simulation *>(param)->onUartOutput(static_cast<uint8_t>(value));
+}
+
+void uartXonHook(struct avr_irq_t *, uint32_t, void *param)
+{
+    Simulation *sim = static_cast<Simulation *>(param);
+    sim->uartXon = true;
+    sim->feedUart();
+}
+
+void uartXoffHook(struct avr_irq_t *, uint32_t, void *param)
+{
+    static_cast<Simulation *>(param)->uartXon = false;
+}
+
+/**
+ * @brief 外部（pty / TCP）から届いたデータを UART 入力に積む
+ */
+void pollExternalInput(int fd, Simulation &sim)
+{
+    if (fd < 0)
+    {
+        return;
+    }
+    uint8_t buf[256];
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    for (ssize_t i = 0; i < n; i++)
+    {
+        sim.pendingInput.push_back(buf[i]);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    elf_firmware_t firmware;
+    std::memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(options.firmware.c_str(), &firmware) != 0)
+    {
+        std::fprintf(stderr, "%s を読み込めません\n", options.firmware.c_str());
+        return 1;
+    }
+    // PlatformIO の ELF には MCU 情報のセクションがないため、指定値を使う
+    if (firmware.mmcu[0] == '\0')
+    {
+        std::snprintf(firmware.mmcu, sizeof(firmware.mmcu), "%s", options.mcu.c_str());
+    }
+    if (firmware.frequency == 0)
+    {
+        firmware.frequency = options.frequency;
+    }
+
+    std::vector<Stimulus> stimuli;
+    if (!options.stimulus.empty() && !loadStimulus(options.stimulus, firmware.frequency, stimuli))
+    {
+        return 1;
+    }
+
+    Simulation sim;
+    sim.avr = avr_make_mcu_by_name(firmware.mmcu);
+    if (sim.avr == nullptr)
+    {
+        std::fprintf(stderr, "MCU %s に対応していません\n", firmware.mmcu);
+        return 1;
+    }
+    avr_init(sim.avr);
+    avr_load_firmware(sim.avr, &firmware);
+    sim.avr->frequency = firmware.frequency;
+
+    // UART0 を標準出力ではなくフックに流す
+    uint32_t uartFlags = 0;
+    avr_ioctl(sim.avr, AVR_IOCTL_UART_GET_FLAGS('0'), &uartFlags);
+    uartFlags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(sim.avr, AVR_IOCTL_UART_SET_FLAGS('0'), &uartFlags);
+    avr_irq_register_notify(avr_io_getirq(sim.avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uartOutputHook,
+                            &sim);
+    avr_irq_register_notify(avr_io_getirq(sim.avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XON), uartXonHook, &sim);
+    avr_irq_register_notify(avr_io_getirq(sim.avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XOFF), uartXoffHook,
+                            &sim);
+    sim.uartInput = avr_io_getirq(sim.avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+    // simavr はプルアップを再現しないため、未押下（HIGH）を外部から与えておく
+    avr_irq_t *buttonPins[6];
+    for (int i = 0; i < 6; i++)
+    {
+        buttonPins[i] = avr_io_getirq(sim.avr, AVR_IOCTL_IOPORT_GETIRQ('C'), i);
+        avr_raise_irq(buttonPins[i], 1);
+    }
+
+    if (!options.capture.empty())
+    {
+        sim.capture = std::fopen(options.capture.c_str(), "w");
+        if (sim.capture == nullptr)
+        {
+            std::fprintf(stderr, "%s を開けません: %s\n", options.capture.c_str(), std::strerror(errno));
+            return 1;
+        }
+        std::fprintf(sim.capture, "# cycle us line (%u Hz)\n", firmware.frequency);
+    }
+    sim.echo = options.echo;
+
+    int slaveFd = -1;
+    if (options.pty)
+    {
+        char slaveName[256];
+        if (openpty(&sim.ptyFd, &slaveFd, slaveName, nullptr, nullptr) < 0)
+        {
+            std::fprintf(stderr, "pty を作成できません: %s\n", std::strerror(errno));
+            return 1;
+        }
+        termios tio;
+        tcgetattr(slaveFd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slaveFd, TCSANOW, &tio);
+        fcntl(sim.ptyFd, F_SETFL, fcntl(sim.ptyFd, F_GETFL) | O_NONBLOCK);
+        std::printf("%s\n", slaveName);
+        std::fflush(stdout);
+        if (!options.link.empty())
+        {
+            ::unlink(options.link.c_str());
+            if (::symlink(slaveName, options.link.c_str()) < 0)
+            {
+                std::fprintf(stderr, "%s を作成できません: %s\n", options.link.c_str(), std::strerror(errno));
+            }
+        }
+    }
+
+    int listenFd = -1;
+    if (options.listenPort >= 0)
+    {
+        listenFd = openListener(options.listenPort);
+        if (listenFd < 0)
+        {
+            std::fprintf(stderr, "ポート %d で待ち受けできません: %s\n", options.listenPort, std::strerror(errno));
+            return 1;
+        }
+        std::fprintf(stderr, "localhost:%d で待ち受けています\n", options.listenPort);
+    }
+
+    // 外部から接続できる場合は停止するまで実時間で動かし続ける
+    bool interactive = options.pty || listenFd >= 0;
+    bool realtime = options.realtime || interactive;
+    uint64_t endCycle = UINT64_MAX;
+    if (!interactive)
+    {
+        uint64_t lastCycle = stimuli.empty() ? 0 : stimuli.back().cycle;
+        endCycle = lastCycle + static_cast<uint64_t>(options.tailMs * firmware.frequency / 1000.0);
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    // 外部入出力の確認と実時間との同期は 1ms ごとに行う
+    const uint64_t pollInterval = firmware.frequency / 1000;
+    uint64_t nextPollCycle = 0;
+    uint64_t wallStart = wallNs();
+    size_t nextStimulus = 0;
+    int state = cpu_Running;
+
+    while (!stopRequested && state != cpu_Done && state != cpu_Crashed && sim.avr->cycle < endCycle)
+    {
+        while (nextStimulus < stimuli.size() && stimuli[nextStimulus].cycle <= sim.avr->cycle)
+        {
+            const Stimulus &stimulus = stimuli[nextStimulus++];
+            switch (stimulus.action)
+            {
+            case Stimulus::PRESS:
+                avr_raise_irq(buttonPins[stimulus.pin], 0);
+                sim.presses.push_back(PressMeasurement{stimulus.pin, buttonIdOf(options, stimulus.pin), sim.avr->cycle, 0});
+                break;
+            case Stimulus::RELEASE:
+                avr_raise_irq(buttonPins[stimulus.pin], 1);
+                break;
+            case Stimulus::SEND:
+                sim.pendingInput.insert(sim.pendingInput.end(), stimulus.text.begin(), stimulus.text.end());
+                sim.feedUart();
+                break;
+            case Stimulus::END:
+                endCycle = sim.avr->cycle;
+                break;
+            }
+        }
+
+        if (sim.avr->cycle >= nextPollCycle)
+        {
+            nextPollCycle = sim.avr->cycle + pollInterval;
+
+            if (listenFd >= 0)
+            {
+                int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd >= 0)
+                {
+                    if (sim.clientFd >= 0)
+                    {
+                        ::close(sim.clientFd);
+                    }
+                    sim.clientFd = fd;
+                    std::fprintf(stderr, "クライアントが接続しました\n");
+                }
+            }
+            pollExternalInput(sim.ptyFd, sim);
+            pollExternalInput(sim.clientFd, sim);
+            sim.feedUart();
+
+            if (realtime)
+            {
+                uint64_t simNs = static_cast<uint64_t>(sim.cyclesToUs(sim.avr->cycle) * 1000.0);
+                uint64_t elapsedNs = wallNs() - wallStart;
+                if (simNs > elapsedNs)
+                {
+                    timespec ts;
+                    ts.tv_sec = static_cast<time_t>((simNs - elapsedNs) / 1000000000ULL);
+                    ts.tv_nsec = static_cast<long>((simNs - elapsedNs) % 1000000000ULL);
+                    nanosleep(&ts, nullptr);
+                }
+            }
+        }
+
+        state = avr_run(sim.avr);
+    }
+
+    if (state == cpu_Crashed)
+    {
+        std::fprintf(stderr, "ファームウェアがクラッシュしました（サイクル %llu）\n",
+                     static_cast<unsigned long long>(sim.avr->cycle));
+    }
+
+    // 押下から、その押下を含む行・フレームの送信開始までの遅延
+    uint64_t minCycles = UINT64_MAX;
+    uint64_t maxCycles = 0;
+    uint64_t totalCycles = 0;
+    unsigned answered = 0;
+    for (const PressMeasurement &press : sim.presses)
+    {
+        if (press.firstTxCycle == 0)
+        {
+            std::printf("press A%d (ボタン%d) @%.1fus: 送信なし\n", press.pin, press.buttonId,
+                        sim.cyclesToUs(press.pressCycle));
+            continue;
+        }
+        uint64_t cycles = press.firstTxCycle - press.pressCycle;
+        std::printf("press A%d (ボタン%d) @%.1fus: 送信まで %llu サイクル (%.1fus)\n", press.pin, press.buttonId,
+                    sim.cyclesToUs(press.pressCycle), static_cast<unsigned long long>(cycles), sim.cyclesToUs(cycles));
+        minCycles = cycles < minCycles ? cycles : minCycles;
+        maxCycles = cycles > maxCycles ? cycles : maxCycles;
+        totalCycles += cycles;
+        answered++;
+    }
+    if (answered > 0)
+    {
+        std::printf("押下→送信: %u 件, 最小 %.1fus, 平均 %.1fus, 最大 %.1fus\n", answered, sim.cyclesToUs(minCycles),
+                    sim.cyclesToUs(totalCycles / answered), sim.cyclesToUs(maxCycles));
+    }
+    std::printf("実行サイクル: %llu (%.3f 秒)\n", static_cast<unsigned long long>(sim.avr->cycle),
+                sim.cyclesToUs(sim.avr->cycle) / 1e6);
+
+    if (sim.capture != nullptr)
+    {
+        std::fclose(sim.capture);
+    }
+    if (!options.link.empty())
+    {
+        ::unlink(options.link.c_str());
+    }
+    if (slaveFd >= 0)
+    {
+        ::close(slaveFd);
+        ::close(sim.ptyFd);
+    }
+    if (sim.clientFd >= 0)
+    {
+        ::close(sim.clientFd);
+    }
+    if (listenFd >= 0)
+    {
+        ::close(listenFd);
+    }
+    return state == cpu_Crashed ? 2 : 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file arbiter.ts
+ * @brief 早押しの判定（controller/lib/QuizArbiter のネイティブアドオン）を読み込む
+ *
+ * ボタンとタブレットの押下は、ファームウェアと同じ C++ の判定コードで順位を決める
+ * アドオン（native/arbiter）は `npm install`（または `npm run build:native`）でビルドする
+ * 判定の規則を TypeScript で持つと C++ と食い違うため、アドオンを読み込めない場合は起動しない
+ * EXE（npm run package）では server.exe と同じフォルダの quiz_arbiter.node を使う
+ * 同じアドオンが受信データの切り出し（LineFramer、framing.ts）も公開する
+ */
+import { createRequire } from "module";
+import path from "path";
+import type { LineFramer } from "./framing";
+
+// controller/lib/QuizArbiter/src/QuizArbiter.h の ArbiterDecision と同じ値
+export const ArbiterDecision = {
+    Accepted: 0,
+    Duplicate: 1,
+    LockedOut: 2,
+    Closed: 3,
+    Invalid: 4,
+} as const;
+export type ArbiterDecisionValue =
+    (typeof ArbiterDecision)[keyof typeof ArbiterDecision];
+
+// ArbiterTieRule と同じ値
+export const TieRule = {
+    Arrival: 0,
+    Player: 1,
+} as const;
+export type TieRuleValue = (typeof TieRule)[keyof typeof TieRule];
+
+// 次の問題まで押せなくする penalty（ARBITER_LOCKOUT_QUESTION）
+export const LOCKOUT_QUESTION = 0xffffffff;
+
+export interface ArbitrationRules {
+    tieWindowUs: number; // この時間差以内の押下は同着（0: 同じ時刻のみ）
+    tieRule: TieRuleValue; // 同着の並べ方
+    penaltyUs: number; // 不正解の後に押せない時間（0: すぐ押せる、LOCKOUT_QUESTION: 次の問題まで）
+}
+
+export interface Arbiter {
+    setRules(tieWindow: number, tieRule: number, penalty: number): void;
+    open(): void;
+    close(): void;
+    isOpen(): boolean;
+    press(player: number, time: number): ArbiterDecisionValue;
+    judgeIncorrect(now: number): number;
+    isLockedOut(player: number, now: number): boolean;
+    order(): number[];
+}
+
+// アドオンのファイル名（binding.gyp の target_name）
+const ADDON_FILE = "quiz_arbiter.node";
+
+// pkg で EXE にした場合に設定される
+const packaged = (process as { pkg?: unknown }).pkg !== undefined;
+
+/**
+ * アドオンのパス
+ *
+ * EXE では server.exe と同じフォルダ（npm run package がコピーする）、それ以外はビルドした場所
+ */
+function addonPath(): string {
+    if (packaged) {
+        return path.join(path.dirname(process.execPath), ADDON_FILE);
+    }
+    return path.join(process.cwd(), "native", "arbiter", "build", "Release", ADDON_FILE);
+}
+
+// アドオンが公開するクラス（LineFramer は framing.ts で使う）
+export interface NativeAddon {
+    QuizArbiter: new (playerCount: number) => Arbiter;
+    LineFramer: new () => LineFramer;
+}
+
+let loadedAddon: NativeAddon | null = null;
+
+/**
+ * アドオンを読み込む（2回目以降は読み込んだものを返す）
+ * @throws アドオンを読み込めない場合
+ */
+export function loadAddon(): NativeAddon {
+    if (loadedAddon) {
+        return loadedAddon;
+    }
+    try {
+        const load = createRequire(path.join(process.cwd(), "package.json"));
+        loadedAddon = load(addonPath()) as NativeAddon;
+        return loadedAddon;
+    } catch (error) {
+        const hint = packaged
+            ? "server.exe と同じフォルダに置いてください"
+            : "npm install か npm run build:native でビルドしてください";
+        throw new Error(
+            `判定のアドオン ${addonPath()} を読み込めません（${hint}）: ${
+                error instanceof Error ? error.message : error
+            }`
+        );
+    }
+}
+
+/**
+ * 判定を作る
+ * @param playerCount プレーヤー数（1-8）
+ * @throws アドオンを読み込めない場合
+ */
+export function createArbiter(playerCount: number): Arbiter {
+    return new (loadAddon().QuizArbiter)(playerCount);
+}
+
+/**
+ * 判定に使う現在時刻（CLOCK_MONOTONIC のマイクロ秒、32bit で一周する）
+ */
+export function arbiterNow(): number {
+    return Number((process.hrtime.bigint() / 1000n) & 0xffffffffn);
+}
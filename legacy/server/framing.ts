@@ -0,0 +1,36 @@
+/**
+ * @file framing.ts
+ * @brief シリアルから直接受信したデータを行（JSON）に切り出す（アドオンの LineFramer）
+ *
+ * コントローラーは改行区切りの JSON 行か、COBS + CRC-16 のフレーム（ENABLE_COBS_FRAMING）で送ってくる
+ * 切り出し・復号・送り方の判別は quiz-ingest と同じ C++ のコード（host/src/LineFramer.cpp と
+ * controller/lib/QuizFraming）で行い、quiz-framefuzz で検査している
+ */
+import { loadAddon } from "./arbiter";
+
+export interface LineFramer {
+    /**
+     * 受信したデータを追加し、取り出せた行（フレームの場合は本文）を返す
+     */
+    push(data: Buffer): string[];
+    /**
+     * 未完成の行を捨て、行モードに戻す（再接続時）
+     */
+    clear(): void;
+    /**
+     * COBS フレームを受信しているか
+     */
+    isFramed(): boolean;
+    /**
+     * 壊れていて捨てたフレームの数
+     */
+    badFrameCount(): number;
+}
+
+/**
+ * 行の切り出しを作る
+ * @throws アドオンを読み込めない場合
+ */
+export function createLineFramer(): LineFramer {
+    return new (loadAddon().LineFramer)();
+}
@@ -0,0 +1,160 @@
+/**
+ * @file LineFramerAddon.cpp
+ * @brief LineFramer（host/src、QuizFraming の COBS + CRC-16 を使う）をサーバーから使うための Node-API のクラス
+ *
+ * シリアルから直接受信するときの行・フレームの切り出しを、quiz-ingest・quiz-framefuzz と同じ C++ のコードで行う
+ * （フレームモードへの切り替え・行モードへの戻りも含む）
+ *
+ *   const framer = new LineFramer();
+ *   framer.push(data);        // 受信した Buffer。取り出せた行・フレームの本文の配列を返す
+ *   framer.clear();           // 再接続時に未完成の行を捨て、行モードに戻す
+ *   framer.isFramed();        // COBS フレームを受信しているか
+ *   framer.badFrameCount();   // 壊れていて捨てたフレームの数
+ */
+
+#include "LineFramerAddon.h"
+
+#include <LineFramer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Node-API の呼び出しが失敗したら（例外は設定済み）undefined を返す
+#define CHECK(call)            \
+    do                         \
+    {                          \
+        if ((call) != napi_ok) \
+        {                      \
+            return nullptr;    \
+        }                      \
+    } while (0)
+
+namespace
+{
+LineFramer *unwrap(napi_env env, napi_callback_info info, size_t argc, napi_value *argv)
+{
+    size_t count = argc;
+    napi_value self;
+    void *framer = nullptr;
+    if (napi_get_cb_info(env, info, &count, argv, &self, nullptr) != napi_ok ||
+        napi_unwrap(env, self, &framer) != napi_ok)
+    {
+        return nullptr;
+    }
+    if (count < argc)
+    {
+        napi_throw_type_error(env, nullptr, "引数が足りません");
+        return nullptr;
+    }
+    return static_cast<LineFramer *>(framer);
+}
+
+void finalize(napi_env env, void *data, void *hint)
+{
+    delete static_cast<LineFramer *>(data);
+}
+
+napi_value construct(napi_env env, napi_callback_info info)
+{
+    napi_value self;
+    CHECK(napi_get_cb_info(env, info, nullptr, nullptr, &self, nullptr));
+    LineFramer *framer = new LineFramer();
+    if (napi_wrap(env, self, framer, finalize, nullptr, nullptr) != napi_ok)
+    {
+        delete framer;
+        return nullptr;
+    }
+    return self;
+}
+
+napi_value push(napi_env env, napi_callback_info info)
+{
+    napi_value argv[1];
+    LineFramer *framer = unwrap(env, info, 1, argv);
+    if (framer == nullptr)
+    {
+        return nullptr;
+    }
+    void *data = nullptr;
+    size_t length = 0;
+    if (napi_get_buffer_info(env, argv[0], &data, &length) != napi_ok)
+    {
+        napi_throw_type_error(env, nullptr, "Buffer を指定してください");
+        return nullptr;
+    }
+
+    // 行は次の writePtr() で無効になるため、書き込むたびに文字列にする
+    napi_value result;
+    CHECK(napi_create_array(env, &result));
+    uint32_t count = 0;
+    const char *src = static_cast<const char *>(data);
+    size_t offset = 0;
+    while (offset < length)
+    {
+        char *dst = framer->writePtr();
+        size_t chunk = std::min(framer->writable(), length - offset);
+        std::memcpy(dst, src + offset, chunk);
+        framer->commit(chunk);
+        offset += chunk;
+
+        std::string_view line;
+        while (framer->next(line))
+        {
+            napi_value text;
+            CHECK(napi_create_string_utf8(env, line.data(), line.size(), &text));
+            CHECK(napi_set_element(env, result, count++, text));
+        }
+    }
+    return result;
+}
+
+napi_value clear(napi_env env, napi_callback_info info)
+{
+    LineFramer *framer = unwrap(env, info, 0, nullptr);
+    if (framer != nullptr)
+    {
+        framer->clear();
+    }
+    return nullptr;
+}
+
+napi_value isFramed(napi_env env, napi_callback_info info)
+{
+    LineFramer *framer = unwrap(env, info, 0, nullptr);
+    if (framer == nullptr)
+    {
+        return nullptr;
+    }
+    napi_value result;
+    CHECK(napi_get_boolean(env, framer->isFramed(), &result));
+    return result;
+}
+
+napi_value badFrameCount(napi_env env, napi_callback_info info)
+{
+    LineFramer *framer = unwrap(env, info, 0, nullptr);
+    if (framer == nullptr)
+    {
+        return nullptr;
+    }
+    napi_value result;
+    CHECK(napi_create_double(env, static_cast<double>(framer->getBadFrameCount()), &result));
+    return result;
+}
+} // namespace
+
+napi_value defineLineFramer(napi_env env, napi_value exports)
+{
+    const napi_property_descriptor methods[] = {
+        {"push", nullptr, push, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"clear", nullptr, clear, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"isFramed", nullptr, isFramed, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"badFrameCount", nullptr, badFrameCount, nullptr, nullptr, nullptr, napi_default, nullptr},
+    };
+    napi_value constructor;
+    CHECK(napi_define_class(env, "LineFramer", NAPI_AUTO_LENGTH, construct, nullptr,
+                            sizeof(methods) / sizeof(methods[0]), methods, &constructor));
+    CHECK(napi_set_named_property(env, exports, "LineFramer", constructor));
+    return exports;
+}
@@ -0,0 +1,19 @@
+/**
+ * @file LineFramerAddon.h
+ * @brief LineFramer の Node-API のクラスを登録する（QuizArbiterAddon.cpp のモジュール初期化から呼ぶ）
+ */
+
+#ifndef LINE_FRAMER_ADDON_H
+#define LINE_FRAMER_ADDON_H
+
+#include <node_api.h>
+
+/**
+ * @brief exports に LineFramer クラスを追加する
+ * @param env 環境
+ * @param exports モジュールの exports
+ * @return exports（失敗した場合は nullptr）
+ */
+napi_value defineLineFramer(napi_env env, napi_value exports);
+
+#endif // LINE_FRAMER_ADDON_H
@@ -0,0 +1,227 @@
+/**
+ * @file QuizArbiterAddon.cpp
+ * @brief QuizArbiter（controller/lib/QuizArbiter）をサーバーから使うための Node-API アドオン
+ *
+ * ファームウェアと同じ判定のコードを、そのまま JavaScript のクラスとして公開する
+ * 引数の検証は呼び出し側（arbiter.ts）で済ませている前提で、数値は 32bit に切り詰めて渡す
+ *
+ *   const arbiter = new QuizArbiter(6);
+ *   arbiter.setRules(tieWindow, tieRule, penalty);
+ *   arbiter.open();
+ *   arbiter.press(player, time);   // ArbiterDecision の値
+ *   arbiter.judgeIncorrect(now);   // 外したプレーヤー番号（0: なし）
+ *   arbiter.order();               // プレーヤー番号の配列（押下順）
+ *
+ * 同じモジュールで、受信データの行・フレームの切り出し（LineFramer、LineFramerAddon.cpp）も公開する
+ */
+
+#include "LineFramerAddon.h"
+
+#include <QuizArbiter.h>
+#include <node_api.h>
+
+#include <cstddef>
+
+// Node-API の呼び出しが失敗したら（例外は設定済み）undefined を返す
+#define CHECK(call)            \
+    do                         \
+    {                          \
+        if ((call) != napi_ok) \
+        {                      \
+            return nullptr;    \
+        }                      \
+    } while (0)
+
+namespace
+{
+/**
+ * @brief メソッド呼び出しの this と数値の引数を取り出す
+ */
+struct CallInfo
+{
+    QuizArbiter *arbiter = nullptr;
+    uint32_t args[3] = {0, 0, 0};
+};
+
+bool unwrap(napi_env env, napi_callback_info info, size_t expected, CallInfo &call)
+{
+    size_t argc = 3;
+    napi_value argv[3];
+    napi_value self;
+    if (napi_get_cb_info(env, info, &argc, argv, &self, nullptr) != napi_ok || argc < expected)
+    {
+        napi_throw_type_error(env, nullptr, "引数が足りません");
+        return false;
+    }
+    for (size_t i = 0; i < expected; i++)
+    {
+        if (napi_get_value_uint32(env, argv[i], &call.args[i]) != napi_ok)
+        {
+            napi_throw_type_error(env, nullptr, "引数は数値で指定してください");
+            return false;
+        }
+    }
+    return napi_unwrap(env, self, reinterpret_cast<void **>(&call.arbiter)) == napi_ok;
+}
+
+napi_value toNumber(napi_env env, uint32_t value)
+{
+    napi_value result;
+    CHECK(napi_create_uint32(env, value, &result));
+    return result;
+}
+
+napi_value toBoolean(napi_env env, bool value)
+{
+    napi_value result;
+    CHECK(napi_get_boolean(env, value, &result));
+    return result;
+}
+
+void finalize(napi_env env, void *data, void *hint)
+{
+    delete static_cast<QuizArbiter *>(data);
+}
+
+napi_value construct(napi_env env, napi_callback_info info)
+{
+    size_t argc = 1;
+    napi_value argv[1];
+    napi_value self;
+    CHECK(napi_get_cb_info(env, info, &argc, argv, &self, nullptr));
+    uint32_t players = ARBITER_MAX_PLAYERS;
+    if (argc >= 1)
+    {
+        CHECK(napi_get_value_uint32(env, argv[0], &players));
+    }
+    if (players < 1 || players > ARBITER_MAX_PLAYERS)
+    {
+        napi_throw_range_error(env, nullptr, "プレーヤー数が範囲外です");
+        return nullptr;
+    }
+
+    QuizArbiter *arbiter = new QuizArbiter(static_cast<uint8_t>(players));
+    if (napi_wrap(env, self, arbiter, finalize, nullptr, nullptr) != napi_ok)
+    {
+        delete arbiter;
+        return nullptr;
+    }
+    return self;
+}
+
+napi_value setRules(napi_env env, napi_callback_info info)
+{
+    CallInfo call;
+    if (!unwrap(env, info, 3, call))
+    {
+        return nullptr;
+    }
+    ArbiterRules rules;
+    rules.tieWindow = call.args[0];
+    rules.tieRule = call.args[1] == TIE_BY_PLAYER ? TIE_BY_PLAYER : TIE_BY_ARRIVAL;
+    rules.penalty = call.args[2];
+    call.arbiter->setRules(rules);
+    return nullptr;
+}
+
+napi_value openQuestion(napi_env env, napi_callback_info info)
+{
+    CallInfo call;
+    if (!unwrap(env, info, 0, call))
+    {
+        return nullptr;
+    }
+    call.arbiter->open();
+    return nullptr;
+}
+
+napi_value closeQuestion(napi_env env, napi_callback_info info)
+{
+    CallInfo call;
+    if (!unwrap(env, info, 0, call))
+    {
+        return nullptr;
+    }
+    call.arbiter->close();
+    return nullptr;
+}
+
+napi_value isOpen(napi_env env, napi_callback_info info)
+{
+    CallInfo call;
+    if (!unwrap(env, info, 0, call))
+    {
+        return nullptr;
+    }
+    return toBoolean(env, call.arbiter->isOpen());
+}
+
+napi_value press(napi_env env, napi_callback_info info)
+{
+    CallInfo call;
+    if (!unwrap(env, info, 2, call))
+    {
+        return nullptr;
+    }
+    uint8_t player = call.args[0] <= 0xFF ? static_cast<uint8_t>(call.args[0]) : 0;
+    return toNumber(env, call.arbiter->press(player, call.args[1]));
+}
+
+napi_value judgeIncorrect(napi_env env, napi_callback_info info)
+{
+    CallInfo call;
+    if (!unwrap(env, info, 1, call))
+    {
+        return nullptr;
+    }
+    return toNumber(env, call.arbiter->judgeIncorrect(call.args[0]));
+}
+
+napi_value isLockedOut(napi_env env, napi_callback_info info)
+{
+    CallInfo call;
+    if (!unwrap(env, info, 2, call))
+    {
+        return nullptr;
+    }
+    uint8_t player = call.args[0] <= 0xFF ? static_cast<uint8_t>(call.args[0]) : 0;
+    return toBoolean(env, call.arbiter->isLockedOut(player, call.args[1]));
+}
+
+napi_value order(napi_env env, napi_callback_info info)
+{
+    CallInfo call;
+    if (!unwrap(env, info, 0, call))
+    {
+        return nullptr;
+    }
+    napi_value result;
+    CHECK(napi_create_array_with_length(env, call.arbiter->getCount(), &result));
+    for (uint8_t i = 0; i < call.arbiter->getCount(); i++)
+    {
+        CHECK(napi_set_element(env, result, i, toNumber(env, call.arbiter->getPlayer(i))));
+    }
+    return result;
+}
+
+napi_value init(napi_env env, napi_value exports)
+{
+    const napi_property_descriptor methods[] = {
+        {"setRules", nullptr, setRules, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"open", nullptr, openQuestion, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"close", nullptr, closeQuestion, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"isOpen", nullptr, isOpen, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"press", nullptr, press, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"judgeIncorrect", nullptr, judgeIncorrect, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"isLockedOut", nullptr, isLockedOut, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"order", nullptr, order, nullptr, nullptr, nullptr, napi_default, nullptr},
+    };
+    napi_value constructor;
+    CHECK(napi_define_class(env, "QuizArbiter", NAPI_AUTO_LENGTH, construct, nullptr,
+                            sizeof(methods) / sizeof(methods[0]), methods, &constructor));
+    CHECK(napi_set_named_property(env, exports, "QuizArbiter", constructor));
+    return defineLineFramer(env, exports);
+}
+} // namespace
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
@@ -0,0 +1,23 @@
+{
+    "targets": [
+        {
+            "target_name": "quiz_arbiter",
+            "sources": [
+                "QuizArbiterAddon.cpp",
+                "LineFramerAddon.cpp",
+                "../../../controller/lib/QuizArbiter/src/QuizArbiter.cpp",
+                "../../../controller/lib/QuizFraming/src/QuizFraming.cpp",
+                "../../../host/src/LineFramer.cpp"
+            ],
+            "include_dirs": [
+                "../../../controller/lib/QuizArbiter/src",
+                "../../../controller/lib/QuizFraming/src",
+                "../../../host/include"
+            ],
+            "cflags_cc": ["-std=c++17"],
+            "msvs_settings": {
+                "VCCLCompilerTool": { "AdditionalOptions": ["/std:c++17"] }
+            }
+        }
+    ]
+}
@@ -19,6 +19,14 @@ import cors from "cors";
 import { SerialPort } from "serialport";
 import net from "net";
 import dotenv from "dotenv";
+import {
+    ArbiterDecision,
+    TieRule,
+    arbiterNow,
+    createArbiter,
+    type ArbitrationRules,
+} from "./arbiter";
+import { createLineFramer } from "./framing";
 import type {
     Player,
     QuestionData,
@@ -35,6 +43,7 @@ function parseArgs() {
         comPort?: string;
         simulator?: boolean;
         serverOnly?: boolean;
+        ingest?: string;
     } = {};
 
     for (let i = 0; i < args.length; i++) {
@@ -57,6 +66,12 @@ function parseArgs() {
             }
         } else if (arg === "--simulator" || arg === "-s") {
             options.simulator = true;
+        } else if (arg === "--ingest" || arg === "-i") {
+            const nextArg = args[i + 1];
+            if (nextArg) {
+                options.ingest = nextArg;
+                i++;
+            }
         } else if (arg === "--server-only" || arg === "-so") {
             options.serverOnly = true;
         } else if (arg === "--help" || arg === "-h") {
@@ -67,6 +82,7 @@ function parseArgs() {
   -p, --port <番号>       サーバーポート番号 (デフォルト: 3001)
   -c, --com <ポート>      COMポート名 (例: COM3)
   -s, --simulator         Arduinoシミュレーターを使用
+  -i, --ingest <パス>     quiz-ingest のソケット経由で接続 (例: /tmp/quiz-ingest.sock)
   -so, --server-only      Arduinoなしでサーバーのみ起動（タブレット専用）
   -h, --help              このヘルプを表示
 
@@ -75,6 +91,7 @@ function parseArgs() {
   server --com COM5
   server --port 3002 --com COM5
   server --simulator
+  server --ingest /tmp/quiz-ingest.sock
   server --server-only
             `);
             process.exit(0);
@@ -90,12 +107,15 @@ const COM_PORT = cmdOptions.comPort || process.env.COM_PORT;
 const USE_SIMULATOR =
     cmdOptions.simulator || process.env.USE_SIMULATOR === "true";
 const SERVER_ONLY = cmdOptions.serverOnly || process.env.SERVER_ONLY === "true";
+const INGEST_SOCKET = cmdOptions.ingest || process.env.INGEST_SOCKET;
 
 console.log(`設定:
   - サーバーポート: ${PORT}
   - モード: ${
       SERVER_ONLY
           ? "サーバーのみ（タブレット専用）"
+          : INGEST_SOCKET
+          ? `quiz-ingest経由 (${INGEST_SOCKET})`
           : USE_SIMULATOR
           ? "シミュレーター"
           : "Arduino接続"
@@ -114,7 +134,10 @@ async function initializeArduino() {
         return; // Arduinoの初期化をスキップ
     }
 
-    if (USE_SIMULATOR) {
+    if (INGEST_SOCKET) {
+        controller = net.connect(INGEST_SOCKET);
+        console.log(`Using quiz-ingest at ${INGEST_SOCKET}`);
+    } else if (USE_SIMULATOR) {
         controller = net.connect(4000, "localhost");
         console.log("Using Arduino simulator at localhost:4000");
     } else {
@@ -184,11 +207,77 @@ type UISettings = {
 
 type ArduinoData = {
     type: string;
-    buttonId?: number;
+    buttonId?: number; // pressedButton / falseStart / answerTimeout / gesture: ボタンID
     message?: string;
     timestamp: number;
+    seq?: number; // イベントのシーケンス番号（16bit、ラップアラウンドあり）
+    from?: number; // resync: 再送の起点となるシーケンス番号
+    presses?: [number, number][]; // pressedButtons: [ボタンID, 先頭からの経過ミリ秒]
+    reason?: string; // recovered: リセット要因（watchdog / brownout）
+    downtime?: number; // recovered: 推定停止時間（ミリ秒）
+    version?: number; // state / stateDelta / heartbeat: 状態の版
+    active?: boolean; // state / stateDelta: システムアクティブ状態
+    round?: number; // 押下・systemReset・armed・falseStart・answerTimeout・gesture・state / stateDelta: ラウンド番号
+    pressed?: number[]; // state / stateDelta: 押下順のボタンID
+    previousRound?: number; // state / stateDelta: 直前のラウンド番号
+    previousPressed?: number[]; // state / stateDelta: 直前のラウンドの押下順
+    missedDeadlines?: number; // state / heartbeat: サンプリングの周期遅れ回数
+    sampleOverflows?: number; // state / heartbeat: サンプルFIFOの溢れ回数
+    pending?: number; // state / heartbeat: 未ACKイベント数
+    retransmits?: number; // state / heartbeat: 再送回数
+    dropped?: number; // state / heartbeat: ウィンドウ溢れで破棄したイベント数
+    button?: number; // calibration: 校正を終えたボタンID（問い合わせへの応答にはない）
+    latency?: (number | null)[]; // calibration: ボタンごとの検出遅延（マイクロ秒、未校正は null）
+    offset?: number[]; // calibration: 押下順の判定に使う補正量（マイクロ秒）
+    players?: number[][]; // analytics: ボタンごとの [件数, 平均, 標準偏差, p50, p90, p99]（ミリ秒）
+    window?: number[]; // debounce: ボタンごとのデバウンス時間（マイクロ秒）
+    observed?: number[]; // debounce: 学習に使った押下・解放の回数
+    edges?: number[]; // debounce: 1回の押下・解放でのバウンスの変化回数（移動平均）
+    span?: number[]; // debounce: バウンス全体の長さ（マイクロ秒、移動平均）
+    maxSpan?: number[]; // debounce: バウンス全体の長さの最大（マイクロ秒）
+    gap?: number[]; // debounce: バウンスの変化の間隔の最大の推定値（マイクロ秒）
+    chatter?: number[]; // debounce: チャタリングの疑いでデバウンス時間を延ばした回数
+    gesture?: "tap" | "long"; // gesture: 最後の押下が長押しなら long
+    taps?: number; // gesture: 押下回数（1: 単押し、2: ダブル…）
+    hold?: number; // gesture: 最後の押下の長さ（ミリ秒、timestamp は最後に離した時刻）
+    total?: number; // gesture: 最初の押下から最後の解放まで（ミリ秒）
 };
 
+// コントローラーの健全性カウンタ（heartbeat で届く値）
+const CONTROLLER_HEALTH_KEYS = [
+    "missedDeadlines",
+    "sampleOverflows",
+    "retransmits",
+    "dropped",
+] as const;
+
+// SUBSCRIBE で受け取るコントローラーの状態
+type ControllerState = {
+    version: number | null; // null: 未購読（次の state を待つ）
+    active: boolean;
+    round: number;
+    pressed: number[];
+    previousRound: number; // 直前のラウンド（次のラウンドの開始後も結果を照合できる）
+    previousPressed: number[];
+    health: Partial<Record<(typeof CONTROLLER_HEALTH_KEYS)[number], number>>;
+    updatedAt: number; // 最後に state / stateDelta / heartbeat を受信した時刻（Date.now()）
+};
+
+// 問題とコントローラーのラウンドの対応（押下の round で、どの問題の押下かを判定する）
+type QuestionRound = {
+    round: number | null; // 現在の問題のラウンド番号（null: RESET の応答待ち・未知）
+    resetsPending: number; // 応答（systemReset）を待っている RESET の数
+    openedAt: number; // 問題を開始した時刻（Date.now()）
+    clockOffset: number | null; // Date.now() - コントローラーの timestamp の推定値（転送遅延の小さい側に寄せる）
+};
+
+// ハートビートが届かない場合に購読し直すまでの時間（ファームウェアの送信間隔 5 秒の3倍）
+const CONTROLLER_STATE_TIMEOUT = 15000;
+
+// RESYNC の応答（resync）が届かないまま欠落が続く場合に送り直すまでの時間
+// （ファームウェアの再送間隔 RETRANSMIT_TIMEOUT 500ms の2倍。応答には seq がなく再送されない）
+const RESYNC_RETRY_INTERVAL = 1000;
+
 // 初期状態(5人プレーヤー対応)
 const quizState: QuizState = {
     questionData: null,
@@ -217,6 +306,21 @@ const uiSettings: UISettings = {
     showAnswer: false,
 };
 
+// 早押しの判定（ファームウェアと共有する controller/lib/QuizArbiter）
+// 時刻は押した時刻を判定の時計（arbiterNow()）に写したもの（pressTimeFromController / pressTimeFromTablet）
+const arbiter = createArbiter(quizState.players.length);
+const arbitrationRules: ArbitrationRules = {
+    tieWindowUs: 0,
+    tieRule: TieRule.Arrival,
+    penaltyUs: 0,
+};
+arbiter.setRules(
+    arbitrationRules.tieWindowUs,
+    arbitrationRules.tieRule,
+    arbitrationRules.penaltyUs
+);
+arbiter.close();
+
 // 状態ブロードキャスト関数
 function broadcastState() {
     const fullState = {
@@ -249,6 +353,9 @@ function correctAnswer() {
         );
     }
 
+    // コントローラーの解答時間の計時を止める
+    sendControllerCommand("ANSWER STOP");
+
     // クイズ終了処理
     endCurrentQuiz();
 
@@ -282,19 +389,15 @@ function incorrectAnswer() {
             )}pt減点)`
         );
 
-        // プレーヤーをオーダーから削除
-        quizState.pressedOrder.shift();
-        player.pressed = false;
-        player.order = null;
+        // コントローラーの解答時間の計時を止める（次の解答者の分は計時しない）
+        sendControllerCommand("ANSWER STOP");
 
-        // 残りのプレーヤーのオーダーを更新
-        quizState.pressedOrder.forEach((playerId, index) => {
-            const idx = playerId - 1;
-            const updatePlayer = quizState.players[idx];
-            if (updatePlayer) {
-                updatePlayer.order = index + 1;
-            }
-        });
+        // プレーヤーをオーダーから削除し、ペナルティを科す
+        arbiter.judgeIncorrect(arbiterNow());
+        syncPressedOrder();
+
+        // コントローラーの順位からも外し、ボタンの押し直しを送信させる（ペナルティはサーバーで判定）
+        sendControllerCommand(`INCORRECT ${firstPlayerId}`);
     }
 
     // 不正解イベントを送信
@@ -305,6 +408,7 @@ function incorrectAnswer() {
 }
 
 function endCurrentQuiz() {
+    arbiter.close();
     quizState.isActive = false;
     quizState.pressedOrder = [];
     quizState.players.forEach((player) => {
@@ -338,6 +442,9 @@ function connection(socket: Socket) {
         quizState.questionData = data;
         quizState.isActive = true;
         quizState.pressedOrder = [];
+        arbiter.open();
+        lastControllerPressTime = null;
+        openQuestionRound();
 
         // 押下状態をリセット（UI設定はリセットしない）
         quizState.players.forEach((player) => {
@@ -378,10 +485,29 @@ function connection(socket: Socket) {
     socket.on("setQuizSetting", (data: Partial<QuizSetting>) => {
         Object.assign(quizSetting, data);
         console.log("クイズ設定が更新されました:", quizSetting);
+        if (data.answerTime !== undefined) {
+            configureAnswerTimer();
+        }
         // 必要に応じて全クライアントに状態をブロードキャスト
         broadcastState();
     });
 
+    // 早押しの判定の規則（同着の時間差・並べ方・不正解のペナルティ）
+    socket.on("setArbitrationRules", (data: Partial<ArbitrationRules>) => {
+        Object.assign(arbitrationRules, data);
+        arbiter.setRules(
+            arbitrationRules.tieWindowUs,
+            arbitrationRules.tieRule,
+            arbitrationRules.penaltyUs
+        );
+        console.log("判定の規則が更新されました:", arbitrationRules);
+        io.emit("arbitrationRules", arbitrationRules);
+    });
+
+    socket.on("getArbitrationRules", () => {
+        socket.emit("arbitrationRules", arbitrationRules);
+    });
+
     // 正解処理
     socket.on("correctAnswer", () => {
         console.log("正解ボタンが押されました");
@@ -419,11 +545,14 @@ function connection(socket: Socket) {
         "pressButton",
         (data: { playerId: number; timestamp: number }) => {
             console.log(`タブレットボタン押下: Player ${data.playerId}`);
-            handleButtonPress({
-                type: "pressedButton",
-                buttonId: data.playerId,
-                timestamp: data.timestamp,
-            });
+            handleButtonPress(
+                {
+                    type: "pressedButton",
+                    buttonId: data.playerId,
+                    timestamp: data.timestamp,
+                },
+                pressTimeFromTablet(socket.id, data.timestamp)
+            );
         }
     );
 
@@ -461,6 +590,39 @@ function connection(socket: Socket) {
         }
     });
 
+    // ボタンの検出遅延の校正（基準エッジのピンをそのボタンにつないでから送る）
+    socket.on("calibrateController", (data: { buttonId: number }) => {
+        console.log(`ボタン ${data.buttonId} の検出遅延を校正`);
+        sendControllerCommand(`CALIBRATE ${data.buttonId}`);
+    });
+
+    // 校正結果の問い合わせ・消去
+    socket.on("getControllerCalibration", () => {
+        sendControllerCommand("CALIBRATION");
+    });
+    socket.on("clearControllerCalibration", () => {
+        console.log("検出遅延の校正結果を消去");
+        sendControllerCommand("CALIBRATE CLEAR");
+    });
+
+    // コントローラーが集計した反応時間の統計の問い合わせ・消去
+    socket.on("getControllerAnalytics", () => {
+        sendControllerCommand("ANALYTICS");
+    });
+    socket.on("resetControllerAnalytics", () => {
+        console.log("反応時間の統計を消去");
+        sendControllerCommand("ANALYTICS RESET");
+    });
+
+    // コントローラーが学習したデバウンス時間の問い合わせ・消去
+    socket.on("getControllerDebounce", () => {
+        sendControllerCommand("DEBOUNCE");
+    });
+    socket.on("resetControllerDebounce", () => {
+        console.log("デバウンス時間の学習結果を消去");
+        sendControllerCommand("DEBOUNCE RESET");
+    });
+
     // 全員のスコアをリセット
     socket.on("resetAllScores", () => {
         console.log("全プレイヤーのスコアをリセット");
@@ -473,60 +635,770 @@ function connection(socket: Socket) {
     // 切断処理
     socket.on("disconnect", (reason) => {
         console.log("クライアント切断:", socket.id, "理由:", reason);
+        tabletClockOffsets.delete(socket.id);
     });
 }
 
 // Arduino通信処理
-function handleButtonPress(data: ArduinoData) {
+function handleButtonPress(data: ArduinoData, pressTime?: number) {
+    if (registerButtonPress(data, pressTime)) {
+        // 更新された状態を全クライアントにブロードキャスト
+        broadcastState();
+    }
+}
+
+/**
+ * 判定の順位を quizState に反映する
+ */
+function syncPressedOrder() {
+    quizState.pressedOrder = arbiter.order();
+    quizState.players.forEach((player) => {
+        const index = quizState.pressedOrder.indexOf(player.id);
+        player.pressed = index >= 0;
+        player.order = index >= 0 ? index + 1 : null;
+    });
+}
+
+// 最後に判定に渡したコントローラーの押下の時刻（判定の時計、null: この問題ではまだない）
+let lastControllerPressTime: number | null = null;
+// タブレット（ソケット）ごとの時計の差（受信時刻 - timestamp の推定値、ミリ秒）
+const tabletClockOffsets = new Map<string, number>();
+
+/**
+ * サーバーの時刻（Date.now() のミリ秒）を判定の時計（arbiterNow() のマイクロ秒）に写す
+ *
+ * 未来の時刻は現在に丸める
+ */
+function toArbiterTime(serverTime: number): number {
+    const ageUs = Math.max(0, Math.round((Date.now() - serverTime) * 1000));
+    return (arbiterNow() - ageUs) >>> 0;
+}
+
+/**
+ * コントローラーの押下の判定に使う時刻
+ *
+ * コントローラーが押下を受け付けた時刻（timestamp、まとめて送られた押下は expandFrame で復元したもの）を
+ * clockOffset でサーバーの時刻に写す。到着した時刻を使うと、まとめて届いた押下やシリアルの遅れの分だけ
+ * タブレットの押下より遅く扱われ、同着の窓の中ではプレーヤー番号で並べ替えられてしまう
+ *
+ * コントローラーは同じ判定で順位を決めてから、受け付けた押下だけを順に送ってくる。
+ * その順を変えないよう、前の押下と同着の窓に入る時刻は窓のすぐ後ろにずらす
+ */
+function pressTimeFromController(data: ArduinoData): number {
+    const serverTime =
+        questionRound.clockOffset === null ? Date.now() : data.timestamp + questionRound.clockOffset;
+    let time = toArbiterTime(serverTime);
+    if (lastControllerPressTime !== null) {
+        const earliest =
+            (lastControllerPressTime + Math.min(arbitrationRules.tieWindowUs, 0x7fffffff) + 1) >>> 0;
+        if (((time - earliest) | 0) < 0) {
+            time = earliest;
+        }
+    }
+    return time;
+}
+
+/**
+ * タブレットの押下の判定に使う時刻
+ *
+ * timestamp はタブレットの時計（Date.now()）のため、ソケットごとに
+ * 受信時刻 - timestamp の最小値（通信の遅れが最も小さかったもの）を時計の差として写す
+ * 最初の押下は差が分からないため受信時刻になり、押すほど通信の遅れを除けるようになる
+ */
+function pressTimeFromTablet(socketId: string, timestamp: number): number {
+    if (typeof timestamp !== "number" || !Number.isFinite(timestamp)) {
+        return arbiterNow();
+    }
+    const sample = Date.now() - timestamp;
+    const previous = tabletClockOffsets.get(socketId);
+    const offset =
+        previous === undefined || sample < previous
+            ? sample
+            : previous + (sample - previous) / 256;
+    tabletClockOffsets.set(socketId, offset);
+    return toArbiterTime(timestamp + offset);
+}
+
+/**
+ * ボタン押下を記録する（状態のブロードキャストは呼び出し側で行う）
+ * @param pressTime 判定に使う時刻（タブレット。省略時はコントローラーの timestamp から求める）
+ * @returns 状態が更新された場合 true
+ */
+function registerButtonPress(data: ArduinoData, pressTime?: number): boolean {
     if (data.type === "pressedButton" && data.buttonId) {
         const buttonId = data.buttonId;
         const playerIndex = buttonId - 1;
 
-        // クイズがアクティブでない場合は無視
-        if (!quizState.isActive) {
+        if (!belongsToQuestion(data)) {
             console.log(
-                `クイズがアクティブではないので Player ${buttonId} の押下を無視`
+                `Player ${buttonId} の押下は前の問題のもの (ラウンド ${data.round}) なので無視`
             );
-            return;
+            return false;
         }
 
-        // プレーヤーIDの範囲チェック
-        if (playerIndex < 0 || playerIndex >= quizState.players.length) {
-            console.warn(`無効なボタンID: ${buttonId} (有効範囲: 1-6)`);
-            return;
+        const fromController = pressTime === undefined;
+        const time = pressTime ?? pressTimeFromController(data);
+        const decision = arbiter.press(buttonId, time);
+        if (decision === ArbiterDecision.Accepted && fromController) {
+            lastControllerPressTime = time;
+        }
+        if (decision === ArbiterDecision.Closed) {
+            console.log(
+                `クイズがアクティブではないので Player ${buttonId} の押下を無視`
+            );
+            return false;
+        }
+        if (decision === ArbiterDecision.Invalid) {
+            console.warn(
+                `無効なボタンID: ${buttonId} (有効範囲: 1-${quizState.players.length})`
+            );
+            return false;
+        }
+        if (decision === ArbiterDecision.Duplicate) {
+            console.log(`Player ${buttonId} は既に押下済み`);
+            return false;
+        }
+        if (decision === ArbiterDecision.LockedOut) {
+            console.log(`Player ${buttonId} はペナルティ中のため押下を無視`);
+            return false;
         }
 
+        // ボタン押下を記録（判定の順位をそのまま反映する）
+        syncPressedOrder();
         const player = quizState.players[playerIndex];
         if (!player) {
             console.warn(`Player not found for button ${buttonId}`);
-            return;
+            return false;
         }
 
-        // 既に押されている場合は無視
-        if (player.pressed) {
-            console.log(`Player ${buttonId} は既に押下済み`);
-            return;
-        }
-
-        // ボタン押下を記録
-        player.pressed = true;
-        player.order = quizState.pressedOrder.length + 1;
-        quizState.pressedOrder.push(buttonId);
-
         console.log(
             `Player ${buttonId} がボタンを押しました (${player.order}番目)`
         );
 
         // ボタン押下イベントをブロードキャスト
+        const emitStart = process.hrtime.bigint();
         io.emit("buttonPressed", { buttonId, timestamp: data.timestamp });
+        reportEmitTrace(data, emitStart, process.hrtime.bigint());
+        return true;
+    }
+    return false;
+}
 
-        // 更新された状態を全クライアントにブロードキャスト
+/**
+ * io.emit の開始・終了時刻を quiz-ingest に通知する（quiz-ingest --trace の遅延計測用）
+ *
+ * 時刻は process.hrtime（CLOCK_MONOTONIC）のナノ秒。シリアル直結時は送らない
+ */
+function reportEmitTrace(data: ArduinoData, start: bigint, end: bigint) {
+    if (!INGEST_SOCKET || data.seq === undefined) {
+        return;
+    }
+    sendControllerCommand(`TRACE EMIT ${data.seq} ${start} ${end}`);
+}
+
+// シリアルから直接受信したデータの行・フレームの切り出し（quiz-ingest と同じ C++ のコード）
+const lineFramer = createLineFramer();
+
+// 最後に順番通り受信したシーケンス番号（null: 未同期）
+let lastSeq: number | null = null;
+// 欠落検出後、RESYNC の応答待ちかどうか
+let resyncRequested = false;
+// 最後に RESYNC を送った時刻（Date.now()）
+let resyncSentAt = 0;
+// 受信データの処理後に ACK を返す必要があるか
+let ackDue = false;
+
+const questionRound: QuestionRound = {
+    round: null,
+    resetsPending: 0,
+    openedAt: 0,
+    clockOffset: null,
+};
+
+// Arduinoへコマンドを送信
+function sendControllerCommand(command: string) {
+    if (!controller) {
+        return;
+    }
+    const stream: NodeJS.WritableStream = controller;
+    stream.write(`${command}\n`);
+}
+
+// 接続時に送るコマンド: 切断中のイベントの再送と、状態の購読
+function requestControllerSync() {
+    // 切断中に送った RESET の応答は届かないことがある
+    questionRound.resetsPending = 0;
+    sendControllerCommand("RESYNC");
+    subscribeControllerState();
+    configureAnswerTimer();
+}
+
+/**
+ * 解答時間（answerTime 秒）をコントローラーに設定する
+ *
+ * 計時は最初の押下を受け付けた時点からコントローラーが行い、時間切れは answerTimeout で届く
+ * 設定は RAM にだけ保持されるため、接続・systemReady・recovered のたびに送り直す
+ */
+function configureAnswerTimer() {
+    sendControllerCommand(`ANSWER ${Math.max(0, Math.round(quizSetting.answerTime * 1000))}`);
+}
+
+const controllerState: ControllerState = {
+    version: null,
+    active: false,
+    round: 0,
+    pressed: [],
+    previousRound: 0,
+    previousPressed: [],
+    health: {},
+    updatedAt: 0,
+};
+
+/**
+ * 問題の開始に合わせてコントローラーのラウンドを開始する
+ *
+ * コントローラーは直前のラウンドの結果を残したまま次のラウンドを受け付けるため、
+ * 前の問題の押下の報告・ACK を待たずに RESET を送る。応答の systemReset までの間に届いた押下は時刻で振り分ける
+ */
+function openQuestionRound() {
+    questionRound.openedAt = Date.now();
+    if (!controller) {
+        return;
+    }
+    questionRound.round = null;
+    questionRound.resetsPending++;
+    sendControllerCommand("RESET");
+}
+
+/**
+ * systemReset のラウンド番号を現在の問題に対応付ける
+ *
+ * 送った RESET の応答をすべて受け取った時点のラウンドが現在の問題のもの
+ * （司会などが問題の途中で RESET した場合も、以降はそのラウンドの押下を数える）
+ */
+function applySystemReset(data: ArduinoData) {
+    if (questionRound.resetsPending > 0) {
+        questionRound.resetsPending--;
+    }
+    if (questionRound.resetsPending === 0 && data.round !== undefined) {
+        questionRound.round = data.round;
+    }
+}
+
+/**
+ * コントローラーの時刻とサーバーの時刻の差を更新する
+ *
+ * 受信時刻 - timestamp は転送遅延の分だけ大きくなるため最小値を使い、
+ * 水晶の誤差による差の変化には少しずつ追従する
+ */
+function observeControllerClock(data: ArduinoData) {
+    if (typeof data.timestamp !== "number") {
+        return;
+    }
+    const sample = Date.now() - data.timestamp;
+    if (questionRound.clockOffset === null || sample < questionRound.clockOffset) {
+        questionRound.clockOffset = sample;
+    } else {
+        questionRound.clockOffset += (sample - questionRound.clockOffset) / 256;
+    }
+}
+
+/**
+ * 押下が現在の問題のものかどうかを判定する
+ *
+ * ラウンドが分かっていればラウンド番号で、RESET の応答待ちの間は押下時刻が問題の開始より後かどうかで判定する
+ * （RESET がコントローラーに届く前に押されても、問題の開始後の押下は失わない）
+ */
+function belongsToQuestion(data: ArduinoData): boolean {
+    if (data.round === undefined) {
+        return true; // ラウンド番号なし（旧ファームウェア・シミュレーター）
+    }
+    if (questionRound.round !== null) {
+        return data.round === questionRound.round;
+    }
+    if (questionRound.clockOffset === null) {
+        return true;
+    }
+    return data.timestamp + questionRound.clockOffset >= questionRound.openedAt;
+}
+
+/**
+ * コントローラーの状態を購読する（STATUS のポーリングの代わり）
+ *
+ * コントローラーのリセットで購読は解除されるため、接続・systemReady・recovered のたびに送り直す
+ */
+function subscribeControllerState() {
+    controllerState.version = null;
+    controllerState.updatedAt = Date.now();
+    sendControllerCommand("SUBSCRIBE");
+}
+
+/**
+ * state / stateDelta / heartbeat を反映する
+ *
+ * 差分の版が連続していない場合（行の取りこぼし）はスナップショットを取り直す
+ */
+function applyControllerState(data: ArduinoData) {
+    if (data.version === undefined) {
+        return;
+    }
+    if (data.type === "state") {
+        controllerState.version = data.version;
+    } else if (
+        controllerState.version === null ||
+        data.version !==
+            (data.type === "stateDelta"
+                ? (controllerState.version + 1) & 0xffff
+                : controllerState.version)
+    ) {
+        if (controllerState.version !== null) {
+            console.warn(
+                `コントローラーの状態の版が一致しません (保持 ${controllerState.version}, 受信 ${data.version})`
+            );
+            subscribeControllerState();
+        }
+        return;
+    } else {
+        controllerState.version = data.version;
+    }
+
+    controllerState.updatedAt = Date.now();
+    let changed = data.type === "state";
+    if (data.active !== undefined) {
+        controllerState.active = data.active;
+        changed = true;
+    }
+    if (data.round !== undefined) {
+        controllerState.round = data.round;
+        changed = true;
+    }
+    if (data.pressed !== undefined) {
+        controllerState.pressed = data.pressed;
+        changed = true;
+    }
+    if (data.previousRound !== undefined) {
+        controllerState.previousRound = data.previousRound;
+        controllerState.previousPressed = data.previousPressed ?? [];
+        changed = true;
+    }
+    for (const key of CONTROLLER_HEALTH_KEYS) {
+        const value = data[key];
+        if (value === undefined) {
+            continue;
+        }
+        const previous = controllerState.health[key];
+        if (previous !== undefined && value > previous) {
+            console.warn(
+                `コントローラーの ${key} が増加しました (${previous} → ${value})`
+            );
+        }
+        controllerState.health[key] = value;
+    }
+
+    if (changed) {
+        io.emit("controllerState", {
+            active: controllerState.active,
+            round: controllerState.round,
+            pressed: controllerState.pressed,
+            previousRound: controllerState.previousRound,
+            previousPressed: controllerState.previousPressed,
+        });
+    }
+}
+
+// ハートビートが途絶えたら購読し直す（リセットを取りこぼした場合など）
+// 一度も state が届いていない場合（SUBSCRIBE 非対応のファームウェア・シミュレーター）は何もしない
+setInterval(() => {
+    if (
+        controller &&
+        controllerState.version !== null &&
+        Date.now() - controllerState.updatedAt > CONTROLLER_STATE_TIMEOUT
+    ) {
+        console.warn("コントローラーの状態通知が途絶えました。購読し直します");
+        subscribeControllerState();
+    }
+}, CONTROLLER_STATE_TIMEOUT);
+
+/**
+ * シーケンス番号を検査し、処理すべきイベントかどうかを判定する
+ *
+ * 重複（再送）は捨てて ACK だけ返し、欠落を検出した場合は
+ * 順序を保つため後続を捨てて RESYNC を要求する（Go-Back-N）
+ * RESYNC の応答が失われた場合に備え、欠落したままのイベントが届き続ける間は一定間隔で送り直す
+ */
+function acceptSequenced(data: ArduinoData): boolean {
+    if (data.type === "resync" && data.from !== undefined) {
+        // Arduino 側で既に破棄された番号は諦めて再送起点に合わせる
+        const expected = lastSeq === null ? null : (lastSeq + 1) & 0xffff;
+        if (expected !== null && expected !== data.from) {
+            console.warn(
+                `イベント ${expected} - ${(data.from - 1) & 0xffff} は失われました`
+            );
+        }
+        lastSeq = (data.from - 1) & 0xffff;
+        resyncRequested = false;
+        return false;
+    }
+
+    if (data.seq === undefined) {
+        return true; // シーケンス番号なし（旧ファームウェア・応答メッセージ）
+    }
+
+    // 起動直後のイベント、または未同期なら無条件に受け入れる
+    if (data.type === "systemReady" || lastSeq === null) {
+        lastSeq = data.seq;
+        ackDue = true;
+        return true;
+    }
+
+    const diff = (data.seq - lastSeq) & 0xffff;
+    if (diff === 1) {
+        lastSeq = data.seq;
+        resyncRequested = false;
+        ackDue = true;
+        return true;
+    }
+
+    if (diff === 0 || diff >= 0x8000) {
+        // 再送による重複
+        ackDue = true;
+        return false;
+    }
+
+    // 欠落あり: 後続は捨てて再送を要求
+    const now = Date.now();
+    if (!resyncRequested) {
+        console.warn(
+            `シーケンス欠落を検出 (期待値 ${(lastSeq + 1) & 0xffff}, 受信 ${data.seq})`
+        );
+    } else if (now - resyncSentAt >= RESYNC_RETRY_INTERVAL) {
+        console.warn(
+            `RESYNC の応答がないため送り直します (期待値 ${(lastSeq + 1) & 0xffff}, 受信 ${data.seq})`
+        );
+    } else {
+        return false;
+    }
+    resyncRequested = true;
+    resyncSentAt = now;
+    sendControllerCommand("RESYNC");
+    return false;
+}
+
+/**
+ * まとめて送られた押下（pressedButtons）を個別の押下イベントに展開する
+ *
+ * 各押下のシーケンス番号は先頭から連番、時刻は先頭からの経過時間で復元する
+ */
+function expandFrame(data: ArduinoData): ArduinoData[] {
+    if (data.type !== "pressedButtons" || !data.presses) {
+        return [data];
+    }
+    return data.presses.map(([buttonId, offset], index) => ({
+        type: "pressedButton",
+        buttonId,
+        round: data.round,
+        timestamp: data.timestamp + offset,
+        seq: data.seq === undefined ? undefined : (data.seq + index) & 0xffff,
+    }));
+}
+
+/**
+ * コントローラーがリセットから復帰したことを記録する
+ *
+ * ラウンドの状態とシーケンス番号はコントローラー側で引き継がれているため、
+ * systemReady と違って同期状態はリセットしない
+ */
+function reportRecovery(data: ArduinoData) {
+    console.warn(
+        `Arduino が ${data.reason ?? "不明な理由"} によるリセットから復帰しました (停止時間 約${data.downtime ?? "?"}ms)`
+    );
+    io.emit("controllerRecovered", {
+        reason: data.reason,
+        downtime: data.downtime,
+        timestamp: data.timestamp,
+    });
+}
+
+/**
+ * ボタンごとのデバウンス時間とバウンスの統計をクライアントへ通知する
+ */
+function reportDebounce(data: ArduinoData) {
+    io.emit("controllerDebounce", {
+        buttons: (data.window ?? []).map((window, index) => ({
+            buttonId: index + 1,
+            windowUs: window,
+            observed: data.observed?.[index] ?? 0,
+            edges: data.edges?.[index] ?? 0,
+            spanUs: data.span?.[index] ?? 0,
+            maxSpanUs: data.maxSpan?.[index] ?? 0,
+            gapUs: data.gap?.[index] ?? 0,
+            chatter: data.chatter?.[index] ?? 0,
+        })),
+        timestamp: data.timestamp,
+    });
+}
+
+/**
+ * トリガー入力によるラウンドの開始とフライングをクライアントへ通知する（ENABLE_TRIGGER_INPUT）
+ *
+ * フライングしたボタンはそのラウンドの間コントローラーが押下として扱わないため、押下順には入らない
+ */
+function reportTrigger(data: ArduinoData) {
+    if (data.type === "armed") {
+        io.emit("roundArmed", { timestamp: data.timestamp });
+    } else {
+        console.log(`ボタン ${data.buttonId} がフライングしました`);
+        io.emit("falseStart", { buttonId: data.buttonId, timestamp: data.timestamp });
+    }
+}
+
+/**
+ * コントローラーが計った解答時間の切れをクライアントへ通知する（ENABLE_ANSWER_TIMER）
+ *
+ * 前の問題のものと、判定の後に届いたもの（解答者が変わっている）は通知しない
+ */
+function reportAnswerTimeout(data: ArduinoData) {
+    if (!belongsToQuestion(data) || quizState.pressedOrder[0] !== data.buttonId) {
+        console.log(`ボタン ${data.buttonId} の解答時間切れは現在の解答者のものではないので無視`);
+        return;
+    }
+    console.log(`Player ${data.buttonId} の解答時間が切れました`);
+    io.emit("answerTimeout", { playerId: data.buttonId, timestamp: data.timestamp });
+}
+
+/**
+ * コントローラーが判定したジェスチャー（連打・長押し）をクライアントへ通知する（ENABLE_GESTURES）
+ *
+ * 押下・解放の時刻はコントローラーが計っているため、シリアルの転送の遅れを含まない
+ * 前の問題のもの（RESET の前に離された連打）は通知しない
+ */
+function reportGesture(data: ArduinoData) {
+    if (!belongsToQuestion(data)) {
+        return;
+    }
+    io.emit("gesture", {
+        playerId: data.buttonId,
+        gesture: data.gesture,
+        taps: data.taps,
+        hold: data.hold,
+        total: data.total,
+        timestamp: data.timestamp,
+    });
+}
+
+/**
+ * 校正結果をクライアントへ通知する
+ */
+function reportCalibration(data: ArduinoData) {
+    if (data.button !== undefined) {
+        console.log(
+            `ボタン ${data.button} の検出遅延: ${data.latency?.[data.button - 1] ?? "?"}µs (補正量 ${data.offset?.join(", ") ?? "?"}µs)`
+        );
+    }
+    io.emit("controllerCalibration", {
+        button: data.button,
+        latency: data.latency,
+        offset: data.offset,
+        timestamp: data.timestamp,
+    });
+}
+
+/**
+ * 反応時間の統計をクライアントへ通知する
+ */
+function reportAnalytics(data: ArduinoData) {
+    io.emit("controllerAnalytics", {
+        players: (data.players ?? []).map((stats, index) => ({
+            playerId: index + 1,
+            count: stats[0] ?? 0,
+            mean: stats[1],
+            stdDev: stats[2],
+            p50: stats[3],
+            p90: stats[4],
+            p99: stats[5],
+        })),
+        timestamp: data.timestamp,
+    });
+}
+
+/**
+ * 受信したイベント群を処理する（状態のブロードキャストと ACK は最後に1回だけ）
+ */
+function processControllerEvents(events: ArduinoData[]) {
+    let stateChanged = false;
+    for (const event of events) {
+        observeControllerClock(event);
+        if (acceptSequenced(event)) {
+            if (event.type === "recovered") {
+                reportRecovery(event);
+            }
+            if (event.type === "systemReady") {
+                // ラウンド番号と時刻は起動からやり直しになる
+                questionRound.round = null;
+                questionRound.resetsPending = 0;
+                questionRound.clockOffset = null;
+            }
+            if (event.type === "systemReady" || event.type === "recovered") {
+                subscribeControllerState();
+                configureAnswerTimer();
+            } else if (event.type === "systemReset") {
+                applySystemReset(event);
+            } else if (
+                event.type === "state" ||
+                event.type === "stateDelta" ||
+                event.type === "heartbeat"
+            ) {
+                applyControllerState(event);
+            } else if (event.type === "calibration") {
+                reportCalibration(event);
+            } else if (event.type === "analytics") {
+                reportAnalytics(event);
+            } else if (event.type === "debounce") {
+                reportDebounce(event);
+            } else if (event.type === "armed" || event.type === "falseStart") {
+                reportTrigger(event);
+            } else if (event.type === "answerTimeout") {
+                reportAnswerTimeout(event);
+            } else if (event.type === "gesture") {
+                reportGesture(event);
+            }
+            stateChanged = registerButtonPress(event) || stateChanged;
+        }
+    }
+
+    if (ackDue) {
+        sendControllerCommand(`ACK ${lastSeq}`);
+        ackDue = false;
+    }
+    if (stateChanged) {
         broadcastState();
     }
 }
 
-// グローバルバッファでデータを蓄積
-let dataBuffer = "";
+// Arduino から届いた1行（1フレームの本文）を解析してイベントに追加
+function parseControllerLine(line: string, events: ArduinoData[]) {
+    const trimmedLine = line.trim();
+    if (!trimmedLine) {
+        return;
+    }
+    console.log("Arduino からのデータ:", trimmedLine);
+
+    try {
+        const buttonData = JSON.parse(trimmedLine) as ArduinoData;
+        events.push(...expandFrame(buttonData));
+    } catch (error) {
+        console.error("データの解析エラー:", error, "受信データ:", trimmedLine);
+        // 不正なJSONの場合は無視して継続
+    }
+}
+
+// Arduino から直接届く JSON 行（または COBS フレーム）を処理
+function handleLineData(data: Buffer) {
+    const events: ArduinoData[] = [];
+    const wasFramed = lineFramer.isFramed();
+    const badFrames = lineFramer.badFrameCount();
+    for (const line of lineFramer.push(data)) {
+        parseControllerLine(line, events);
+    }
+    if (lineFramer.isFramed() !== wasFramed) {
+        console.log(
+            lineFramer.isFramed()
+                ? "コントローラーは COBS フレームで送信しています"
+                : "コントローラーは改行区切りの行で送信しています"
+        );
+    }
+    if (lineFramer.badFrameCount() !== badFrames) {
+        // ノイズやデバッグ出力: 次の 0x00 から読み直す
+        console.error(`壊れたフレームを破棄しました (${lineFramer.badFrameCount() - badFrames} 件)`);
+    }
+    processControllerEvents(events);
+}
+
+// quiz-ingest のレコード（legacy/host/include/IngestRecord.h）
+const INGEST_HEADER_SIZE = 24;
+const INGEST_FLAG_HAS_SEQ = 0x0001;
+const INGEST_FLAG_HAS_ROUND = 0x0004;
+const INGEST_KIND_TYPES: Record<number, string> = {
+    1: "pressedButton",
+    2: "systemReset",
+    3: "error",
+    4: "systemReady",
+    5: "resync",
+    8: "recovered",
+    9: "armed",
+    10: "falseStart",
+    12: "answerTimeout",
+};
+// 元の行をペイロードとして転送する種別（status / state / heartbeat などと recovered・gesture）
+const INGEST_RAW_KINDS = new Set([7, 8, 13]);
+const INGEST_KIND_LINK_UP = 16;
+const INGEST_KIND_LINK_DOWN = 17;
+let ingestBuffer: Buffer = Buffer.alloc(0);
+
+// quiz-ingest から届くバイナリレコードを処理（JSON の解析は quiz-ingest 側で済んでいる）
+function handleIngestData(data: Buffer) {
+    ingestBuffer =
+        ingestBuffer.length > 0 ? Buffer.concat([ingestBuffer, data]) : data;
+
+    const events: ArduinoData[] = [];
+    let offset = 0;
+    while (ingestBuffer.length - offset >= INGEST_HEADER_SIZE) {
+        const length = ingestBuffer.readUInt16LE(offset);
+        if (length < INGEST_HEADER_SIZE) {
+            console.error("quiz-ingest のレコードが不正です");
+            offset = ingestBuffer.length;
+            break;
+        }
+        if (ingestBuffer.length - offset < length) {
+            break;
+        }
+
+        const kind = ingestBuffer.readUInt8(offset + 2);
+        const flags = ingestBuffer.readUInt16LE(offset + 6);
+        const type = INGEST_KIND_TYPES[kind];
+        if (INGEST_RAW_KINDS.has(kind)) {
+            // 固定ヘッダーに収まらない項目はペイロードの元の行から取り出す
+            const payload = ingestBuffer.toString(
+                "utf8",
+                offset + INGEST_HEADER_SIZE,
+                offset + length
+            );
+            try {
+                events.push(JSON.parse(payload) as ArduinoData);
+            } catch (error) {
+                console.error("データの解析エラー:", error, "受信データ:", payload);
+            }
+        } else if (type) {
+            events.push({
+                type,
+                buttonId: ingestBuffer.readUInt8(offset + 3),
+                seq:
+                    flags & INGEST_FLAG_HAS_SEQ
+                        ? ingestBuffer.readUInt16LE(offset + 4)
+                        : undefined,
+                timestamp: ingestBuffer.readUInt32LE(offset + 8),
+                from: ingestBuffer.readUInt16LE(offset + 12),
+                round:
+                    flags & INGEST_FLAG_HAS_ROUND
+                        ? ingestBuffer.readUInt16LE(offset + 14)
+                        : undefined,
+                message: ingestBuffer.toString(
+                    "utf8",
+                    offset + INGEST_HEADER_SIZE,
+                    offset + length
+                ),
+            });
+        } else if (kind === INGEST_KIND_LINK_UP) {
+            console.log("Arduino接続完了! (quiz-ingest)");
+            requestControllerSync();
+        } else if (kind === INGEST_KIND_LINK_DOWN) {
+            console.warn("Arduino が切断されました (quiz-ingest)");
+        }
+        offset += length;
+    }
+    ingestBuffer = ingestBuffer.subarray(offset);
+    processControllerEvents(events);
+}
 
 // シリアル通信初期化
 async function initializeSerial() {
@@ -537,49 +1409,33 @@ async function initializeSerial() {
         return;
     }
 
-    controller.on("data", (data: Buffer) => {
-        // 受信データをバッファに追加
-        dataBuffer += data.toString();
-
-        // 改行文字で区切ってメッセージを分割
-        const lines = dataBuffer.split("\n");
-
-        // 最後の要素（未完成の可能性がある）をバッファに残す
-        dataBuffer = lines.pop() || "";
-
-        // 完成したメッセージを処理
-        lines.forEach((line) => {
-            const trimmedLine = line.trim();
-            if (trimmedLine) {
-                console.log("Arduino からのデータ:", trimmedLine);
-
-                try {
-                    const buttonData = JSON.parse(trimmedLine) as ArduinoData;
-                    handleButtonPress(buttonData);
-                } catch (error) {
-                    console.error(
-                        "データの解析エラー:",
-                        error,
-                        "受信データ:",
-                        trimmedLine
-                    );
-                    // 不正なJSONの場合は無視して継続
-                }
-            }
-        });
-    });
+    controller.on("data", INGEST_SOCKET ? handleIngestData : handleLineData);
 
     if (controller instanceof SerialPort) {
         controller.on("open", () => {
             console.log("Arduino接続完了!");
+            lineFramer.clear();
+            // 切断中に送られたイベントを再送してもらい、状態を購読し直す
+            requestControllerSync();
         });
 
         controller.on("error", (err) => {
             console.error("シリアルポートエラー:", err);
         });
+    } else if (INGEST_SOCKET) {
+        // シリアルポートの再接続は quiz-ingest が LinkUp レコードで通知する
+        controller.on("connect", () => {
+            console.log("quiz-ingest 接続完了!");
+            requestControllerSync();
+        });
+
+        controller.on("error", (err) => {
+            console.error("quiz-ingest 接続エラー:", err);
+        });
     } else {
         controller.on("connect", () => {
             console.log("Arduino シミュレーター接続完了!");
+            requestControllerSync();
         });
 
         controller.on("error", (err) => {